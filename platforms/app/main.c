@@ -5,6 +5,8 @@
 //  All rights reserved.
 //
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -29,6 +31,18 @@
 #include "m3_api_tracer.h"
 #endif
 
+#if defined(d_m3HasWASI) && !defined(_WIN32) && !defined(__wasi__) && !defined(__EMSCRIPTEN__)
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#define LISTEN_SOCKETS
+#endif
+
+#if defined(d_m3HasWASI) && !defined(_WIN32)
+#define WASI_IMAGE
+#endif
+
 // TODO: remove
 #include "m3_env.h"
 
@@ -40,20 +54,23 @@
 #define GAS_LIMIT       500000000
 #define GAS_FACTOR      10000LL
 
-#define MAX_MODULES     16
-
 #define FATAL(msg, ...) { fprintf(stderr, "Error: [Fatal] " msg "\n", ##__VA_ARGS__); goto _onfatal; }
 
 
 static IM3Environment env;
 static IM3Runtime runtime;
 
-static u8* wasm_bins[MAX_MODULES];
-static int wasm_bins_qty = 0;
+#if defined(WASI_IMAGE)
+static const char* wasi_image = NULL;
+#endif
 
 static
 bool g_full_compile_timer = false;
 
+static const char* g_profile_path = NULL;
+static bool g_profiling = false;
+static bool g_op_stats = false;
+
 static
 uint64_t monotonic_raw_time_ns (void)
 {
@@ -103,6 +120,8 @@ uint64_t monotonic_raw_time_ns (void)
 static int64_t initial_gas = GAS_FACTOR * GAS_LIMIT;
 static int64_t current_gas = GAS_FACTOR * GAS_LIMIT;
 static bool is_gas_metered = false;
+static bool is_gas_limit_set = false;
+static bool is_fuel_metered = false;
 
 m3ApiRawFunction(metering_usegas)
 {
@@ -119,32 +138,63 @@ m3ApiRawFunction(metering_usegas)
 #endif // GAS_LIMIT
 
 
-M3Result link_all  (IM3Module module)
+static
+M3Result register_all  (IM3ImportRegistry registry)
 {
     M3Result res;
-    res = m3_LinkSpecTest (module);
+    res = m3_RegisterSpecTest (registry);
     if (res) return res;
 
-    res = m3_LinkLibC (module);
+    res = m3_RegisterLibC (registry);
     if (res) return res;
 
 #if defined(LINK_WASI)
-    res = m3_LinkWASI (module);
+    res = m3_RegisterWASI (registry);
     if (res) return res;
 #endif
 
 #if defined(d_m3HasTracer)
-    res = m3_LinkTracer (module);
+    res = m3_RegisterTracer (registry);
     if (res) return res;
 #endif
 
+    return res;
+}
+
+M3Result link_all  (IM3Module module)
+{
+    static IM3ImportRegistry registry = NULL;
+
+    M3Result res;
+    if (!registry) {
+        registry = m3_NewImportRegistry ();
+        if (!registry) return m3Err_mallocFailed;
+
+        res = register_all (registry);
+        if (res) {
+            m3_FreeImportRegistry (registry);
+            registry = NULL;
+            return res;
+        }
+    }
+
+    res = m3_LinkImportRegistry (module, registry, NULL, NULL);
+    if (res) return res;
+
 #if defined(GAS_LIMIT)
     res = m3_LinkRawFunction (module, "metering", "usegas", "v(i)", &metering_usegas);
     if (!res) {
         fprintf(stderr, "Warning: Gas is limited to %0.4f\n", (double)(current_gas) / GAS_FACTOR);
         is_gas_metered = true;
     }
-    if (res == m3Err_functionLookupFailed) { res = NULL; }
+    if (res == m3Err_functionLookupFailed) {
+        res = NULL;
+        // not instrumented: fall back to the interpreter's own fuel accounting, counted in wasm instructions
+        if (is_gas_limit_set && !m3_SetFuel (runtime, initial_gas / GAS_FACTOR)) {
+            fprintf(stderr, "Warning: Fuel is limited to %" PRIi64 " instructions\n", (int64_t)(initial_gas / GAS_FACTOR));
+            is_fuel_metered = true;
+        }
+    }
 #endif
 
     return res;
@@ -166,39 +216,7 @@ M3Result repl_load  (const char* fn)
     M3Result result = m3Err_none;
     IM3Module module = NULL;
 
-    u8* wasm = NULL;
-    u32 fsize = 0;
-
-    FILE* f = fopen (fn, "rb");
-    if (!f) {
-        return "cannot open file";
-    }
-    fseek (f, 0, SEEK_END);
-    fsize = ftell(f);
-    fseek (f, 0, SEEK_SET);
-
-    if (fsize < 8) {
-        result = "file is too small";
-        goto on_error;
-    } else if (fsize > 256*1024*1024) {
-        result = "file is too big";
-        goto on_error;
-    }
-
-    wasm = (u8*) malloc(fsize);
-    if (!wasm) {
-        result = "cannot allocate memory for wasm binary";
-        goto on_error;
-    }
-
-    if (fread (wasm, 1, fsize, f) != fsize) {
-        result = "cannot read file";
-        goto on_error;
-    }
-    fclose (f);
-    f = NULL;
-
-    result = m3_ParseModule (env, &module, wasm, fsize);
+    result = m3_ParseModuleFile (env, &module, fn);
     if (result) goto on_error;
 
     result = m3_LoadModule (runtime, module);
@@ -209,16 +227,10 @@ M3Result repl_load  (const char* fn)
     result = link_all (module);
     if (result) goto on_error;
 
-    if (wasm_bins_qty < MAX_MODULES) {
-        wasm_bins[wasm_bins_qty++] = wasm;
-    }
-
     return result;
 
 on_error:
     m3_FreeModule(module);
-    if (wasm) free(wasm);
-    if (f) fclose(f);
 
     return result;
 }
@@ -275,10 +287,97 @@ void print_gas_used()
 #if defined(GAS_LIMIT)
     if (is_gas_metered) {
         fprintf(stderr, "Gas used: %0.4f\n", (double)(initial_gas - current_gas) / GAS_FACTOR);
+    } else if (is_fuel_metered) {
+        fprintf(stderr, "Fuel used: %" PRIu64 "\n", (uint64_t)(initial_gas / GAS_FACTOR) - m3_GetFuel(runtime));
     }
 #endif
 }
 
+void start_profile()
+{
+    if (!g_profile_path) return;
+
+    M3Result result = m3_StartSampling(runtime, 1000);
+    if (result) {
+        fprintf(stderr, "Warning: --profile: %s\n", result);
+    }
+    g_profiling = !result;
+}
+
+void stop_profile()
+{
+    if (!g_profiling) return;
+
+    g_profiling = false;
+    M3Result result = m3_StopSampling(runtime, g_profile_path);
+    if (result) {
+        fprintf(stderr, "Warning: --profile: %s\n", result);
+    }
+}
+
+static const uint64_t* g_sorted_counts;
+
+static
+int compare_op_counts (const void* a, const void* b)
+{
+    uint64_t x = g_sorted_counts[*(const uint32_t*)a];
+    uint64_t y = g_sorted_counts[*(const uint32_t*)b];
+    return (x < y) - (x > y);
+}
+
+static
+void sort_ops (uint32_t* order, const uint64_t* counts, uint32_t numOps)
+{
+    for (uint32_t i = 0; i < numOps; i++) {
+        order[i] = i;
+    }
+    g_sorted_counts = counts;
+    qsort(order, numOps, sizeof(uint32_t), compare_op_counts);
+}
+
+// prints and resets the op counters after each call, busiest ops and functions first
+void print_op_stats()
+{
+    if (!g_op_stats) return;
+
+    IM3ProfilerStats stats = m3_GetProfilerStats(runtime);
+    if (!stats) {
+        fprintf(stderr, "Warning: --op-stats: counters not available (needs d_m3EnableOpProfiling)\n");
+        return;
+    }
+
+    uint32_t* order = malloc(stats->numOps * sizeof(uint32_t) + 1);
+    if (!order) return;
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < stats->numOps; i++) {
+        total += stats->opCounts[i];
+    }
+    double percent = total ? 100.0 / total : 0;
+
+    fprintf(stderr, "==== op stats: %" PRIu64 " ops executed\n", total);
+    sort_ops(order, stats->opCounts, stats->numOps);
+    for (uint32_t i = 0; i < stats->numOps && stats->opCounts[order[i]]; i++) {
+        uint64_t count = stats->opCounts[order[i]];
+        fprintf(stderr, "%13" PRIu64 " %5.1f%%  %s\n", count, count * percent, stats->opNames[order[i]]);
+    }
+
+    fprintf(stderr, "==== op stats by function\n");
+    for (uint32_t f = 0; f < stats->numFunctions && f < 20; f++) {
+        const M3FunctionProfile* fn = &stats->functions[f];
+        fprintf(stderr, "%13" PRIu64 " %5.1f%%  %s (%" PRIu64 " calls)\n", fn->numOpsExecuted,
+                fn->numOpsExecuted * percent, m3_GetFunctionName(fn->function), fn->calls);
+
+        sort_ops(order, fn->opCounts, stats->numOps);
+        for (uint32_t i = 0; i < stats->numOps && i < 5 && fn->opCounts[order[i]]; i++) {
+            fprintf(stderr, "%13s %13" PRIu64 "  %s\n", "", fn->opCounts[order[i]], stats->opNames[order[i]]);
+        }
+    }
+
+    free(order);
+    m3_ResetProfilerStats(runtime);
+}
+
 void print_backtrace()
 {
     IM3BacktraceInfo info = m3_GetBacktrace(runtime);
@@ -327,7 +426,11 @@ M3Result repl_call  (const char* name, int argc, const char* argv[])
         wasi_ctx->argc = argc;
         wasi_ctx->argv = argv;
 
+        start_profile();
         result = m3_CallArgv(func, 0, NULL);
+        stop_profile();
+        print_op_stats();
+        m3_FlushWASI();
 
         print_gas_used();
 
@@ -349,7 +452,13 @@ M3Result repl_call  (const char* name, int argc, const char* argv[])
         return "too many arguments";
     }
 
+    start_profile();
     result = m3_CallArgv (func, argc, argv);
+    stop_profile();
+    print_op_stats();
+#if defined(LINK_WASI)
+    m3_FlushWASI();
+#endif
 
     print_gas_used();
 
@@ -530,11 +639,6 @@ void repl_free  ()
         m3_FreeRuntime (runtime);
         runtime = NULL;
     }
-
-    for (int i = 0; i < wasm_bins_qty; i++) {
-        free (wasm_bins[i]);
-        wasm_bins[i] = NULL;
-    }
 }
 
 M3Result repl_init  (unsigned stack)
@@ -544,9 +648,57 @@ M3Result repl_init  (unsigned stack)
     if (runtime == NULL) {
         return "m3_NewRuntime failed";
     }
+#if defined(WASI_IMAGE)
+    if (wasi_image) {
+        return m3_MountWASIImage (runtime, wasi_image);
+    }
+#endif
     return m3Err_none;
 }
 
+#if defined(LISTEN_SOCKETS)
+
+// opens a TCP listener on "[host:]port" (all interfaces when the host is omitted)
+static
+M3Result open_listener  (const char* addr, int* o_fd)
+{
+    char host[256] = "";
+    const char* port = strrchr(addr, ':');
+    if (port) {
+        size_t len = port - addr;
+        if (len >= sizeof(host)) return "listen address too long";
+        memcpy(host, addr, len);
+        host[len] = 0;
+        port++;
+    } else {
+        port = addr;
+    }
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE;
+    if (getaddrinfo(host[0] ? host : NULL, port, &hints, &res) != 0) return "cannot resolve listen address";
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    int one = 1;
+    if (fd < 0 or
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 or
+        bind(fd, res->ai_addr, res->ai_addrlen) != 0 or
+        listen(fd, SOMAXCONN) != 0)
+    {
+        if (fd >= 0) close(fd);
+        freeaddrinfo(res);
+        return "cannot listen on address";
+    }
+    freeaddrinfo(res);
+
+    return m3_PreopenSocketWASI(fd, o_fd);
+}
+
+#endif // LISTEN_SOCKETS
+
 static
 void unescape(char* buff)
 {
@@ -623,7 +775,15 @@ void print_usage() {
     puts("  --compile             disable lazy compilation");
     puts("  --timer               print full compile time");
     puts("  --dump-on-trap        dump wasm memory");
-    puts("  --gas-limit           set gas limit");
+    puts("  --gas-limit           set gas limit (native fuel if the module is not instrumented)");
+    puts("  --profile <file>      write sampled wasm call stacks (folded format; needs d_m3EnableSampling)");
+    puts("  --op-stats            print executed ops, overall and per function (needs d_m3EnableOpProfiling)");
+#if defined(LISTEN_SOCKETS)
+    puts("  --listen <[host:]port> pre-open a listening TCP socket (WASI fd 5, 6, ...)");
+#endif
+#if defined(WASI_IMAGE)
+    puts("  --image <file.tar>    serve the WASI preopens from a tar image held in memory");
+#endif
 }
 
 #define ARGV_SHIFT()  { i_argc--; i_argv++; }
@@ -675,12 +835,30 @@ int  main  (int i_argc, const char* i_argv[])
             const char* tmp = "0";
             ARGV_SET(tmp);
             initial_gas = current_gas = GAS_FACTOR * atol(tmp);
+            is_gas_limit_set = true;
         } else if (!strcmp("--dir", arg)) {
             const char* argDir;
             ARGV_SET(argDir);
             (void)argDir;
+        } else if (!strcmp("--profile", arg)) {
+            ARGV_SET(g_profile_path);
+        } else if (!strcmp("--op-stats", arg)) {
+            g_op_stats = true;
         } else if (!strcmp("--func", arg) or !strcmp("-f", arg)) {
             ARGV_SET(argFunc);
+#if defined(LISTEN_SOCKETS)
+        } else if (!strcmp("--listen", arg)) {
+            const char* argAddr = NULL;
+            ARGV_SET(argAddr);
+            if (!argAddr) FATAL("--listen needs an address");
+            int fd;
+            result = open_listener(argAddr, &fd);
+            if (result) FATAL("--listen %s: %s", argAddr, result);
+#endif
+#if defined(WASI_IMAGE)
+        } else if (!strcmp("--image", arg)) {
+            ARGV_SET(wasi_image);
+#endif
         }
     }
 
@@ -10,6 +10,9 @@
 #include <string>
 #include <iterator>
 #include <cassert>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
 
 extern "C"
 {
@@ -27,22 +30,34 @@ namespace wasm3 {
 
         typedef const void *(*m3_api_raw_fn)(IM3Runtime, uint64_t *, void *);
 
+        /* reads an argument straight from its stack slot; pointers are translated from wasm memory offsets */
         template<typename T>
-        void arg_from_stack(T &dest, stack_type &_sp, [[maybe_unused]] mem_type mem) {
-            m3ApiGetArg(T, tmp);
-            dest = tmp;
+        T arg_from_slot(const uint64_t *slot, [[maybe_unused]] mem_type mem) {
+            if constexpr (std::is_pointer<T>::value) {
+                return reinterpret_cast<T>(static_cast<uint8_t *>(mem) + *reinterpret_cast<const uint32_t *>(slot));
+            } else {
+                return *reinterpret_cast<const T *>(slot);
+            }
         }
 
+        /* i32/f32 occupy the low-address bytes of a slot */
         template<typename T>
-        void arg_from_stack(T* &dest, stack_type &_sp, [[maybe_unused]] mem_type _mem) {
-            m3ApiGetArgMem(T*, tmp);
-            dest = tmp;
-        };
+        void value_to_slot(M3Value &slot, T value) {
+            static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "unsupported wasm value type");
+            std::memcpy(&slot, &value, sizeof(T));
+        }
 
         template<typename T>
-        void arg_from_stack(const T* &dest, stack_type &_sp, [[maybe_unused]] mem_type _mem) {
-            m3ApiGetArgMem(const T*, tmp);
-            dest = tmp;
+        T value_from_slot(const M3Value &slot) {
+            static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "unsupported wasm value type");
+            T value;
+            std::memcpy(&value, &slot, sizeof(T));
+            return value;
+        }
+
+        struct cached_function {
+            IM3Function func;
+            std::shared_ptr<M3PreparedCall> call;
         };
 
         template<char c>
@@ -68,26 +83,24 @@ namespace wasm3 {
         template<> struct m3_type_to_sig<void>    : m3_sig<'v'> {};
         template<> struct m3_type_to_sig<void *>  : m3_sig<'*'> {};
         template<> struct m3_type_to_sig<const void *> : m3_sig<'*'> {};
+        template<typename T> struct m3_type_to_sig<T *, std::enable_if_t<!std::is_void<T>::value>> : m3_sig<'*'> {};
 
 
+        /* the signature string is built at compile time, e.g. m3_signature<double, double, double>::value == "F(FF)" */
         template<typename Ret, typename ... Args>
         struct m3_signature {
-            constexpr static size_t n_args = sizeof...(Args);
-            constexpr static const char value[n_args + 4] = {
+            static constexpr size_t n_args = sizeof...(Args);
+            static constexpr char value[n_args + 4] = {
                     m3_type_to_sig<Ret>::value,
                     '(',
                     m3_type_to_sig<Args>::value...,
                     ')',
                     0
             };
-        };
 
-        template <typename ...Args>
-        static void get_args_from_stack(stack_type &sp, mem_type mem, std::tuple<Args...> &tuple) {
-            std::apply([&](auto &... item) {
-                (arg_from_stack(item, sp, mem), ...);
-            }, tuple);
-        }
+            /* no memory pointers: the function can be linked as a typed import (m3_LinkTypedFunction) */
+            static constexpr bool is_plain = !std::is_pointer<Ret>::value && (!std::is_pointer<Args>::value && ...);
+        };
 
         template<typename Func>
         struct wrap_helper;
@@ -95,26 +108,21 @@ namespace wasm3 {
         template <typename Ret, typename ...Args>
         struct wrap_helper<Ret(Args...)> {
             using Func = Ret(Args...);
-            static const void *wrap_fn([[maybe_unused]] IM3Runtime rt, IM3ImportContext _ctx, stack_type _sp, mem_type mem) {
-                std::tuple<Args...> args;
-                // The order here matters: m3ApiReturnType should go before calling get_args_from_stack,
-                // since both modify `_sp`, and the return value on the stack is reserved before the arguments.
-                m3ApiReturnType(Ret);
-                get_args_from_stack(_sp, mem, args);
-                Func* function = reinterpret_cast<Func*>(_ctx->userdata);
-                Ret r = std::apply(function, args);
-                m3ApiReturn(r);
+            static constexpr size_t n_rets = std::is_void<Ret>::value ? 0 : 1;
+
+            template <size_t ...I>
+            static Ret invoke(Func *function, const uint64_t *args, mem_type mem, std::index_sequence<I...>) {
+                return function(arg_from_slot<Args>(args + I, mem)...);
             }
-        };
 
-        template <typename ...Args>
-        struct wrap_helper<void(Args...)> {
-            using Func = void(Args...);
-            static const void *wrap_fn([[maybe_unused]] IM3Runtime rt, IM3ImportContext _ctx, stack_type sp, mem_type mem) {
-                std::tuple<Args...> args;
-                get_args_from_stack(sp, mem, args);
+            static const void *wrap_fn([[maybe_unused]] IM3Runtime rt, IM3ImportContext _ctx, stack_type _sp, mem_type mem) {
                 Func* function = reinterpret_cast<Func*>(_ctx->userdata);
-                std::apply(function, args);
+                // the return value slot is reserved before the arguments
+                if constexpr (std::is_void<Ret>::value) {
+                    invoke(function, _sp, mem, std::index_sequence_for<Args...>{});
+                } else {
+                    *reinterpret_cast<Ret *>(_sp) = invoke(function, _sp + n_rets, mem, std::index_sequence_for<Args...>{});
+                }
                 m3ApiSuccess();
             }
         };
@@ -129,9 +137,20 @@ namespace wasm3 {
                                  const char *const i_moduleName,
                                  const char *const i_functionName,
                                  Ret (*function)(Args...)) {
+                using signature = m3_signature<Ret, Args...>;
+
+                if constexpr (signature::is_plain) {
+                    // the runtime calls the function directly; falls back to the wrapper for shapes it has no thunk for
+                    M3Result res = m3_LinkTypedFunction(io_module, i_moduleName, i_functionName,
+                                                        signature::value,
+                                                        reinterpret_cast<M3TypedCall>(function));
+                    if (res != m3Err_typedImportUnsupported) {
+                        return res;
+                    }
+                }
 
                 return m3_LinkRawFunctionEx(io_module, i_moduleName, i_functionName,
-                                            m3_signature<Ret, Args...>::value,
+                                            signature::value,
                                             &wrap_helper<Ret(Args...)>::wrap_fn,
                                             reinterpret_cast<void*>(function));
             }
@@ -142,6 +161,7 @@ namespace wasm3 {
     class wasm_module;
     class wasm_runtime;
     class wasm_function;
+    class wasm_memory;
 
     /**
      * Exception thrown for wasm3 errors.
@@ -230,6 +250,13 @@ namespace wasm3 {
          */
         wasm_function find_function(const char *name);
 
+        /**
+         * Bounds-checked view of the linear memory
+         *
+         * The view is invalidated when the memory grows.
+         */
+        wasm_memory memory();
+
     protected:
         friend class wasm_environment;
 
@@ -239,11 +266,14 @@ namespace wasm3 {
             if (m_runtime == nullptr) {
                 throw std::bad_alloc();
             }
+            m_functions = std::make_shared<std::unordered_map<std::string, detail::cached_function>>();
         }
 
         /* runtime extends the lifetime of the environment */
         std::shared_ptr<M3Environment> m_env;
         std::shared_ptr<M3Runtime> m_runtime;
+        /* prepared calls of functions already looked up, shared by copies of this runtime */
+        std::shared_ptr<std::unordered_map<std::string, detail::cached_function>> m_functions;
     };
 
     /**
@@ -371,32 +401,113 @@ namespace wasm3 {
          */
         template<typename Ret = void, typename ... Args>
         Ret call(Args... args) {
-            std::array<const void*, sizeof...(args)> arg_ptrs{ reinterpret_cast<const void*>(&args)... };
-            M3Result res = m3_Call(m_func, arg_ptrs.size(), arg_ptrs.data());
+            if (sizeof...(Args) != m3_GetArgCount(m_func)) {
+                throw error(m3Err_argumentCountMismatch);
+            }
+            assert(check_arg_types<Args...>());
+
+            // arguments are written straight into the prepared call's slots
+            M3Value *slots = m3_GetPreparedArgs(m_call.get());
+            [[maybe_unused]] size_t i = 0;
+            (detail::value_to_slot(slots[i++], args), ...);
+
+            M3Result res = m3_CallPrepared(m_call.get());
             detail::check_error(res);
 
             if constexpr (!std::is_void<Ret>::value) {
-                Ret ret;
-                const void* ret_ptrs[] = { &ret };
-                res = m3_GetResults(m_func, 1, ret_ptrs);
-                detail::check_error(res);
-                return ret; 
+                return detail::value_from_slot<Ret>(m3_GetPreparedResults(m_call.get())[0]);
             }
         }
 
     protected:
         friend class wasm_runtime;
 
-        wasm_function(const std::shared_ptr<M3Runtime> &runtime, const char *name) : m_runtime(runtime) {
-            M3Result err = m3_FindFunction(&m_func, runtime.get(), name);
-            detail::check_error(err);
-            assert(m_func != nullptr);
+        wasm_function(const std::shared_ptr<M3Runtime> &runtime, const detail::cached_function &cached)
+                : m_runtime(runtime), m_call(cached.call), m_func(cached.func) {}
+
+        template<typename ... Args>
+        bool check_arg_types() const {
+            [[maybe_unused]] uint32_t i = 0;
+            return ((m3_GetArgType(m_func, i++) == value_type<Args>()) && ...);
+        }
+
+        template<typename T>
+        static M3ValueType value_type() {
+            if constexpr (std::is_enum<T>::value) return value_type<std::underlying_type_t<T>>();
+            else if constexpr (std::is_same<T, float>::value) return c_m3Type_f32;
+            else if constexpr (std::is_same<T, double>::value) return c_m3Type_f64;
+            else if constexpr (sizeof(T) == sizeof(int64_t)) return c_m3Type_i64;
+            else return c_m3Type_i32;
         }
 
         std::shared_ptr<M3Runtime> m_runtime;
+        std::shared_ptr<M3PreparedCall> m_call;
         M3Function *m_func = nullptr;
     };
 
+    /**
+     * Bounds-checked view over the linear memory of a runtime, obtained from runtime::memory.
+     *
+     * Offsets are wasm addresses; accesses outside the memory throw wasm3::error.
+     */
+    class wasm_memory {
+    public:
+        uint8_t *data() const { return m_data; }
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+
+        uint8_t *begin() const { return m_data; }
+        uint8_t *end() const { return m_data + m_size; }
+
+        uint8_t &operator[](size_t offset) const {
+            assert(offset < m_size);
+            return m_data[offset];
+        }
+
+        uint8_t &at(size_t offset) const {
+            check(offset, 1);
+            return m_data[offset];
+        }
+
+        /** Pointer to `count` objects of type T at `offset` */
+        template<typename T>
+        T *ptr(uint32_t offset, size_t count = 1) const {
+            check(offset, sizeof(T) * count);
+            return reinterpret_cast<T *>(m_data + offset);
+        }
+
+        /** Unaligned little-endian load / store */
+        template<typename T>
+        T load(uint32_t offset) const {
+            T value;
+            std::memcpy(&value, ptr<uint8_t>(offset, sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        template<typename T>
+        void store(uint32_t offset, const T &value) const {
+            std::memcpy(ptr<uint8_t>(offset, sizeof(T)), &value, sizeof(T));
+        }
+
+        wasm_memory subspan(uint32_t offset, size_t count) const {
+            return wasm_memory(ptr<uint8_t>(offset, count), count);
+        }
+
+    protected:
+        friend class wasm_runtime;
+
+        wasm_memory(uint8_t *data, size_t size) : m_data(data), m_size(size) {}
+
+        void check(uint64_t offset, uint64_t len) const {
+            if (offset + len > m_size) {
+                throw error(m3Err_trapOutOfBoundsMemoryAccess);
+            }
+        }
+
+        uint8_t *m_data;
+        size_t m_size;
+    };
+
     inline wasm_runtime wasm_environment::new_runtime(uint32_t stack_size_bytes) {
         return wasm_runtime(m_env, stack_size_bytes);
     }
@@ -414,7 +525,28 @@ namespace wasm3 {
     }
 
     inline wasm_function wasm_runtime::find_function(const char *name) {
-        return wasm_function(m_runtime, name);
+        auto it = m_functions->find(name);
+        if (it == m_functions->end()) {
+            IM3Function func;
+            M3Result err = m3_FindFunction(&func, m_runtime.get(), name);
+            detail::check_error(err);
+            assert(func != nullptr);
+
+            IM3PreparedCall call;
+            err = m3_PrepareCall(&call, func);
+            detail::check_error(err);
+
+            // the prepared call is released through the runtime's allocator, so it keeps the runtime alive
+            std::shared_ptr<M3PreparedCall> ptr(call, [runtime = m_runtime](IM3PreparedCall c) { m3_FreePreparedCall(c); });
+            it = m_functions->emplace(name, detail::cached_function{func, std::move(ptr)}).first;
+        }
+        return wasm_function(m_runtime, it->second);
+    }
+
+    inline wasm_memory wasm_runtime::memory() {
+        uint32_t size = 0;
+        uint8_t *data = m3_GetMemory(m_runtime.get(), &size, 0);
+        return wasm_memory(data, data ? size : 0);
     }
 
     template<typename Func>
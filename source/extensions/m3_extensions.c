@@ -14,17 +14,10 @@
 
 IM3Module  m3_NewModule  (IM3Environment i_environment)
 {
-    IM3Module module = m3_AllocStruct (M3Module);
+    IM3Module module = NULL;
 
-    if (module)
-    {
-        module->name = ".unnamed";
-        module->startFunction = -1;
-        module->environment = i_environment;
-
-        module->wasmStart = NULL;
-        module->wasmEnd = NULL;
-    }
+    if (Module_New (i_environment, & module))
+        module = NULL;
 
     return module;
 }
@@ -65,13 +58,18 @@ _   (ReadLEB_u32 (& size, & bytes, end));
     {
         // add slot to function type table in the module
         u32 funcTypeIndex = i_module->numFuncTypes++;
-        i_module->funcTypes = m3_ReallocArray (IM3FuncType, i_module->funcTypes, i_module->numFuncTypes, funcTypeIndex);
+        i_module->funcTypes = m3_AllocatorReallocArray (& i_module->allocator, IM3FuncType, i_module->funcTypes, i_module->numFuncTypes, funcTypeIndex);
         _throwifnull (i_module->funcTypes);
 
-        // add functype object to the environment
-        Environment_AddFuncType (i_module->environment, & ftype);
-        i_module->funcTypes [funcTypeIndex] = ftype;
-        ftype = NULL; // prevent freeing below
+        // add a copy of the functype to the environment; it must come from the environment allocator
+        IM3FuncType envType;
+        u32 numTypes = ftype->numRets + ftype->numArgs;
+_       (AllocFuncType (& envType, numTypes, & i_module->environment->allocator));
+        memcpy (envType, ftype, sizeof (M3FuncType) + numTypes);
+        envType->next = NULL;
+
+        Environment_AddFuncType (i_module->environment, & envType);
+        i_module->funcTypes [funcTypeIndex] = envType;
 
         index = (i32) i_module->numFunctions;
 _       (Module_AddFunction (i_module, funcTypeIndex, NULL));
@@ -83,10 +81,10 @@ _       (Module_AddFunction (i_module, funcTypeIndex, NULL));
     function->compiled = NULL;
 
     if (function->ownsWasmCode)
-        m3_Free (function->wasm);
+        m3_AllocatorFree (& i_module->allocator, function->wasm);
 
     size_t numBytes = end - i_wasmBytes;
-    function->wasm = m3_CopyMem (i_wasmBytes, numBytes);
+    function->wasm = m3_CopyMem (i_wasmBytes, numBytes, & i_module->allocator);
     _throwifnull (function->wasm);
 
     function->wasmEnd = function->wasm + numBytes;
@@ -11,6 +11,7 @@
 
 #include "m3_env.h"
 #include "m3_exception.h"
+#include "m3_bind.h"
 
 #include <time.h>
 #include <errno.h>
@@ -191,55 +192,59 @@ m3ApiRawFunction(m3_libc_clock_ms)
 #endif
 }
 
-static
-M3Result  SuppressLookupFailure (M3Result i_result)
-{
-    if (i_result == m3Err_functionLookupFailed)
-        return m3Err_none;
-    else
-        return i_result;
-}
-
 m3ApiRawFunction(m3_spectest_dummy)
 {
     m3ApiSuccess();
 }
 
-M3Result  m3_LinkSpecTest  (IM3Module module)
+M3Result  m3_RegisterSpecTest  (IM3ImportRegistry io_registry)
 {
     M3Result result = m3Err_none;
 
     const char* spectest = "spectest";
 
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, spectest, "print",         "v()",      &m3_spectest_dummy)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, spectest, "print_i32",     "v(i)",     &m3_spectest_dummy)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, spectest, "print_i64",     "v(I)",     &m3_spectest_dummy)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, spectest, "print_f32",     "v(f)",     &m3_spectest_dummy)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, spectest, "print_f64",     "v(F)",     &m3_spectest_dummy)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, spectest, "print_i32_f32", "v(if)",    &m3_spectest_dummy)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, spectest, "print_i64_f64", "v(IF)",    &m3_spectest_dummy)));
+_   (m3_RegisterRawFunction (io_registry, spectest, "print",         "v()",      &m3_spectest_dummy, NULL));
+_   (m3_RegisterRawFunction (io_registry, spectest, "print_i32",     "v(i)",     &m3_spectest_dummy, NULL));
+_   (m3_RegisterRawFunction (io_registry, spectest, "print_i64",     "v(I)",     &m3_spectest_dummy, NULL));
+_   (m3_RegisterRawFunction (io_registry, spectest, "print_f32",     "v(f)",     &m3_spectest_dummy, NULL));
+_   (m3_RegisterRawFunction (io_registry, spectest, "print_f64",     "v(F)",     &m3_spectest_dummy, NULL));
+_   (m3_RegisterRawFunction (io_registry, spectest, "print_i32_f32", "v(if)",    &m3_spectest_dummy, NULL));
+_   (m3_RegisterRawFunction (io_registry, spectest, "print_i64_f64", "v(IF)",    &m3_spectest_dummy, NULL));
 
 _catch:
     return result;
 }
 
 
-M3Result  m3_LinkLibC  (IM3Module module)
+M3Result  m3_RegisterLibC  (IM3ImportRegistry io_registry)
 {
     M3Result result = m3Err_none;
 
     const char* env = "env";
 
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "_debug",            "i(*i)",   &m3_libc_print)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "_memset",           "*(*ii)",  &m3_libc_memset)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "_memmove",          "*(**i)",  &m3_libc_memmove)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "_memcpy",           "*(**i)",  &m3_libc_memmove))); // just alias of memmove
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "_abort",            "v()",     &m3_libc_abort)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "_exit",             "v(i)",    &m3_libc_exit)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "clock_ms",          "i()",     &m3_libc_clock_ms)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "printf",            "i(**)",   &m3_libc_printf)));
+_   (m3_RegisterRawFunction (io_registry, env, "_debug",            "i(*i)",   &m3_libc_print, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "_memset",           "*(*ii)",  &m3_libc_memset, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "_memmove",          "*(**i)",  &m3_libc_memmove, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "_memcpy",           "*(**i)",  &m3_libc_memmove, NULL)); // just alias of memmove
+_   (m3_RegisterRawFunction (io_registry, env, "_abort",            "v()",     &m3_libc_abort, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "_exit",             "v(i)",    &m3_libc_exit, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "clock_ms",          "i()",     &m3_libc_clock_ms, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "printf",            "i(**)",   &m3_libc_printf, NULL));
 
 _catch:
     return result;
 }
 
+
+M3Result  m3_LinkSpecTest  (IM3Module module)
+{
+    static IM3ImportRegistry registry = NULL;
+    return LinkRegisteredImports (module, & registry, m3_RegisterSpecTest);
+}
+
+
+M3Result  m3_LinkLibC  (IM3Module module)
+{
+    static IM3ImportRegistry registry = NULL;
+    return LinkRegisteredImports (module, & registry, m3_RegisterLibC);
+}
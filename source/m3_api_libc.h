@@ -12,8 +12,12 @@
 
 d_m3BeginExternC
 
-M3Result    m3_LinkLibC     (IM3Module io_module);
-M3Result    m3_LinkSpecTest (IM3Module io_module);
+M3Result    m3_LinkLibC         (IM3Module io_module);
+M3Result    m3_LinkSpecTest     (IM3Module io_module);
+
+// add the same imports to a registry, to link several import sets in one pass (m3_LinkImportRegistry)
+M3Result    m3_RegisterLibC     (IM3ImportRegistry io_registry);
+M3Result    m3_RegisterSpecTest (IM3ImportRegistry io_registry);
 
 d_m3EndExternC
 
@@ -9,6 +9,7 @@
 
 #include "m3_env.h"
 #include "m3_exception.h"
+#include "m3_bind.h"
 
 #if defined(d_m3HasMetaWASI)
 
@@ -28,28 +29,60 @@
 # include <wasi/core.h>
 # define __WASI_ERRNO_SUCCESS   __WASI_ESUCCESS
 # define __WASI_ERRNO_INVAL     __WASI_EINVAL
+# define __WASI_ERRNO_NOMEM     __WASI_ENOMEM
+# define __WASI_ERRNO_BADF      __WASI_EBADF
 # define WASI_STAT_FIELD(f) st_##f
 
 #else
 # error "Missing WASI headers"
 #endif
 
+#define c_wasiErrnoBadf     __WASI_ERRNO_BADF
+#define c_wasiErrnoNomem    __WASI_ERRNO_NOMEM
+#include "m3_api_wasi_io.h"
+
 static m3_wasi_context_t* wasi_context;
 
-typedef size_t __wasi_size_t;
+#if d_m3WasiStdio
+static
+void wasi_release_state(IM3Runtime runtime)
+{
+    wasi_stdio_clear((m3_wasi_stdio_t*) runtime->wasi);
+    m3_AllocatorFree(&runtime->environment->allocator, runtime->wasi);
+    runtime->releaseWasi = NULL;
+}
 
-static inline
-const void* copy_iov_to_host(IM3Runtime runtime, void* _mem, __wasi_iovec_t* host_iov, __wasi_iovec_t* wasi_iov, int32_t iovs_len)
+// the stdio capture is all the state this backend keeps per runtime
+static
+m3_wasi_stdio_t* wasi_stdio_state(IM3Runtime runtime, bool create)
 {
-    // Convert wasi memory offsets to host addresses
-    for (int i = 0; i < iovs_len; i++) {
-        host_iov[i].buf = m3ApiOffsetToPtr(wasi_iov[i].buf);
-        host_iov[i].buf_len  = wasi_iov[i].buf_len;
-        m3ApiCheckMem(host_iov[i].buf,     host_iov[i].buf_len);
+    if (!runtime->wasi && create) {
+        runtime->wasi = m3_AllocatorAllocStruct(&runtime->environment->allocator, m3_wasi_stdio_t);
+        if (runtime->wasi) runtime->releaseWasi = wasi_release_state;
     }
-    m3ApiSuccess();
+    return (m3_wasi_stdio_t*) runtime->wasi;
+}
+#endif
+
+typedef size_t __wasi_size_t;
+
+static
+uint32_t wasi_host_writev(int32_t fd, const m3_host_iovec_t* iovs, uint32_t iovs_len, size_t* nwritten)
+{
+    __wasi_size_t written = 0;
+    __wasi_errno_t ret = __wasi_fd_write(fd, (const __wasi_ciovec_t*)iovs, iovs_len, &written);
+    *nwritten = written;
+    return ret;
 }
 
+#if d_m3WasiWriteBufferSize
+static
+void wasi_flush_at_exit(void)
+{
+    wasi_flush_all(wasi_host_writev);
+}
+#endif
+
 #if d_m3EnableWasiTracing
 
 const char* wasi_errno2str(__wasi_errno_t err)
@@ -487,6 +520,10 @@ m3ApiRawFunction(m3_wasi_generic_fd_sync)
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (__wasi_fd_t          , fd)
 
+#if d_m3WasiWriteBufferSize
+    wasi_flush_fd(wasi_host_writev, fd);
+#endif
+
     __wasi_errno_t ret = __wasi_fd_sync(fd);
 
     WASI_TRACE("fd:%d", fd);
@@ -727,21 +764,21 @@ m3ApiRawFunction(m3_wasi_generic_fd_pread)
 {
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (__wasi_fd_t          , fd)
-    m3ApiGetArgMem   (__wasi_iovec_t *     , wasi_iovs)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
     m3ApiGetArg      (__wasi_size_t        , iovs_len)
     m3ApiGetArg      (__wasi_filesize_t    , offset)
     m3ApiGetArgMem   (__wasi_size_t *      , nread)
 
-    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(__wasi_iovec_t));
     m3ApiCheckMem(nread,        sizeof(__wasi_size_t));
 
-    __wasi_iovec_t iovs[iovs_len];
-    const void* mem_check = copy_iov_to_host(runtime, _mem, iovs, wasi_iovs, iovs_len);
+    m3_wasi_iovecs_t iovecs;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, NULL);
     if (mem_check != m3Err_none) {
         return mem_check;
     }
 
-    __wasi_errno_t ret = __wasi_fd_pread(fd, iovs, iovs_len, offset, nread);
+    __wasi_errno_t ret = __wasi_fd_pread(fd, (const __wasi_iovec_t*)iovecs.iovs, iovs_len, offset, nread);
+    wasi_release_iovs(runtime, &iovecs);
 
     WASI_TRACE("fd:%d | nread:%d", fd, *nread);
 
@@ -752,20 +789,36 @@ m3ApiRawFunction(m3_wasi_generic_fd_read)
 {
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (__wasi_fd_t          , fd)
-    m3ApiGetArgMem   (__wasi_iovec_t *     , wasi_iovs)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
     m3ApiGetArg      (__wasi_size_t        , iovs_len)
     m3ApiGetArgMem   (__wasi_size_t *      , nread)
 
-    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(__wasi_iovec_t));
     m3ApiCheckMem(nread,        sizeof(__wasi_size_t));
 
-    __wasi_iovec_t iovs[iovs_len];
-    const void* mem_check = copy_iov_to_host(runtime, _mem, iovs, wasi_iovs, iovs_len);
+    m3_wasi_iovecs_t iovecs;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, NULL);
     if (mem_check != m3Err_none) {
         return mem_check;
     }
 
-    __wasi_errno_t ret = __wasi_fd_read(fd, iovs, iovs_len, nread);
+#if d_m3WasiStdio
+    m3_wasi_stdio_t* stdio = wasi_stdio_get(runtime, fd);
+    if (stdio) {
+        size_t num = 0;
+        uint32_t ret = wasi_stdio_rw(stdio, false, fd, iovecs.iovs, iovs_len, &num);
+        wasi_release_iovs(runtime, &iovecs);
+        m3ApiWriteMem32(nread, num);
+        m3ApiReturn(ret);
+    }
+#endif
+
+#if d_m3WasiWriteBufferSize
+    // show any pending prompt before blocking on input
+    if (fd == 0) wasi_flush_all(wasi_host_writev);
+#endif
+
+    __wasi_errno_t ret = __wasi_fd_read(fd, (const __wasi_iovec_t*)iovecs.iovs, iovs_len, nread);
+    wasi_release_iovs(runtime, &iovecs);
 
     WASI_TRACE("fd:%d | nread:%d", fd, *nread);
 
@@ -776,20 +829,44 @@ m3ApiRawFunction(m3_wasi_generic_fd_write)
 {
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (__wasi_fd_t          , fd)
-    m3ApiGetArgMem   (__wasi_iovec_t *     , wasi_iovs)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
     m3ApiGetArg      (__wasi_size_t        , iovs_len)
     m3ApiGetArgMem   (__wasi_size_t *      , nwritten)
 
-    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(__wasi_iovec_t));
     m3ApiCheckMem(nwritten,     sizeof(__wasi_size_t));
 
-    __wasi_iovec_t iovs[iovs_len];
-    const void* mem_check = copy_iov_to_host(runtime, _mem, iovs, wasi_iovs, iovs_len);
+    m3_wasi_iovecs_t iovecs;
+    size_t total_len = 0;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, &total_len);
     if (mem_check != m3Err_none) {
         return mem_check;
     }
 
-    __wasi_errno_t ret = __wasi_fd_write(fd, (__wasi_ciovec_t*)iovs, iovs_len, nwritten);
+#if d_m3WasiStdio
+    m3_wasi_stdio_t* stdio = wasi_stdio_get(runtime, fd);
+    if (stdio) {
+        size_t num = 0;
+        uint32_t ret = wasi_stdio_rw(stdio, true, fd, iovecs.iovs, iovs_len, &num);
+        wasi_release_iovs(runtime, &iovecs);
+        m3ApiWriteMem32(nwritten, num);
+        m3ApiReturn(ret);
+    }
+#endif
+
+    __wasi_errno_t ret;
+#if d_m3WasiWriteBufferSize
+    size_t buffered = 0;
+    uint32_t buffered_ret = 0;
+    if (wasi_buffered_write(wasi_host_writev, fd, iovecs.iovs, iovs_len, total_len, &buffered, &buffered_ret)) {
+        *nwritten = buffered;
+        ret = buffered_ret;
+    }
+    else
+#endif
+    {
+        ret = __wasi_fd_write(fd, (const __wasi_ciovec_t*)iovecs.iovs, iovs_len, nwritten);
+    }
+    wasi_release_iovs(runtime, &iovecs);
 
     WASI_TRACE("fd:%d | nwritten:%d", fd, *nwritten);
 
@@ -800,21 +877,21 @@ m3ApiRawFunction(m3_wasi_generic_fd_pwrite)
 {
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (__wasi_fd_t          , fd)
-    m3ApiGetArgMem   (__wasi_iovec_t *     , wasi_iovs)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
     m3ApiGetArg      (__wasi_size_t        , iovs_len)
     m3ApiGetArg      (__wasi_filesize_t    , offset)
     m3ApiGetArgMem   (__wasi_size_t *      , nwritten)
 
-    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(__wasi_iovec_t));
     m3ApiCheckMem(nwritten,     sizeof(__wasi_size_t));
 
-    __wasi_iovec_t iovs[iovs_len];
-    const void* mem_check = copy_iov_to_host(runtime, _mem, iovs, wasi_iovs, iovs_len);
+    m3_wasi_iovecs_t iovecs;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, NULL);
     if (mem_check != m3Err_none) {
         return mem_check;
     }
-    
-    __wasi_errno_t ret = __wasi_fd_pwrite(fd, (__wasi_ciovec_t*)iovs, iovs_len, offset, nwritten);
+
+    __wasi_errno_t ret = __wasi_fd_pwrite(fd, (const __wasi_ciovec_t*)iovecs.iovs, iovs_len, offset, nwritten);
+    wasi_release_iovs(runtime, &iovecs);
 
     WASI_TRACE("fd:%d | nwritten:%d", fd, *nwritten);
 
@@ -874,6 +951,10 @@ m3ApiRawFunction(m3_wasi_generic_fd_close)
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (__wasi_fd_t, fd)
 
+#if d_m3WasiWriteBufferSize
+    wasi_flush_fd(wasi_host_writev, fd);
+#endif
+
     __wasi_errno_t ret = __wasi_fd_close(fd);
 
     WASI_TRACE("fd:%d", fd);
@@ -886,6 +967,10 @@ m3ApiRawFunction(m3_wasi_generic_fd_datasync)
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (__wasi_fd_t, fd)
 
+#if d_m3WasiWriteBufferSize
+    wasi_flush_fd(wasi_host_writev, fd);
+#endif
+
     __wasi_errno_t ret = __wasi_fd_datasync(fd);
 
     WASI_TRACE("fd:%d", fd);
@@ -945,21 +1030,66 @@ m3ApiRawFunction(m3_wasi_generic_clock_time_get)
     m3ApiReturn(ret);
 }
 
-m3ApiRawFunction(m3_wasi_generic_poll_oneoff)
+// the host libc speaks one subscription layout; the other ABI is converted
+static
+__wasi_errno_t wasi_poll_oneoff(const uint8_t* in, __wasi_event_t* out, __wasi_size_t nsubscriptions, bool unstable, __wasi_size_t* nevents)
+{
+#if defined(USE_NEW_WASI)
+    const bool hostUnstable = false;
+#else
+    const bool hostUnstable = true;
+#endif
+
+#if d_m3WasiWriteBufferSize
+    wasi_flush_all(wasi_host_writev);
+#endif
+
+    if (unstable == hostUnstable) {
+        return __wasi_poll_oneoff((const __wasi_subscription_t*) in, out, nsubscriptions, nevents);
+    }
+
+    uint8_t* subs = (uint8_t*) malloc((size_t) nsubscriptions * (hostUnstable ? c_wasiUnstableSubscriptionSize : c_wasiSubscriptionSize) + 1);
+    if (!subs) return __WASI_ERRNO_NOMEM;
+
+    wasi_convert_subscriptions(subs, hostUnstable, in, unstable, nsubscriptions);
+
+    __wasi_errno_t ret = __wasi_poll_oneoff((const __wasi_subscription_t*) subs, out, nsubscriptions, nevents);
+    free(subs);
+    return ret;
+}
+
+m3ApiRawFunction(m3_wasi_unstable_poll_oneoff)
 {
     m3ApiReturnType  (uint32_t)
-    m3ApiGetArgMem   (const __wasi_subscription_t * , in)
+    m3ApiGetArgMem   (const uint8_t *               , in)
     m3ApiGetArgMem   (__wasi_event_t *              , out)
     m3ApiGetArg      (__wasi_size_t                 , nsubscriptions)
     m3ApiGetArgMem   (__wasi_size_t *               , nevents)
 
-    m3ApiCheckMem(in,       nsubscriptions * sizeof(__wasi_subscription_t));
-    m3ApiCheckMem(out,      nsubscriptions * sizeof(__wasi_event_t));
+    m3ApiCheckMem(in,       (uint64_t) nsubscriptions * c_wasiUnstableSubscriptionSize);
+    m3ApiCheckMem(out,      (uint64_t) nsubscriptions * c_wasiEventSize);
     m3ApiCheckMem(nevents,  sizeof(__wasi_size_t));
 
-    // TODO: unstable/snapshot_preview1 compatibility
+    __wasi_errno_t ret = wasi_poll_oneoff(in, out, nsubscriptions, true, nevents);
 
-    __wasi_errno_t ret = __wasi_poll_oneoff(in, out, nsubscriptions, nevents);
+    WASI_TRACE("nsubscriptions:%d | nevents:%d", nsubscriptions, *nevents);
+
+    m3ApiReturn(ret);
+}
+
+m3ApiRawFunction(m3_wasi_snapshot_preview1_poll_oneoff)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArgMem   (const uint8_t *               , in)
+    m3ApiGetArgMem   (__wasi_event_t *              , out)
+    m3ApiGetArg      (__wasi_size_t                 , nsubscriptions)
+    m3ApiGetArgMem   (__wasi_size_t *               , nevents)
+
+    m3ApiCheckMem(in,       (uint64_t) nsubscriptions * c_wasiSubscriptionSize);
+    m3ApiCheckMem(out,      (uint64_t) nsubscriptions * c_wasiEventSize);
+    m3ApiCheckMem(nevents,  sizeof(__wasi_size_t));
+
+    __wasi_errno_t ret = wasi_poll_oneoff(in, out, nsubscriptions, false, nevents);
 
     WASI_TRACE("nsubscriptions:%d | nevents:%d", nsubscriptions, *nevents);
 
@@ -976,6 +1106,10 @@ m3ApiRawFunction(m3_wasi_generic_proc_exit)
         context->exit_code = code;
     }
 
+#if d_m3WasiWriteBufferSize
+    wasi_flush_all(wasi_host_writev);
+#endif
+
     m3ApiTrap(m3Err_trapExit);
 }
 
@@ -1005,22 +1139,47 @@ m3ApiRawFunction(m3_wasi_generic_sched_yield)
 }
 
 
-static
-M3Result SuppressLookupFailure(M3Result i_result)
+m3_wasi_context_t* m3_GetWasiContext()
 {
-    if (i_result == m3Err_functionLookupFailed)
-        return m3Err_none;
-    else
-        return i_result;
+    return wasi_context;
 }
 
-m3_wasi_context_t* m3_GetWasiContext()
+
+void m3_FlushWASI()
 {
-    return wasi_context;
+#if d_m3WasiWriteBufferSize
+    wasi_flush_all(wasi_host_writev);
+#endif
 }
 
 
-M3Result  m3_LinkWASI  (IM3Module module)
+M3Result m3_CaptureStdioWASI (IM3Runtime i_runtime)
+{
+    return wasi_stdio_capture(i_runtime);
+}
+
+void m3_ReleaseStdioWASI (IM3Runtime i_runtime)
+{
+    wasi_stdio_release(i_runtime);
+}
+
+size_t m3_PeekStdioWASI (IM3Runtime i_runtime, int i_fd, const void** o_data)
+{
+    return wasi_stdio_peek(i_runtime, i_fd, o_data);
+}
+
+void m3_ConsumeStdioWASI (IM3Runtime i_runtime, int i_fd, size_t i_length)
+{
+    wasi_stdio_consume(i_runtime, i_fd, i_length);
+}
+
+M3Result m3_FeedStdinWASI (IM3Runtime i_runtime, const void* i_data, size_t i_length)
+{
+    return wasi_stdio_feed(i_runtime, i_data, i_length);
+}
+
+
+M3Result  m3_RegisterWASI  (IM3ImportRegistry io_registry)
 {
     M3Result result = m3Err_none;
 
@@ -1029,73 +1188,85 @@ M3Result  m3_LinkWASI  (IM3Module module)
         wasi_context->exit_code = 0;
         wasi_context->argc = 0;
         wasi_context->argv = 0;
+
+#if d_m3WasiWriteBufferSize
+        atexit(wasi_flush_at_exit);
+#endif
     }
 
     static const char* namespaces[2] = { "wasi_unstable", "wasi_snapshot_preview1" };
 
     // Some functions are incompatible between WASI versions
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_unstable",          "fd_seek",           "i(iIi*)",   &m3_wasi_unstable_fd_seek)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_snapshot_preview1", "fd_seek",           "i(iIi*)",   &m3_wasi_snapshot_preview1_fd_seek)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_unstable",          "fd_filestat_get",   "i(i*)",     &m3_wasi_unstable_fd_filestat_get)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_snapshot_preview1", "fd_filestat_get",   "i(i*)",     &m3_wasi_snapshot_preview1_fd_filestat_get)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_unstable",          "path_filestat_get", "i(ii*i*)",  &m3_wasi_unstable_path_filestat_get)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_snapshot_preview1", "path_filestat_get", "i(ii*i*)",  &m3_wasi_snapshot_preview1_path_filestat_get)));
+_   (m3_RegisterRawFunction (io_registry, "wasi_unstable",          "fd_seek",           "i(iIi*)",   &m3_wasi_unstable_fd_seek, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "fd_seek",           "i(iIi*)",   &m3_wasi_snapshot_preview1_fd_seek, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_unstable",          "poll_oneoff",       "i(**i*)",   &m3_wasi_unstable_poll_oneoff, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "poll_oneoff",       "i(**i*)",   &m3_wasi_snapshot_preview1_poll_oneoff, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_unstable",          "fd_filestat_get",   "i(i*)",     &m3_wasi_unstable_fd_filestat_get, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "fd_filestat_get",   "i(i*)",     &m3_wasi_snapshot_preview1_fd_filestat_get, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_unstable",          "path_filestat_get", "i(ii*i*)",  &m3_wasi_unstable_path_filestat_get, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "path_filestat_get", "i(ii*i*)",  &m3_wasi_snapshot_preview1_path_filestat_get, NULL));
 
     for (int i=0; i<2; i++)
     {
         const char* wasi = namespaces[i];
 
-_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "args_get",           "i(**)",   &m3_wasi_generic_args_get, wasi_context)));
-_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "args_sizes_get",     "i(**)",   &m3_wasi_generic_args_sizes_get, wasi_context)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "clock_res_get",        "i(i*)",   &m3_wasi_generic_clock_res_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "clock_time_get",       "i(iI*)",  &m3_wasi_generic_clock_time_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "environ_get",          "i(**)",   &m3_wasi_generic_environ_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "environ_sizes_get",    "i(**)",   &m3_wasi_generic_environ_sizes_get)));
-
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_advise",            "i(iIIi)", &m3_wasi_generic_fd_advise)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_allocate",          "i(iII)",  &m3_wasi_generic_fd_allocate)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_close",             "i(i)",    &m3_wasi_generic_fd_close)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_datasync",          "i(i)",    &m3_wasi_generic_fd_datasync)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_get",        "i(i*)",   &m3_wasi_generic_fd_fdstat_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_set_flags",  "i(ii)",   &m3_wasi_generic_fd_fdstat_set_flags)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_set_rights", "i(iII)",  &m3_wasi_generic_fd_fdstat_set_rights)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_filestat_set_size", "i(iI)",   &m3_wasi_generic_fd_filestat_set_size)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_filestat_set_times","i(iIIi)", &m3_wasi_generic_fd_filestat_set_times)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_pread",             "i(i*iI*)",&m3_wasi_generic_fd_pread)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_prestat_get",       "i(i*)",   &m3_wasi_generic_fd_prestat_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_prestat_dir_name",  "i(i*i)",  &m3_wasi_generic_fd_prestat_dir_name)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_pwrite",            "i(i*iI*)",&m3_wasi_generic_fd_pwrite)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_read",              "i(i*i*)", &m3_wasi_generic_fd_read)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_readdir",           "i(i*iI*)",&m3_wasi_generic_fd_readdir)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_renumber",          "i(ii)",   &m3_wasi_generic_fd_renumber)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_sync",              "i(i)",    &m3_wasi_generic_fd_sync)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_tell",              "i(i*)",   &m3_wasi_generic_fd_tell)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_write",             "i(i*i*)", &m3_wasi_generic_fd_write)));
-
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_create_directory",    "i(i*i)",       &m3_wasi_generic_path_create_directory)));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_filestat_set_times",  "i(ii*iIIi)",   )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_link",                "i(ii*ii*i)",   )));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_open",                "i(ii*iiIIi*)", &m3_wasi_generic_path_open)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_readlink",            "i(i*i*i*)",    &m3_wasi_generic_path_readlink)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_remove_directory",    "i(i*i)",       &m3_wasi_generic_path_remove_directory)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_rename",              "i(i*ii*i)",    &m3_wasi_generic_path_rename)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_symlink",             "i(*ii*i)",     &m3_wasi_generic_path_symlink)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_unlink_file",         "i(i*i)",       &m3_wasi_generic_path_unlink_file)));
-
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "poll_oneoff",          "i(**i*)", &m3_wasi_generic_poll_oneoff)));
-_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "proc_exit",          "v(i)",    &m3_wasi_generic_proc_exit, wasi_context)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "proc_raise",           "i(i)",    &m3_wasi_generic_proc_raise)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "random_get",           "i(*i)",   &m3_wasi_generic_random_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sched_yield",          "i()",     &m3_wasi_generic_sched_yield)));
-
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sock_recv",            "i(i*ii**)",        )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sock_send",            "i(i*ii*)",         )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sock_shutdown",        "i(ii)",            )));
+_       (m3_RegisterRawFunction (io_registry, wasi, "args_get",             "i(**)",   &m3_wasi_generic_args_get, wasi_context));
+_       (m3_RegisterRawFunction (io_registry, wasi, "args_sizes_get",       "i(**)",   &m3_wasi_generic_args_sizes_get, wasi_context));
+_       (m3_RegisterRawFunction (io_registry, wasi, "clock_res_get",        "i(i*)",   &m3_wasi_generic_clock_res_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "clock_time_get",       "i(iI*)",  &m3_wasi_generic_clock_time_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "environ_get",          "i(**)",   &m3_wasi_generic_environ_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "environ_sizes_get",    "i(**)",   &m3_wasi_generic_environ_sizes_get, NULL));
+
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_advise",            "i(iIIi)", &m3_wasi_generic_fd_advise, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_allocate",          "i(iII)",  &m3_wasi_generic_fd_allocate, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_close",             "i(i)",    &m3_wasi_generic_fd_close, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_datasync",          "i(i)",    &m3_wasi_generic_fd_datasync, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_fdstat_get",        "i(i*)",   &m3_wasi_generic_fd_fdstat_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_fdstat_set_flags",  "i(ii)",   &m3_wasi_generic_fd_fdstat_set_flags, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_fdstat_set_rights", "i(iII)",  &m3_wasi_generic_fd_fdstat_set_rights, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_filestat_set_size", "i(iI)",   &m3_wasi_generic_fd_filestat_set_size, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_filestat_set_times","i(iIIi)", &m3_wasi_generic_fd_filestat_set_times, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_pread",             "i(i*iI*)",&m3_wasi_generic_fd_pread, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_prestat_get",       "i(i*)",   &m3_wasi_generic_fd_prestat_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_prestat_dir_name",  "i(i*i)",  &m3_wasi_generic_fd_prestat_dir_name, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_pwrite",            "i(i*iI*)",&m3_wasi_generic_fd_pwrite, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_read",              "i(i*i*)", &m3_wasi_generic_fd_read, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_readdir",           "i(i*iI*)",&m3_wasi_generic_fd_readdir, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_renumber",          "i(ii)",   &m3_wasi_generic_fd_renumber, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_sync",              "i(i)",    &m3_wasi_generic_fd_sync, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_tell",              "i(i*)",   &m3_wasi_generic_fd_tell, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_write",             "i(i*i*)", &m3_wasi_generic_fd_write, NULL));
+
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_create_directory",    "i(i*i)",       &m3_wasi_generic_path_create_directory, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "path_filestat_set_times",  "i(ii*iIIi)",   &m3_wasi_generic_path_filestat_set_times, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "path_link",                "i(ii*ii*i)",   &m3_wasi_generic_path_link, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_open",                "i(ii*iiIIi*)", &m3_wasi_generic_path_open, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_readlink",            "i(i*i*i*)",    &m3_wasi_generic_path_readlink, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_remove_directory",    "i(i*i)",       &m3_wasi_generic_path_remove_directory, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_rename",              "i(i*ii*i)",    &m3_wasi_generic_path_rename, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_symlink",             "i(*ii*i)",     &m3_wasi_generic_path_symlink, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_unlink_file",         "i(i*i)",       &m3_wasi_generic_path_unlink_file, NULL));
+
+_       (m3_RegisterRawFunction (io_registry, wasi, "proc_exit",            "v(i)",    &m3_wasi_generic_proc_exit, wasi_context));
+_       (m3_RegisterRawFunction (io_registry, wasi, "proc_raise",           "i(i)",    &m3_wasi_generic_proc_raise, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "random_get",           "i(*i)",   &m3_wasi_generic_random_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "sched_yield",          "i()",     &m3_wasi_generic_sched_yield, NULL));
+
+//_     (m3_RegisterRawFunction (io_registry, wasi, "sock_recv",            "i(i*ii**)",        &m3_wasi_generic_sock_recv, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "sock_send",            "i(i*ii*)",         &m3_wasi_generic_sock_send, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "sock_shutdown",        "i(ii)",            &m3_wasi_generic_sock_shutdown, NULL));
     }
 
 _catch:
     return result;
 }
 
+
+M3Result  m3_LinkWASI  (IM3Module module)
+{
+    static IM3ImportRegistry registry = NULL;
+    return LinkRegisteredImports (module, & registry, m3_RegisterWASI);
+}
+
 #endif // d_m3HasMetaWASI
 
@@ -9,16 +9,27 @@
 
 #include "m3_env.h"
 #include "m3_exception.h"
+#include "m3_bind.h"
 
 #if defined(d_m3HasTracer)
 
 
 static FILE* trace = NULL;
 
+// the trace file is only created once a module actually calls into the tracer
+static
+FILE *  TraceFile  (void)
+{
+    if (!trace) {
+        trace = fopen ("wasm3_trace.csv","w");
+    }
+    return trace;
+}
+
 m3ApiRawFunction(m3_env_log_execution)
 {
     m3ApiGetArg      (uint32_t, id)
-    fprintf(trace, "exec;%d\n", id);
+    fprintf(TraceFile(), "exec;%d\n", id);
     m3ApiSuccess();
 }
 
@@ -26,7 +37,7 @@ m3ApiRawFunction(m3_env_log_exec_enter)
 {
     m3ApiGetArg      (uint32_t, id)
     m3ApiGetArg      (uint32_t, func)
-    fprintf(trace, "enter;%d;%d\n", id, func);
+    fprintf(TraceFile(), "enter;%d;%d\n", id, func);
     m3ApiSuccess();
 }
 
@@ -34,14 +45,14 @@ m3ApiRawFunction(m3_env_log_exec_exit)
 {
     m3ApiGetArg      (uint32_t, id)
     m3ApiGetArg      (uint32_t, func)
-    fprintf(trace, "exit;%d;%d\n", id, func);
+    fprintf(TraceFile(), "exit;%d;%d\n", id, func);
     m3ApiSuccess();
 }
 
 m3ApiRawFunction(m3_env_log_exec_loop)
 {
     m3ApiGetArg      (uint32_t, id)
-    fprintf(trace, "loop;%d\n", id);
+    fprintf(TraceFile(), "loop;%d\n", id);
     m3ApiSuccess();
 }
 
@@ -52,7 +63,7 @@ m3ApiRawFunction(m3_env_load_ptr)
     m3ApiGetArg      (uint32_t, align)
     m3ApiGetArg      (uint32_t, offset)
     m3ApiGetArg      (uint32_t, address)
-    fprintf(trace, "load ptr;%d;%d;%d;%d\n", id, align, offset, address);
+    fprintf(TraceFile(), "load ptr;%d;%d;%d;%d\n", id, align, offset, address);
     m3ApiReturn(address);
 }
 
@@ -63,7 +74,7 @@ m3ApiRawFunction(m3_env_store_ptr)
     m3ApiGetArg      (uint32_t, align)
     m3ApiGetArg      (uint32_t, offset)
     m3ApiGetArg      (uint32_t, address)
-    fprintf(trace, "store ptr;%d;%d;%d;%d\n", id, align, offset, address);
+    fprintf(TraceFile(), "store ptr;%d;%d;%d;%d\n", id, align, offset, address);
     m3ApiReturn(address);
 }
 
@@ -74,7 +85,7 @@ m3ApiRawFunction(m3_env_##FUNC)                               \
     m3ApiReturnType (TYPE)                                    \
     m3ApiGetArg      (uint32_t, id)                           \
     m3ApiGetArg      (TYPE,     val)                          \
-    fprintf(trace, NAME ";%d;" FMT "\n", id, val);            \
+    fprintf(TraceFile(), NAME ";%d;" FMT "\n", id, val);      \
     m3ApiReturn(val);                                         \
 }
 
@@ -95,7 +106,7 @@ m3ApiRawFunction(m3_env_##FUNC)                               \
     m3ApiGetArg      (uint32_t, id)                           \
     m3ApiGetArg      (uint32_t, local)                        \
     m3ApiGetArg      (TYPE,     val)                          \
-    fprintf(trace, NAME ";%d;%d;" FMT "\n", id, local, val); \
+    fprintf(TraceFile(), NAME ";%d;%d;" FMT "\n", id, local, val); \
     m3ApiReturn(val);                                         \
 }
 
@@ -110,59 +121,51 @@ d_m3TraceLocal(get_f64, "get f64", double,  "%" PRIf64)
 d_m3TraceLocal(set_f64, "set f64", double,  "%" PRIf64)
 
 
-static
-M3Result SuppressLookupFailure(M3Result i_result)
-{
-    if (i_result == m3Err_none) {
-        // If any trace function is found in the module, open the trace file
-        if (!trace) {
-            trace = fopen ("wasm3_trace.csv","w");
-        }
-    } else if (i_result == m3Err_functionLookupFailed) {
-        i_result = m3Err_none;
-    }
-    return i_result;
-}
-
-
-M3Result  m3_LinkTracer  (IM3Module module)
+M3Result  m3_RegisterTracer  (IM3ImportRegistry io_registry)
 {
     M3Result result = m3Err_none;
 
     const char* env  = "env";
 
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "log_execution",       "v(i)",     &m3_env_log_execution)));
+_   (m3_RegisterRawFunction (io_registry, env, "log_execution",       "v(i)",     &m3_env_log_execution, NULL));
 
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "log_exec_enter",      "v(ii)",    &m3_env_log_exec_enter)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "log_exec_exit",       "v(ii)",    &m3_env_log_exec_exit)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "log_exec_loop",       "v(i)",     &m3_env_log_exec_loop)));
+_   (m3_RegisterRawFunction (io_registry, env, "log_exec_enter",      "v(ii)",    &m3_env_log_exec_enter, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "log_exec_exit",       "v(ii)",    &m3_env_log_exec_exit, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "log_exec_loop",       "v(i)",     &m3_env_log_exec_loop, NULL));
 
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "load_ptr",            "i(iiii)",  &m3_env_load_ptr)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "store_ptr",           "i(iiii)",  &m3_env_store_ptr)));
+_   (m3_RegisterRawFunction (io_registry, env, "load_ptr",            "i(iiii)",  &m3_env_load_ptr, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "store_ptr",           "i(iiii)",  &m3_env_store_ptr, NULL));
 
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "load_val_i32",        "i(ii)",    &m3_env_load_val_i32)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "load_val_i64",        "I(iI)",    &m3_env_load_val_i64)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "load_val_f32",        "f(if)",    &m3_env_load_val_f32)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "load_val_f64",        "F(iF)",    &m3_env_load_val_f64)));
+_   (m3_RegisterRawFunction (io_registry, env, "load_val_i32",        "i(ii)",    &m3_env_load_val_i32, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "load_val_i64",        "I(iI)",    &m3_env_load_val_i64, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "load_val_f32",        "f(if)",    &m3_env_load_val_f32, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "load_val_f64",        "F(iF)",    &m3_env_load_val_f64, NULL));
 
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "store_val_i32",       "i(ii)",    &m3_env_store_val_i32)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "store_val_i64",       "I(iI)",    &m3_env_store_val_i64)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "store_val_f32",       "f(if)",    &m3_env_store_val_f32)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "store_val_f64",       "F(iF)",    &m3_env_store_val_f64)));
+_   (m3_RegisterRawFunction (io_registry, env, "store_val_i32",       "i(ii)",    &m3_env_store_val_i32, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "store_val_i64",       "I(iI)",    &m3_env_store_val_i64, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "store_val_f32",       "f(if)",    &m3_env_store_val_f32, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "store_val_f64",       "F(iF)",    &m3_env_store_val_f64, NULL));
 
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "get_i32",             "i(iii)",   &m3_env_get_i32)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "get_i64",             "I(iiI)",   &m3_env_get_i64)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "get_f32",             "f(iif)",   &m3_env_get_f32)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "get_f64",             "F(iiF)",   &m3_env_get_f64)));
+_   (m3_RegisterRawFunction (io_registry, env, "get_i32",             "i(iii)",   &m3_env_get_i32, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "get_i64",             "I(iiI)",   &m3_env_get_i64, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "get_f32",             "f(iif)",   &m3_env_get_f32, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "get_f64",             "F(iiF)",   &m3_env_get_f64, NULL));
 
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "set_i32",             "i(iii)",   &m3_env_set_i32)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "set_i64",             "I(iiI)",   &m3_env_set_i64)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "set_f32",             "f(iif)",   &m3_env_set_f32)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, env, "set_f64",             "F(iiF)",   &m3_env_set_f64)));
+_   (m3_RegisterRawFunction (io_registry, env, "set_i32",             "i(iii)",   &m3_env_set_i32, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "set_i64",             "I(iiI)",   &m3_env_set_i64, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "set_f32",             "f(iif)",   &m3_env_set_f32, NULL));
+_   (m3_RegisterRawFunction (io_registry, env, "set_f64",             "F(iiF)",   &m3_env_set_f64, NULL));
 
 _catch:
     return result;
 }
 
+
+M3Result  m3_LinkTracer  (IM3Module module)
+{
+    static IM3ImportRegistry registry = NULL;
+    return LinkRegisteredImports (module, & registry, m3_RegisterTracer);
+}
+
 #endif // d_m3HasTracer
 
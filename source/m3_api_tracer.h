@@ -13,6 +13,7 @@
 d_m3BeginExternC
 
 M3Result    m3_LinkTracer       (IM3Module io_module);
+M3Result    m3_RegisterTracer   (IM3ImportRegistry io_registry);
 
 d_m3EndExternC
 
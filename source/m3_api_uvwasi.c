@@ -11,9 +11,14 @@
 
 #include "m3_env.h"
 #include "m3_exception.h"
+#include "m3_bind.h"
 
 #if defined(d_m3HasUVWASI)
 
+#define c_wasiErrnoBadf     UVWASI_EBADF
+#define c_wasiErrnoNomem    UVWASI_ENOMEM
+#include "m3_api_wasi_io.h"
+
 #include <stdio.h>
 #include <string.h>
 
@@ -27,11 +32,184 @@ extern char** environ;
 static m3_wasi_context_t* wasi_context;
 static uvwasi_t uvwasi;
 
-typedef struct wasi_iovec_t
+#if d_m3WasiStdio
+static
+void wasi_release_state(IM3Runtime runtime)
+{
+    wasi_stdio_clear((m3_wasi_stdio_t*) runtime->wasi);
+    m3_AllocatorFree(&runtime->environment->allocator, runtime->wasi);
+    runtime->releaseWasi = NULL;
+}
+
+// the stdio capture is all the state this backend keeps per runtime
+static
+m3_wasi_stdio_t* wasi_stdio_state(IM3Runtime runtime, bool create)
+{
+    if (!runtime->wasi && create) {
+        runtime->wasi = m3_AllocatorAllocStruct(&runtime->environment->allocator, m3_wasi_stdio_t);
+        if (runtime->wasi) runtime->releaseWasi = wasi_release_state;
+    }
+    return (m3_wasi_stdio_t*) runtime->wasi;
+}
+#endif
+
+static
+uint32_t wasi_host_writev(int32_t fd, const m3_host_iovec_t* iovs, uint32_t iovs_len, size_t* nwritten)
 {
-    uvwasi_size_t buf;
-    uvwasi_size_t buf_len;
-} wasi_iovec_t;
+    uvwasi_size_t written = 0;
+    uvwasi_errno_t ret = uvwasi_fd_write(&uvwasi, fd, (const uvwasi_ciovec_t*)iovs, iovs_len, &written);
+    *nwritten = written;
+    return ret;
+}
+
+/*
+ * Shared event loop
+ */
+
+static uv_loop_t *              wasi_loop;
+static M3WasiResumeHandler      wasi_on_resumed;
+
+// a uvwasi call that may run on the loop's threadpool
+typedef struct m3_wasi_async_t
+{
+    uv_work_t               req;
+    IM3Runtime              runtime;    // parked on this call; NULL once nobody waits for it
+    uvwasi_errno_t          (* call) (struct m3_wasi_async_t *);
+    uvwasi_errno_t          ret;
+    u32                     finished;   // set by the threadpool once call has returned
+
+    uvwasi_fd_t             fd;
+    const void *            in;
+    void *                  out;
+    uvwasi_size_t           len;
+    uvwasi_filesize_t       offset;
+    uvwasi_size_t           size;       // result count
+}
+m3_wasi_async_t;
+
+static
+void wasi_async_work(uv_work_t* req)
+{
+    m3_wasi_async_t* job = (m3_wasi_async_t*) req->data;
+    job->ret = job->call(job);
+    m3_AtomicExchange32(&job->finished, 1);
+}
+
+static
+void wasi_async_done(uv_work_t* req, int status)
+{
+    m3_wasi_async_t* job = (m3_wasi_async_t*) req->data;
+    IM3Runtime runtime = job->runtime;
+
+    if (!runtime) {
+        free(job);
+        return;
+    }
+    if (status == UV_ECANCELED) job->ret = UVWASI_ECANCELED;
+
+    // the resumed guest takes the result and frees job
+    M3Result result = m3_Resume(runtime);
+    if (result == m3Err_notSuspended) free(job);
+    if (wasi_on_resumed) wasi_on_resumed(runtime, result);
+}
+
+// runs the call on the attached loop and parks the guest until it completes,
+// or runs it here when there is no loop or the guest can't be suspended.
+// the queued request lives on the heap: if parking fails after all, the loop
+// still owns it and frees it once the threadpool is done with it
+static
+uvwasi_errno_t wasi_async(IM3Runtime runtime, m3_wasi_async_t* a)
+{
+    if (wasi_loop && m3_CanSuspend(runtime)) {
+        m3_wasi_async_t* job = (m3_wasi_async_t*) malloc(sizeof(m3_wasi_async_t));
+        if (job) {
+            *job = *a;
+            job->runtime = runtime;
+            job->finished = 0;
+            job->req.data = job;
+            if (uv_queue_work(wasi_loop, &job->req, wasi_async_work, wasi_async_done) == 0) {
+                if (m3_Suspend(runtime) == m3Err_none) {
+                    // resumed by wasi_async_done
+                    a->ret  = job->ret;
+                    a->size = job->size;
+                    free(job);
+                    return a->ret;
+                }
+
+                job->runtime = NULL;
+                if (uv_cancel((uv_req_t*) &job->req) == 0) {
+                    return a->call(a);
+                }
+                // already on the threadpool; wasi_async_done runs on this thread, so job
+                // stays valid until we return
+                while (!m3_AtomicLoad32(&job->finished)) {
+                    uv_sleep(1);
+                }
+                a->size = job->size;
+                return job->ret;
+            }
+            free(job);
+        }
+    }
+    return a->call(a);
+}
+
+static
+uvwasi_errno_t wasi_call_fd_read(m3_wasi_async_t* a)
+{
+    return uvwasi_fd_read(&uvwasi, a->fd, (const uvwasi_iovec_t*) a->in, a->len, &a->size);
+}
+
+static
+uvwasi_errno_t wasi_call_fd_pread(m3_wasi_async_t* a)
+{
+    return uvwasi_fd_pread(&uvwasi, a->fd, (const uvwasi_iovec_t*) a->in, a->len, a->offset, &a->size);
+}
+
+static
+uvwasi_errno_t wasi_call_fd_write(m3_wasi_async_t* a)
+{
+    return uvwasi_fd_write(&uvwasi, a->fd, (const uvwasi_ciovec_t*) a->in, a->len, &a->size);
+}
+
+static
+uvwasi_errno_t wasi_call_fd_pwrite(m3_wasi_async_t* a)
+{
+    return uvwasi_fd_pwrite(&uvwasi, a->fd, (const uvwasi_ciovec_t*) a->in, a->len, a->offset, &a->size);
+}
+
+static
+uvwasi_errno_t wasi_call_fd_sync(m3_wasi_async_t* a)
+{
+    return uvwasi_fd_sync(&uvwasi, a->fd);
+}
+
+static
+uvwasi_errno_t wasi_call_fd_datasync(m3_wasi_async_t* a)
+{
+    return uvwasi_fd_datasync(&uvwasi, a->fd);
+}
+
+static
+uvwasi_errno_t wasi_call_poll_oneoff(m3_wasi_async_t* a)
+{
+    return uvwasi_poll_oneoff(&uvwasi, (const uvwasi_subscription_t*) a->in, (uvwasi_event_t*) a->out, a->len, &a->size);
+}
+
+M3Result  m3_AttachWASILoop  (uv_loop_t * i_loop, M3WasiResumeHandler i_onResumed)
+{
+    wasi_loop = i_loop;
+    wasi_on_resumed = i_onResumed;
+    return m3Err_none;
+}
+
+#if d_m3WasiWriteBufferSize
+static
+void wasi_flush_at_exit(void)
+{
+    wasi_flush_all(wasi_host_writev);
+}
+#endif
 
 #if d_m3EnableWasiTracing
 
@@ -507,7 +685,12 @@ m3ApiRawFunction(m3_wasi_generic_fd_sync)
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (uvwasi_fd_t          , fd)
 
-    uvwasi_errno_t ret = uvwasi_fd_sync(&uvwasi, fd);
+#if d_m3WasiWriteBufferSize
+    wasi_flush_fd(wasi_host_writev, fd);
+#endif
+
+    m3_wasi_async_t call = { .call = wasi_call_fd_sync, .fd = fd };
+    uvwasi_errno_t ret = wasi_async(runtime, &call);
 
     WASI_TRACE("fd:%d", fd);
 
@@ -756,32 +939,23 @@ m3ApiRawFunction(m3_wasi_generic_fd_pread)
 {
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (uvwasi_fd_t          , fd)
-    m3ApiGetArgMem   (wasi_iovec_t *       , wasi_iovs)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
     m3ApiGetArg      (uvwasi_size_t        , iovs_len)
     m3ApiGetArg      (uvwasi_filesize_t    , offset)
     m3ApiGetArgMem   (uvwasi_size_t *      , nread)
 
-    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(wasi_iovec_t));
     m3ApiCheckMem(nread,        sizeof(uvwasi_size_t));
 
-#if defined(M3_COMPILER_MSVC)
-    if (iovs_len > 32) m3ApiReturn(UVWASI_EINVAL);
-    uvwasi_iovec_t  iovs[32];
-#else
-    if (iovs_len > 128) m3ApiReturn(UVWASI_EINVAL);
-    uvwasi_iovec_t  iovs[iovs_len];
-#endif
-
-    for (uvwasi_size_t i = 0; i < iovs_len; ++i) {
-        iovs[i].buf = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
-        iovs[i].buf_len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
-        m3ApiCheckMem(iovs[i].buf,     iovs[i].buf_len);
-        //fprintf(stderr, "> fd_pread fd:%d iov%d.len:%d\n", fd, i, iovs[i].buf_len);
+    m3_wasi_iovecs_t iovecs;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, NULL);
+    if (mem_check != m3Err_none) {
+        return mem_check;
     }
 
-    uvwasi_size_t num_read;
-
-    uvwasi_errno_t ret = uvwasi_fd_pread(&uvwasi, fd, iovs, iovs_len, offset, &num_read);
+    m3_wasi_async_t call = { .call = wasi_call_fd_pread, .fd = fd, .in = iovecs.iovs, .len = iovs_len, .offset = offset };
+    uvwasi_errno_t ret = wasi_async(runtime, &call);
+    wasi_release_iovs(runtime, &iovecs);
+    uvwasi_size_t num_read = call.size;
 
     WASI_TRACE("fd:%d | nread:%d", fd, num_read);
 
@@ -793,31 +967,38 @@ m3ApiRawFunction(m3_wasi_generic_fd_read)
 {
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (uvwasi_fd_t          , fd)
-    m3ApiGetArgMem   (wasi_iovec_t *       , wasi_iovs)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
     m3ApiGetArg      (uvwasi_size_t        , iovs_len)
     m3ApiGetArgMem   (uvwasi_size_t *      , nread)
 
-    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(wasi_iovec_t));
     m3ApiCheckMem(nread,        sizeof(uvwasi_size_t));
 
-#if defined(M3_COMPILER_MSVC)
-    if (iovs_len > 32) m3ApiReturn(UVWASI_EINVAL);
-    uvwasi_iovec_t  iovs[32];
-#else
-    if (iovs_len > 128) m3ApiReturn(UVWASI_EINVAL);
-    uvwasi_iovec_t  iovs[iovs_len];
-#endif
-    uvwasi_size_t num_read;
-    uvwasi_errno_t ret;
+    m3_wasi_iovecs_t iovecs;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, NULL);
+    if (mem_check != m3Err_none) {
+        return mem_check;
+    }
 
-    for (uvwasi_size_t i = 0; i < iovs_len; ++i) {
-        iovs[i].buf = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
-        iovs[i].buf_len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
-        m3ApiCheckMem(iovs[i].buf,     iovs[i].buf_len);
-        //fprintf(stderr, "> fd_read fd:%d iov%d.len:%d\n", fd, i, iovs[i].buf_len);
+#if d_m3WasiStdio
+    m3_wasi_stdio_t* stdio = wasi_stdio_get(runtime, fd);
+    if (stdio) {
+        size_t num = 0;
+        uint32_t ret = wasi_stdio_rw(stdio, false, fd, iovecs.iovs, iovs_len, &num);
+        wasi_release_iovs(runtime, &iovecs);
+        m3ApiWriteMem32(nread, num);
+        m3ApiReturn(ret);
     }
+#endif
 
-    ret = uvwasi_fd_read(&uvwasi, fd, iovs, iovs_len, &num_read);
+#if d_m3WasiWriteBufferSize
+    // show any pending prompt before blocking on input
+    if (fd == 0) wasi_flush_all(wasi_host_writev);
+#endif
+
+    m3_wasi_async_t call = { .call = wasi_call_fd_read, .fd = fd, .in = iovecs.iovs, .len = iovs_len };
+    uvwasi_errno_t ret = wasi_async(runtime, &call);
+    wasi_release_iovs(runtime, &iovecs);
+    uvwasi_size_t num_read = call.size;
 
     WASI_TRACE("fd:%d | nread:%d", fd, num_read);
 
@@ -829,32 +1010,43 @@ m3ApiRawFunction(m3_wasi_generic_fd_write)
 {
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (uvwasi_fd_t          , fd)
-    m3ApiGetArgMem   (wasi_iovec_t *       , wasi_iovs)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
     m3ApiGetArg      (uvwasi_size_t        , iovs_len)
     m3ApiGetArgMem   (uvwasi_size_t *      , nwritten)
 
-    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(wasi_iovec_t));
     m3ApiCheckMem(nwritten,     sizeof(uvwasi_size_t));
 
-#if defined(M3_COMPILER_MSVC)
-    if (iovs_len > 32) m3ApiReturn(UVWASI_EINVAL);
-    uvwasi_ciovec_t  iovs[32];
-#else
-    if (iovs_len > 128) m3ApiReturn(UVWASI_EINVAL);
-    uvwasi_ciovec_t  iovs[iovs_len];
-#endif
-    uvwasi_size_t num_written;
-    uvwasi_errno_t ret;
+    m3_wasi_iovecs_t iovecs;
+    size_t total_len = 0;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, &total_len);
+    if (mem_check != m3Err_none) {
+        return mem_check;
+    }
 
-    for (uvwasi_size_t i = 0; i < iovs_len; ++i) {
-        iovs[i].buf = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
-        iovs[i].buf_len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
-        m3ApiCheckMem(iovs[i].buf,     iovs[i].buf_len);
+#if d_m3WasiStdio
+    m3_wasi_stdio_t* stdio = wasi_stdio_get(runtime, fd);
+    if (stdio) {
+        size_t num = 0;
+        uint32_t ret = wasi_stdio_rw(stdio, true, fd, iovecs.iovs, iovs_len, &num);
+        wasi_release_iovs(runtime, &iovecs);
+        m3ApiWriteMem32(nwritten, num);
+        m3ApiReturn(ret);
     }
+#endif
 
-    ret = uvwasi_fd_write(&uvwasi, fd, iovs, iovs_len, &num_written);
+    size_t num_written = 0;
+    uint32_t ret;
+#if d_m3WasiWriteBufferSize
+    if (!wasi_buffered_write(wasi_host_writev, fd, iovecs.iovs, iovs_len, total_len, &num_written, &ret))
+#endif
+    {
+        m3_wasi_async_t call = { .call = wasi_call_fd_write, .fd = fd, .in = iovecs.iovs, .len = iovs_len };
+        ret = wasi_async(runtime, &call);
+        num_written = call.size;
+    }
+    wasi_release_iovs(runtime, &iovecs);
 
-    WASI_TRACE("fd:%d | nwritten:%d", fd, num_written);
+    WASI_TRACE("fd:%d | nwritten:%d", fd, (uvwasi_size_t) num_written);
 
     m3ApiWriteMem32(nwritten, num_written);
     m3ApiReturn(ret);
@@ -864,31 +1056,23 @@ m3ApiRawFunction(m3_wasi_generic_fd_pwrite)
 {
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (uvwasi_fd_t          , fd)
-    m3ApiGetArgMem   (wasi_iovec_t *       , wasi_iovs)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
     m3ApiGetArg      (uvwasi_size_t        , iovs_len)
     m3ApiGetArg      (uvwasi_filesize_t    , offset)
     m3ApiGetArgMem   (uvwasi_size_t *      , nwritten)
 
-    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(wasi_iovec_t));
     m3ApiCheckMem(nwritten,     sizeof(uvwasi_size_t));
 
-#if defined(M3_COMPILER_MSVC)
-    if (iovs_len > 32) m3ApiReturn(UVWASI_EINVAL);
-    uvwasi_ciovec_t  iovs[32];
-#else
-    if (iovs_len > 128) m3ApiReturn(UVWASI_EINVAL);
-    uvwasi_ciovec_t  iovs[iovs_len];
-#endif
-    uvwasi_size_t num_written;
-    uvwasi_errno_t ret;
-
-    for (uvwasi_size_t i = 0; i < iovs_len; ++i) {
-        iovs[i].buf = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
-        iovs[i].buf_len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
-        m3ApiCheckMem(iovs[i].buf,     iovs[i].buf_len);
+    m3_wasi_iovecs_t iovecs;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, NULL);
+    if (mem_check != m3Err_none) {
+        return mem_check;
     }
 
-    ret = uvwasi_fd_pwrite(&uvwasi, fd, iovs, iovs_len, offset, &num_written);
+    m3_wasi_async_t call = { .call = wasi_call_fd_pwrite, .fd = fd, .in = iovecs.iovs, .len = iovs_len, .offset = offset };
+    uvwasi_errno_t ret = wasi_async(runtime, &call);
+    wasi_release_iovs(runtime, &iovecs);
+    uvwasi_size_t num_written = call.size;
 
     WASI_TRACE("fd:%d | nwritten:%d", fd, num_written);
 
@@ -952,6 +1136,10 @@ m3ApiRawFunction(m3_wasi_generic_fd_close)
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (uvwasi_fd_t, fd)
 
+#if d_m3WasiWriteBufferSize
+    wasi_flush_fd(wasi_host_writev, fd);
+#endif
+
     uvwasi_errno_t ret = uvwasi_fd_close(&uvwasi, fd);
 
     WASI_TRACE("fd:%d", fd);
@@ -964,7 +1152,12 @@ m3ApiRawFunction(m3_wasi_generic_fd_datasync)
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (uvwasi_fd_t, fd)
 
-    uvwasi_errno_t ret = uvwasi_fd_datasync(&uvwasi, fd);
+#if d_m3WasiWriteBufferSize
+    wasi_flush_fd(wasi_host_writev, fd);
+#endif
+
+    m3_wasi_async_t call = { .call = wasi_call_fd_datasync, .fd = fd };
+    uvwasi_errno_t ret = wasi_async(runtime, &call);
 
     WASI_TRACE("fd:%d", fd);
 
@@ -1037,11 +1230,16 @@ m3ApiRawFunction(m3_wasi_generic_poll_oneoff)
 
     // TODO: unstable/snapshot_preview1 compatibility
 
-    uvwasi_errno_t ret = uvwasi_poll_oneoff(&uvwasi, in, out, nsubscriptions, nevents);
+#if d_m3WasiWriteBufferSize
+    wasi_flush_all(wasi_host_writev);
+#endif
+
+    m3_wasi_async_t call = { .call = wasi_call_poll_oneoff, .in = in, .out = out, .len = nsubscriptions };
+    uvwasi_errno_t ret = wasi_async(runtime, &call);
 
-    WASI_TRACE("nsubscriptions:%d | nevents:%d", nsubscriptions, *nevents);
+    WASI_TRACE("nsubscriptions:%d | nevents:%d", nsubscriptions, call.size);
 
-    //TODO: m3ApiWriteMem
+    m3ApiWriteMem32(nevents, call.size);
 
     m3ApiReturn(ret);
 }
@@ -1058,6 +1256,10 @@ m3ApiRawFunction(m3_wasi_generic_proc_exit)
 
     //TODO: fprintf(stderr, "proc_exit code:%d\n", code);
 
+#if d_m3WasiWriteBufferSize
+    wasi_flush_all(wasi_host_writev);
+#endif
+
     m3ApiTrap(m3Err_trapExit);
 }
 
@@ -1084,26 +1286,53 @@ m3ApiRawFunction(m3_wasi_generic_sched_yield)
 }
 
 
-static
-M3Result SuppressLookupFailure(M3Result i_result)
+m3_wasi_context_t* m3_GetWasiContext()
 {
-    if (i_result == m3Err_functionLookupFailed)
-        return m3Err_none;
-    else
-        return i_result;
+    return wasi_context;
 }
 
-m3_wasi_context_t* m3_GetWasiContext()
+
+void m3_FlushWASI()
 {
-    return wasi_context;
+#if d_m3WasiWriteBufferSize
+    wasi_flush_all(wasi_host_writev);
+#endif
 }
 
 
-M3Result  m3_LinkWASI  (IM3Module module)
+M3Result m3_CaptureStdioWASI (IM3Runtime i_runtime)
+{
+    return wasi_stdio_capture(i_runtime);
+}
+
+void m3_ReleaseStdioWASI (IM3Runtime i_runtime)
+{
+    wasi_stdio_release(i_runtime);
+}
+
+size_t m3_PeekStdioWASI (IM3Runtime i_runtime, int i_fd, const void** o_data)
+{
+    return wasi_stdio_peek(i_runtime, i_fd, o_data);
+}
+
+void m3_ConsumeStdioWASI (IM3Runtime i_runtime, int i_fd, size_t i_length)
+{
+    wasi_stdio_consume(i_runtime, i_fd, i_length);
+}
+
+M3Result m3_FeedStdinWASI (IM3Runtime i_runtime, const void* i_data, size_t i_length)
+{
+    return wasi_stdio_feed(i_runtime, i_data, i_length);
+}
+
+
+static
+void  GetDefaultOptions  (uvwasi_options_t * o_options)
 {
     #define ENV_COUNT       9
 
-    char* env[ENV_COUNT];
+    // uvwasi_init copies these, but keep them alive past this call anyway
+    static char* env[ENV_COUNT];
     env[0] = "TERM=xterm-256color";
     env[1] = "COLORTERM=truecolor";
     env[2] = "LANG=en_US.UTF-8";
@@ -1116,104 +1345,140 @@ M3Result  m3_LinkWASI  (IM3Module module)
 
     #define PREOPENS_COUNT  2
 
-    uvwasi_preopen_t preopens[PREOPENS_COUNT];
+    static uvwasi_preopen_t preopens[PREOPENS_COUNT];
     preopens[0].mapped_path = "/";
     preopens[0].real_path = ".";
     preopens[1].mapped_path = "./";
     preopens[1].real_path = ".";
 
-    uvwasi_options_t init_options;
-    uvwasi_options_init(&init_options);
-    init_options.argc = 0;      // runtime->argc is not initialized at this point, so we implement args_get directly
-    init_options.envp = (const char **) env;
-    init_options.preopenc = PREOPENS_COUNT;
-    init_options.preopens = preopens;
-
-    return m3_LinkWASIWithOptions(module, init_options);
+    uvwasi_options_init(o_options);
+    o_options->argc = 0;      // runtime->argc is not initialized at this point, so we implement args_get directly
+    o_options->envp = (const char **) env;
+    o_options->preopenc = PREOPENS_COUNT;
+    o_options->preopens = preopens;
 }
 
-M3Result  m3_LinkWASIWithOptions  (IM3Module module, uvwasi_options_t init_options)
+static
+M3Result  InitWasiContext  (uvwasi_options_t * i_options)
 {
-    M3Result result = m3Err_none;
-
     if (!wasi_context) {
         wasi_context = (m3_wasi_context_t*)malloc(sizeof(m3_wasi_context_t));
         wasi_context->exit_code = 0;
         wasi_context->argc = 0;
         wasi_context->argv = 0;
 
-        uvwasi_errno_t ret = uvwasi_init(&uvwasi, &init_options);
+        uvwasi_errno_t ret = uvwasi_init(&uvwasi, i_options);
 
         if (ret != UVWASI_ESUCCESS) {
             return "uvwasi_init failed";
         }
+
+#if d_m3WasiWriteBufferSize
+        atexit(wasi_flush_at_exit);
+#endif
+    }
+
+    return m3Err_none;
+}
+
+
+M3Result  m3_RegisterWASI  (IM3ImportRegistry io_registry)
+{
+    M3Result result = m3Err_none;
+
+    if (!wasi_context) {
+        uvwasi_options_t init_options;
+        GetDefaultOptions(&init_options);
+_       (InitWasiContext(&init_options));
     }
 
     static const char* namespaces[2] = { "wasi_unstable", "wasi_snapshot_preview1" };
 
     // Some functions are incompatible between WASI versions
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_unstable",          "fd_seek",           "i(iIi*)",   &m3_wasi_unstable_fd_seek)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_snapshot_preview1", "fd_seek",           "i(iIi*)",   &m3_wasi_snapshot_preview1_fd_seek)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_unstable",          "fd_filestat_get",   "i(i*)",     &m3_wasi_unstable_fd_filestat_get)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_snapshot_preview1", "fd_filestat_get",   "i(i*)",     &m3_wasi_snapshot_preview1_fd_filestat_get)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_unstable",          "path_filestat_get", "i(ii*i*)",  &m3_wasi_unstable_path_filestat_get)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_snapshot_preview1", "path_filestat_get", "i(ii*i*)",  &m3_wasi_snapshot_preview1_path_filestat_get)));
+_   (m3_RegisterRawFunction (io_registry, "wasi_unstable",          "fd_seek",           "i(iIi*)",   &m3_wasi_unstable_fd_seek, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "fd_seek",           "i(iIi*)",   &m3_wasi_snapshot_preview1_fd_seek, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_unstable",          "fd_filestat_get",   "i(i*)",     &m3_wasi_unstable_fd_filestat_get, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "fd_filestat_get",   "i(i*)",     &m3_wasi_snapshot_preview1_fd_filestat_get, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_unstable",          "path_filestat_get", "i(ii*i*)",  &m3_wasi_unstable_path_filestat_get, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "path_filestat_get", "i(ii*i*)",  &m3_wasi_snapshot_preview1_path_filestat_get, NULL));
 
     for (int i=0; i<2; i++)
     {
         const char* wasi = namespaces[i];
 
-_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "args_get",           "i(**)",   &m3_wasi_generic_args_get, wasi_context)));
-_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "args_sizes_get",     "i(**)",   &m3_wasi_generic_args_sizes_get, wasi_context)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "clock_res_get",        "i(i*)",   &m3_wasi_generic_clock_res_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "clock_time_get",       "i(iI*)",  &m3_wasi_generic_clock_time_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "environ_get",          "i(**)",   &m3_wasi_generic_environ_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "environ_sizes_get",    "i(**)",   &m3_wasi_generic_environ_sizes_get)));
-
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_advise",            "i(iIIi)", &m3_wasi_generic_fd_advise)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_allocate",          "i(iII)",  &m3_wasi_generic_fd_allocate)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_close",             "i(i)",    &m3_wasi_generic_fd_close)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_datasync",          "i(i)",    &m3_wasi_generic_fd_datasync)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_get",        "i(i*)",   &m3_wasi_generic_fd_fdstat_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_set_flags",  "i(ii)",   &m3_wasi_generic_fd_fdstat_set_flags)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_set_rights", "i(iII)",  &m3_wasi_generic_fd_fdstat_set_rights)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_filestat_set_size", "i(iI)",   &m3_wasi_generic_fd_filestat_set_size)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_filestat_set_times","i(iIIi)", &m3_wasi_generic_fd_filestat_set_times)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_pread",             "i(i*iI*)",&m3_wasi_generic_fd_pread)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_prestat_get",       "i(i*)",   &m3_wasi_generic_fd_prestat_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_prestat_dir_name",  "i(i*i)",  &m3_wasi_generic_fd_prestat_dir_name)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_pwrite",            "i(i*iI*)",&m3_wasi_generic_fd_pwrite)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_read",              "i(i*i*)", &m3_wasi_generic_fd_read)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_readdir",           "i(i*iI*)",&m3_wasi_generic_fd_readdir)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_renumber",          "i(ii)",   &m3_wasi_generic_fd_renumber)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_sync",              "i(i)",    &m3_wasi_generic_fd_sync)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_tell",              "i(i*)",   &m3_wasi_generic_fd_tell)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_write",             "i(i*i*)", &m3_wasi_generic_fd_write)));
-
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_create_directory",    "i(i*i)",       &m3_wasi_generic_path_create_directory)));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_filestat_set_times",  "i(ii*iIIi)",   )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_link",                "i(ii*ii*i)",   )));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_open",                "i(ii*iiIIi*)", &m3_wasi_generic_path_open)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_readlink",            "i(i*i*i*)",    &m3_wasi_generic_path_readlink)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_remove_directory",    "i(i*i)",       &m3_wasi_generic_path_remove_directory)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_rename",              "i(i*ii*i)",    &m3_wasi_generic_path_rename)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_symlink",             "i(*ii*i)",     &m3_wasi_generic_path_symlink)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_unlink_file",         "i(i*i)",       &m3_wasi_generic_path_unlink_file)));
-
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "poll_oneoff",          "i(**i*)", &m3_wasi_generic_poll_oneoff)));
-_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "proc_exit",          "v(i)",    &m3_wasi_generic_proc_exit, wasi_context)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "proc_raise",           "i(i)",    &m3_wasi_generic_proc_raise)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "random_get",           "i(*i)",   &m3_wasi_generic_random_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sched_yield",          "i()",     &m3_wasi_generic_sched_yield)));
-
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sock_recv",            "i(i*ii**)",        )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sock_send",            "i(i*ii*)",         )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sock_shutdown",        "i(ii)",            )));
+_       (m3_RegisterRawFunction (io_registry, wasi, "args_get",             "i(**)",   &m3_wasi_generic_args_get, wasi_context));
+_       (m3_RegisterRawFunction (io_registry, wasi, "args_sizes_get",       "i(**)",   &m3_wasi_generic_args_sizes_get, wasi_context));
+_       (m3_RegisterRawFunction (io_registry, wasi, "clock_res_get",        "i(i*)",   &m3_wasi_generic_clock_res_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "clock_time_get",       "i(iI*)",  &m3_wasi_generic_clock_time_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "environ_get",          "i(**)",   &m3_wasi_generic_environ_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "environ_sizes_get",    "i(**)",   &m3_wasi_generic_environ_sizes_get, NULL));
+
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_advise",            "i(iIIi)", &m3_wasi_generic_fd_advise, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_allocate",          "i(iII)",  &m3_wasi_generic_fd_allocate, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_close",             "i(i)",    &m3_wasi_generic_fd_close, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_datasync",          "i(i)",    &m3_wasi_generic_fd_datasync, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_fdstat_get",        "i(i*)",   &m3_wasi_generic_fd_fdstat_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_fdstat_set_flags",  "i(ii)",   &m3_wasi_generic_fd_fdstat_set_flags, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_fdstat_set_rights", "i(iII)",  &m3_wasi_generic_fd_fdstat_set_rights, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_filestat_set_size", "i(iI)",   &m3_wasi_generic_fd_filestat_set_size, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_filestat_set_times","i(iIIi)", &m3_wasi_generic_fd_filestat_set_times, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_pread",             "i(i*iI*)",&m3_wasi_generic_fd_pread, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_prestat_get",       "i(i*)",   &m3_wasi_generic_fd_prestat_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_prestat_dir_name",  "i(i*i)",  &m3_wasi_generic_fd_prestat_dir_name, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_pwrite",            "i(i*iI*)",&m3_wasi_generic_fd_pwrite, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_read",              "i(i*i*)", &m3_wasi_generic_fd_read, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_readdir",           "i(i*iI*)",&m3_wasi_generic_fd_readdir, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_renumber",          "i(ii)",   &m3_wasi_generic_fd_renumber, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_sync",              "i(i)",    &m3_wasi_generic_fd_sync, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_tell",              "i(i*)",   &m3_wasi_generic_fd_tell, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_write",             "i(i*i*)", &m3_wasi_generic_fd_write, NULL));
+
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_create_directory",    "i(i*i)",       &m3_wasi_generic_path_create_directory, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "path_filestat_set_times",  "i(ii*iIIi)",   &m3_wasi_generic_path_filestat_set_times, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "path_link",                "i(ii*ii*i)",   &m3_wasi_generic_path_link, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_open",                "i(ii*iiIIi*)", &m3_wasi_generic_path_open, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_readlink",            "i(i*i*i*)",    &m3_wasi_generic_path_readlink, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_remove_directory",    "i(i*i)",       &m3_wasi_generic_path_remove_directory, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_rename",              "i(i*ii*i)",    &m3_wasi_generic_path_rename, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_symlink",             "i(*ii*i)",     &m3_wasi_generic_path_symlink, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_unlink_file",         "i(i*i)",       &m3_wasi_generic_path_unlink_file, NULL));
+
+_       (m3_RegisterRawFunction (io_registry, wasi, "poll_oneoff",          "i(**i*)", &m3_wasi_generic_poll_oneoff, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "proc_exit",            "v(i)",    &m3_wasi_generic_proc_exit, wasi_context));
+_       (m3_RegisterRawFunction (io_registry, wasi, "proc_raise",           "i(i)",    &m3_wasi_generic_proc_raise, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "random_get",           "i(*i)",   &m3_wasi_generic_random_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "sched_yield",          "i()",     &m3_wasi_generic_sched_yield, NULL));
+
+//_     (m3_RegisterRawFunction (io_registry, wasi, "sock_recv",            "i(i*ii**)",        &m3_wasi_generic_sock_recv, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "sock_send",            "i(i*ii*)",         &m3_wasi_generic_sock_send, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "sock_shutdown",        "i(ii)",            &m3_wasi_generic_sock_shutdown, NULL));
     }
 
 _catch:
     return result;
 }
 
+
+M3Result  m3_LinkWASI  (IM3Module module)
+{
+    uvwasi_options_t init_options;
+    GetDefaultOptions(&init_options);
+
+    return m3_LinkWASIWithOptions(module, init_options);
+}
+
+M3Result  m3_LinkWASIWithOptions  (IM3Module module, uvwasi_options_t init_options)
+{
+    M3Result result = m3Err_none;
+
+_   (InitWasiContext(&init_options));
+
+    static IM3ImportRegistry registry = NULL;
+_   (LinkRegisteredImports (module, & registry, m3_RegisterWASI));
+
+_catch:
+    return result;
+}
+
 #endif // d_m3HasUVWASI
 
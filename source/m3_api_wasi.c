@@ -5,12 +5,16 @@
 //  Copyright © 2019 Volodymyr Shymanskyy. All rights reserved.
 //
 
+#if defined(__linux__)
+#  define _GNU_SOURCE       // O_PATH; syscall, preadv, pwritev
+#endif
 #define _POSIX_C_SOURCE 200809L
 
 #include "m3_api_wasi.h"
 
 #include "m3_env.h"
 #include "m3_exception.h"
+#include "m3_bind.h"
 
 #if defined(d_m3HasWASI)
 
@@ -23,6 +27,10 @@
 
 #include "extra/wasi_core.h"
 
+#define c_wasiErrnoBadf     __WASI_ERRNO_BADF
+#define c_wasiErrnoNomem    __WASI_ERRNO_NOMEM
+#include "m3_api_wasi_io.h"
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <time.h>
@@ -62,13 +70,205 @@
 #  define close _close
 #endif
 
+#if defined(HAS_IOVEC) && !defined(__wasi__) && !defined(__EMSCRIPTEN__)
+#  include <sys/socket.h>
+#  define HAS_SOCKETS
+#endif
+
+#if !defined(S_ISSOCK)
+#  define S_ISSOCK(m)   0
+#endif
+
+#if defined(__linux__)
+#  include <poll.h>
+#  include <sys/epoll.h>
+#  include <sys/ioctl.h>
+#  include <sys/timerfd.h>
+#endif
+
+#if defined(d_m3HasUringWASI)
+#  include "m3_api_wasi_uring.h"
+#endif
+
 static m3_wasi_context_t* wasi_context;
 
-typedef struct wasi_iovec_t
+// the cache holds search-only handles (O_PATH, or POSIX O_SEARCH), which also open directories
+// without read permission
+#if d_m3WasiDirCacheSize && !defined(_WIN32) && !defined(APE) && (defined(O_PATH) || defined(O_SEARCH))
+#  define HAS_DIR_CACHE
+
+#if d_m3WasiDirCacheSize < 2
+#  error "d_m3WasiDirCacheSize must be 0 or at least 2 (path_rename resolves two paths)"
+#endif
+
+#define c_wasiDirCachePathMax   256
+
+// open directory handles keyed by (base fd, normalized relative path), so repeated lookups
+// under the same directories only make the kernel walk the last component
+typedef struct wasi_dir_cache_entry_t
+{
+    int         base;
+    int         fd;
+    u32         lastUse;
+    char        path [c_wasiDirCachePathMax];
+}
+wasi_dir_cache_entry_t;
+#endif
+
+// a pool inherited across fork() must not be handed out in the child too
+#if d_m3WasiRandomPoolSize && !defined(_WIN32) && !defined(__wasi__) && !defined(__EMSCRIPTEN__)
+#  define HAS_FORK_GENERATION
+#  include <pthread.h>
+
+static u32 wasi_fork_generation;    // bumped in every forked child
+
+static
+void wasi_on_fork_child(void)
+{
+    wasi_fork_generation++;
+}
+#endif
+
+#if defined(CLOCK_MONOTONIC_COARSE) && defined(CLOCK_REALTIME_COARSE)
+#  define HAS_COARSE_CLOCKS
+#endif
+
+#if d_m3WasiVfs && !defined(_WIN32) && !defined(APE) && !defined(__wasi__)
+#  define HAS_WASI_VFS
+#  include "m3_api_wasi_vfs.h"
+#endif
+
+#if defined(__linux__) || defined(HAS_DIR_CACHE) || d_m3WasiRandomPoolSize || defined(HAS_COARSE_CLOCKS) || defined(HAS_WASI_VFS) || d_m3WasiStdio
+#  define HAS_WASI_STATE
+
+// state that belongs to one runtime: allocated on first use, released with the runtime
+typedef struct m3_wasi_state_t
+{
+#if defined(__linux__)
+    int                     epollFd;        // poll_oneoff; -1 until the first call
+    int                     timerFd;
+#endif
+#if defined(HAS_DIR_CACHE)
+    wasi_dir_cache_entry_t  dirCache [d_m3WasiDirCacheSize];
+    u32                     dirCacheClock;
+#endif
+#if d_m3WasiRandomPoolSize
+    uint8_t                 randomPool [d_m3WasiRandomPoolSize];    // see wasi_pool_random
+    size_t                  randomAvail;
+#   if defined(HAS_FORK_GENERATION)
+    u32                     randomGeneration;   // wasi_fork_generation the pool was filled under
+#   endif
+#endif
+#if defined(HAS_COARSE_CLOCKS)
+    __wasi_timestamp_t      lastMonotonic;  // see clock_time_get
+#endif
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t *         vfs;            // m3_MountWASIImage
+#endif
+#if d_m3WasiStdio
+    m3_wasi_stdio_t         stdio;          // m3_CaptureStdioWASI
+#endif
+#if defined(d_m3HasUringWASI)
+    m3_wasi_uring_t         uring;          // see wasi_uring_get
+#endif
+}
+m3_wasi_state_t;
+
+static
+void wasi_release_state(IM3Runtime runtime)
+{
+    m3_wasi_state_t* state = (m3_wasi_state_t*) runtime->wasi;
+
+#if defined(__linux__)
+    if (state->epollFd >= 0) close(state->epollFd);
+    if (state->timerFd >= 0) close(state->timerFd);
+#endif
+#if defined(HAS_DIR_CACHE)
+    for (u32 i = 0; i < d_m3WasiDirCacheSize; i++) {
+        if (state->dirCache[i].fd >= 0) close(state->dirCache[i].fd);
+    }
+#endif
+#if d_m3WasiRandomPoolSize
+    memset(state->randomPool, 0, sizeof(state->randomPool));
+#endif
+#if defined(HAS_WASI_VFS)
+    if (state->vfs) vfs_free(state->vfs);
+#endif
+#if d_m3WasiStdio
+    wasi_stdio_clear(&state->stdio);
+#endif
+#if defined(d_m3HasUringWASI)
+    wasi_uring_free(&state->uring);
+#endif
+
+    m3_AllocatorFree(&runtime->environment->allocator, runtime->wasi);
+    runtime->releaseWasi = NULL;
+}
+
+static
+m3_wasi_state_t* wasi_state(IM3Runtime runtime)
+{
+    if (!runtime->wasi) {
+        m3_wasi_state_t* state = m3_AllocatorAllocStruct(&runtime->environment->allocator, m3_wasi_state_t);
+        if (!state) return NULL;
+
+#if defined(__linux__)
+        state->epollFd = -1;
+        state->timerFd = -1;
+#endif
+#if defined(HAS_DIR_CACHE)
+        for (u32 i = 0; i < d_m3WasiDirCacheSize; i++) {
+            state->dirCache[i].fd = -1;
+        }
+#endif
+#if defined(d_m3HasUringWASI)
+        state->uring.fd = -1;
+#endif
+
+        runtime->wasi = state;
+        runtime->releaseWasi = wasi_release_state;
+    }
+    return (m3_wasi_state_t*) runtime->wasi;
+}
+
+#if d_m3WasiStdio
+static
+m3_wasi_stdio_t* wasi_stdio_state(IM3Runtime runtime, bool create)
+{
+    m3_wasi_state_t* state = create ? wasi_state(runtime) : (m3_wasi_state_t*) runtime->wasi;
+    return state ? &state->stdio : NULL;
+}
+#endif
+
+#if defined(HAS_WASI_VFS)
+// the runtime's image when i_fd belongs to it: the preopens and fds from vfs_open
+static inline
+m3_wasi_vfs_t* wasi_vfs_get(IM3Runtime i_runtime, u32 i_fd)
+{
+    m3_wasi_state_t* state = (m3_wasi_state_t*) i_runtime->wasi;
+    if (!state || !state->vfs) return NULL;
+    if (i_fd != 3 && i_fd != 4 && i_fd < c_wasiVfsFdBase) return NULL;
+    return state->vfs;
+}
+#endif
+
+#if defined(d_m3HasUringWASI)
+// the runtime's ring, set up on first use. NULL without one (old kernel, seccomp), and then
+// I/O falls back to plain syscalls
+static
+m3_wasi_uring_t* wasi_uring_get(IM3Runtime runtime)
 {
-    __wasi_size_t buf;
-    __wasi_size_t buf_len;
-} wasi_iovec_t;
+    m3_wasi_state_t* state = wasi_state(runtime);
+    if (!state) return NULL;
+
+    if (!state->uring.initialized) {
+        wasi_uring_init(&state->uring, d_m3WasiUringEntries);
+    }
+    return (state->uring.fd >= 0) ? &state->uring : NULL;
+}
+#endif
+
+#endif // HAS_WASI_STATE
 
 #define PREOPEN_CNT   5
 
@@ -130,6 +330,13 @@ __wasi_errno_t errno_to_wasi(int errnum) {
     APE_CASE_RET( EROFS   , __WASI_ERRNO_ROFS   )
     APE_CASE_RET( EMLINK  , __WASI_ERRNO_MLINK  )
     APE_CASE_RET( EPIPE   , __WASI_ERRNO_PIPE   )
+#if defined(HAS_SOCKETS)
+    APE_CASE_RET( ENOTSOCK      , __WASI_ERRNO_NOTSOCK      )
+    APE_CASE_RET( ENOTCONN      , __WASI_ERRNO_NOTCONN      )
+    APE_CASE_RET( ECONNRESET    , __WASI_ERRNO_CONNRESET    )
+    APE_CASE_RET( ECONNABORTED  , __WASI_ERRNO_CONNABORTED  )
+    APE_CASE_RET( EOPNOTSUPP    , __WASI_ERRNO_NOTSUP       )
+#endif
     APE_CASE_RET( EDOM    , __WASI_ERRNO_DOM    )
     APE_CASE_RET( ERANGE  , __WASI_ERRNO_RANGE  )
     APE_SWITCH_END
@@ -186,21 +393,273 @@ __wasi_timestamp_t convert_timespec(const struct timespec *ts) {
     return (__wasi_timestamp_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
 }
 
+static
+uint32_t wasi_host_readv(int32_t fd, const m3_host_iovec_t* iovs, uint32_t iovs_len, size_t* nread)
+{
+#if defined(HAS_IOVEC)
+    ssize_t ret = readv(fd, (const struct iovec*)iovs, iovs_len);
+    if (ret < 0) return errno_to_wasi(errno);
+    *nread = ret;
+#else
+    size_t res = 0;
+    for (uint32_t i = 0; i < iovs_len; i++) {
+        if (iovs[i].buf_len == 0) continue;
+        int ret = read(fd, iovs[i].buf, iovs[i].buf_len);
+        if (ret < 0) return errno_to_wasi(errno);
+        res += ret;
+        if ((size_t)ret < iovs[i].buf_len) break;
+    }
+    *nread = res;
+#endif
+    return __WASI_ERRNO_SUCCESS;
+}
+
+static
+uint32_t wasi_host_writev(int32_t fd, const m3_host_iovec_t* iovs, uint32_t iovs_len, size_t* nwritten)
+{
 #if defined(HAS_IOVEC)
+    ssize_t ret = writev(fd, (const struct iovec*)iovs, iovs_len);
+    if (ret < 0) return errno_to_wasi(errno);
+    *nwritten = ret;
+#else
+    size_t res = 0;
+    for (uint32_t i = 0; i < iovs_len; i++) {
+        if (iovs[i].buf_len == 0) continue;
+        int ret = write(fd, iovs[i].buf, iovs[i].buf_len);
+        if (ret < 0) return errno_to_wasi(errno);
+        res += ret;
+        if ((size_t)ret < iovs[i].buf_len) break;
+    }
+    *nwritten = res;
+#endif
+    return __WASI_ERRNO_SUCCESS;
+}
+
+// reads or writes buffers in linear memory at offset (-1 for the file position)
+static
+uint32_t wasi_host_rw(IM3Runtime runtime, bool write, int32_t fd, const m3_host_iovec_t* iovs, uint32_t iovs_len, int64_t offset, size_t* nbytes)
+{
+#if defined(d_m3HasUringWASI)
+    m3_wasi_uring_t* ring = wasi_uring_get(runtime);
+    if (ring && wasi_uring_can_rw(ring, offset)) {
+        int ret = wasi_uring_rw(ring, runtime, write, fd, iovs, iovs_len, offset);
+        if (ret < 0) return errno_to_wasi(-ret);
+        *nbytes = ret;
+        return __WASI_ERRNO_SUCCESS;
+    }
+    if (offset >= 0) {
+        ssize_t ret = write ? pwritev(fd, (const struct iovec*)iovs, iovs_len, offset)
+                            : preadv(fd, (const struct iovec*)iovs, iovs_len, offset);
+        if (ret < 0) return errno_to_wasi(errno);
+        *nbytes = ret;
+        return __WASI_ERRNO_SUCCESS;
+    }
+#endif
+    return write ? wasi_host_writev(fd, iovs, iovs_len, nbytes)
+                 : wasi_host_readv(fd, iovs, iovs_len, nbytes);
+}
+
+#if d_m3WasiWriteBufferSize
+static
+void wasi_flush_at_exit(void)
+{
+    wasi_flush_all(wasi_host_writev);
+}
+#endif
+
+#if !defined(_WIN32) && !defined(APE)
+
+#if defined(__APPLE__)
+#  define st_atim   st_atimespec
+#  define st_mtim   st_mtimespec
+#  define st_ctim   st_ctimespec
+#endif
+
+// host directory fd that guest paths relative to dirfd start from
+static inline
+int wasi_dir_fd(__wasi_fd_t dirfd)
+{
+    return (dirfd >= 3 && dirfd < PREOPEN_CNT) ? preopen[dirfd].fd : (int) dirfd;
+}
+
+// copies a guest path into a NUL terminated buffer of 512 bytes
+static inline
+bool wasi_copy_path(char* host_path, const char* path, __wasi_size_t path_len)
+{
+    if (path_len >= 512) return false;
+    memcpy(host_path, path, path_len);
+    host_path[path_len] = '\0';
+    return true;
+}
+
+#if defined(HAS_DIR_CACHE)
+
+// drops the runtime's entries that resolve from base, or all of them when base is -1.
+// only changes made through WASI are seen: a cached handle follows its directory, so if another
+// process renames it, paths under the old name keep resolving into it until it is evicted
+static
+void wasi_dir_cache_invalidate(IM3Runtime runtime, int base)
+{
+    m3_wasi_state_t* state = (m3_wasi_state_t*) runtime->wasi;
+    if (!state) return;
+
+    for (u32 i = 0; i < d_m3WasiDirCacheSize; i++) {
+        wasi_dir_cache_entry_t* e = &state->dirCache[i];
+        if (e->fd >= 0 && (base < 0 || e->base == base)) {
+            close(e->fd);
+            e->fd = -1;
+        }
+    }
+}
+
+static
+int wasi_dir_cache_get(IM3Runtime runtime, int base, const char* dir)
+{
+    m3_wasi_state_t* state = wasi_state(runtime);
+    if (!state) return -1;
+
+    wasi_dir_cache_entry_t* victim = &state->dirCache[0];
+
+    for (u32 i = 0; i < d_m3WasiDirCacheSize; i++) {
+        wasi_dir_cache_entry_t* e = &state->dirCache[i];
+        if (e->fd < 0) {
+            if (victim->fd >= 0) victim = e;
+            continue;
+        }
+        if (e->base == base && strcmp(e->path, dir) == 0) {
+            e->lastUse = ++state->dirCacheClock;
+            return e->fd;
+        }
+        if (victim->fd >= 0 && e->lastUse < victim->lastUse) victim = e;
+    }
+
+    size_t len = strlen(dir);
+    if (len >= c_wasiDirCachePathMax) return -1;
+
+#if defined(O_PATH)
+    int fd = openat(base, dir, O_PATH | O_DIRECTORY | O_CLOEXEC);
+#else
+    int fd = openat(base, dir, O_SEARCH | O_DIRECTORY | O_CLOEXEC);
+#endif
+    if (fd < 0) return -1;
+
+    if (victim->fd >= 0) close(victim->fd);
+    victim->base = base;
+    victim->fd = fd;
+    victim->lastUse = ++state->dirCacheClock;
+    memcpy(victim->path, dir, len + 1);
+    return fd;
+}
+
+// collapses empty and "." components in place. returns false for paths left to the kernel
+// as they are: absolute ones, ones with "..", and ones naming a directory with a trailing "/"
+static
+bool wasi_normalize_path(char* path)
+{
+    size_t len = strlen(path);
+    if (len == 0 || path[0] == '/' || path[len - 1] == '/') return false;
+
+    char* out = path;
+    const char* p = path;
+    while (*p) {
+        const char* end = strchr(p, '/');
+        size_t n = end ? (size_t)(end - p) : strlen(p);
+
+        if (n == 2 && p[0] == '.' && p[1] == '.') return false;
+        if (n && !(n == 1 && p[0] == '.')) {
+            if (out != path) *out++ = '/';
+            memmove(out, p, n);
+            out += n;
+        }
+        p += n + (end ? 1 : 0);
+    }
+    *out = '\0';
+
+    return out != path;
+}
+
+#endif // HAS_DIR_CACHE
+
+// resolves path relative to the host dir fd base: returns the directory to pass to the *at
+// call and sets o_leaf to the part of path relative to it. path is modified in place
+static
+int wasi_resolve_path(IM3Runtime runtime, int base, char* path, const char** o_leaf)
+{
+    *o_leaf = path;
+
+#if defined(HAS_DIR_CACHE)
+    if (!wasi_normalize_path(path)) return base;
+
+    char* slash = strrchr(path, '/');
+    if (!slash) return base;
+
+    *slash = '\0';
+    int dir = wasi_dir_cache_get(runtime, base, path);
+    if (dir < 0) {
+        // let the real call walk the whole path and report the error
+        *slash = '/';
+        return base;
+    }
+
+    *o_leaf = slash + 1;
+    return dir;
+#else
+    return base;
+#endif
+}
+
+static inline
+void wasi_invalidate_dirs(IM3Runtime runtime)
+{
+#if defined(HAS_DIR_CACHE)
+    wasi_dir_cache_invalidate(runtime, -1);
+#endif
+}
 
 static inline
-const void* copy_iov_to_host(IM3Runtime runtime, void* _mem, struct iovec* host_iov, wasi_iovec_t* wasi_iov, int32_t iovs_len)
+__wasi_filetype_t wasi_filetype(mode_t mode)
+{
+    return (S_ISBLK(mode)   ? __WASI_FILETYPE_BLOCK_DEVICE     : 0) |
+           (S_ISCHR(mode)   ? __WASI_FILETYPE_CHARACTER_DEVICE : 0) |
+           (S_ISDIR(mode)   ? __WASI_FILETYPE_DIRECTORY        : 0) |
+           (S_ISREG(mode)   ? __WASI_FILETYPE_REGULAR_FILE     : 0) |
+           (S_ISSOCK(mode)  ? __WASI_FILETYPE_SOCKET_STREAM    : 0) |
+           (S_ISLNK(mode)   ? __WASI_FILETYPE_SYMBOLIC_LINK    : 0);
+}
+
+// wasi_unstable has a 32-bit nlink, which shifts the fields after it
+static
+void wasi_write_filestat(uint8_t* buf, const struct stat* st, bool unstable)
 {
-    // Convert wasi memory offsets to host addresses
-    for (int i = 0; i < iovs_len; i++) {
-        host_iov[i].iov_base = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iov[i].buf));
-        host_iov[i].iov_len  = m3ApiReadMem32(&wasi_iov[i].buf_len);
-        m3ApiCheckMem(host_iov[i].iov_base,     host_iov[i].iov_len);
+    uint8_t* rest = buf + (unstable ? 24 : 32);
+
+    memset(buf, 0, unstable ? 56 : 64);
+    m3ApiWriteMem64(buf + 0,  st->st_dev);
+    m3ApiWriteMem64(buf + 8,  st->st_ino);
+    buf[16] = wasi_filetype(st->st_mode);
+    if (unstable) {
+        m3ApiWriteMem32(buf + 20, st->st_nlink);
+    } else {
+        m3ApiWriteMem64(buf + 24, st->st_nlink);
     }
-    m3ApiSuccess();
+    m3ApiWriteMem64(rest + 0,  st->st_size);
+    m3ApiWriteMem64(rest + 8,  convert_timespec(&st->st_atim));
+    m3ApiWriteMem64(rest + 16, convert_timespec(&st->st_mtim));
+    m3ApiWriteMem64(rest + 24, convert_timespec(&st->st_ctim));
 }
 
+#endif // !_WIN32 && !APE
+
+// wasi_host_rw, or the runtime's image for fds opened in it
+static
+uint32_t wasi_fd_rw(IM3Runtime runtime, bool write, int32_t fd, const m3_host_iovec_t* iovs, uint32_t iovs_len, int64_t offset, size_t* nbytes)
+{
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, fd);
+    if (vfs) return vfs_rw(vfs, write, fd, iovs, iovs_len, offset, nbytes);
 #endif
+    return wasi_host_rw(runtime, write, fd, iovs, iovs_len, offset, nbytes);
+}
 
 /*
  * WASI API implementation
@@ -322,6 +781,21 @@ m3ApiRawFunction(m3_wasi_generic_fd_fdstat_get)
 
     m3ApiCheckMem(fdstat, sizeof(__wasi_fdstat_t));
 
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, fd);
+    if (vfs) {
+        __wasi_filetype_t type;
+        __wasi_fdflags_t flags;
+        __wasi_errno_t ret = vfs_fdstat(vfs, fd, &type, &flags);
+        if (ret) { m3ApiReturn(ret); }
+        fdstat->fs_filetype = type;
+        m3ApiWriteMem16(&fdstat->fs_flags, flags);
+        fdstat->fs_rights_base = (uint64_t)-1; // all rights
+        fdstat->fs_rights_inheriting = (uint64_t)-1; // all rights
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+#endif
+
 #ifdef _WIN32
 
     // TODO: This needs a proper implementation
@@ -349,7 +823,7 @@ m3ApiRawFunction(m3_wasi_generic_fd_fdstat_get)
                           (S_ISCHR(mode)   ? __WASI_FILETYPE_CHARACTER_DEVICE : 0) |
                           (S_ISDIR(mode)   ? __WASI_FILETYPE_DIRECTORY        : 0) |
                           (S_ISREG(mode)   ? __WASI_FILETYPE_REGULAR_FILE     : 0) |
-                          //(S_ISSOCK(mode)  ? __WASI_FILETYPE_SOCKET_STREAM    : 0) |
+                          (S_ISSOCK(mode)  ? __WASI_FILETYPE_SOCKET_STREAM    : 0) |
                           (S_ISLNK(mode)   ? __WASI_FILETYPE_SYMBOLIC_LINK    : 0);
 #if !defined(APE)
     m3ApiWriteMem16(&fdstat->fs_flags,
@@ -378,7 +852,24 @@ m3ApiRawFunction(m3_wasi_generic_fd_fdstat_set_flags)
     m3ApiGetArg      (__wasi_fd_t          , fd)
     m3ApiGetArg      (__wasi_fdflags_t     , flags)
 
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, fd);
+    if (vfs) { m3ApiReturn(vfs_set_flags(vfs, fd, flags)); }
+#endif
+
+#if !defined(_WIN32) && !defined(APE)
+    // only APPEND and NONBLOCK can change on an open descriptor
+    int fl = fcntl(fd, F_GETFL);
+    if (fl < 0) { m3ApiReturn(errno_to_wasi(errno)); }
+
+    fl &= ~(O_APPEND | O_NONBLOCK);
+    fl |= ((flags & __WASI_FDFLAGS_APPEND)   ? O_APPEND   : 0) |
+          ((flags & __WASI_FDFLAGS_NONBLOCK) ? O_NONBLOCK : 0);
+
+    if (fcntl(fd, F_SETFL, fl) != 0) { m3ApiReturn(errno_to_wasi(errno)); }
+#else
     // TODO
+#endif
 
     m3ApiReturn(__WASI_ERRNO_SUCCESS);
 }
@@ -402,6 +893,17 @@ m3ApiRawFunction(m3_wasi_unstable_fd_seek)
     default:                m3ApiReturn(__WASI_ERRNO_INVAL);
     }
 
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, fd);
+    if (vfs) {
+        uint64_t pos;
+        __wasi_errno_t err = vfs_seek(vfs, fd, offset, whence, &pos);
+        if (err) { m3ApiReturn(err); }
+        m3ApiWriteMem64(result, pos);
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+#endif
+
     int64_t ret;
 #if defined(M3_COMPILER_MSVC) || defined(__MINGW32__)
     ret = _lseeki64(fd, offset, whence);
@@ -432,6 +934,17 @@ m3ApiRawFunction(m3_wasi_snapshot_preview1_fd_seek)
     default:                m3ApiReturn(__WASI_ERRNO_INVAL);
     }
 
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, fd);
+    if (vfs) {
+        uint64_t pos;
+        __wasi_errno_t err = vfs_seek(vfs, fd, offset, whence, &pos);
+        if (err) { m3ApiReturn(err); }
+        m3ApiWriteMem64(result, pos);
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+#endif
+
     int64_t ret;
 #if defined(M3_COMPILER_MSVC) || defined(__MINGW32__)
     ret = _lseeki64(fd, offset, whence);
@@ -460,6 +973,17 @@ m3ApiRawFunction(m3_wasi_generic_path_open)
     m3ApiCheckMem(path, path_len);
     m3ApiCheckMem(fd,   sizeof(__wasi_fd_t));
 
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, dirfd);
+    if (vfs) {
+        __wasi_fd_t vfs_fd;
+        __wasi_errno_t ret = vfs_open(vfs, dirfd, path, path_len, oflags, fs_flags, &vfs_fd);
+        if (ret) { m3ApiReturn(ret); }
+        m3ApiWriteMem32(fd, vfs_fd);
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+#endif
+
     if (path_len >= 512)
         m3ApiReturn(__WASI_ERRNO_INVAL);
 
@@ -551,7 +1075,9 @@ m3ApiRawFunction(m3_wasi_generic_path_open)
         flags |= O_RDONLY; // no-op because O_RDONLY is 0
     }
     int mode = 0644;
-    int host_fd = openat (preopen[dirfd].fd, host_path, flags, mode);
+    const char* leaf;
+    int dir = wasi_resolve_path(runtime, wasi_dir_fd(dirfd), host_path, &leaf);
+    int host_fd = openat (dir, leaf, flags, mode);
 
     if (host_fd < 0)
     {
@@ -565,100 +1091,356 @@ m3ApiRawFunction(m3_wasi_generic_path_open)
 #endif
 }
 
-m3ApiRawFunction(m3_wasi_generic_fd_read)
+#if !defined(_WIN32) && !defined(APE)
+
+static
+const void* wasi_path_filestat_get(IM3Runtime runtime, uint64_t* _sp, void* _mem, bool unstable)
 {
     m3ApiReturnType  (uint32_t)
-    m3ApiGetArg      (__wasi_fd_t          , fd)
-    m3ApiGetArgMem   (wasi_iovec_t *       , wasi_iovs)
-    m3ApiGetArg      (__wasi_size_t        , iovs_len)
-    m3ApiGetArgMem   (__wasi_size_t *      , nread)
-
-    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(wasi_iovec_t));
-    m3ApiCheckMem(nread,        sizeof(__wasi_size_t));
-
-#if defined(HAS_IOVEC)
-    struct iovec iovs[iovs_len];
-    const void* mem_check = copy_iov_to_host(runtime, _mem, iovs, wasi_iovs, iovs_len);
-    if (mem_check != m3Err_none) {
-        return mem_check;
-    }
+    m3ApiGetArg      (__wasi_fd_t          , dirfd)
+    m3ApiGetArg      (__wasi_lookupflags_t , flags)
+    m3ApiGetArgMem   (const char *         , path)
+    m3ApiGetArg      (__wasi_size_t        , path_len)
+    m3ApiGetArgMem   (uint8_t *            , buf)
 
-    ssize_t ret = readv(fd, iovs, iovs_len);
-    if (ret < 0) { m3ApiReturn(errno_to_wasi(errno)); }
-    m3ApiWriteMem32(nread, ret);
-    m3ApiReturn(__WASI_ERRNO_SUCCESS);
-#else
-    ssize_t res = 0;
-    for (__wasi_size_t i = 0; i < iovs_len; i++) {
-        void* addr = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
-        size_t len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
-        if (len == 0) continue;
-        m3ApiCheckMem(addr,     len);
-        int ret = read (fd, addr, len);
-        if (ret < 0) m3ApiReturn(errno_to_wasi(errno));
-        res += ret;
-        if ((size_t)ret < len) break;
+    m3ApiCheckMem(path, path_len);
+    m3ApiCheckMem(buf,  unstable ? 56 : sizeof(__wasi_filestat_t));
+
+    struct stat st;
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, dirfd);
+    if (vfs) {
+        __wasi_errno_t ret = vfs_stat(vfs, dirfd, path, path_len, &st);
+        if (ret) { m3ApiReturn(ret); }
+        wasi_write_filestat(buf, &st, unstable);
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
     }
-    m3ApiWriteMem32(nread, res);
-    m3ApiReturn(__WASI_ERRNO_SUCCESS);
 #endif
-}
 
-m3ApiRawFunction(m3_wasi_generic_fd_write)
-{
-    m3ApiReturnType  (uint32_t)
-    m3ApiGetArg      (__wasi_fd_t          , fd)
-    m3ApiGetArgMem   (wasi_iovec_t *       , wasi_iovs)
-    m3ApiGetArg      (__wasi_size_t        , iovs_len)
-    m3ApiGetArgMem   (__wasi_size_t *      , nwritten)
+    char host_path[512];
+    if (!wasi_copy_path(host_path, path, path_len)) { m3ApiReturn(__WASI_ERRNO_INVAL); }
 
-    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(wasi_iovec_t));
-    m3ApiCheckMem(nwritten,     sizeof(__wasi_size_t));
+    const char* leaf;
+    int dir = wasi_resolve_path(runtime, wasi_dir_fd(dirfd), host_path, &leaf);
 
-#if defined(HAS_IOVEC)
-    struct iovec iovs[iovs_len];
-    const void* mem_check = copy_iov_to_host(runtime, _mem, iovs, wasi_iovs, iovs_len);
-    if (mem_check != m3Err_none) {
-        return mem_check;
-    }
+    int atflags = (flags & __WASI_LOOKUPFLAGS_SYMLINK_FOLLOW) ? 0 : AT_SYMLINK_NOFOLLOW;
+    if (fstatat(dir, leaf, &st, atflags) != 0) { m3ApiReturn(errno_to_wasi(errno)); }
 
-    ssize_t ret = writev(fd, iovs, iovs_len);
-    if (ret < 0) { m3ApiReturn(errno_to_wasi(errno)); }
-    m3ApiWriteMem32(nwritten, ret);
-    m3ApiReturn(__WASI_ERRNO_SUCCESS);
-#else
-    ssize_t res = 0;
-    for (__wasi_size_t i = 0; i < iovs_len; i++) {
-        void* addr = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
-        size_t len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
-        if (len == 0) continue;
-        m3ApiCheckMem(addr,     len);
-        int ret = write (fd, addr, len);
-        if (ret < 0) m3ApiReturn(errno_to_wasi(errno));
-        res += ret;
-        if ((size_t)ret < len) break;
-    }
-    m3ApiWriteMem32(nwritten, res);
+    wasi_write_filestat(buf, &st, unstable);
     m3ApiReturn(__WASI_ERRNO_SUCCESS);
-#endif
 }
 
-m3ApiRawFunction(m3_wasi_generic_fd_close)
+m3ApiRawFunction(m3_wasi_unstable_path_filestat_get)
 {
-    m3ApiReturnType  (uint32_t)
-    m3ApiGetArg      (__wasi_fd_t, fd)
+    return wasi_path_filestat_get(runtime, _sp, _mem, true);
+}
 
-    int ret = close(fd);
-    m3ApiReturn(ret == 0 ? __WASI_ERRNO_SUCCESS : ret);
+m3ApiRawFunction(m3_wasi_snapshot_preview1_path_filestat_get)
+{
+    return wasi_path_filestat_get(runtime, _sp, _mem, false);
 }
 
-m3ApiRawFunction(m3_wasi_generic_fd_datasync)
+m3ApiRawFunction(m3_wasi_generic_path_create_directory)
 {
     m3ApiReturnType  (uint32_t)
-    m3ApiGetArg      (__wasi_fd_t, fd)
+    m3ApiGetArg      (__wasi_fd_t          , dirfd)
+    m3ApiGetArgMem   (const char *         , path)
+    m3ApiGetArg      (__wasi_size_t        , path_len)
 
-#if defined(_WIN32)
-    int ret = _commit(fd);
+    m3ApiCheckMem(path, path_len);
+
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, dirfd);
+    if (vfs) { m3ApiReturn(vfs_mkdir(vfs, dirfd, path, path_len)); }
+#endif
+
+    char host_path[512];
+    if (!wasi_copy_path(host_path, path, path_len)) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    const char* leaf;
+    int dir = wasi_resolve_path(runtime, wasi_dir_fd(dirfd), host_path, &leaf);
+
+    if (mkdirat(dir, leaf, 0777) != 0) { m3ApiReturn(errno_to_wasi(errno)); }
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+m3ApiRawFunction(m3_wasi_generic_path_remove_directory)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , dirfd)
+    m3ApiGetArgMem   (const char *         , path)
+    m3ApiGetArg      (__wasi_size_t        , path_len)
+
+    m3ApiCheckMem(path, path_len);
+
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, dirfd);
+    if (vfs) { m3ApiReturn(vfs_remove(vfs, dirfd, path, path_len, true)); }
+#endif
+
+    char host_path[512];
+    if (!wasi_copy_path(host_path, path, path_len)) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    const char* leaf;
+    int dir = wasi_resolve_path(runtime, wasi_dir_fd(dirfd), host_path, &leaf);
+
+    if (unlinkat(dir, leaf, AT_REMOVEDIR) != 0) { m3ApiReturn(errno_to_wasi(errno)); }
+
+    wasi_invalidate_dirs(runtime);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+m3ApiRawFunction(m3_wasi_generic_path_unlink_file)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , dirfd)
+    m3ApiGetArgMem   (const char *         , path)
+    m3ApiGetArg      (__wasi_size_t        , path_len)
+
+    m3ApiCheckMem(path, path_len);
+
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, dirfd);
+    if (vfs) { m3ApiReturn(vfs_remove(vfs, dirfd, path, path_len, false)); }
+#endif
+
+    char host_path[512];
+    if (!wasi_copy_path(host_path, path, path_len)) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    const char* leaf;
+    int dir = wasi_resolve_path(runtime, wasi_dir_fd(dirfd), host_path, &leaf);
+
+    // only a symlink can be a directory component of a cached path
+    struct stat st;
+    bool isLink = (fstatat(dir, leaf, &st, AT_SYMLINK_NOFOLLOW) == 0) && S_ISLNK(st.st_mode);
+
+    if (unlinkat(dir, leaf, 0) != 0) { m3ApiReturn(errno_to_wasi(errno)); }
+
+    if (isLink) wasi_invalidate_dirs(runtime);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+m3ApiRawFunction(m3_wasi_generic_path_rename)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , old_fd)
+    m3ApiGetArgMem   (const char *         , old_path)
+    m3ApiGetArg      (__wasi_size_t        , old_path_len)
+    m3ApiGetArg      (__wasi_fd_t          , new_fd)
+    m3ApiGetArgMem   (const char *         , new_path)
+    m3ApiGetArg      (__wasi_size_t        , new_path_len)
+
+    m3ApiCheckMem(old_path, old_path_len);
+    m3ApiCheckMem(new_path, new_path_len);
+
+#if defined(HAS_WASI_VFS)
+    // both paths must be in the same image
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, old_fd);
+    if (vfs != wasi_vfs_get(runtime, new_fd)) { m3ApiReturn(__WASI_ERRNO_XDEV); }
+    if (vfs) { m3ApiReturn(vfs_rename(vfs, old_fd, old_path, old_path_len, new_fd, new_path, new_path_len)); }
+#endif
+
+    char host_old[512];
+    char host_new[512];
+    if (!wasi_copy_path(host_old, old_path, old_path_len) ||
+        !wasi_copy_path(host_new, new_path, new_path_len)) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    const char* old_leaf;
+    const char* new_leaf;
+    int old_dir = wasi_resolve_path(runtime, wasi_dir_fd(old_fd), host_old, &old_leaf);
+    int new_dir = wasi_resolve_path(runtime, wasi_dir_fd(new_fd), host_new, &new_leaf);
+
+    if (renameat(old_dir, old_leaf, new_dir, new_leaf) != 0) { m3ApiReturn(errno_to_wasi(errno)); }
+
+    wasi_invalidate_dirs(runtime);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+#endif // !_WIN32 && !APE
+
+m3ApiRawFunction(m3_wasi_generic_fd_read)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
+    m3ApiGetArg      (__wasi_size_t        , iovs_len)
+    m3ApiGetArgMem   (__wasi_size_t *      , nread)
+
+    m3ApiCheckMem(nread,        sizeof(__wasi_size_t));
+
+    m3_wasi_iovecs_t iovecs;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, NULL);
+    if (mem_check != m3Err_none) {
+        return mem_check;
+    }
+
+    size_t num_read = 0;
+    uint32_t ret;
+#if d_m3WasiStdio
+    m3_wasi_stdio_t* stdio = wasi_stdio_get(runtime, fd);
+    if (stdio) {
+        ret = wasi_stdio_rw(stdio, false, fd, iovecs.iovs, iovs_len, &num_read);
+        wasi_release_iovs(runtime, &iovecs);
+        m3ApiWriteMem32(nread, num_read);
+        m3ApiReturn(ret);
+    }
+#endif
+
+#if d_m3WasiWriteBufferSize
+    // show any pending prompt before blocking on input
+    if (fd == 0) wasi_flush_all(wasi_host_writev);
+#endif
+
+    ret = wasi_fd_rw(runtime, false, fd, iovecs.iovs, iovs_len, -1, &num_read);
+    wasi_release_iovs(runtime, &iovecs);
+    if (ret) { m3ApiReturn(ret); }
+    m3ApiWriteMem32(nread, num_read);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+m3ApiRawFunction(m3_wasi_generic_fd_write)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
+    m3ApiGetArg      (__wasi_size_t        , iovs_len)
+    m3ApiGetArgMem   (__wasi_size_t *      , nwritten)
+
+    m3ApiCheckMem(nwritten,     sizeof(__wasi_size_t));
+
+    m3_wasi_iovecs_t iovecs;
+    size_t total_len = 0;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, &total_len);
+    if (mem_check != m3Err_none) {
+        return mem_check;
+    }
+
+    size_t num_written = 0;
+    uint32_t ret;
+#if d_m3WasiStdio
+    m3_wasi_stdio_t* stdio = wasi_stdio_get(runtime, fd);
+    if (stdio) {
+        ret = wasi_stdio_rw(stdio, true, fd, iovecs.iovs, iovs_len, &num_written);
+        wasi_release_iovs(runtime, &iovecs);
+        m3ApiWriteMem32(nwritten, num_written);
+        m3ApiReturn(ret);
+    }
+#endif
+
+#if d_m3WasiWriteBufferSize
+    if (!wasi_buffered_write(wasi_host_writev, fd, iovecs.iovs, iovs_len, total_len, &num_written, &ret))
+#endif
+    {
+        ret = wasi_fd_rw(runtime, true, fd, iovecs.iovs, iovs_len, -1, &num_written);
+    }
+    wasi_release_iovs(runtime, &iovecs);
+
+    if (ret) { m3ApiReturn(ret); }
+    m3ApiWriteMem32(nwritten, num_written);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+#if defined(d_m3HasUringWASI)
+
+m3ApiRawFunction(m3_wasi_generic_fd_pread)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
+    m3ApiGetArg      (__wasi_size_t        , iovs_len)
+    m3ApiGetArg      (__wasi_filesize_t    , offset)
+    m3ApiGetArgMem   (__wasi_size_t *      , nread)
+
+    m3ApiCheckMem(nread,        sizeof(__wasi_size_t));
+
+    if (offset > INT64_MAX) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    m3_wasi_iovecs_t iovecs;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, NULL);
+    if (mem_check != m3Err_none) {
+        return mem_check;
+    }
+
+    size_t num_read = 0;
+    uint32_t ret = wasi_fd_rw(runtime, false, fd, iovecs.iovs, iovs_len, (int64_t) offset, &num_read);
+    wasi_release_iovs(runtime, &iovecs);
+    if (ret) { m3ApiReturn(ret); }
+    m3ApiWriteMem32(nread, num_read);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+m3ApiRawFunction(m3_wasi_generic_fd_pwrite)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
+    m3ApiGetArg      (__wasi_size_t        , iovs_len)
+    m3ApiGetArg      (__wasi_filesize_t    , offset)
+    m3ApiGetArgMem   (__wasi_size_t *      , nwritten)
+
+    m3ApiCheckMem(nwritten,     sizeof(__wasi_size_t));
+
+    if (offset > INT64_MAX) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    m3_wasi_iovecs_t iovecs;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, NULL);
+    if (mem_check != m3Err_none) {
+        return mem_check;
+    }
+
+#if d_m3WasiWriteBufferSize
+    wasi_flush_fd(wasi_host_writev, fd);
+#endif
+
+    size_t num_written = 0;
+    uint32_t ret = wasi_fd_rw(runtime, true, fd, iovecs.iovs, iovs_len, (int64_t) offset, &num_written);
+    wasi_release_iovs(runtime, &iovecs);
+    if (ret) { m3ApiReturn(ret); }
+    m3ApiWriteMem32(nwritten, num_written);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+#endif // d_m3HasUringWASI
+
+m3ApiRawFunction(m3_wasi_generic_fd_close)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t, fd)
+
+#if defined(HAS_WASI_VFS)
+    m3_wasi_vfs_t* vfs = wasi_vfs_get(runtime, fd);
+    if (vfs) { m3ApiReturn(vfs_close(vfs, fd)); }
+#endif
+
+#if d_m3WasiWriteBufferSize
+    wasi_flush_fd(wasi_host_writev, fd);
+#endif
+#if defined(HAS_DIR_CACHE)
+    // the fd number may come back as a different directory
+    wasi_dir_cache_invalidate(runtime, fd);
+#endif
+
+    int ret = close(fd);
+    m3ApiReturn(ret == 0 ? __WASI_ERRNO_SUCCESS : ret);
+}
+
+m3ApiRawFunction(m3_wasi_generic_fd_datasync)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t, fd)
+
+#if defined(HAS_WASI_VFS)
+    // the image only lives in memory
+    if (wasi_vfs_get(runtime, fd)) { m3ApiReturn(__WASI_ERRNO_SUCCESS); }
+#endif
+
+#if d_m3WasiWriteBufferSize
+    uint32_t flushed = wasi_flush_fd(wasi_host_writev, fd);
+    if (flushed) { m3ApiReturn(flushed); }
+#endif
+
+#if defined(_WIN32)
+    int ret = _commit(fd);
 #elif defined(__APPLE__)
     int ret = fsync(fd);
 #elif defined(__ANDROID_API__) || defined(__OpenBSD__) || defined(__linux__) || defined(__EMSCRIPTEN__)
@@ -669,14 +1451,32 @@ m3ApiRawFunction(m3_wasi_generic_fd_datasync)
     m3ApiReturn(ret == 0 ? __WASI_ERRNO_SUCCESS : ret);
 }
 
-m3ApiRawFunction(m3_wasi_generic_random_get)
+m3ApiRawFunction(m3_wasi_generic_fd_sync)
 {
     m3ApiReturnType  (uint32_t)
-    m3ApiGetArgMem   (uint8_t *            , buf)
-    m3ApiGetArg      (__wasi_size_t        , buf_len)
+    m3ApiGetArg      (__wasi_fd_t, fd)
 
-    m3ApiCheckMem(buf, buf_len);
+#if defined(HAS_WASI_VFS)
+    // the image only lives in memory
+    if (wasi_vfs_get(runtime, fd)) { m3ApiReturn(__WASI_ERRNO_SUCCESS); }
+#endif
+
+#if d_m3WasiWriteBufferSize
+    uint32_t flushed = wasi_flush_fd(wasi_host_writev, fd);
+    if (flushed) { m3ApiReturn(flushed); }
+#endif
 
+#if defined(_WIN32)
+    int ret = _commit(fd);
+#else
+    int ret = fsync(fd);
+#endif
+    m3ApiReturn(ret == 0 ? __WASI_ERRNO_SUCCESS : errno_to_wasi(errno));
+}
+
+static
+__wasi_errno_t wasi_os_random(uint8_t* buf, size_t buf_len)
+{
     while (1) {
         ssize_t retlen = 0;
 
@@ -691,18 +1491,18 @@ m3ApiRawFunction(m3_wasi_generic_random_get)
         retlen = getrandom(buf, buf_len, 0);
 #elif defined(_WIN32)
         if (RtlGenRandom(buf, buf_len) == TRUE) {
-            m3ApiReturn(__WASI_ERRNO_SUCCESS);
+            return __WASI_ERRNO_SUCCESS;
         }
 #else
-        m3ApiReturn(__WASI_ERRNO_NOSYS);
+        return __WASI_ERRNO_NOSYS;
 #endif
         if (retlen < 0) {
             if (errno == EINTR || errno == EAGAIN) {
                 continue;
             }
-            m3ApiReturn(errno_to_wasi(errno));
-        } else if (retlen == buf_len) {
-            m3ApiReturn(__WASI_ERRNO_SUCCESS);
+            return errno_to_wasi(errno);
+        } else if ((size_t) retlen == buf_len) {
+            return __WASI_ERRNO_SUCCESS;
         } else {
             buf     += retlen;
             buf_len -= retlen;
@@ -710,6 +1510,83 @@ m3ApiRawFunction(m3_wasi_generic_random_get)
     }
 }
 
+#if d_m3WasiRandomPoolSize
+
+// each runtime refills its own pool, so runtimes on different threads never hand out the same
+// bytes. bytes are wiped as they are handed out, so a later memory disclosure can't reveal what
+// a guest has already consumed, and a pool inherited across fork() is dropped unused
+static
+__wasi_errno_t wasi_pool_random(IM3Runtime runtime, uint8_t* buf, size_t buf_len)
+{
+    m3_wasi_state_t* state = wasi_state(runtime);
+    if (!state) return __WASI_ERRNO_NOMEM;
+
+#if defined(HAS_FORK_GENERATION)
+    if (state->randomGeneration != wasi_fork_generation) {
+        memset(state->randomPool, 0, sizeof(state->randomPool));
+        state->randomAvail = 0;
+        state->randomGeneration = wasi_fork_generation;
+    }
+#endif
+
+    while (buf_len) {
+        if (!state->randomAvail) {
+            __wasi_errno_t ret = wasi_os_random(state->randomPool, sizeof(state->randomPool));
+            if (ret != __WASI_ERRNO_SUCCESS) return ret;
+            state->randomAvail = sizeof(state->randomPool);
+        }
+
+        size_t n = M3_MIN(buf_len, state->randomAvail);
+        uint8_t* src = state->randomPool + sizeof(state->randomPool) - state->randomAvail;
+        memcpy(buf, src, n);
+        memset(src, 0, n);
+
+        state->randomAvail -= n;
+        buf     += n;
+        buf_len -= n;
+    }
+    return __WASI_ERRNO_SUCCESS;
+}
+
+#endif // d_m3WasiRandomPoolSize
+
+m3ApiRawFunction(m3_wasi_generic_random_get)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArgMem   (uint8_t *            , buf)
+    m3ApiGetArg      (__wasi_size_t        , buf_len)
+
+    m3ApiCheckMem(buf, buf_len);
+
+#if d_m3WasiRandomPoolSize
+    if (buf_len < d_m3WasiRandomPoolSize) {
+        m3ApiReturn(wasi_pool_random(runtime, buf, buf_len));
+    }
+#endif
+    m3ApiReturn(wasi_os_random(buf, buf_len));
+}
+
+// realtime and monotonic reads switch to the coarse (tick based) clocks when their
+// resolution is within the precision the guest asked for or d_m3WasiClockResolution
+static
+int wasi_fast_clock(int clk, __wasi_timestamp_t precision)
+{
+#if defined(HAS_COARSE_CLOCKS)
+    static __wasi_timestamp_t coarse_res = 0;
+
+    if (clk != CLOCK_MONOTONIC && clk != CLOCK_REALTIME) return clk;
+
+    if (!coarse_res) {
+        struct timespec tp;
+        coarse_res = (clock_getres(CLOCK_MONOTONIC_COARSE, &tp) == 0) ? convert_timespec(&tp) : UINT64_MAX;
+    }
+    if (coarse_res <= M3_MAX(precision, d_m3WasiClockResolution)) {
+        return (clk == CLOCK_MONOTONIC) ? CLOCK_MONOTONIC_COARSE : CLOCK_REALTIME_COARSE;
+    }
+#endif
+    return clk;
+}
+
 m3ApiRawFunction(m3_wasi_generic_clock_res_get)
 {
     m3ApiReturnType  (uint32_t)
@@ -722,7 +1599,7 @@ m3ApiRawFunction(m3_wasi_generic_clock_res_get)
     if (clk < 0) m3ApiReturn(__WASI_ERRNO_INVAL);
 
     struct timespec tp;
-    if (clock_getres(clk, &tp) != 0) {
+    if (clock_getres(wasi_fast_clock(clk, 0), &tp) != 0) {
         m3ApiWriteMem64(resolution, 1000000);
     } else {
         m3ApiWriteMem64(resolution, convert_timespec(&tp));
@@ -744,14 +1621,611 @@ m3ApiRawFunction(m3_wasi_generic_clock_time_get)
     if (clk < 0) m3ApiReturn(__WASI_ERRNO_INVAL);
 
     struct timespec tp;
-    if (clock_gettime(clk, &tp) != 0) {
+    if (clock_gettime(wasi_fast_clock(clk, precision), &tp) != 0) {
         m3ApiReturn(errno_to_wasi(errno));
     }
 
-    m3ApiWriteMem64(time, convert_timespec(&tp));
+    __wasi_timestamp_t t = convert_timespec(&tp);
+#if defined(HAS_COARSE_CLOCKS)
+    // the coarse clock lags the fine one by up to a tick; don't let
+    // mixed-precision readers on this runtime see monotonic time go backwards
+    if (clk == CLOCK_MONOTONIC) {
+        m3_wasi_state_t* state = wasi_state(runtime);
+        if (!state) m3ApiReturn(__WASI_ERRNO_NOMEM);
+
+        if (t < state->lastMonotonic) t = state->lastMonotonic;
+        state->lastMonotonic = t;
+    }
+#endif
+
+    m3ApiWriteMem64(time, t);
     m3ApiReturn(__WASI_ERRNO_SUCCESS);
 }
 
+/*
+ * sockets
+ */
+
+#if defined(HAS_SOCKETS)
+
+// without MSG_NOSIGNAL (Apple) a send to a closed peer raises SIGPIPE unless
+// the socket opts out with SO_NOSIGPIPE
+#if !defined(MSG_NOSIGNAL)
+#  define MSG_NOSIGNAL  0
+#  if defined(SO_NOSIGPIPE)
+#    define HAS_SO_NOSIGPIPE
+#  endif
+#endif
+
+static
+void wasi_no_sigpipe(int fd)
+{
+#if defined(HAS_SO_NOSIGPIPE)
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    (void) fd;
+#endif
+}
+
+// guest fds are host fds, except the preopen slots; keep new descriptors out of those
+static
+int wasi_guest_fd(int fd)
+{
+    if (fd < 0 || fd >= PREOPEN_CNT) return fd;
+
+    int moved = fcntl(fd, F_DUPFD_CLOEXEC, PREOPEN_CNT);
+    close(fd);
+    return moved;
+}
+
+M3Result m3_PreopenSocketWASI (int i_hostFd, int* o_wasiFd)
+{
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+    if (getsockopt(i_hostFd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) != 0 || !listening)
+        return "not a listening socket";
+
+    int fd = wasi_guest_fd(i_hostFd);
+    if (fd < 0) return "failed to move socket descriptor";
+
+    wasi_no_sigpipe(fd);
+
+    *o_wasiFd = fd;
+    return m3Err_none;
+}
+
+m3ApiRawFunction(m3_wasi_generic_sock_accept)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArg      (__wasi_fdflags_t     , flags)
+    m3ApiGetArgMem   (__wasi_fd_t *        , ro_fd)
+
+    m3ApiCheckMem(ro_fd, sizeof(__wasi_fd_t));
+
+    if (flags & ~__WASI_FDFLAGS_NONBLOCK) m3ApiReturn(__WASI_ERRNO_INVAL);
+
+    // a non-blocking listener returns AGAIN; guests wait for it with an fd_read subscription
+    int conn;
+    do {
+        conn = accept(fd, NULL, NULL);
+    } while (conn < 0 && errno == EINTR);
+    if (conn < 0) m3ApiReturn(errno_to_wasi(errno));
+
+    fcntl(conn, F_SETFD, FD_CLOEXEC);
+    wasi_no_sigpipe(conn);
+    if (flags & __WASI_FDFLAGS_NONBLOCK) {
+        fcntl(conn, F_SETFL, fcntl(conn, F_GETFL) | O_NONBLOCK);
+    }
+
+    conn = wasi_guest_fd(conn);
+    if (conn < 0) m3ApiReturn(errno_to_wasi(errno));
+
+    m3ApiWriteMem32(ro_fd, conn);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+m3ApiRawFunction(m3_wasi_generic_sock_recv)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
+    m3ApiGetArg      (__wasi_size_t        , iovs_len)
+    m3ApiGetArg      (__wasi_riflags_t     , ri_flags)
+    m3ApiGetArgMem   (__wasi_size_t *      , ro_datalen)
+    m3ApiGetArgMem   (__wasi_roflags_t *   , ro_flags)
+
+    m3ApiCheckMem(ro_datalen,   sizeof(__wasi_size_t));
+    m3ApiCheckMem(ro_flags,     sizeof(__wasi_roflags_t));
+
+    // received straight into linear memory
+    m3_wasi_iovecs_t iovecs;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, NULL);
+    if (mem_check != m3Err_none) {
+        return mem_check;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov     = (void*) iovecs.iovs;  // same layout as struct iovec
+    msg.msg_iovlen  = iovs_len;
+
+    int flags = ((ri_flags & __WASI_RIFLAGS_RECV_PEEK)    ? MSG_PEEK    : 0) |
+                ((ri_flags & __WASI_RIFLAGS_RECV_WAITALL) ? MSG_WAITALL : 0);
+
+    ssize_t ret;
+    do {
+        ret = recvmsg(fd, &msg, flags);
+    } while (ret < 0 && errno == EINTR);
+    int error = errno;
+    wasi_release_iovs(runtime, &iovecs);
+    if (ret < 0) m3ApiReturn(errno_to_wasi(error));
+
+    m3ApiWriteMem32(ro_datalen, ret);
+    m3ApiWriteMem16(ro_flags, (msg.msg_flags & MSG_TRUNC) ? __WASI_ROFLAGS_RECV_DATA_TRUNCATED : 0);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+m3ApiRawFunction(m3_wasi_generic_sock_send)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArgMem   (m3_wasi_iovec_t *    , wasi_iovs)
+    m3ApiGetArg      (__wasi_size_t        , iovs_len)
+    m3ApiGetArg      (__wasi_siflags_t     , si_flags)
+    m3ApiGetArgMem   (__wasi_size_t *      , so_datalen)
+
+    m3ApiCheckMem(so_datalen,   sizeof(__wasi_size_t));
+
+    m3_wasi_iovecs_t iovecs;
+    const void* mem_check = wasi_translate_iovs(runtime, _mem, &iovecs, wasi_iovs, iovs_len, NULL);
+    if (mem_check != m3Err_none) {
+        return mem_check;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov     = (void*) iovecs.iovs;  // same layout as struct iovec
+    msg.msg_iovlen  = iovs_len;
+
+    // a closed peer is reported as PIPE rather than killing the host with SIGPIPE
+    ssize_t ret;
+    do {
+        ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+    int error = errno;
+    wasi_release_iovs(runtime, &iovecs);
+    if (ret < 0) m3ApiReturn(errno_to_wasi(error));
+
+    m3ApiWriteMem32(so_datalen, ret);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+m3ApiRawFunction(m3_wasi_generic_sock_shutdown)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArg      (__wasi_sdflags_t     , how)
+
+    int mode;
+    switch (how & (__WASI_SDFLAGS_RD | __WASI_SDFLAGS_WR)) {
+    case __WASI_SDFLAGS_RD:                         mode = SHUT_RD;   break;
+    case __WASI_SDFLAGS_WR:                         mode = SHUT_WR;   break;
+    case __WASI_SDFLAGS_RD | __WASI_SDFLAGS_WR:     mode = SHUT_RDWR; break;
+    default: m3ApiReturn(__WASI_ERRNO_INVAL);
+    }
+
+    if (shutdown(fd, mode) != 0) m3ApiReturn(errno_to_wasi(errno));
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+#endif // HAS_SOCKETS
+
+/*
+ * poll_oneoff
+ */
+
+#if defined(__linux__)
+
+static
+__wasi_timestamp_t wasi_monotonic_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return convert_timespec(&now);
+}
+
+// deadline of a clock subscription on CLOCK_MONOTONIC. relative timeouts count from start;
+// absolute ones are converted against their own clock at the time of the call
+static
+__wasi_errno_t wasi_clock_deadline(const m3_wasi_subscription_t* sub, __wasi_timestamp_t start, __wasi_timestamp_t* o_deadline)
+{
+    int clk = convert_clockid(sub->clock_id);
+    if (clk < 0) return __WASI_ERRNO_INVAL;
+
+    __wasi_timestamp_t timeout = sub->timeout;
+    if (sub->flags & __WASI_SUBCLOCKFLAGS_SUBSCRIPTION_CLOCK_ABSTIME) {
+        struct timespec ts;
+        if (clock_gettime(clk, &ts) != 0) return errno_to_wasi(errno);
+        __wasi_timestamp_t t = convert_timespec(&ts);
+        timeout = (timeout > t) ? timeout - t : 0;
+        start = wasi_monotonic_now();
+    }
+
+    *o_deadline = (timeout > UINT64_MAX - start) ? UINT64_MAX : start + timeout;
+    return __WASI_ERRNO_SUCCESS;
+}
+
+static
+void wasi_fd_event(uint8_t* out, const m3_wasi_subscription_t* sub, bool hangup)
+{
+    int avail = 0;
+    __wasi_filesize_t nbytes = 0;
+    if (sub->type == __WASI_EVENTTYPE_FD_READ && ioctl(sub->fd, FIONREAD, &avail) == 0 && avail > 0) {
+        nbytes = avail;
+    }
+    wasi_write_event(out, sub, __WASI_ERRNO_SUCCESS, nbytes, hangup ? __WASI_EVENTRWFLAGS_FD_READWRITE_HANGUP : 0);
+}
+
+static
+bool wasi_is_fd_subscription(const m3_wasi_subscription_t* sub)
+{
+    return sub->type == __WASI_EVENTTYPE_FD_READ || sub->type == __WASI_EVENTTYPE_FD_WRITE;
+}
+
+#define c_wasiTimerTag      UINT64_MAX
+
+// fd readiness comes from epoll, and all clock subscriptions share one timerfd armed for the
+// earliest deadline plus its precision, so clocks that expire within that slack fire together.
+// both belong to the runtime, so runtimes on different threads never see each other's events
+static
+__wasi_errno_t wasi_epoll_poll_oneoff(IM3Runtime runtime, const uint8_t* in, uint8_t* out, __wasi_size_t nsubscriptions, bool unstable, __wasi_size_t* o_nevents)
+{
+    const size_t subSize = unstable ? c_wasiUnstableSubscriptionSize : c_wasiSubscriptionSize;
+
+    m3_wasi_state_t* state = wasi_state(runtime);
+    if (!state) return __WASI_ERRNO_NOMEM;
+
+    if (state->epollFd < 0) {
+        state->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (state->epollFd < 0) return errno_to_wasi(errno);
+    }
+    if (state->timerFd < 0) {
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (fd < 0) return errno_to_wasi(errno);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = c_wasiTimerTag;
+        if (epoll_ctl(state->epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            return errno_to_wasi(errno);
+        }
+        state->timerFd = fd;
+    }
+
+    const int epollFd = state->epollFd;
+    const int timerFd = state->timerFd;
+
+    __wasi_size_t numEvents = 0;
+    __wasi_timestamp_t start = wasi_monotonic_now();
+    __wasi_timestamp_t fireAt = UINT64_MAX;
+
+    for (u32 i = 0; i < nsubscriptions; i++)
+    {
+        m3_wasi_subscription_t sub;
+        wasi_read_subscription(&sub, in + i * subSize, unstable);
+
+        if (sub.type == __WASI_EVENTTYPE_CLOCK)
+        {
+            __wasi_timestamp_t deadline;
+            __wasi_errno_t error = wasi_clock_deadline(&sub, start, &deadline);
+            if (error) {
+                wasi_write_event(out + c_wasiEventSize * numEvents++, &sub, error, 0, 0);
+                continue;
+            }
+            __wasi_timestamp_t latest = deadline + M3_MIN(sub.precision, UINT64_MAX - deadline);
+            fireAt = M3_MIN(fireAt, latest);
+        }
+        else if (wasi_is_fd_subscription(&sub))
+        {
+            // one registration per fd, covering all of its subscriptions
+            bool seen = false;
+            u32 mask = 0;
+            for (u32 j = 0; j < nsubscriptions; j++) {
+                m3_wasi_subscription_t other;
+                wasi_read_subscription(&other, in + j * subSize, unstable);
+                if (!wasi_is_fd_subscription(&other) || other.fd != sub.fd) continue;
+                if (j < i) { seen = true; break; }
+                mask |= (other.type == __WASI_EVENTTYPE_FD_READ) ? EPOLLIN : EPOLLOUT;
+            }
+            if (seen) continue;
+
+            struct epoll_event ev;
+            ev.events = mask;
+            ev.data.u64 = sub.fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, sub.fd, &ev) == 0) continue;
+
+            // regular files can't be polled and are always ready
+            __wasi_errno_t error = (errno == EPERM) ? __WASI_ERRNO_SUCCESS : errno_to_wasi(errno);
+            for (u32 j = i; j < nsubscriptions; j++) {
+                m3_wasi_subscription_t other;
+                wasi_read_subscription(&other, in + j * subSize, unstable);
+                if (!wasi_is_fd_subscription(&other) || other.fd != sub.fd) continue;
+                if (error) wasi_write_event(out + c_wasiEventSize * numEvents++, &other, error, 0, 0);
+                else       wasi_fd_event(out + c_wasiEventSize * numEvents++, &other, false);
+            }
+        }
+        else
+        {
+            wasi_write_event(out + c_wasiEventSize * numEvents++, &sub, __WASI_ERRNO_INVAL, 0, 0);
+        }
+    }
+
+    __wasi_errno_t ret = __WASI_ERRNO_SUCCESS;
+    while (numEvents == 0)
+    {
+        if (fireAt != UINT64_MAX) {
+            struct itimerspec its;
+            memset(&its, 0, sizeof(its));
+            its.it_value.tv_sec  = fireAt / 1000000000;
+            its.it_value.tv_nsec = fireAt % 1000000000;
+            if (!its.it_value.tv_sec && !its.it_value.tv_nsec) its.it_value.tv_nsec = 1;
+            timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &its, NULL);
+        }
+
+        struct epoll_event ready [32];
+        int n = epoll_wait(epollFd, ready, 32, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ret = errno_to_wasi(errno);
+            break;
+        }
+
+        for (int k = 0; k < n; k++) {
+            if (ready[k].data.u64 == c_wasiTimerTag) {
+                uint64_t expirations;
+                (void) !read(timerFd, &expirations, sizeof(expirations));
+                continue;
+            }
+            for (u32 j = 0; j < nsubscriptions; j++) {
+                m3_wasi_subscription_t sub;
+                wasi_read_subscription(&sub, in + j * subSize, unstable);
+                if (!wasi_is_fd_subscription(&sub) || sub.fd != ready[k].data.u64) continue;
+
+                u32 want = (sub.type == __WASI_EVENTTYPE_FD_READ) ? EPOLLIN : EPOLLOUT;
+                if (ready[k].events & (want | EPOLLHUP | EPOLLERR)) {
+                    wasi_fd_event(out + c_wasiEventSize * numEvents++, &sub, ready[k].events & (EPOLLHUP | EPOLLERR));
+                }
+            }
+        }
+
+        if (fireAt != UINT64_MAX) {
+            for (u32 j = 0; j < nsubscriptions; j++) {
+                m3_wasi_subscription_t sub;
+                __wasi_timestamp_t deadline;
+                wasi_read_subscription(&sub, in + j * subSize, unstable);
+                if (sub.type != __WASI_EVENTTYPE_CLOCK || wasi_clock_deadline(&sub, start, &deadline)) continue;
+                if (deadline <= wasi_monotonic_now()) {
+                    wasi_write_event(out + c_wasiEventSize * numEvents++, &sub, __WASI_ERRNO_SUCCESS, 0, 0);
+                }
+            }
+        }
+    }
+
+    // leave the epoll set and the timer empty for the next call
+    for (u32 i = 0; i < nsubscriptions; i++) {
+        m3_wasi_subscription_t sub;
+        wasi_read_subscription(&sub, in + i * subSize, unstable);
+        if (wasi_is_fd_subscription(&sub)) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, sub.fd, NULL);
+        }
+    }
+    if (fireAt != UINT64_MAX) {
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        timerfd_settime(timerFd, 0, &its, NULL);
+    }
+
+    *o_nevents = numEvents;
+    return ret;
+}
+
+#if defined(d_m3HasUringWASI)
+
+static
+void wasi_uring_poll_event(uint8_t* out, const m3_wasi_subscription_t* sub, int res)
+{
+    if (sub->type == __WASI_EVENTTYPE_CLOCK) {
+        wasi_write_event(out, sub, (res < 0 && res != -ETIME) ? errno_to_wasi(-res) : __WASI_ERRNO_SUCCESS, 0, 0);
+    } else if (res < 0) {
+        wasi_write_event(out, sub, errno_to_wasi(-res), 0, 0);
+    } else if (res & POLLNVAL) {
+        wasi_write_event(out, sub, __WASI_ERRNO_BADF, 0, 0);
+    } else {
+        wasi_fd_event(out, sub, res & (POLLHUP | POLLERR));
+    }
+}
+
+// clock subscriptions become ring timeouts and fd subscriptions become poll requests, all
+// submitted with one syscall. whatever hasn't fired by the first completion is removed again
+static
+__wasi_errno_t wasi_uring_poll_oneoff(m3_wasi_uring_t* ring, const uint8_t* in, uint8_t* out, __wasi_size_t nsubscriptions, bool unstable, __wasi_size_t* o_nevents)
+{
+    const size_t subSize = unstable ? c_wasiUnstableSubscriptionSize : c_wasiSubscriptionSize;
+
+    struct __kernel_timespec* timeouts = ring->timeouts;
+    bool* pending = ring->pending;
+
+    __wasi_size_t numEvents = 0;
+    __wasi_timestamp_t start = wasi_monotonic_now();
+    u32 numPending = 0;
+
+    wasi_uring_begin_batch(ring);
+
+    for (u32 i = 0; i < nsubscriptions; i++)
+    {
+        m3_wasi_subscription_t sub;
+        wasi_read_subscription(&sub, in + i * subSize, unstable);
+        struct io_uring_sqe* sqe = NULL;
+        pending[i] = false;
+
+        if (sub.type == __WASI_EVENTTYPE_CLOCK)
+        {
+            __wasi_timestamp_t deadline;
+            __wasi_errno_t error = wasi_clock_deadline(&sub, start, &deadline);
+            if (error) {
+                wasi_write_event(out + c_wasiEventSize * numEvents++, &sub, error, 0, 0);
+                continue;
+            }
+            __wasi_timestamp_t timeout = (deadline > start) ? deadline - start : 0;
+            timeouts[i].tv_sec  = timeout / 1000000000;
+            timeouts[i].tv_nsec = timeout % 1000000000;
+
+            sqe = wasi_uring_get_sqe(ring);
+            sqe->opcode     = IORING_OP_TIMEOUT;
+            sqe->addr       = (u64)(uintptr_t) &timeouts[i];
+            sqe->len        = 1;
+        }
+        else if (wasi_is_fd_subscription(&sub))
+        {
+            u32 mask = (sub.type == __WASI_EVENTTYPE_FD_READ) ? POLLIN : POLLOUT;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            mask = (mask << 16) | (mask >> 16);
+#endif
+            sqe = wasi_uring_get_sqe(ring);
+            sqe->opcode         = IORING_OP_POLL_ADD;
+            sqe->fd             = sub.fd;
+            sqe->poll32_events  = mask;
+        }
+        else
+        {
+            wasi_write_event(out + c_wasiEventSize * numEvents++, &sub, __WASI_ERRNO_INVAL, 0, 0);
+            continue;
+        }
+
+        sqe->user_data = wasi_uring_user_data(ring, 0, i);
+        pending[i] = true;
+        numPending++;
+    }
+
+    int ret = wasi_uring_enter(ring, (numPending && !numEvents) ? 1 : 0);
+    if (ret < 0) {
+        wasi_uring_drain(ring);
+        return errno_to_wasi(-ret);
+    }
+
+    struct io_uring_cqe cqe;
+    while (wasi_uring_pop_cqe(ring, &cqe)) {
+        u32 i;
+        if (!wasi_uring_batch_index(ring, cqe.user_data, 0, nsubscriptions, &i) || !pending[i]) continue;
+
+        m3_wasi_subscription_t sub;
+        wasi_read_subscription(&sub, in + i * subSize, unstable);
+        pending[i] = false;
+        numPending--;
+        wasi_uring_poll_event(out + c_wasiEventSize * numEvents++, &sub, cqe.res);
+    }
+
+    // remove the rest; each one completes once for itself and once for its removal
+    u32 numOutstanding = 2 * numPending;
+    for (u32 i = 0; i < nsubscriptions; i++) {
+        if (!pending[i]) continue;
+        struct io_uring_sqe* sqe = wasi_uring_get_sqe(ring);
+        sqe->opcode     = (in[i * subSize + 8] == __WASI_EVENTTYPE_CLOCK) ? IORING_OP_TIMEOUT_REMOVE : IORING_OP_POLL_REMOVE;
+        sqe->addr       = wasi_uring_user_data(ring, 0, i);
+        sqe->user_data  = wasi_uring_user_data(ring, c_wasiUringCancelTag, i);
+    }
+
+    while (numOutstanding) {
+        ret = wasi_uring_enter(ring, 1);
+        if (ret < 0) {
+            wasi_uring_drain(ring);
+            return errno_to_wasi(-ret);
+        }
+
+        while (wasi_uring_pop_cqe(ring, &cqe)) {
+            u32 i;
+            if (wasi_uring_batch_index(ring, cqe.user_data, c_wasiUringCancelTag, nsubscriptions, &i)) {
+                numOutstanding--;
+                continue;
+            }
+            if (!wasi_uring_batch_index(ring, cqe.user_data, 0, nsubscriptions, &i) || !pending[i]) continue;
+
+            numOutstanding--;
+            pending[i] = false;
+
+            // fired while it was being removed
+            if (cqe.res != -ECANCELED) {
+                m3_wasi_subscription_t sub;
+                wasi_read_subscription(&sub, in + i * subSize, unstable);
+                wasi_uring_poll_event(out + c_wasiEventSize * numEvents++, &sub, cqe.res);
+            }
+        }
+    }
+
+    *o_nevents = numEvents;
+    return __WASI_ERRNO_SUCCESS;
+}
+
+#endif // d_m3HasUringWASI
+
+static
+__wasi_errno_t wasi_poll_oneoff(IM3Runtime runtime, const uint8_t* in, uint8_t* out, __wasi_size_t nsubscriptions, bool unstable, __wasi_size_t* o_nevents)
+{
+    if (nsubscriptions == 0) return __WASI_ERRNO_INVAL;
+
+#if d_m3WasiWriteBufferSize
+    wasi_flush_all(wasi_host_writev);
+#endif
+
+#if defined(d_m3HasUringWASI)
+    m3_wasi_uring_t* ring = wasi_uring_get(runtime);
+    if (ring && nsubscriptions <= d_m3WasiUringEntries)
+        return wasi_uring_poll_oneoff(ring, in, out, nsubscriptions, unstable, o_nevents);
+#endif
+    return wasi_epoll_poll_oneoff(runtime, in, out, nsubscriptions, unstable, o_nevents);
+}
+
+m3ApiRawFunction(m3_wasi_unstable_poll_oneoff)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArgMem   (const uint8_t *      , in)
+    m3ApiGetArgMem   (uint8_t *            , out)
+    m3ApiGetArg      (__wasi_size_t        , nsubscriptions)
+    m3ApiGetArgMem   (__wasi_size_t *      , nevents)
+
+    m3ApiCheckMem(in,       (uint64_t) nsubscriptions * c_wasiUnstableSubscriptionSize);
+    m3ApiCheckMem(out,      (uint64_t) nsubscriptions * c_wasiEventSize);
+    m3ApiCheckMem(nevents,  sizeof(__wasi_size_t));
+
+    __wasi_size_t num_events = 0;
+    __wasi_errno_t ret = wasi_poll_oneoff(runtime, in, out, nsubscriptions, true, &num_events);
+    m3ApiWriteMem32(nevents, num_events);
+    m3ApiReturn(ret);
+}
+
+m3ApiRawFunction(m3_wasi_snapshot_preview1_poll_oneoff)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArgMem   (const uint8_t *      , in)
+    m3ApiGetArgMem   (uint8_t *            , out)
+    m3ApiGetArg      (__wasi_size_t        , nsubscriptions)
+    m3ApiGetArgMem   (__wasi_size_t *      , nevents)
+
+    m3ApiCheckMem(in,       (uint64_t) nsubscriptions * c_wasiSubscriptionSize);
+    m3ApiCheckMem(out,      (uint64_t) nsubscriptions * c_wasiEventSize);
+    m3ApiCheckMem(nevents,  sizeof(__wasi_size_t));
+
+    __wasi_size_t num_events = 0;
+    __wasi_errno_t ret = wasi_poll_oneoff(runtime, in, out, nsubscriptions, false, &num_events);
+    m3ApiWriteMem32(nevents, num_events);
+    m3ApiReturn(ret);
+}
+
+#endif // __linux__
+
 m3ApiRawFunction(m3_wasi_generic_proc_exit)
 {
     m3ApiGetArg      (uint32_t, code)
@@ -762,112 +2236,204 @@ m3ApiRawFunction(m3_wasi_generic_proc_exit)
         context->exit_code = code;
     }
 
+#if d_m3WasiWriteBufferSize
+    wasi_flush_all(wasi_host_writev);
+#endif
+
     m3ApiTrap(m3Err_trapExit);
 }
 
 
-static
-M3Result SuppressLookupFailure(M3Result i_result)
+m3_wasi_context_t* m3_GetWasiContext()
 {
-    if (i_result == m3Err_functionLookupFailed)
-        return m3Err_none;
-    else
-        return i_result;
+    return wasi_context;
 }
 
-m3_wasi_context_t* m3_GetWasiContext()
+
+void m3_FlushWASI()
 {
-    return wasi_context;
+#if d_m3WasiWriteBufferSize
+    wasi_flush_all(wasi_host_writev);
+#endif
 }
 
 
-M3Result  m3_LinkWASI  (IM3Module module)
+M3Result m3_CaptureStdioWASI (IM3Runtime i_runtime)
 {
-    M3Result result = m3Err_none;
+    return wasi_stdio_capture(i_runtime);
+}
+
+void m3_ReleaseStdioWASI (IM3Runtime i_runtime)
+{
+    wasi_stdio_release(i_runtime);
+}
+
+size_t m3_PeekStdioWASI (IM3Runtime i_runtime, int i_fd, const void** o_data)
+{
+    return wasi_stdio_peek(i_runtime, i_fd, o_data);
+}
+
+void m3_ConsumeStdioWASI (IM3Runtime i_runtime, int i_fd, size_t i_length)
+{
+    wasi_stdio_consume(i_runtime, i_fd, i_length);
+}
+
+M3Result m3_FeedStdinWASI (IM3Runtime i_runtime, const void* i_data, size_t i_length)
+{
+    return wasi_stdio_feed(i_runtime, i_data, i_length);
+}
 
-#ifdef _WIN32
-    setmode(fileno(stdin),  O_BINARY);
-    setmode(fileno(stdout), O_BINARY);
-    setmode(fileno(stderr), O_BINARY);
 
+#if !defined(_WIN32)
+
+M3Result m3_MountWASIImage (IM3Runtime i_runtime, const char* i_tarPath)
+{
+#if defined(HAS_WASI_VFS)
+    m3_wasi_state_t* state = wasi_state(i_runtime);
+    if (!state) return m3Err_mallocFailed;
+    if (state->vfs) return "runtime already has a WASI image";
+
+    return vfs_mount(&state->vfs, i_tarPath);
 #else
-    // Preopen dirs
-    for (int i = 3; i < PREOPEN_CNT; i++) {
-        preopen[i].fd = open(preopen[i].real_path, O_RDONLY);
+    return "WASI images are not supported in this build";
+#endif
+}
+
+void m3_UnmountWASIImage (IM3Runtime i_runtime)
+{
+#if defined(HAS_WASI_VFS)
+    m3_wasi_state_t* state = (m3_wasi_state_t*) i_runtime->wasi;
+    if (state && state->vfs) {
+        vfs_free(state->vfs);
+        state->vfs = NULL;
     }
 #endif
+}
+
+#endif
+
+
+M3Result  m3_RegisterWASI  (IM3ImportRegistry io_registry)
+{
+    M3Result result = m3Err_none;
 
     if (!wasi_context) {
         wasi_context = (m3_wasi_context_t*)malloc(sizeof(m3_wasi_context_t));
         wasi_context->exit_code = 0;
         wasi_context->argc = 0;
         wasi_context->argv = 0;
+
+#if d_m3WasiWriteBufferSize
+        atexit(wasi_flush_at_exit);
+#endif
+#if defined(HAS_FORK_GENERATION)
+        pthread_atfork(NULL, NULL, wasi_on_fork_child);
+#endif
+
+#ifdef _WIN32
+        setmode(fileno(stdin),  O_BINARY);
+        setmode(fileno(stdout), O_BINARY);
+        setmode(fileno(stderr), O_BINARY);
+
+#else
+        // Preopen dirs
+        for (int i = 3; i < PREOPEN_CNT; i++) {
+            preopen[i].fd = open(preopen[i].real_path, O_RDONLY);
+        }
+#endif
     }
 
     static const char* namespaces[2] = { "wasi_unstable", "wasi_snapshot_preview1" };
 
     // Some functions are incompatible between WASI versions
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_unstable",          "fd_seek",     "i(iIi*)", &m3_wasi_unstable_fd_seek)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_snapshot_preview1", "fd_seek",     "i(iIi*)", &m3_wasi_snapshot_preview1_fd_seek)));
-//_ (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_unstable",          "fd_filestat_get",   "i(i*)",     &m3_wasi_unstable_fd_filestat_get)));
-//_ (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_snapshot_preview1", "fd_filestat_get",   "i(i*)",     &m3_wasi_snapshot_preview1_fd_filestat_get)));
-//_ (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_unstable",          "path_filestat_get", "i(ii*i*)",  &m3_wasi_unstable_path_filestat_get)));
-//_ (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_snapshot_preview1", "path_filestat_get", "i(ii*i*)",  &m3_wasi_snapshot_preview1_path_filestat_get)));
+_   (m3_RegisterRawFunction (io_registry, "wasi_unstable",          "fd_seek",     "i(iIi*)", &m3_wasi_unstable_fd_seek, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "fd_seek",     "i(iIi*)", &m3_wasi_snapshot_preview1_fd_seek, NULL));
+#if defined(__linux__)
+_   (m3_RegisterRawFunction (io_registry, "wasi_unstable",          "poll_oneoff", "i(**i*)", &m3_wasi_unstable_poll_oneoff, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "poll_oneoff", "i(**i*)", &m3_wasi_snapshot_preview1_poll_oneoff, NULL));
+#endif
+//_ (m3_RegisterRawFunction (io_registry, "wasi_unstable",          "fd_filestat_get",   "i(i*)",     &m3_wasi_unstable_fd_filestat_get, NULL));
+//_ (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "fd_filestat_get",   "i(i*)",     &m3_wasi_snapshot_preview1_fd_filestat_get, NULL));
+#if !defined(_WIN32) && !defined(APE)
+_   (m3_RegisterRawFunction (io_registry, "wasi_unstable",          "path_filestat_get", "i(ii*i*)",  &m3_wasi_unstable_path_filestat_get, NULL));
+_   (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "path_filestat_get", "i(ii*i*)",  &m3_wasi_snapshot_preview1_path_filestat_get, NULL));
+#endif
+#if defined(HAS_SOCKETS)
+_   (m3_RegisterRawFunction (io_registry, "wasi_snapshot_preview1", "sock_accept",       "i(ii*)",    &m3_wasi_generic_sock_accept, NULL));
+#endif
 
     for (int i=0; i<2; i++)
     {
         const char* wasi = namespaces[i];
 
-_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "args_get",           "i(**)",   &m3_wasi_generic_args_get, wasi_context)));
-_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "args_sizes_get",     "i(**)",   &m3_wasi_generic_args_sizes_get, wasi_context)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "clock_res_get",        "i(i*)",   &m3_wasi_generic_clock_res_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "clock_time_get",       "i(iI*)",  &m3_wasi_generic_clock_time_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "environ_get",          "i(**)",   &m3_wasi_generic_environ_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "environ_sizes_get",    "i(**)",   &m3_wasi_generic_environ_sizes_get)));
-
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_advise",            "i(iIIi)", )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_allocate",          "i(iII)",  )));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_close",             "i(i)",    &m3_wasi_generic_fd_close)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_datasync",          "i(i)",    &m3_wasi_generic_fd_datasync)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_get",        "i(i*)",   &m3_wasi_generic_fd_fdstat_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_set_flags",  "i(ii)",   &m3_wasi_generic_fd_fdstat_set_flags)));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_set_rights", "i(iII)",  )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_filestat_set_size", "i(iI)",   )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_filestat_set_times","i(iIIi)", )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_pread",             "i(i*iI*)",)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_prestat_get",       "i(i*)",   &m3_wasi_generic_fd_prestat_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_prestat_dir_name",  "i(i*i)",  &m3_wasi_generic_fd_prestat_dir_name)));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_pwrite",            "i(i*iI*)",)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_read",              "i(i*i*)", &m3_wasi_generic_fd_read)));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_readdir",           "i(i*iI*)",)));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_renumber",          "i(ii)",   )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_sync",              "i(i)",    )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_tell",              "i(i*)",   )));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_write",             "i(i*i*)", &m3_wasi_generic_fd_write)));
-
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_create_directory",    "i(i*i)",       )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_filestat_set_times",  "i(ii*iIIi)",   )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_link",                "i(ii*ii*i)",   )));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_open",                "i(ii*iiIIi*)", &m3_wasi_generic_path_open)));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_readlink",            "i(i*i*i*)",    )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_remove_directory",    "i(i*i)",       )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_rename",              "i(i*ii*i)",    )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_symlink",             "i(*ii*i)",     )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_unlink_file",         "i(i*i)",       )));
-
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "poll_oneoff",          "i(**i*)", &m3_wasi_generic_poll_oneoff)));
-_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "proc_exit",          "v(i)",    &m3_wasi_generic_proc_exit, wasi_context)));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "proc_raise",           "i(i)",    )));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "random_get",           "i(*i)",   &m3_wasi_generic_random_get)));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sched_yield",          "i()",     )));
-
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sock_recv",            "i(i*ii**)",        )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sock_send",            "i(i*ii*)",         )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sock_shutdown",        "i(ii)",            )));
+_       (m3_RegisterRawFunction (io_registry, wasi, "args_get",             "i(**)",   &m3_wasi_generic_args_get, wasi_context));
+_       (m3_RegisterRawFunction (io_registry, wasi, "args_sizes_get",       "i(**)",   &m3_wasi_generic_args_sizes_get, wasi_context));
+_       (m3_RegisterRawFunction (io_registry, wasi, "clock_res_get",        "i(i*)",   &m3_wasi_generic_clock_res_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "clock_time_get",       "i(iI*)",  &m3_wasi_generic_clock_time_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "environ_get",          "i(**)",   &m3_wasi_generic_environ_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "environ_sizes_get",    "i(**)",   &m3_wasi_generic_environ_sizes_get, NULL));
+
+//_     (m3_RegisterRawFunction (io_registry, wasi, "fd_advise",            "i(iIIi)", &m3_wasi_generic_fd_advise, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "fd_allocate",          "i(iII)",  &m3_wasi_generic_fd_allocate, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_close",             "i(i)",    &m3_wasi_generic_fd_close, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_datasync",          "i(i)",    &m3_wasi_generic_fd_datasync, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_fdstat_get",        "i(i*)",   &m3_wasi_generic_fd_fdstat_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_fdstat_set_flags",  "i(ii)",   &m3_wasi_generic_fd_fdstat_set_flags, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "fd_fdstat_set_rights", "i(iII)",  &m3_wasi_generic_fd_fdstat_set_rights, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "fd_filestat_set_size", "i(iI)",   &m3_wasi_generic_fd_filestat_set_size, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "fd_filestat_set_times","i(iIIi)", &m3_wasi_generic_fd_filestat_set_times, NULL));
+#if defined(d_m3HasUringWASI)
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_pread",             "i(i*iI*)",&m3_wasi_generic_fd_pread, NULL));
+#endif
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_prestat_get",       "i(i*)",   &m3_wasi_generic_fd_prestat_get, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_prestat_dir_name",  "i(i*i)",  &m3_wasi_generic_fd_prestat_dir_name, NULL));
+#if defined(d_m3HasUringWASI)
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_pwrite",            "i(i*iI*)",&m3_wasi_generic_fd_pwrite, NULL));
+#endif
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_read",              "i(i*i*)", &m3_wasi_generic_fd_read, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "fd_readdir",           "i(i*iI*)",&m3_wasi_generic_fd_readdir, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "fd_renumber",          "i(ii)",   &m3_wasi_generic_fd_renumber, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_sync",              "i(i)",    &m3_wasi_generic_fd_sync, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "fd_tell",              "i(i*)",   &m3_wasi_generic_fd_tell, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "fd_write",             "i(i*i*)", &m3_wasi_generic_fd_write, NULL));
+
+#if !defined(_WIN32) && !defined(APE)
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_create_directory",    "i(i*i)",       &m3_wasi_generic_path_create_directory, NULL));
+#endif
+//_     (m3_RegisterRawFunction (io_registry, wasi, "path_filestat_set_times",  "i(ii*iIIi)",   &m3_wasi_generic_path_filestat_set_times, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "path_link",                "i(ii*ii*i)",   &m3_wasi_generic_path_link, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_open",                "i(ii*iiIIi*)", &m3_wasi_generic_path_open, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "path_readlink",            "i(i*i*i*)",    &m3_wasi_generic_path_readlink, NULL));
+#if !defined(_WIN32) && !defined(APE)
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_remove_directory",    "i(i*i)",       &m3_wasi_generic_path_remove_directory, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_rename",              "i(i*ii*i)",    &m3_wasi_generic_path_rename, NULL));
+#endif
+//_     (m3_RegisterRawFunction (io_registry, wasi, "path_symlink",             "i(*ii*i)",     &m3_wasi_generic_path_symlink, NULL));
+#if !defined(_WIN32) && !defined(APE)
+_       (m3_RegisterRawFunction (io_registry, wasi, "path_unlink_file",         "i(i*i)",       &m3_wasi_generic_path_unlink_file, NULL));
+#endif
+
+_       (m3_RegisterRawFunction (io_registry, wasi, "proc_exit",            "v(i)",    &m3_wasi_generic_proc_exit, wasi_context));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "proc_raise",           "i(i)",    &m3_wasi_generic_proc_raise, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "random_get",           "i(*i)",   &m3_wasi_generic_random_get, NULL));
+//_     (m3_RegisterRawFunction (io_registry, wasi, "sched_yield",          "i()",     &m3_wasi_generic_sched_yield, NULL));
+
+#if defined(HAS_SOCKETS)
+_       (m3_RegisterRawFunction (io_registry, wasi, "sock_recv",            "i(i*ii**)",        &m3_wasi_generic_sock_recv, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "sock_send",            "i(i*ii*)",         &m3_wasi_generic_sock_send, NULL));
+_       (m3_RegisterRawFunction (io_registry, wasi, "sock_shutdown",        "i(ii)",            &m3_wasi_generic_sock_shutdown, NULL));
+#endif
     }
 
 _catch:
     return result;
 }
 
+
+M3Result  m3_LinkWASI  (IM3Module module)
+{
+    static IM3ImportRegistry registry = NULL;
+    return LinkRegisteredImports (module, & registry, m3_RegisterWASI);
+}
+
 #endif // d_m3HasWASI
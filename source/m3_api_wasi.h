@@ -24,15 +24,55 @@ typedef struct m3_wasi_context_t
 } m3_wasi_context_t;
 
 M3Result    m3_LinkWASI             (IM3Module io_module);
+M3Result    m3_RegisterWASI         (IM3ImportRegistry io_registry);
 
 #if defined(d_m3HasUVWASI)
 
 M3Result    m3_LinkWASIWithOptions  (IM3Module io_module, uvwasi_options_t uvwasiOptions);
 
+// receives the result of each m3_Resume done by the attached loop: m3Err_suspended while
+// the call is still parked, otherwise the call's final result
+typedef void (* M3WasiResumeHandler) (IM3Runtime i_runtime, M3Result i_result);
+
+// blocking file calls of suspendable runtimes (d_m3EnableResumableCalls, m3_SetSuspendable)
+// run on i_loop's threadpool while the guest is parked at the import. calls have to be
+// started on the thread that runs the loop; NULL detaches
+M3Result    m3_AttachWASILoop       (uv_loop_t * i_loop, M3WasiResumeHandler i_onResumed);
+
 #endif
 
 m3_wasi_context_t* m3_GetWasiContext();
 
+#if defined(d_m3HasWASI) && !defined(_WIN32)
+
+// exposes a listening socket to the guest for sock_accept; o_wasiFd is its fd number there
+M3Result    m3_PreopenSocketWASI    (int i_hostFd, int* o_wasiFd);
+
+// serves the runtime's preopened directories from a tar image read into memory instead of
+// the host filesystem. writes stay in memory and are dropped by m3_UnmountWASIImage or when
+// the runtime is freed
+M3Result    m3_MountWASIImage       (IM3Runtime i_runtime, const char* i_tarPath);
+void        m3_UnmountWASIImage     (IM3Runtime i_runtime);
+
+#endif
+
+// writes out stdout/stderr output held by the WASI write buffer (d_m3WasiWriteBufferSize)
+void m3_FlushWASI();
+
+// routes the runtime's fd 0, 1 and 2 to memory instead of the host (d_m3WasiStdio).
+// guest output collects in growable buffers read in place with m3_PeekStdioWASI, and
+// stdin reads take bytes queued by m3_FeedStdinWASI, ending the input once they run out.
+// the buffers are freed by m3_ReleaseStdioWASI or with the runtime
+M3Result    m3_CaptureStdioWASI     (IM3Runtime i_runtime);
+void        m3_ReleaseStdioWASI     (IM3Runtime i_runtime);
+
+// the oldest unread output of fd 1 or 2; this can be only part of it when the buffer wraps,
+// so peek again after consuming. the pointer is valid until the guest runs again
+size_t      m3_PeekStdioWASI        (IM3Runtime i_runtime, int i_fd, const void ** o_data);
+void        m3_ConsumeStdioWASI     (IM3Runtime i_runtime, int i_fd, size_t i_length);
+
+M3Result    m3_FeedStdinWASI        (IM3Runtime i_runtime, const void * i_data, size_t i_length);
+
 d_m3EndExternC
 
 #endif // m3_api_wasi_h
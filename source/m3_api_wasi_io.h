@@ -0,0 +1,431 @@
+//
+//  m3_api_wasi_io.h
+//
+//  iovec translation, stdio write buffering and stdio capture shared by the WASI backends
+//
+
+#ifndef m3_api_wasi_io_h
+#define m3_api_wasi_io_h
+
+#include "m3_env.h"
+
+// guest iovec: an offset and length in linear memory
+typedef struct m3_wasi_iovec_t
+{
+    uint32_t    buf;
+    uint32_t    buf_len;
+}
+m3_wasi_iovec_t;
+
+// host iovec: same layout as struct iovec, uvwasi_iovec_t and (on wasm32) __wasi_iovec_t
+typedef struct m3_host_iovec_t
+{
+    void *      buf;
+    size_t      buf_len;
+}
+m3_host_iovec_t;
+
+// host iovecs of one call: up to d_m3WasiMaxIovecs stay in the caller's frame, longer lists
+// (guests pass up to IOV_MAX) are allocated and must be released with wasi_release_iovs
+typedef struct m3_wasi_iovecs_t
+{
+    m3_host_iovec_t *   iovs;
+    m3_host_iovec_t     local [d_m3WasiMaxIovecs];
+}
+m3_wasi_iovecs_t;
+
+static inline
+void wasi_release_iovs(IM3Runtime runtime, m3_wasi_iovecs_t* io_iovecs)
+{
+    if (io_iovecs->iovs != io_iovecs->local) {
+        m3_AllocatorFree(&runtime->environment->allocator, io_iovecs->iovs);
+    }
+    io_iovecs->iovs = io_iovecs->local;
+}
+
+static inline
+const void* wasi_check_mem(IM3Runtime runtime, void* _mem, const void* addr, uint64_t len)
+{
+    m3ApiCheckMem(addr, len);
+    m3ApiSuccess();
+}
+
+// translates iovs_len guest iovecs into o_iovecs->iovs. traps when the iovec array or any
+// buffer is outside linear memory, and then leaves nothing to release
+static inline
+const void* wasi_translate_iovs(IM3Runtime runtime, void* _mem, m3_wasi_iovecs_t* o_iovecs,
+                                const m3_wasi_iovec_t* wasi_iovs, uint32_t iovs_len, size_t* total_len)
+{
+    o_iovecs->iovs = o_iovecs->local;
+    m3ApiCheckMem(wasi_iovs, (uint64_t) iovs_len * sizeof(m3_wasi_iovec_t));
+
+    if (iovs_len > d_m3WasiMaxIovecs) {
+        m3_host_iovec_t* iovs = m3_AllocatorAllocArray(&runtime->environment->allocator, m3_host_iovec_t, iovs_len);
+        if (!iovs) m3ApiTrap(m3Err_mallocFailed);
+        o_iovecs->iovs = iovs;
+    }
+
+    m3_host_iovec_t* host_iovs = o_iovecs->iovs;
+    size_t total = 0;
+    for (uint32_t i = 0; i < iovs_len; i++) {
+        host_iovs[i].buf     = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
+        host_iovs[i].buf_len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
+
+        const void* result = wasi_check_mem(runtime, _mem, host_iovs[i].buf, host_iovs[i].buf_len);
+        if (result) {
+            wasi_release_iovs(runtime, o_iovecs);
+            return result;
+        }
+        total += host_iovs[i].buf_len;
+    }
+
+    if (total_len) *total_len = total;
+    m3ApiSuccess();
+}
+
+
+// poll_oneoff subscription, decoded from either ABI
+typedef struct m3_wasi_subscription_t
+{
+    uint64_t    userdata;
+    uint64_t    timeout;
+    uint64_t    precision;
+    uint32_t    clock_id;
+    uint32_t    fd;
+    uint16_t    flags;
+    uint8_t     type;
+}
+m3_wasi_subscription_t;
+
+#define c_wasiSubscriptionSize          48      // wasi_snapshot_preview1
+#define c_wasiUnstableSubscriptionSize  56      // wasi_unstable clocks carry an extra 64-bit identifier
+#define c_wasiEventSize                 32      // same in both
+#define c_wasiEventTypeClock            0
+
+static inline
+void wasi_read_subscription(m3_wasi_subscription_t* o_sub, const uint8_t* in, bool unstable)
+{
+    const uint8_t* clock = in + (unstable ? 24 : 16);
+
+    o_sub->userdata     = m3ApiReadMem64(in);
+    o_sub->type         = in[8];
+    o_sub->fd           = m3ApiReadMem32(in + 16);
+    o_sub->clock_id     = m3ApiReadMem32(clock);
+    o_sub->timeout      = m3ApiReadMem64(clock + 8);
+    o_sub->precision    = m3ApiReadMem64(clock + 16);
+    o_sub->flags        = m3ApiReadMem16(clock + 24);
+}
+
+// rewrites nsubscriptions subscriptions into the other ABI's layout; dst holds as many of the
+// target size. only clock subscriptions differ: the wasi_unstable id sits before the clock fields
+static inline
+void wasi_convert_subscriptions(uint8_t* dst, bool dstUnstable, const uint8_t* src, bool srcUnstable, uint32_t nsubscriptions)
+{
+    const size_t srcSize  = srcUnstable ? c_wasiUnstableSubscriptionSize : c_wasiSubscriptionSize;
+    const size_t dstSize  = dstUnstable ? c_wasiUnstableSubscriptionSize : c_wasiSubscriptionSize;
+    const size_t srcClock = srcUnstable ? 24 : 16;
+    const size_t dstClock = dstUnstable ? 24 : 16;
+
+    for (uint32_t i = 0; i < nsubscriptions; i++, src += srcSize, dst += dstSize) {
+        memset(dst, 0, dstSize);
+        memcpy(dst, src, 16);                                   // userdata, type
+        if (src[8] == c_wasiEventTypeClock) {
+            memcpy(dst + dstClock, src + srcClock, 32);         // clock id, timeout, precision, flags
+        } else {
+            memcpy(dst + 16, src + 16, 4);                      // fd
+        }
+    }
+}
+
+static inline
+void wasi_write_event(uint8_t* out, const m3_wasi_subscription_t* sub, uint16_t error, uint64_t nbytes, uint16_t flags)
+{
+    memset(out, 0, c_wasiEventSize);
+    m3ApiWriteMem64(out, sub->userdata);
+    m3ApiWriteMem16(out + 8, error);
+    out[10] = sub->type;
+    m3ApiWriteMem64(out + 16, nbytes);
+    m3ApiWriteMem16(out + 24, flags);
+}
+
+
+#if d_m3WasiWriteBufferSize
+
+// the backend's vectored write; returns a WASI errno
+typedef uint32_t (* wasi_writev_t) (int32_t fd, const m3_host_iovec_t* iovs, uint32_t iovs_len, size_t* nwritten);
+
+typedef struct m3_wasi_write_buffer_t
+{
+    uint32_t    length;
+    uint8_t     data [d_m3WasiWriteBufferSize];
+}
+m3_wasi_write_buffer_t;
+
+// stdout and stderr
+static m3_wasi_write_buffer_t wasi_write_buffers [2];
+
+static inline
+m3_wasi_write_buffer_t* wasi_write_buffer(int32_t fd)
+{
+    return (fd == 1 || fd == 2) ? &wasi_write_buffers[fd - 1] : NULL;
+}
+
+static inline
+uint32_t wasi_flush_fd(wasi_writev_t writev_fn, int32_t fd)
+{
+    m3_wasi_write_buffer_t* wb = wasi_write_buffer(fd);
+    if (!wb) return 0;
+
+    uint32_t ret = 0;
+    uint32_t done = 0;
+    while (done < wb->length) {
+        m3_host_iovec_t iov = { wb->data + done, wb->length - done };
+        size_t written = 0;
+        ret = writev_fn(fd, &iov, 1, &written);
+        if (ret || written == 0) break;
+        done += written;
+    }
+
+    // on error the pending output is dropped, like a failed unbuffered write
+    wb->length = 0;
+    return ret;
+}
+
+static inline
+void wasi_flush_all(wasi_writev_t writev_fn)
+{
+    wasi_flush_fd(writev_fn, 1);
+    wasi_flush_fd(writev_fn, 2);
+}
+
+// buffers a write to stdout or stderr. returns false when the write should go straight
+// to the backend (not a stdio fd, or too large to buffer); the buffers are flushed first
+// so output order is kept
+static inline
+bool wasi_buffered_write(wasi_writev_t writev_fn, int32_t fd, const m3_host_iovec_t* iovs, uint32_t iovs_len,
+                         size_t total_len, size_t* nwritten, uint32_t* ret)
+{
+    m3_wasi_write_buffer_t* wb = wasi_write_buffer(fd);
+    if (!wb) return false;
+
+    // keep stdout and stderr interleaved as written
+    wasi_flush_fd(writev_fn, fd == 1 ? 2 : 1);
+
+    if (total_len > sizeof(wb->data) - wb->length) {
+        *ret = wasi_flush_fd(writev_fn, fd);
+        if (*ret || total_len >= sizeof(wb->data)) {
+            *nwritten = 0;
+            return (*ret != 0);
+        }
+    }
+
+    bool has_newline = false;
+    for (uint32_t i = 0; i < iovs_len; i++) {
+        size_t len = iovs[i].buf_len;
+        memcpy(wb->data + wb->length, iovs[i].buf, len);
+        wb->length += len;
+        has_newline = has_newline || memchr(iovs[i].buf, '\n', len) != NULL;
+    }
+
+    *ret = has_newline ? wasi_flush_fd(writev_fn, fd) : 0;
+    *nwritten = *ret ? 0 : total_len;
+    return true;
+}
+
+#endif // d_m3WasiWriteBufferSize
+
+
+#if d_m3WasiStdio
+
+// growable ring buffer; the unread bytes start at head and may wrap around the end
+typedef struct m3_wasi_ring_t
+{
+    uint8_t *   data;
+    size_t      capacity;
+    size_t      head;
+    size_t      length;
+}
+m3_wasi_ring_t;
+
+// stdin source and stdout/stderr sinks of a runtime that captures stdio
+typedef struct m3_wasi_stdio_t
+{
+    bool            enabled;
+    m3_wasi_ring_t  rings [3];
+}
+m3_wasi_stdio_t;
+
+// provided by the backend: the capture kept in the runtime's WASI state (M3Runtime.wasi),
+// which is allocated first when i_create is set. NULL without state
+static m3_wasi_stdio_t* wasi_stdio_state (IM3Runtime runtime, bool i_create);
+
+static inline
+m3_wasi_stdio_t* wasi_stdio_get(IM3Runtime runtime, int32_t fd)
+{
+    if (fd < 0 || fd > 2) return NULL;
+
+    m3_wasi_stdio_t* stdio = wasi_stdio_state(runtime, false);
+    return (stdio && stdio->enabled) ? stdio : NULL;
+}
+
+// makes room for extra more bytes, unwrapping the contents into the new buffer
+static inline
+bool wasi_ring_reserve(m3_wasi_ring_t* ring, size_t extra)
+{
+    if (ring->capacity - ring->length >= extra) return true;
+
+    size_t capacity = ring->capacity ? ring->capacity : 4096;
+    while (capacity - ring->length < extra) {
+        if (capacity > SIZE_MAX / 2) return false;
+        capacity *= 2;
+    }
+
+    uint8_t* data = (uint8_t*) malloc(capacity);
+    if (!data) return false;
+
+    if (ring->length) {
+        size_t first = M3_MIN(ring->length, ring->capacity - ring->head);
+        memcpy(data, ring->data + ring->head, first);
+        memcpy(data + first, ring->data, ring->length - first);
+    }
+    free(ring->data);
+    ring->data = data;
+    ring->capacity = capacity;
+    ring->head = 0;
+    return true;
+}
+
+static inline
+void wasi_ring_put(m3_wasi_ring_t* ring, const uint8_t* src, size_t len)
+{
+    if (!len) return;
+
+    size_t tail = (ring->head + ring->length) % ring->capacity;
+    size_t first = M3_MIN(len, ring->capacity - tail);
+    memcpy(ring->data + tail, src, first);
+    memcpy(ring->data, src + first, len - first);
+    ring->length += len;
+}
+
+// the unread bytes up to the end of the buffer
+static inline
+size_t wasi_ring_peek(m3_wasi_ring_t* ring, const uint8_t** o_data)
+{
+    *o_data = ring->data + ring->head;
+    return M3_MIN(ring->length, ring->capacity - ring->head);
+}
+
+static inline
+void wasi_ring_consume(m3_wasi_ring_t* ring, size_t len)
+{
+    len = M3_MIN(len, ring->length);
+    ring->length -= len;
+    ring->head = ring->length ? (ring->head + len) % ring->capacity : 0;
+}
+
+// reads fd 0 or writes fd 1 and 2 of a runtime that captures stdio; returns the backend's
+// errno (it defines c_wasiErrnoBadf and c_wasiErrnoNomem before including this header).
+// an empty stdin reads as end of file
+static inline
+uint32_t wasi_stdio_rw(m3_wasi_stdio_t* stdio, bool write, int32_t fd, const m3_host_iovec_t* iovs, uint32_t iovs_len, size_t* nbytes)
+{
+    m3_wasi_ring_t* ring = &stdio->rings[fd];
+    *nbytes = 0;
+
+    if (write != (fd != 0)) return c_wasiErrnoBadf;
+
+    size_t done = 0;
+    if (write) {
+        size_t total = 0;
+        for (uint32_t i = 0; i < iovs_len; i++) total += iovs[i].buf_len;
+        if (!wasi_ring_reserve(ring, total)) return c_wasiErrnoNomem;
+
+        for (uint32_t i = 0; i < iovs_len; i++) {
+            wasi_ring_put(ring, (const uint8_t*) iovs[i].buf, iovs[i].buf_len);
+        }
+        done = total;
+    } else {
+        for (uint32_t i = 0; i < iovs_len && ring->length; i++) {
+            size_t want = iovs[i].buf_len;
+            while (want && ring->length) {
+                const uint8_t* src;
+                size_t len = M3_MIN(wasi_ring_peek(ring, &src), want);
+                memcpy((uint8_t*) iovs[i].buf + iovs[i].buf_len - want, src, len);
+                wasi_ring_consume(ring, len);
+                want -= len;
+                done += len;
+            }
+        }
+    }
+
+    *nbytes = done;
+    return 0;
+}
+
+static inline
+M3Result wasi_stdio_capture(IM3Runtime runtime)
+{
+    m3_wasi_stdio_t* stdio = wasi_stdio_state(runtime, true);
+    if (!stdio) return m3Err_mallocFailed;
+
+    stdio->enabled = true;
+    return m3Err_none;
+}
+
+// frees the buffers; the backend also calls this when it releases the runtime's state
+static inline
+void wasi_stdio_clear(m3_wasi_stdio_t* stdio)
+{
+    for (int i = 0; i < 3; i++) free(stdio->rings[i].data);
+    memset(stdio, 0, sizeof(m3_wasi_stdio_t));
+}
+
+static inline
+void wasi_stdio_release(IM3Runtime runtime)
+{
+    m3_wasi_stdio_t* stdio = wasi_stdio_state(runtime, false);
+    if (stdio) wasi_stdio_clear(stdio);
+}
+
+static inline
+size_t wasi_stdio_peek(IM3Runtime runtime, int fd, const void** o_data)
+{
+    m3_wasi_stdio_t* stdio = wasi_stdio_get(runtime, fd);
+    *o_data = NULL;
+    if (!stdio || fd == 0) return 0;
+
+    const uint8_t* data;
+    size_t len = wasi_ring_peek(&stdio->rings[fd], &data);
+    if (len) *o_data = data;
+    return len;
+}
+
+static inline
+void wasi_stdio_consume(IM3Runtime runtime, int fd, size_t len)
+{
+    m3_wasi_stdio_t* stdio = wasi_stdio_get(runtime, fd);
+    if (stdio && fd != 0) wasi_ring_consume(&stdio->rings[fd], len);
+}
+
+static inline
+M3Result wasi_stdio_feed(IM3Runtime runtime, const void* data, size_t len)
+{
+    m3_wasi_stdio_t* stdio = wasi_stdio_get(runtime, 0);
+    if (!stdio) return "runtime does not capture WASI stdio";
+    if (!wasi_ring_reserve(&stdio->rings[0], len)) return m3Err_mallocFailed;
+
+    wasi_ring_put(&stdio->rings[0], (const uint8_t*) data, len);
+    return m3Err_none;
+}
+
+#else
+
+static inline M3Result  wasi_stdio_capture  (IM3Runtime runtime)                                 { return "WASI stdio capture is disabled (d_m3WasiStdio)"; }
+static inline void      wasi_stdio_release  (IM3Runtime runtime)                                 { }
+static inline size_t    wasi_stdio_peek     (IM3Runtime runtime, int fd, const void** o_data)    { *o_data = NULL; return 0; }
+static inline void      wasi_stdio_consume  (IM3Runtime runtime, int fd, size_t len)             { }
+static inline M3Result  wasi_stdio_feed     (IM3Runtime runtime, const void* data, size_t len)   { return "WASI stdio capture is disabled (d_m3WasiStdio)"; }
+
+#endif // d_m3WasiStdio
+
+#endif // m3_api_wasi_io_h
@@ -0,0 +1,343 @@
+//
+//  m3_api_wasi_uring.h
+//
+//  io_uring submission for the simple WASI backend (BUILD_WASI=uring).
+//  Uses the raw syscalls, so only the kernel uapi headers are needed.
+//
+
+#ifndef m3_api_wasi_uring_h
+#define m3_api_wasi_uring_h
+
+#include "m3_api_wasi_io.h"
+#include "m3_env.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#if !defined(IORING_FEAT_RW_CUR_POS)
+#  define IORING_FEAT_RW_CUR_POS    (1U << 3)
+#endif
+
+// user_data of a request: a tag in the top bits, the batch it belongs to, and its index in the
+// batch (the poll_oneoff subscription or the read/write iovec)
+#define c_wasiUringRwTag        (UINT64_C(1) << 62)
+#define c_wasiUringCancelTag    (UINT64_C(1) << 63)
+#define c_wasiUringDrainTag     (c_wasiUringRwTag | c_wasiUringCancelTag)
+#define c_wasiUringBatchMask    UINT32_C(0x3FFFFFFF)
+
+// iovecs a read or write splits into separate fixed-buffer requests; longer lists go out as one readv/writev
+#define c_wasiUringMaxFixedIovecs   16
+
+// one ring per runtime, kept in its WASI state
+typedef struct m3_wasi_uring_t
+{
+    int                     fd;                 // -1 without a ring
+    bool                    initialized;        // set up, or tried to; never retried
+    u32                     features;           // IORING_FEAT_*
+
+    u8 *                    ring;
+    size_t                  ringSize;
+    size_t                  sqesSize;
+
+    u32 *                   sqHead;
+    u32 *                   sqTail;
+    u32                     sqMask;
+    u32                     sqEntries;
+    u32 *                   sqArray;
+    struct io_uring_sqe *   sqes;
+    u32                     sqLocalTail;        // queued but not yet published to the kernel
+
+    u32 *                   cqHead;
+    u32 *                   cqTail;
+    u32                     cqMask;
+    struct io_uring_cqe *   cqes;
+
+    u32                     inFlight;           // queued requests whose completion hasn't been reaped
+    u32                     batch;              // see wasi_uring_user_data
+
+    // linear memory registered as fixed buffer 0, keyed by M3MemoryHeader::serial. the kernel
+    // pins the whole registration, so only memories up to d_m3WasiUringFixedMemoryMax qualify
+    u64                     fixedSerial;
+    bool                    fixedRegistered;
+
+    // poll_oneoff scratch; the timeouts must stay valid until they complete
+    struct __kernel_timespec    timeouts [d_m3WasiUringEntries];
+    bool                        pending [d_m3WasiUringEntries];
+}
+m3_wasi_uring_t;
+
+
+static inline
+bool wasi_uring_init(m3_wasi_uring_t* ring, u32 i_entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    ring->initialized = true;
+
+    int fd = (int) syscall(__NR_io_uring_setup, i_entries, &p);
+    if (fd < 0) return false;
+
+    // the ring has to be drained in one mmap and never drop completions
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP)) {
+        close(fd);
+        return false;
+    }
+
+    size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(u32);
+    size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    size_t ringSize = M3_MAX(sqSize, cqSize);
+    size_t sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    u8* mem = (u8*) mmap(NULL, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (mem == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    void* sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        munmap(mem, ringSize);
+        close(fd);
+        return false;
+    }
+
+    ring->fd            = fd;
+    ring->features      = p.features;
+    ring->ring          = mem;
+    ring->ringSize      = ringSize;
+    ring->sqesSize      = sqesSize;
+    ring->sqHead        = (u32*)(mem + p.sq_off.head);
+    ring->sqTail        = (u32*)(mem + p.sq_off.tail);
+    ring->sqMask        = *(u32*)(mem + p.sq_off.ring_mask);
+    ring->sqEntries     = p.sq_entries;
+    ring->sqArray       = (u32*)(mem + p.sq_off.array);
+    ring->sqes          = (struct io_uring_sqe*) sqes;
+    ring->sqLocalTail   = *ring->sqTail;
+    ring->cqHead        = (u32*)(mem + p.cq_off.head);
+    ring->cqTail        = (u32*)(mem + p.cq_off.tail);
+    ring->cqMask        = *(u32*)(mem + p.cq_off.ring_mask);
+    ring->cqes          = (struct io_uring_cqe*)(mem + p.cq_off.cqes);
+
+    return true;
+}
+
+// closing the ring cancels whatever is still in flight and drops the fixed buffer
+static inline
+void wasi_uring_free(m3_wasi_uring_t* ring)
+{
+    if (ring->fd < 0) return;
+
+    close(ring->fd);
+    munmap(ring->sqes, ring->sqesSize);
+    munmap(ring->ring, ring->ringSize);
+
+    ring->fd = -1;
+    ring->inFlight = 0;
+    ring->fixedRegistered = false;
+}
+
+// publishes queued submissions and waits for i_waitNr completions; returns 0 or -errno
+static inline
+int wasi_uring_enter(m3_wasi_uring_t* ring, u32 i_waitNr)
+{
+    u32 toSubmit = ring->sqLocalTail - *ring->sqTail;
+    __atomic_store_n(ring->sqTail, ring->sqLocalTail, __ATOMIC_RELEASE);
+
+    while (toSubmit || i_waitNr)
+    {
+        int ret = (int) syscall(__NR_io_uring_enter, ring->fd, toSubmit, i_waitNr, i_waitNr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        toSubmit -= M3_MIN((u32) ret, toSubmit);
+        if (!toSubmit) break;
+    }
+
+    return 0;
+}
+
+// returns a zeroed submission entry; submits what is queued when the SQ is full
+static inline
+struct io_uring_sqe* wasi_uring_get_sqe(m3_wasi_uring_t* ring)
+{
+    // without SQPOLL the kernel consumes submissions inside io_uring_enter
+    u32 head = __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+    if (ring->sqLocalTail - head >= ring->sqEntries) {
+        wasi_uring_enter(ring, 0);
+    }
+
+    u32 index = ring->sqLocalTail & ring->sqMask;
+    ring->sqArray[index] = index;
+    ring->sqLocalTail++;
+    ring->inFlight++;
+
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+static inline
+bool wasi_uring_pop_cqe(m3_wasi_uring_t* ring, struct io_uring_cqe* o_cqe)
+{
+    u32 head = *ring->cqHead;
+    if (head == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+        return false;
+
+    *o_cqe = ring->cqes[head & ring->cqMask];
+    __atomic_store_n(ring->cqHead, head + 1, __ATOMIC_RELEASE);
+    ring->inFlight--;
+    return true;
+}
+
+// starts a batch: completions left over from earlier ones no longer match wasi_uring_batch_index
+static inline
+void wasi_uring_begin_batch(m3_wasi_uring_t* ring)
+{
+    ring->batch = (ring->batch + 1) & c_wasiUringBatchMask;
+}
+
+static inline
+u64 wasi_uring_user_data(const m3_wasi_uring_t* ring, u64 i_tag, u32 i_index)
+{
+    return i_tag | ((u64) ring->batch << 32) | i_index;
+}
+
+// the index of a completion from the current batch with tag i_tag; false for anything else
+static inline
+bool wasi_uring_batch_index(const m3_wasi_uring_t* ring, u64 i_userData, u64 i_tag, u32 i_count, u32* o_index)
+{
+    if ((i_userData & ~(u64) UINT32_MAX) != wasi_uring_user_data(ring, i_tag, 0)) return false;
+    *o_index = (u32) i_userData;
+    return *o_index < i_count;
+}
+
+// after a batch failed halfway: cancels what is still in flight and reaps it, so no completion
+// outlives the batch. when that fails too, the ring is given up and I/O falls back to syscalls
+static inline
+void wasi_uring_drain(m3_wasi_uring_t* ring)
+{
+#if defined(IORING_ASYNC_CANCEL_ANY)
+    if (ring->fd < 0 || !ring->inFlight) return;
+
+    struct io_uring_sqe* sqe = wasi_uring_get_sqe(ring);
+    sqe->opcode         = IORING_OP_ASYNC_CANCEL;
+    sqe->cancel_flags   = IORING_ASYNC_CANCEL_ANY;
+    sqe->user_data      = c_wasiUringDrainTag;
+
+    while (ring->inFlight) {
+        if (wasi_uring_enter(ring, 1) < 0) break;
+
+        struct io_uring_cqe cqe;
+        bool failed = false;
+        while (wasi_uring_pop_cqe(ring, &cqe)) {
+            // -ENOENT: everything completed by itself
+            if (cqe.user_data == c_wasiUringDrainTag && cqe.res < 0 && cqe.res != -ENOENT) failed = true;
+        }
+        if (failed) break;
+    }
+#endif
+    if (ring->inFlight) wasi_uring_free(ring);
+}
+
+// registers the runtime's linear memory as fixed buffer 0 and keeps it registered until the
+// memory is reallocated. returns false when it can't be registered (size, RLIMIT_MEMLOCK)
+static inline
+bool wasi_uring_register_memory(m3_wasi_uring_t* ring, IM3Runtime i_runtime)
+{
+    M3MemoryHeader* header = i_runtime->memory.mallocated;
+    if (!header || !header->length || header->length > d_m3WasiUringFixedMemoryMax) return false;
+
+    if (header->serial == ring->fixedSerial)
+        return ring->fixedRegistered;
+
+    if (ring->fixedRegistered)
+        syscall(__NR_io_uring_register, ring->fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+
+    struct iovec iov = { m3MemData(header), header->length };
+    ring->fixedRegistered = (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+    ring->fixedSerial = header->serial;
+
+    return ring->fixedRegistered;
+}
+
+// true when wasi_uring_rw can serve a transfer at i_offset; reads and writes at the file
+// position need IORING_FEAT_RW_CUR_POS (5.6)
+static inline
+bool wasi_uring_can_rw(const m3_wasi_uring_t* ring, int64_t i_offset)
+{
+    return ring->fd >= 0 && (i_offset >= 0 || (ring->features & IORING_FEAT_RW_CUR_POS));
+}
+
+// vectored read or write at i_offset (-1 for the file position) of buffers in the runtime's
+// linear memory. returns the byte count or -errno.
+// with the memory registered, every iovec becomes a fixed-buffer request and all of them go to
+// the kernel in one io_uring_enter. reads at an explicit offset run concurrently; everything
+// else is linked so the transfers land in order and a short one cancels the rest
+static inline
+int wasi_uring_rw(m3_wasi_uring_t* ring, IM3Runtime i_runtime, bool i_write, int32_t i_fd, const m3_host_iovec_t* i_iovs, uint32_t i_iovsLen, int64_t i_offset)
+{
+    // a chain has to fit the SQ, or wasi_uring_get_sqe would submit it in pieces
+    bool fixed = (i_iovsLen <= M3_MIN(c_wasiUringMaxFixedIovecs, ring->sqEntries)) && wasi_uring_register_memory(ring, i_runtime);
+    bool linked = i_write || i_offset < 0;
+    u32 numRequests = fixed ? i_iovsLen : 1;
+    u64 offset = (u64) i_offset;
+
+    if (!numRequests) return 0;
+
+    wasi_uring_begin_batch(ring);
+    for (u32 i = 0; i < numRequests; i++) {
+        struct io_uring_sqe* sqe = wasi_uring_get_sqe(ring);
+
+        if (fixed) {
+            sqe->opcode     = i_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe->addr       = (u64)(uintptr_t) i_iovs[i].buf;
+            sqe->len        = (u32) i_iovs[i].buf_len;
+            sqe->buf_index  = 0;
+            sqe->off        = offset;
+            if (i_offset >= 0) offset += i_iovs[i].buf_len;
+            if (linked && i + 1 < numRequests) sqe->flags |= IOSQE_IO_LINK;
+        } else {
+            sqe->opcode     = i_write ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe->addr       = (u64)(uintptr_t) i_iovs;
+            sqe->len        = i_iovsLen;
+            sqe->off        = offset;
+        }
+        sqe->fd         = i_fd;
+        sqe->user_data  = wasi_uring_user_data(ring, c_wasiUringRwTag, i);
+    }
+
+    int results[c_wasiUringMaxFixedIovecs];
+    for (u32 done = 0; done < numRequests; ) {
+        int ret = wasi_uring_enter(ring, 1);
+        if (ret < 0) {
+            wasi_uring_drain(ring);
+            return ret;
+        }
+
+        struct io_uring_cqe cqe;
+        while (wasi_uring_pop_cqe(ring, &cqe)) {
+            u32 i;
+            if (!wasi_uring_batch_index(ring, cqe.user_data, c_wasiUringRwTag, numRequests, &i)) continue;
+            results[i] = cqe.res;
+            done++;
+        }
+    }
+
+    // like readv/writev: the bytes up to the first short transfer, or its error if nothing moved
+    int total = 0;
+    for (u32 i = 0; i < numRequests; i++) {
+        if (results[i] < 0) return total ? total : results[i];
+        total += results[i];
+        if (fixed && (size_t) results[i] < i_iovs[i].buf_len) break;
+    }
+    return total;
+}
+
+#endif // m3_api_wasi_uring_h
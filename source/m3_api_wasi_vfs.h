@@ -0,0 +1,681 @@
+//
+//  m3_api_wasi_vfs.h
+//
+//  In-memory filesystem for the simple WASI backend. A tar image is mapped read-only
+//  and each runtime gets its own tree over it (held in its WASI state); guest writes go to overlay buffers, so
+//  after mounting no file operation reaches the host.
+//
+
+#ifndef m3_api_wasi_vfs_h
+#define m3_api_wasi_vfs_h
+
+#include "m3_api_wasi_io.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define c_wasiVfsFdBase         0x10000         // guest fds of files opened in the image
+#define c_wasiVfsNone           UINT32_MAX
+#define c_wasiVfsRoot           0
+
+typedef struct m3_vfs_node_t
+{
+    char *                  name;
+    u32                     nameLen;
+    u32                     parent;             // c_wasiVfsNone once unlinked
+    u32                     child;              // first entry of a directory
+    u32                     sibling;
+    bool                    isDir;
+
+    const u8 *              base;               // contents in the image, until first written
+    u8 *                    data;               // overlay copy
+    u64                     size;
+    u64                     capacity;
+    u64                     mtime;              // ns
+}
+m3_vfs_node_t;
+
+typedef struct m3_vfs_file_t
+{
+    u32                     node;               // c_wasiVfsNone for a free slot
+    u16                     flags;              // __WASI_FDFLAGS_APPEND
+    u64                     pos;
+}
+m3_vfs_file_t;
+
+typedef struct m3_wasi_vfs_t
+{
+    void *                  image;
+    size_t                  imageSize;
+
+    m3_vfs_node_t *         nodes;
+    u32                     numNodes;
+    u32                     maxNodes;
+
+    m3_vfs_file_t *         files;
+    u32                     numFiles;
+}
+m3_wasi_vfs_t;
+
+
+static inline
+u64 vfs_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (u64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static
+u32 vfs_child(m3_wasi_vfs_t* vfs, u32 dir, const char* name, size_t len)
+{
+    for (u32 i = vfs->nodes[dir].child; i != c_wasiVfsNone; i = vfs->nodes[i].sibling) {
+        m3_vfs_node_t* n = &vfs->nodes[i];
+        if (n->nameLen == len && memcmp(n->name, name, len) == 0) return i;
+    }
+    return c_wasiVfsNone;
+}
+
+static
+void vfs_link(m3_wasi_vfs_t* vfs, u32 node, u32 dir)
+{
+    vfs->nodes[node].parent = dir;
+    vfs->nodes[node].sibling = vfs->nodes[dir].child;
+    vfs->nodes[dir].child = node;
+}
+
+static
+void vfs_unlink(m3_wasi_vfs_t* vfs, u32 node)
+{
+    u32* link = &vfs->nodes[vfs->nodes[node].parent].child;
+    while (*link != node) link = &vfs->nodes[*link].sibling;
+    *link = vfs->nodes[node].sibling;
+
+    vfs->nodes[node].parent = c_wasiVfsNone;
+    vfs->nodes[node].sibling = c_wasiVfsNone;
+}
+
+static
+u32 vfs_new_node(m3_wasi_vfs_t* vfs, u32 dir, const char* name, size_t len, bool isDir)
+{
+    if (vfs->numNodes == vfs->maxNodes) {
+        u32 maxNodes = vfs->maxNodes ? vfs->maxNodes * 2 : 64;
+        m3_vfs_node_t* nodes = (m3_vfs_node_t*) realloc(vfs->nodes, maxNodes * sizeof(m3_vfs_node_t));
+        if (!nodes) return c_wasiVfsNone;
+        vfs->nodes = nodes;
+        vfs->maxNodes = maxNodes;
+    }
+
+    char* copy = (char*) malloc(len + 1);
+    if (!copy) return c_wasiVfsNone;
+    memcpy(copy, name, len);
+    copy[len] = 0;
+
+    u32 index = vfs->numNodes++;
+    m3_vfs_node_t* n = &vfs->nodes[index];
+    memset(n, 0, sizeof(*n));
+    n->name     = copy;
+    n->nameLen  = (u32) len;
+    n->child    = c_wasiVfsNone;
+    n->sibling  = c_wasiVfsNone;
+    n->parent   = c_wasiVfsNone;
+    n->isDir    = isDir;
+    n->mtime    = vfs_now();
+
+    if (dir != c_wasiVfsNone) vfs_link(vfs, index, dir);
+    return index;
+}
+
+
+/*
+ * tar image
+ */
+
+static
+u64 vfs_octal(const u8* s, size_t n)
+{
+    u64 v = 0;
+    for (size_t i = 0; i < n && s[i] >= '0' && s[i] <= '7'; i++) {
+        v = v * 8 + (s[i] - '0');
+    }
+    return v;
+}
+
+// adds an image entry, creating missing parent directories
+static
+M3Result vfs_add_entry(m3_wasi_vfs_t* vfs, const char* path, size_t len, bool isDir, const u8* data, u64 size, u64 mtime)
+{
+    u32 dir = c_wasiVfsRoot;
+    size_t i = 0;
+
+    while (i < len) {
+        while (i < len && path[i] == '/') i++;
+        size_t start = i;
+        while (i < len && path[i] != '/') i++;
+        size_t compLen = i - start;
+        if (!compLen || (compLen == 1 && path[start] == '.')) continue;
+        if (compLen == 2 && path[start] == '.' && path[start + 1] == '.') return "tar image entry leaves the root";
+
+        bool last = true;
+        for (size_t j = i; j < len; j++) {
+            if (path[j] != '/') { last = false; break; }
+        }
+
+        u32 node = vfs_child(vfs, dir, path + start, compLen);
+        if (node == c_wasiVfsNone) {
+            node = vfs_new_node(vfs, dir, path + start, compLen, !last || isDir);
+            if (node == c_wasiVfsNone) return m3Err_mallocFailed;
+        }
+
+        m3_vfs_node_t* n = &vfs->nodes[node];
+        if (last) {
+            n->isDir = isDir;
+            n->base  = isDir ? NULL : data;
+            n->size  = isDir ? 0 : size;
+            n->mtime = mtime;
+        } else if (!n->isDir) {
+            return "tar image entry is inside a file";
+        }
+        dir = node;
+    }
+    return m3Err_none;
+}
+
+// ustar with GNU long names and pax path records; links and devices are skipped
+static
+M3Result vfs_load_tar(m3_wasi_vfs_t* vfs)
+{
+    M3Result result = m3Err_none;
+
+    const u8* p = (const u8*) vfs->image;
+    const u8* end = p + vfs->imageSize;
+
+    const char* longName = NULL;
+    size_t longLen = 0;
+    char path[256 + 1 + 100];
+
+    while (end - p >= 512 && p[0])
+    {
+        u64 size = vfs_octal(p + 124, 12);
+        u8 type = p[156];
+        const u8* data = p + 512;
+        if (size > (u64)(end - data)) return "truncated tar image";
+
+        const char* name = longName;
+        size_t nameLen = longLen;
+        if (!name) {
+            size_t prefixLen = (memcmp(p + 257, "ustar", 5) == 0) ? strnlen((const char*) p + 345, 155) : 0;
+            size_t baseLen = strnlen((const char*) p, 100);
+            memcpy(path, p + 345, prefixLen);
+            if (prefixLen) path[prefixLen++] = '/';
+            memcpy(path + prefixLen, p, baseLen);
+            name = path;
+            nameLen = prefixLen + baseLen;
+        }
+
+        bool named = true;
+        switch (type)
+        {
+        case 'L':
+            longName = (const char*) data;
+            longLen = strnlen(longName, size);
+            named = false;
+            break;
+        case 'x':
+            // "<len> <key>=<value>\n" records
+            for (const u8* r = data; r < data + size; ) {
+                u64 recLen = 0;
+                const u8* q = r;
+                while (q < data + size && *q >= '0' && *q <= '9') recLen = recLen * 10 + (*q++ - '0');
+                if (!recLen || recLen > (u64)(data + size - r)) break;
+                // the value runs up to the record's closing newline and can't be empty
+                if (q + 6 < r + recLen && r[recLen - 1] == '\n' && memcmp(q, " path=", 6) == 0) {
+                    longName = (const char*)(q + 6);
+                    longLen = (r + recLen - 1) - (q + 6);
+                }
+                r += recLen;
+            }
+            named = false;
+            break;
+        case '5':
+_           (vfs_add_entry(vfs, name, nameLen, true, NULL, 0, vfs_octal(p + 136, 12) * 1000000000));
+            break;
+        case '0': case '\0': case '7':
+_           (vfs_add_entry(vfs, name, nameLen, false, data, size, vfs_octal(p + 136, 12) * 1000000000));
+            break;
+        default:
+            break;
+        }
+
+        if (named) {
+            longName = NULL;
+            longLen = 0;
+        }
+        p = data + ((size + 511) & ~(u64) 511);
+    }
+
+_catch:
+    return result;
+}
+
+
+/*
+ * guest operations
+ */
+
+static
+m3_vfs_file_t* vfs_file(m3_wasi_vfs_t* vfs, u32 fd)
+{
+    if (fd < c_wasiVfsFdBase || fd - c_wasiVfsFdBase >= vfs->numFiles) return NULL;
+    m3_vfs_file_t* f = &vfs->files[fd - c_wasiVfsFdBase];
+    return (f->node != c_wasiVfsNone) ? f : NULL;
+}
+
+static
+__wasi_errno_t vfs_dir(m3_wasi_vfs_t* vfs, u32 fd, u32* o_dir)
+{
+    if (fd == 3 || fd == 4) {
+        *o_dir = c_wasiVfsRoot;
+        return __WASI_ERRNO_SUCCESS;
+    }
+    m3_vfs_file_t* f = vfs_file(vfs, fd);
+    if (!f) return __WASI_ERRNO_BADF;
+    if (!vfs->nodes[f->node].isDir) return __WASI_ERRNO_NOTDIR;
+    *o_dir = f->node;
+    return __WASI_ERRNO_SUCCESS;
+}
+
+// resolves i_path under the directory fd. o_node is c_wasiVfsNone when the last component
+// doesn't exist; o_parent and o_leaf then tell where it would be created (o_leaf is NULL
+// for paths ending in "." or "..")
+static
+__wasi_errno_t vfs_lookup(m3_wasi_vfs_t* vfs, u32 dirfd, const char* path, size_t len,
+                          u32* o_node, u32* o_parent, const char** o_leaf, size_t* o_leafLen)
+{
+    u32 dir;
+    __wasi_errno_t ret = vfs_dir(vfs, dirfd, &dir);
+    if (ret) return ret;
+
+    if (!len) return __WASI_ERRNO_NOENT;
+    if (path[0] == '/') return __WASI_ERRNO_NOTCAPABLE;
+
+    u32 node = dir;
+    u32 parent = dir;
+    const char* leaf = NULL;
+    size_t leafLen = 0;
+    size_t i = 0;
+
+    while (i < len)
+    {
+        size_t start = i;
+        while (i < len && path[i] != '/') i++;
+        size_t compLen = i - start;
+        while (i < len && path[i] == '/') i++;
+
+        if (node == c_wasiVfsNone) return __WASI_ERRNO_NOENT;
+        if (!vfs->nodes[node].isDir) return __WASI_ERRNO_NOTDIR;
+
+        if (compLen == 1 && path[start] == '.') {
+            parent = node;
+            leaf = NULL;
+        } else if (compLen == 2 && path[start] == '.' && path[start + 1] == '.') {
+            if (node == dir) return __WASI_ERRNO_NOTCAPABLE;
+            node = vfs->nodes[node].parent;
+            parent = node;
+            leaf = NULL;
+        } else {
+            parent = node;
+            leaf = path + start;
+            leafLen = compLen;
+            node = vfs_child(vfs, node, leaf, compLen);
+        }
+    }
+
+    *o_node = node;
+    *o_parent = parent;
+    *o_leaf = leaf;
+    *o_leafLen = leafLen;
+    return __WASI_ERRNO_SUCCESS;
+}
+
+// makes the node's contents writable and at least i_size bytes large
+static
+bool vfs_reserve(m3_vfs_node_t* n, u64 i_size)
+{
+    if (n->data && i_size <= n->capacity) return true;
+
+    u64 capacity = M3_MAX(M3_MAX(i_size, n->size), M3_MAX(n->capacity * 2, 64));
+    if (capacity > SIZE_MAX) return false;
+
+    u8* data = (u8*) realloc(n->data, (size_t) capacity);
+    if (!data) return false;
+
+    if (n->base) {
+        memcpy(data, n->base, (size_t) n->size);
+        n->base = NULL;
+    }
+    n->data = data;
+    n->capacity = capacity;
+    return true;
+}
+
+static
+__wasi_errno_t vfs_open(m3_wasi_vfs_t* vfs, u32 dirfd, const char* path, size_t len,
+                        __wasi_oflags_t oflags, __wasi_fdflags_t fdflags, __wasi_fd_t* o_fd)
+{
+    u32 node, parent;
+    const char* leaf;
+    size_t leafLen;
+    __wasi_errno_t ret = vfs_lookup(vfs, dirfd, path, len, &node, &parent, &leaf, &leafLen);
+    if (ret) return ret;
+
+    if (node == c_wasiVfsNone) {
+        if (!(oflags & __WASI_OFLAGS_CREAT)) return __WASI_ERRNO_NOENT;
+        if (oflags & __WASI_OFLAGS_DIRECTORY) return __WASI_ERRNO_NOENT;
+        node = vfs_new_node(vfs, parent, leaf, leafLen, false);
+        if (node == c_wasiVfsNone) return __WASI_ERRNO_NOMEM;
+    } else {
+        m3_vfs_node_t* n = &vfs->nodes[node];
+        if ((oflags & __WASI_OFLAGS_CREAT) && (oflags & __WASI_OFLAGS_EXCL)) return __WASI_ERRNO_EXIST;
+        if ((oflags & __WASI_OFLAGS_DIRECTORY) && !n->isDir) return __WASI_ERRNO_NOTDIR;
+        if (oflags & __WASI_OFLAGS_TRUNC) {
+            if (n->isDir) return __WASI_ERRNO_ISDIR;
+            n->base = NULL;
+            n->size = 0;
+            n->mtime = vfs_now();
+        }
+    }
+
+    u32 slot = 0;
+    while (slot < vfs->numFiles && vfs->files[slot].node != c_wasiVfsNone) slot++;
+    if (slot == vfs->numFiles) {
+        u32 numFiles = vfs->numFiles ? vfs->numFiles * 2 : 16;
+        m3_vfs_file_t* files = (m3_vfs_file_t*) realloc(vfs->files, numFiles * sizeof(m3_vfs_file_t));
+        if (!files) return __WASI_ERRNO_NOMEM;
+        for (u32 i = vfs->numFiles; i < numFiles; i++) files[i].node = c_wasiVfsNone;
+        vfs->files = files;
+        vfs->numFiles = numFiles;
+    }
+
+    vfs->files[slot].node = node;
+    vfs->files[slot].flags = fdflags & __WASI_FDFLAGS_APPEND;
+    vfs->files[slot].pos = 0;
+
+    *o_fd = c_wasiVfsFdBase + slot;
+    return __WASI_ERRNO_SUCCESS;
+}
+
+static
+__wasi_errno_t vfs_close(m3_wasi_vfs_t* vfs, u32 fd)
+{
+    if (fd == 3 || fd == 4) return __WASI_ERRNO_SUCCESS;
+
+    m3_vfs_file_t* f = vfs_file(vfs, fd);
+    if (!f) return __WASI_ERRNO_BADF;
+    f->node = c_wasiVfsNone;
+    return __WASI_ERRNO_SUCCESS;
+}
+
+// i_offset < 0 uses and advances the file position
+static
+__wasi_errno_t vfs_rw(m3_wasi_vfs_t* vfs, bool i_write, u32 fd, const m3_host_iovec_t* iovs, u32 iovs_len, i64 i_offset, size_t* o_nbytes)
+{
+    *o_nbytes = 0;
+    if (fd == 3 || fd == 4) return __WASI_ERRNO_ISDIR;
+
+    m3_vfs_file_t* f = vfs_file(vfs, fd);
+    if (!f) return __WASI_ERRNO_BADF;
+
+    m3_vfs_node_t* n = &vfs->nodes[f->node];
+    if (n->isDir) return __WASI_ERRNO_ISDIR;
+
+    u64 pos = (i_offset < 0) ? f->pos : (u64) i_offset;
+    size_t done = 0;
+
+    if (i_write) {
+        if (i_offset < 0 && (f->flags & __WASI_FDFLAGS_APPEND)) pos = n->size;
+
+        size_t total = 0;
+        for (u32 i = 0; i < iovs_len; i++) total += iovs[i].buf_len;
+
+        if (total) {
+            if (!vfs_reserve(n, pos + total)) return __WASI_ERRNO_NOSPC;
+            if (pos > n->size) memset(n->data + n->size, 0, (size_t)(pos - n->size));
+
+            for (u32 i = 0; i < iovs_len; i++) {
+                memcpy(n->data + pos + done, iovs[i].buf, iovs[i].buf_len);
+                done += iovs[i].buf_len;
+            }
+            n->size = M3_MAX(n->size, pos + total);
+            n->mtime = vfs_now();
+        }
+    } else {
+        const u8* src = n->data ? n->data : n->base;
+        for (u32 i = 0; i < iovs_len && pos + done < n->size; i++) {
+            size_t len = (size_t) M3_MIN((u64) iovs[i].buf_len, n->size - pos - done);
+            memcpy(iovs[i].buf, src + pos + done, len);
+            done += len;
+        }
+    }
+
+    if (i_offset < 0) f->pos = pos + done;
+    *o_nbytes = done;
+    return __WASI_ERRNO_SUCCESS;
+}
+
+static
+__wasi_errno_t vfs_seek(m3_wasi_vfs_t* vfs, u32 fd, i64 i_offset, int i_whence, u64* o_pos)
+{
+    if (fd == 3 || fd == 4) return __WASI_ERRNO_ISDIR;
+
+    m3_vfs_file_t* f = vfs_file(vfs, fd);
+    if (!f) return __WASI_ERRNO_BADF;
+
+    i64 origin = (i_whence == SEEK_CUR) ? (i64) f->pos :
+                 (i_whence == SEEK_END) ? (i64) vfs->nodes[f->node].size : 0;
+    if (i_offset < 0 && origin + i_offset < 0) return __WASI_ERRNO_INVAL;
+
+    f->pos = origin + i_offset;
+    *o_pos = f->pos;
+    return __WASI_ERRNO_SUCCESS;
+}
+
+static
+__wasi_errno_t vfs_fdstat(m3_wasi_vfs_t* vfs, u32 fd, __wasi_filetype_t* o_type, __wasi_fdflags_t* o_flags)
+{
+    if (fd == 3 || fd == 4) {
+        *o_type = __WASI_FILETYPE_DIRECTORY;
+        *o_flags = 0;
+        return __WASI_ERRNO_SUCCESS;
+    }
+    m3_vfs_file_t* f = vfs_file(vfs, fd);
+    if (!f) return __WASI_ERRNO_BADF;
+
+    *o_type = vfs->nodes[f->node].isDir ? __WASI_FILETYPE_DIRECTORY : __WASI_FILETYPE_REGULAR_FILE;
+    *o_flags = f->flags;
+    return __WASI_ERRNO_SUCCESS;
+}
+
+static
+__wasi_errno_t vfs_set_flags(m3_wasi_vfs_t* vfs, u32 fd, __wasi_fdflags_t flags)
+{
+    if (fd == 3 || fd == 4) return __WASI_ERRNO_SUCCESS;
+
+    m3_vfs_file_t* f = vfs_file(vfs, fd);
+    if (!f) return __WASI_ERRNO_BADF;
+    f->flags = flags & __WASI_FDFLAGS_APPEND;
+    return __WASI_ERRNO_SUCCESS;
+}
+
+static
+__wasi_errno_t vfs_stat(m3_wasi_vfs_t* vfs, u32 dirfd, const char* path, size_t len, struct stat* o_st)
+{
+    u32 node, parent;
+    const char* leaf;
+    size_t leafLen;
+    __wasi_errno_t ret = vfs_lookup(vfs, dirfd, path, len, &node, &parent, &leaf, &leafLen);
+    if (ret) return ret;
+    if (node == c_wasiVfsNone) return __WASI_ERRNO_NOENT;
+
+    m3_vfs_node_t* n = &vfs->nodes[node];
+    memset(o_st, 0, sizeof(*o_st));
+    o_st->st_ino    = node + 1;
+    o_st->st_mode   = n->isDir ? (S_IFDIR | 0755) : (S_IFREG | 0644);
+    o_st->st_nlink  = 1;
+    o_st->st_size   = (off_t) n->size;
+    o_st->st_mtim.tv_sec  = n->mtime / 1000000000;
+    o_st->st_mtim.tv_nsec = n->mtime % 1000000000;
+    o_st->st_atim   = o_st->st_mtim;
+    o_st->st_ctim   = o_st->st_mtim;
+    return __WASI_ERRNO_SUCCESS;
+}
+
+static
+__wasi_errno_t vfs_mkdir(m3_wasi_vfs_t* vfs, u32 dirfd, const char* path, size_t len)
+{
+    u32 node, parent;
+    const char* leaf;
+    size_t leafLen;
+    __wasi_errno_t ret = vfs_lookup(vfs, dirfd, path, len, &node, &parent, &leaf, &leafLen);
+    if (ret) return ret;
+    if (node != c_wasiVfsNone || !leaf) return __WASI_ERRNO_EXIST;
+
+    return (vfs_new_node(vfs, parent, leaf, leafLen, true) != c_wasiVfsNone) ? __WASI_ERRNO_SUCCESS : __WASI_ERRNO_NOMEM;
+}
+
+// removes a file (i_dir false) or an empty directory
+static
+__wasi_errno_t vfs_remove(m3_wasi_vfs_t* vfs, u32 dirfd, const char* path, size_t len, bool i_dir)
+{
+    u32 node, parent;
+    const char* leaf;
+    size_t leafLen;
+    __wasi_errno_t ret = vfs_lookup(vfs, dirfd, path, len, &node, &parent, &leaf, &leafLen);
+    if (ret) return ret;
+    if (node == c_wasiVfsNone) return __WASI_ERRNO_NOENT;
+    if (!leaf) return i_dir ? __WASI_ERRNO_BUSY : __WASI_ERRNO_ISDIR;
+
+    m3_vfs_node_t* n = &vfs->nodes[node];
+    if (i_dir) {
+        if (!n->isDir) return __WASI_ERRNO_NOTDIR;
+        if (n->child != c_wasiVfsNone) return __WASI_ERRNO_NOTEMPTY;
+    } else if (n->isDir) {
+        return __WASI_ERRNO_ISDIR;
+    }
+
+    // open fds keep the node, like an unlinked host file
+    vfs_unlink(vfs, node);
+    return __WASI_ERRNO_SUCCESS;
+}
+
+static
+__wasi_errno_t vfs_rename(m3_wasi_vfs_t* vfs, u32 oldfd, const char* oldPath, size_t oldLen, u32 newfd, const char* newPath, size_t newLen)
+{
+    u32 src, srcParent, dst, dstParent;
+    const char *srcLeaf, *dstLeaf;
+    size_t srcLeafLen, dstLeafLen;
+
+    __wasi_errno_t ret = vfs_lookup(vfs, oldfd, oldPath, oldLen, &src, &srcParent, &srcLeaf, &srcLeafLen);
+    if (ret) return ret;
+    ret = vfs_lookup(vfs, newfd, newPath, newLen, &dst, &dstParent, &dstLeaf, &dstLeafLen);
+    if (ret) return ret;
+
+    if (src == c_wasiVfsNone) return __WASI_ERRNO_NOENT;
+    if (!srcLeaf || !dstLeaf) return __WASI_ERRNO_BUSY;
+    if (src == dst) return __WASI_ERRNO_SUCCESS;
+
+    bool isDir = vfs->nodes[src].isDir;
+    if (isDir) {
+        for (u32 p = dstParent; p != c_wasiVfsNone; p = vfs->nodes[p].parent) {
+            if (p == src) return __WASI_ERRNO_INVAL;
+        }
+    }
+
+    if (dst != c_wasiVfsNone) {
+        m3_vfs_node_t* d = &vfs->nodes[dst];
+        if (isDir && !d->isDir) return __WASI_ERRNO_NOTDIR;
+        if (!isDir && d->isDir) return __WASI_ERRNO_ISDIR;
+        if (d->isDir && d->child != c_wasiVfsNone) return __WASI_ERRNO_NOTEMPTY;
+        vfs_unlink(vfs, dst);
+    }
+
+    char* name = (char*) malloc(dstLeafLen + 1);
+    if (!name) return __WASI_ERRNO_NOMEM;
+    memcpy(name, dstLeaf, dstLeafLen);
+    name[dstLeafLen] = 0;
+
+    m3_vfs_node_t* s = &vfs->nodes[src];
+    free(s->name);
+    s->name = name;
+    s->nameLen = (u32) dstLeafLen;
+
+    vfs_unlink(vfs, src);
+    vfs_link(vfs, src, dstParent);
+    return __WASI_ERRNO_SUCCESS;
+}
+
+
+/*
+ * mounting
+ */
+
+static
+void vfs_free(m3_wasi_vfs_t* vfs)
+{
+    for (u32 i = 0; i < vfs->numNodes; i++) {
+        free(vfs->nodes[i].name);
+        free(vfs->nodes[i].data);
+    }
+    free(vfs->nodes);
+    free(vfs->files);
+    if (vfs->image) munmap(vfs->image, vfs->imageSize);
+    free(vfs);
+}
+
+static
+M3Result vfs_mount(m3_wasi_vfs_t** o_vfs, const char* i_imagePath)
+{
+    M3Result result = m3Err_none;
+
+    m3_wasi_vfs_t* vfs = (m3_wasi_vfs_t*) calloc(1, sizeof(m3_wasi_vfs_t));
+    if (!vfs) return m3Err_mallocFailed;
+
+    int fd = open(i_imagePath, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        vfs_free(vfs);
+        return "cannot open WASI image";
+    }
+    if (st.st_size > 0) {
+        vfs->image = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (vfs->image == MAP_FAILED) vfs->image = NULL;
+        else vfs->imageSize = (size_t) st.st_size;
+    }
+    close(fd);
+    if (st.st_size > 0 && !vfs->image) {
+        vfs_free(vfs);
+        return "cannot map WASI image";
+    }
+
+    if (vfs_new_node(vfs, c_wasiVfsNone, "", 0, true) == c_wasiVfsNone) {
+        vfs_free(vfs);
+        return m3Err_mallocFailed;
+    }
+
+    result = vfs_load_tar(vfs);
+    if (result) {
+        vfs_free(vfs);
+        return result;
+    }
+
+    *o_vfs = vfs;
+    return m3Err_none;
+}
+
+#endif // m3_api_wasi_vfs_h
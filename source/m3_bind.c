@@ -8,6 +8,8 @@
 #include "m3_env.h"
 #include "m3_exception.h"
 #include "m3_info.h"
+#include "m3_compile.h"
+#include "m3_bind.h"
 
 
 u8  ConvertTypeCharToTypeId (char i_code)
@@ -45,7 +47,7 @@ _try {
 
     _throwif (m3Err_tooManyArgsRets, maxNumTypes > d_m3MaxSaneFunctionArgRetCount);
 
-_   (AllocFuncType (& funcType, (u32) maxNumTypes));
+_   (AllocFuncType (& funcType, (u32) maxNumTypes, NULL));
 
     u8 * typelist = funcType->types;
 
@@ -109,7 +111,7 @@ _   (SignatureToFuncType (& ftype, i_linkingSignature));
         m3log (module, "expected: %s", SPrintFuncTypeSignature (ftype));
         m3log (module, "   found: %s", SPrintFuncTypeSignature (i_function->funcType));
 
-        _throw ("function signature mismatch");
+        _throw (m3Err_functionSignatureMismatch);
     }
 
     _catch:
@@ -120,32 +122,185 @@ _   (SignatureToFuncType (& ftype, i_linkingSignature));
 }
 
 
+//-------------------------------------------------------------------------------------------------------------------------------
+//  typed import thunks: one per (result, args...) combination, indexed by GetTypedThunk
+//-------------------------------------------------------------------------------------------------------------------------------
+
+#define d_m3ThunkRets_none          0
+#define d_m3ThunkRets_i32           1
+#define d_m3ThunkRets_i64           1
+#define d_m3ThunkRets_f32           1
+#define d_m3ThunkRets_f64           1
+
+#define d_m3ThunkArg(R, T, I)       * (T *) (io_sp + d_m3ThunkRets_##R + I)
+
+#define d_m3ThunkCall_none(PARAMS, ARGS)    ((void (*) PARAMS) i_function) ARGS;
+#define d_m3ThunkCall_i32(PARAMS, ARGS)     * (i32 *) io_sp = ((i32 (*) PARAMS) i_function) ARGS;
+#define d_m3ThunkCall_i64(PARAMS, ARGS)     * (i64 *) io_sp = ((i64 (*) PARAMS) i_function) ARGS;
+#define d_m3ThunkCall_f32(PARAMS, ARGS)     * (f32 *) io_sp = ((f32 (*) PARAMS) i_function) ARGS;
+#define d_m3ThunkCall_f64(PARAMS, ARGS)     * (f64 *) io_sp = ((f64 (*) PARAMS) i_function) ARGS;
+
+#define d_m3Thunk0(R)               static void Thunk_##R (u64 * io_sp, const void * i_function) \
+                                    { d_m3ThunkCall_##R ((void), ()) }
+#define d_m3Thunk1(R, A)            static void Thunk_##R##_##A (u64 * io_sp, const void * i_function) \
+                                    { d_m3ThunkCall_##R ((A), (d_m3ThunkArg (R, A, 0))) }
+#define d_m3Thunk2(R, A, B)         static void Thunk_##R##_##A##_##B (u64 * io_sp, const void * i_function) \
+                                    { d_m3ThunkCall_##R ((A, B), (d_m3ThunkArg (R, A, 0), d_m3ThunkArg (R, B, 1))) }
+#define d_m3Thunk3(R, A, B, C)      static void Thunk_##R##_##A##_##B##_##C (u64 * io_sp, const void * i_function) \
+                                    { d_m3ThunkCall_##R ((A, B, C), (d_m3ThunkArg (R, A, 0), d_m3ThunkArg (R, B, 1), d_m3ThunkArg (R, C, 2))) }
+#define d_m3Thunk4(R, A, B, C, D)   static void Thunk_##R##_##A##_##B##_##C##_##D (u64 * io_sp, const void * i_function) \
+                                    { d_m3ThunkCall_##R ((A, B, C, D), (d_m3ThunkArg (R, A, 0), d_m3ThunkArg (R, B, 1), d_m3ThunkArg (R, C, 2), d_m3ThunkArg (R, D, 3))) }
+#define d_m3Thunk5(R, A, B, C, D, E) \
+                                    static void Thunk_##R##_##A##_##B##_##C##_##D##_##E (u64 * io_sp, const void * i_function) \
+                                    { d_m3ThunkCall_##R ((A, B, C, D, E), (d_m3ThunkArg (R, A, 0), d_m3ThunkArg (R, B, 1), d_m3ThunkArg (R, C, 2), d_m3ThunkArg (R, D, 3), \
+                                                                           d_m3ThunkArg (R, E, 4))) }
+#define d_m3Thunk6(R, A, B, C, D, E, F) \
+                                    static void Thunk_##R##_##A##_##B##_##C##_##D##_##E##_##F (u64 * io_sp, const void * i_function) \
+                                    { d_m3ThunkCall_##R ((A, B, C, D, E, F), (d_m3ThunkArg (R, A, 0), d_m3ThunkArg (R, B, 1), d_m3ThunkArg (R, C, 2), d_m3ThunkArg (R, D, 3), \
+                                                                              d_m3ThunkArg (R, E, 4), d_m3ThunkArg (R, F, 5))) }
+
+#define d_m3ThunkEntry0(R)          Thunk_##R,
+#define d_m3ThunkEntry1(R, A)       Thunk_##R##_##A,
+#define d_m3ThunkEntry2(R, A, B)    Thunk_##R##_##A##_##B,
+#define d_m3ThunkEntry3(R, A, B, C) Thunk_##R##_##A##_##B##_##C,
+#define d_m3ThunkEntry4(R, A, B, C, D)          Thunk_##R##_##A##_##B##_##C##_##D,
+#define d_m3ThunkEntry5(R, A, B, C, D, E)       Thunk_##R##_##A##_##B##_##C##_##D##_##E,
+#define d_m3ThunkEntry6(R, A, B, C, D, E, F)    Thunk_##R##_##A##_##B##_##C##_##D##_##E##_##F,
+
+// expand M over every argument type combination, in c_m3Type order
+#define d_m3ThunkArgs0(M, R)                M (R)
+#define d_m3ThunkArgs1(M, R)                M (R, i32) M (R, i64) M (R, f32) M (R, f64)
+#define d_m3ThunkArgs2_(M, R, A)            M (R, A, i32) M (R, A, i64) M (R, A, f32) M (R, A, f64)
+#define d_m3ThunkArgs2(M, R)                d_m3ThunkArgs2_ (M, R, i32) d_m3ThunkArgs2_ (M, R, i64) d_m3ThunkArgs2_ (M, R, f32) d_m3ThunkArgs2_ (M, R, f64)
+#define d_m3ThunkArgs3__(M, R, A, B)        M (R, A, B, i32) M (R, A, B, i64) M (R, A, B, f32) M (R, A, B, f64)
+#define d_m3ThunkArgs3_(M, R, A)            d_m3ThunkArgs3__ (M, R, A, i32) d_m3ThunkArgs3__ (M, R, A, i64) d_m3ThunkArgs3__ (M, R, A, f32) d_m3ThunkArgs3__ (M, R, A, f64)
+#define d_m3ThunkArgs3(M, R)                d_m3ThunkArgs3_ (M, R, i32) d_m3ThunkArgs3_ (M, R, i64) d_m3ThunkArgs3_ (M, R, f32) d_m3ThunkArgs3_ (M, R, f64)
+
+
+// wider thunks only take integer arguments (pointers, lengths, handles): 4^N thunks per result type would be too much code
+#define d_m3ThunkIntArgs4___(M, R, A, B, C)             M (R, A, B, C, i32) M (R, A, B, C, i64)
+#define d_m3ThunkIntArgs4__(M, R, A, B)                 d_m3ThunkIntArgs4___ (M, R, A, B, i32) d_m3ThunkIntArgs4___ (M, R, A, B, i64)
+#define d_m3ThunkIntArgs4_(M, R, A)                     d_m3ThunkIntArgs4__ (M, R, A, i32) d_m3ThunkIntArgs4__ (M, R, A, i64)
+#define d_m3ThunkIntArgs4(M, R)                         d_m3ThunkIntArgs4_ (M, R, i32) d_m3ThunkIntArgs4_ (M, R, i64)
+#define d_m3ThunkIntArgs5____(M, R, A, B, C, D)         M (R, A, B, C, D, i32) M (R, A, B, C, D, i64)
+#define d_m3ThunkIntArgs5___(M, R, A, B, C)             d_m3ThunkIntArgs5____ (M, R, A, B, C, i32) d_m3ThunkIntArgs5____ (M, R, A, B, C, i64)
+#define d_m3ThunkIntArgs5__(M, R, A, B)                 d_m3ThunkIntArgs5___ (M, R, A, B, i32) d_m3ThunkIntArgs5___ (M, R, A, B, i64)
+#define d_m3ThunkIntArgs5_(M, R, A)                     d_m3ThunkIntArgs5__ (M, R, A, i32) d_m3ThunkIntArgs5__ (M, R, A, i64)
+#define d_m3ThunkIntArgs5(M, R)                         d_m3ThunkIntArgs5_ (M, R, i32) d_m3ThunkIntArgs5_ (M, R, i64)
+#define d_m3ThunkIntArgs6_____(M, R, A, B, C, D, E)     M (R, A, B, C, D, E, i32) M (R, A, B, C, D, E, i64)
+#define d_m3ThunkIntArgs6____(M, R, A, B, C, D)         d_m3ThunkIntArgs6_____ (M, R, A, B, C, D, i32) d_m3ThunkIntArgs6_____ (M, R, A, B, C, D, i64)
+#define d_m3ThunkIntArgs6___(M, R, A, B, C)             d_m3ThunkIntArgs6____ (M, R, A, B, C, i32) d_m3ThunkIntArgs6____ (M, R, A, B, C, i64)
+#define d_m3ThunkIntArgs6__(M, R, A, B)                 d_m3ThunkIntArgs6___ (M, R, A, B, i32) d_m3ThunkIntArgs6___ (M, R, A, B, i64)
+#define d_m3ThunkIntArgs6_(M, R, A)                     d_m3ThunkIntArgs6__ (M, R, A, i32) d_m3ThunkIntArgs6__ (M, R, A, i64)
+#define d_m3ThunkIntArgs6(M, R)                         d_m3ThunkIntArgs6_ (M, R, i32) d_m3ThunkIntArgs6_ (M, R, i64)
+
+#define d_m3ThunkRets(ARGS, M)              ARGS (M, none) ARGS (M, i32) ARGS (M, i64) ARGS (M, f32) ARGS (M, f64)
+
+d_m3ThunkRets (d_m3ThunkArgs0, d_m3Thunk0)
+d_m3ThunkRets (d_m3ThunkArgs1, d_m3Thunk1)
+d_m3ThunkRets (d_m3ThunkArgs2, d_m3Thunk2)
+
+static const M3TypedThunk c_typedThunks0 [] = { d_m3ThunkRets (d_m3ThunkArgs0, d_m3ThunkEntry0) };
+static const M3TypedThunk c_typedThunks1 [] = { d_m3ThunkRets (d_m3ThunkArgs1, d_m3ThunkEntry1) };
+static const M3TypedThunk c_typedThunks2 [] = { d_m3ThunkRets (d_m3ThunkArgs2, d_m3ThunkEntry2) };
+
+#if d_m3MaxTypedImportArgs >= 3
+d_m3ThunkRets (d_m3ThunkArgs3, d_m3Thunk3)
+
+static const M3TypedThunk c_typedThunks3 [] = { d_m3ThunkRets (d_m3ThunkArgs3, d_m3ThunkEntry3) };
+#endif
+
+#if d_m3MaxTypedImportArgs >= 4
+d_m3ThunkRets (d_m3ThunkIntArgs4, d_m3Thunk4)
+
+static const M3TypedThunk c_typedThunks4 [] = { d_m3ThunkRets (d_m3ThunkIntArgs4, d_m3ThunkEntry4) };
+#endif
+
+#if d_m3MaxTypedImportArgs >= 5
+d_m3ThunkRets (d_m3ThunkIntArgs5, d_m3Thunk5)
+
+static const M3TypedThunk c_typedThunks5 [] = { d_m3ThunkRets (d_m3ThunkIntArgs5, d_m3ThunkEntry5) };
+#endif
+
+#if d_m3MaxTypedImportArgs >= 6
+d_m3ThunkRets (d_m3ThunkIntArgs6, d_m3Thunk6)
+
+static const M3TypedThunk c_typedThunks6 [] = { d_m3ThunkRets (d_m3ThunkIntArgs6, d_m3ThunkEntry6) };
+#endif
+
+#define d_m3MaxAnyTypedImportArgs       3       // beyond this, thunks exist for i32 & i64 arguments only
+
+
+static
+M3Result  GetTypedThunk  (M3TypedThunk * o_thunk, IM3FuncType i_type)
+{
+    static const M3TypedThunk * const tables [] = { c_typedThunks0, c_typedThunks1, c_typedThunks2,
+#if d_m3MaxTypedImportArgs >= 3
+                                                    c_typedThunks3,
+#endif
+#if d_m3MaxTypedImportArgs >= 4
+                                                    c_typedThunks4,
+#endif
+#if d_m3MaxTypedImportArgs >= 5
+                                                    c_typedThunks5,
+#endif
+#if d_m3MaxTypedImportArgs >= 6
+                                                    c_typedThunks6,
+#endif
+    };
+
+    if (i_type->numRets > 1 or i_type->numArgs >= M3_COUNT_OF (tables))
+        return m3Err_typedImportUnsupported;
+
+    u32 index = i_type->numRets ? d_FuncRetType (i_type, 0) : c_m3Type_none;
+    u32 numArgTypes = (i_type->numArgs > d_m3MaxAnyTypedImportArgs) ? 2 : 4;
+
+    for (u32 i = 0; i < i_type->numArgs; ++i)
+    {
+        u8 type = d_FuncArgType (i_type, i);
+        if (type < c_m3Type_i32 or type >= c_m3Type_i32 + numArgTypes)
+            return m3Err_typedImportUnsupported;
+
+        index = index * numArgTypes + (type - c_m3Type_i32);
+    }
+
+    * o_thunk = tables [i_type->numArgs] [index];
+
+    return m3Err_none;
+}
+
+
 M3Result  FindAndLinkFunction      (IM3Module       io_module,
                                     ccstr_t         i_moduleName,
                                     ccstr_t         i_functionName,
                                     ccstr_t         i_signature,
                                     voidptr_t       i_function,
-                                    voidptr_t       i_userdata)
+                                    voidptr_t       i_userdata,
+                                    M3TypedThunk    i_thunk)
 {
 _try {
     _throwif(m3Err_moduleNotLinked, !io_module->runtime);
 
+_   (Module_IndexSymbols (io_module));
+
     const bool wildcardModule = (strcmp (i_moduleName, "*") == 0);
 
     result = m3Err_functionLookupFailed;
 
-    for (u32 i = 0; i < io_module->numFunctions; ++i)
+    M3Symbol * symbol = NULL;
+    while ((symbol = Module_FindSymbol (io_module, c_m3Symbol_functionImport, i_functionName, symbol)))
     {
-        const IM3Function f = & io_module->functions [i];
+        const IM3Function f = & io_module->functions [symbol->index];
 
-        if (f->import.moduleUtf8 and f->import.fieldUtf8)
+        if (wildcardModule or strcmp (f->import.moduleUtf8, i_moduleName) == 0)
         {
-            if (strcmp (f->import.fieldUtf8, i_functionName) == 0 and
-               (wildcardModule or strcmp (f->import.moduleUtf8, i_moduleName) == 0))
-            {
-                if (i_signature) {
-_                   (ValidateSignature (f, i_signature));
-                }
+            if (i_signature) {
+_               (ValidateSignature (f, i_signature));
+            }
+            if (i_thunk) {
+_               (CompileTypedFunction (io_module, f, i_thunk, i_function));
+            }
+            else {
 _               (CompileRawFunction (io_module, f, i_function, i_userdata));
             }
         }
@@ -161,7 +316,7 @@ M3Result  m3_LinkRawFunctionEx  (IM3Module            io_module,
                                 M3RawCall             i_function,
                                 const void *          i_userdata)
 {
-    return FindAndLinkFunction (io_module, i_moduleName, i_functionName, i_signature, (voidptr_t)i_function, i_userdata);
+    return FindAndLinkFunction (io_module, i_moduleName, i_functionName, i_signature, (voidptr_t)i_function, i_userdata, NULL);
 }
 
 M3Result  m3_LinkRawFunction  (IM3Module            io_module,
@@ -170,6 +325,331 @@ M3Result  m3_LinkRawFunction  (IM3Module            io_module,
                               const char * const    i_signature,
                               M3RawCall             i_function)
 {
-    return FindAndLinkFunction (io_module, i_moduleName, i_functionName, i_signature, (voidptr_t)i_function, NULL);
+    return FindAndLinkFunction (io_module, i_moduleName, i_functionName, i_signature, (voidptr_t)i_function, NULL, NULL);
+}
+
+M3Result  m3_LinkTypedFunction  (IM3Module              io_module,
+                                const char * const      i_moduleName,
+                                const char * const      i_functionName,
+                                const char * const      i_signature,
+                                M3TypedCall             i_function)
+{
+    M3Result result = m3Err_none;
+    IM3FuncType ftype = NULL;
+    M3TypedThunk thunk = NULL;
+
+    _throwif (m3Err_malformedFunctionSignature, not i_signature);
+
+_   (SignatureToFuncType (& ftype, i_signature));
+_   (GetTypedThunk (& thunk, ftype));
+_   (FindAndLinkFunction (io_module, i_moduleName, i_functionName, i_signature, (voidptr_t) i_function, NULL, thunk));
+
+    _catch:
+    m3_Free (ftype);
+
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------------------------------------
+//  import registry
+//-------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct M3ImportEntry
+{
+    cstr_t                  moduleName;
+    cstr_t                  functionName;
+    IM3FuncType             funcType;       // NULL: any signature
+
+    voidptr_t               function;
+    voidptr_t               userdata;
+    M3TypedThunk            thunk;          // NULL: raw function
+
+    u32                     hash;
+}
+M3ImportEntry;
+
+typedef struct M3ImportRegistry
+{
+    M3ImportEntry *         entries;        // open-addressed; moduleName == NULL marks an empty slot
+    u32                     numEntries;
+    u32                     mask;
+}
+M3ImportRegistry;
+
+
+static
+u32  HashImportName  (cstr_t i_moduleName, cstr_t i_functionName)
+{
+    u32 hash = 2166136261u;     // FNV-1a of "module!field"
+
+    while (* i_moduleName)
+    {
+        hash ^= (u8) * i_moduleName++;
+        hash *= 16777619u;
+    }
+
+    hash ^= '!';
+    hash *= 16777619u;
+
+    while (* i_functionName)
+    {
+        hash ^= (u8) * i_functionName++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+
+static
+M3ImportEntry *  Registry_Find  (IM3ImportRegistry i_registry, cstr_t i_moduleName, cstr_t i_functionName, u32 i_hash)
+{
+    if (not i_registry->entries)
+        return NULL;
+
+    u32 slot = i_hash;
+
+    for (;;)
+    {
+        M3ImportEntry * entry = & i_registry->entries [slot & i_registry->mask];
+
+        if (not entry->moduleName)
+            return entry;
+
+        if (entry->hash == i_hash and strcmp (entry->functionName, i_functionName) == 0 and strcmp (entry->moduleName, i_moduleName) == 0)
+            return entry;
+
+        ++slot;
+    }
+}
+
+
+static
+M3Result  Registry_Grow  (IM3ImportRegistry io_registry)
+{
+    M3Result result = m3Err_none;
+
+    u32 capacity = io_registry->entries ? (io_registry->mask + 1) * 2 : 64;
+    M3ImportEntry * entries = io_registry->entries;
+    u32 oldCapacity = entries ? io_registry->mask + 1 : 0;
+
+    io_registry->entries = m3_AllocArray (M3ImportEntry, capacity);
+    _throwifnull (io_registry->entries);
+    io_registry->mask = capacity - 1;
+
+    for (u32 i = 0; i < oldCapacity; ++i)
+    {
+        if (entries [i].moduleName)
+            * Registry_Find (io_registry, entries [i].moduleName, entries [i].functionName, entries [i].hash) = entries [i];
+    }
+
+    _catch:
+    if (result)
+        io_registry->entries = entries;
+    else
+        m3_Free (entries);
+
+    return result;
+}
+
+
+static
+M3Result  Registry_Add  (IM3ImportRegistry io_registry, cstr_t i_moduleName, cstr_t i_functionName,
+                         voidptr_t i_function, voidptr_t i_userdata, M3TypedThunk i_thunk, IM3FuncType i_funcType)
+{
+_try {
+    _throwif (m3Err_functionLookupFailed, not i_moduleName or not i_functionName);
+
+    // keep the load factor at or below 1/2
+    if ((io_registry->numEntries + 1) * 2 > io_registry->mask + 1 or not io_registry->entries)
+    {
+_       (Registry_Grow (io_registry));
+    }
+
+    u32 hash = HashImportName (i_moduleName, i_functionName);
+    M3ImportEntry * entry = Registry_Find (io_registry, i_moduleName, i_functionName, hash);
+
+    if (entry->moduleName)
+    {
+        m3_Free (entry->funcType);
+    }
+    else
+    {
+        size_t moduleLength = strlen (i_moduleName) + 1;
+        size_t functionLength = strlen (i_functionName) + 1;
+
+        char * names = m3_AllocArray (char, moduleLength + functionLength);
+        _throwifnull (names);
+        memcpy (names, i_moduleName, moduleLength);
+        memcpy (names + moduleLength, i_functionName, functionLength);
+
+        entry->moduleName = names;
+        entry->functionName = names + moduleLength;
+        entry->hash = hash;
+        io_registry->numEntries++;
+    }
+
+    entry->funcType = i_funcType;
+    entry->function = i_function;
+    entry->userdata = i_userdata;
+    entry->thunk = i_thunk;
+
+} _catch:
+    return result;
+}
+
+
+IM3ImportRegistry  m3_NewImportRegistry  (void)
+{
+    return m3_AllocStruct (M3ImportRegistry);
+}
+
+
+void  m3_FreeImportRegistry  (IM3ImportRegistry i_registry)
+{
+    if (i_registry)
+    {
+        for (u32 i = 0; i <= i_registry->mask and i_registry->entries; ++i)
+        {
+            M3ImportEntry * entry = & i_registry->entries [i];
+
+            m3_Free (entry->moduleName);        // functionName shares this block
+            m3_Free (entry->funcType);
+        }
+
+        m3_Free (i_registry->entries);
+        m3_Free (i_registry);
+    }
+}
+
+
+M3Result  m3_RegisterRawFunction  (IM3ImportRegistry      io_registry,
+                                  const char * const      i_moduleName,
+                                  const char * const      i_functionName,
+                                  const char * const      i_signature,
+                                  M3RawCall               i_function,
+                                  const void *            i_userdata)
+{
+    M3Result result = m3Err_none;
+    IM3FuncType ftype = NULL;
+
+    if (i_signature)
+    {
+_       (SignatureToFuncType (& ftype, i_signature));
+    }
+
+_   (Registry_Add (io_registry, i_moduleName, i_functionName, (voidptr_t) i_function, i_userdata, NULL, ftype));
+    ftype = NULL;
+
+    _catch:
+    m3_Free (ftype);
+
+    return result;
+}
+
+
+M3Result  m3_RegisterTypedFunction  (IM3ImportRegistry    io_registry,
+                                    const char * const    i_moduleName,
+                                    const char * const    i_functionName,
+                                    const char * const    i_signature,
+                                    M3TypedCall           i_function)
+{
+    M3Result result = m3Err_none;
+    IM3FuncType ftype = NULL;
+    M3TypedThunk thunk = NULL;
+
+    _throwif (m3Err_malformedFunctionSignature, not i_signature);
+
+_   (SignatureToFuncType (& ftype, i_signature));
+_   (GetTypedThunk (& thunk, ftype));
+_   (Registry_Add (io_registry, i_moduleName, i_functionName, (voidptr_t) i_function, NULL, thunk, ftype));
+    ftype = NULL;
+
+    _catch:
+    m3_Free (ftype);
+
+    return result;
+}
+
+
+M3Result  m3_LinkImportRegistry  (IM3Module                   io_module,
+                                 IM3ImportRegistry           i_registry,
+                                 M3UnresolvedImportHandler   i_unresolved,
+                                 void *                      i_userdata)
+{
+_try {
+    _throwif (m3Err_moduleNotLinked, not io_module->runtime);
+
+    for (u32 i = 0; i < io_module->numFunctions; ++i)
+    {
+        IM3Function f = & io_module->functions [i];
+        cstr_t moduleName = f->import.moduleUtf8;
+        cstr_t functionName = f->import.fieldUtf8;
+
+        if (not moduleName or not functionName)
+            continue;
+
+        M3ImportEntry * entry = Registry_Find (i_registry, moduleName, functionName, HashImportName (moduleName, functionName));
+
+        if (not entry or not entry->moduleName)
+            entry = Registry_Find (i_registry, "*", functionName, HashImportName ("*", functionName));
+
+        if (entry and entry->moduleName)
+        {
+            if (entry->funcType and not AreFuncTypesEqual (entry->funcType, f->funcType))
+            {
+                m3log (module, "expected: %s", SPrintFuncTypeSignature (entry->funcType));
+                m3log (module, "   found: %s", SPrintFuncTypeSignature (f->funcType));
+
+                _throw (ErrorModule (m3Err_functionSignatureMismatch, io_module, "'%s!%s'", moduleName, functionName));
+            }
+
+            if (entry->thunk) {
+_               (CompileTypedFunction (io_module, f, entry->thunk, entry->function));
+            }
+            else {
+_               (CompileRawFunction (io_module, f, entry->function, entry->userdata));
+            }
+        }
+        else if (i_unresolved and not f->compiled)
+        {
+            i_unresolved (i_userdata, moduleName, functionName);
+        }
+    }
+
+} _catch:
+    return result;
 }
 
+
+M3Result  LinkRegisteredImports  (IM3Module io_module, IM3ImportRegistry * io_registry, M3RegisterImports i_register)
+{
+    M3Result result = m3Err_none;
+
+    IM3ImportRegistry registry = (IM3ImportRegistry) m3_AtomicLoadPtr (io_registry);
+
+    if (not registry)
+    {
+        // threads linking concurrently may each build one; the first to publish wins, the others free theirs
+        registry = m3_NewImportRegistry ();
+        _throwifnull (registry);
+
+        result = i_register (registry);
+        if (result)
+        {
+            m3_FreeImportRegistry (registry);
+            _throw (result);
+        }
+
+        if (not m3_AtomicCasPtr (io_registry, NULL, registry))
+        {
+            m3_FreeImportRegistry (registry);
+            registry = (IM3ImportRegistry) m3_AtomicLoadPtr (io_registry);
+        }
+    }
+
+_   (m3_LinkImportRegistry (io_module, registry, NULL, NULL));
+
+    _catch: return result;
+}
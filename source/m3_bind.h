@@ -15,6 +15,11 @@ d_m3BeginExternC
 u8          ConvertTypeCharToTypeId     (char i_code);
 M3Result    SignatureToFuncType         (IM3FuncType * o_functionType, ccstr_t i_signature);
 
+typedef M3Result (* M3RegisterImports) (IM3ImportRegistry io_registry);
+
+// builds * io_registry with i_register on first use, then links io_module against it
+M3Result    LinkRegisteredImports       (IM3Module io_module, IM3ImportRegistry * io_registry, M3RegisterImports i_register);
+
 d_m3EndExternC
 
 #endif /* m3_bind_h */
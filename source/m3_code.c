@@ -33,7 +33,9 @@ IM3CodePage  NewCodePage  (IM3Runtime i_runtime, u32 i_minNumLines)
         return NULL;
     }
 
-    page = (IM3CodePage)m3_Malloc ("M3CodePage", pageSize);
+    IM3Allocator allocator = & i_runtime->environment->allocator;
+
+    page = (IM3CodePage)m3_AllocatorMalloc (allocator, pageSize);
 
     if (page)
     {
@@ -42,7 +44,7 @@ IM3CodePage  NewCodePage  (IM3Runtime i_runtime, u32 i_minNumLines)
 
 #if d_m3RecordBacktraces
         u32 pageSizeBt = sizeof (M3CodeMappingPage) + sizeof (M3CodeMapEntry) * page->info.numLines;
-        page->info.mapping = (M3CodeMappingPage *)m3_Malloc ("M3CodeMappingPage", pageSizeBt);
+        page->info.mapping = (M3CodeMappingPage *)m3_AllocatorMalloc (allocator, pageSizeBt);
 
         if (page->info.mapping)
         {
@@ -51,7 +53,7 @@ IM3CodePage  NewCodePage  (IM3Runtime i_runtime, u32 i_minNumLines)
         }
         else
         {
-            m3_Free (page);
+            m3_AllocatorFree (allocator, page);
             return NULL;
         }
         page->info.mapping->basePC = GetPageStartPC(page);
@@ -64,7 +66,7 @@ IM3CodePage  NewCodePage  (IM3Runtime i_runtime, u32 i_minNumLines)
 }
 
 
-void  FreeCodePages  (IM3CodePage * io_list)
+void  FreeCodePages  (IM3CodePage * io_list, IM3Allocator i_allocator)
 {
     IM3CodePage page = * io_list;
 
@@ -74,9 +76,9 @@ void  FreeCodePages  (IM3CodePage * io_list)
 
         IM3CodePage next = page->info.next;
 #if d_m3RecordBacktraces
-        m3_Free (page->info.mapping);
+        m3_AllocatorFree (i_allocator, page->info.mapping);
 #endif // d_m3RecordBacktraces
-        m3_Free (page);
+        m3_AllocatorFree (i_allocator, page);
         page = next;
     }
 
@@ -24,7 +24,7 @@ typedef M3CodePage *    IM3CodePage;
 
 IM3CodePage             NewCodePage             (IM3Runtime i_runtime, u32 i_minNumLines);
 
-void                    FreeCodePages           (IM3CodePage * io_list);
+void                    FreeCodePages           (IM3CodePage * io_list, IM3Allocator i_allocator);
 
 u32                     NumFreeLines            (IM3CodePage i_page);
 pc_t                    GetPageStartPC          (IM3CodePage i_page);
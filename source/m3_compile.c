@@ -14,7 +14,7 @@
 #include "m3_exception.h"
 #include "m3_info.h"
 
-#if d_m3EnableLocalRegCaching && M3_HAS_TAIL_CALL && M3_COMPILER_HAS_ATTRIBUTE(musttail)
+#if d_m3EnableLocalRegCaching && M3_HAS_TAIL_CALL && M3_COMPILER_HAS_ATTRIBUTE(musttail) && !d_m3EnableFuelMetering && !d_m3EnableInterrupts
     // When local-regcache is enabled, prefer direct branches to loop headers instead of
     // op_ContinueLoop returns. This keeps cached locals in argument registers across loop
     // backedges (and avoids per-iteration reloads).
@@ -79,7 +79,7 @@ M3Result  EmitOp  (IM3Compilation o, IM3Operation i_operation)
         if (not result)
         {                                                           if (d_m3LogEmit) log_emit (o, i_operation);
 # if d_m3RecordBacktraces
-            EmitMappingEntry (o->page, o->lastOpcodeStart - o->module->wasmStart);
+            EmitMappingEntry (o->page, o->module->wasmStartOffset + (u32) (o->lastOpcodeStart - o->module->wasmStart));
 # endif // d_m3RecordBacktraces
             EmitWord (o->page, i_operation);
         }
@@ -114,7 +114,7 @@ void  EmitSlotOffset  (IM3Compilation o, const i32 i_offset)
                 if (o->numSlotOffsetPatches >= o->capSlotOffsetPatches)
                 {
                     u32 newCap = o->capSlotOffsetPatches ? (o->capSlotOffsetPatches * 2u) : 128u;
-                    M3SlotOffsetPatch * newPatches = m3_ReallocArray (M3SlotOffsetPatch, o->slotOffsetPatches, newCap, o->capSlotOffsetPatches);
+                    M3SlotOffsetPatch * newPatches = m3_AllocatorReallocArray (& o->module->environment->allocator, M3SlotOffsetPatch, o->slotOffsetPatches, newCap, o->capSlotOffsetPatches);
 
                     // Best-effort: if allocation fails, stop recording patches for this function.
                     if (newPatches)
@@ -558,24 +558,25 @@ _   (PreserveRegisterIfOccupied (o, c_m3Type_i64));
     _catch: return result;
 }
 
+// preserves any register not holding one of the top i_numTopValues stack values
 static
-M3Result  PreserveNonTopRegisters  (IM3Compilation o)
+M3Result  PreserveRegistersBelowTop  (IM3Compilation o, u16 i_numTopValues)
 {
     M3Result result = m3Err_none;
 
-    i16 stackTop = GetStackTopIndex (o);
+    i32 keepIndex = (i32) o->stackIndex - i_numTopValues;
 
-    if (stackTop >= 0)
+    if (keepIndex > 0)
     {
         if (IsRegisterAllocated (o, 0))     // r0
         {
-            if (GetRegisterStackIndex (o, 0) != stackTop)
+            if (GetRegisterStackIndex (o, 0) < keepIndex)
 _               (PreserveRegisterIfOccupied (o, c_m3Type_i64));
         }
 
         if (IsRegisterAllocated (o, 1))     // fp0
         {
-            if (GetRegisterStackIndex (o, 1) != stackTop)
+            if (GetRegisterStackIndex (o, 1) < keepIndex)
 _               (PreserveRegisterIfOccupied (o, c_m3Type_f64));
         }
     }
@@ -583,6 +584,12 @@ _               (PreserveRegisterIfOccupied (o, c_m3Type_f64));
     _catch: return result;
 }
 
+static inline
+M3Result  PreserveNonTopRegisters  (IM3Compilation o)
+{
+    return PreserveRegistersBelowTop (o, 1);
+}
+
 
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -1128,8 +1135,8 @@ M3Result  ResolveBlockResults  (IM3Compilation o, IM3CompilationScope i_targetBl
         u16 endIndex = GetStackTopIndex (o) + 1;
         u16 numRemValues = numValues;
 
-        // The last result is taken from _fp0. See PushBlockResults.
-        if (not isLoop and IsFpType (GetStackTopType (o)))
+        // The last result is taken from _r0 or _fp0. See PushBlockResults.
+        if (not isLoop)
         {
 _           (CopyStackTopToRegister (o, false));
             --endIndex;
@@ -1564,6 +1571,10 @@ _               (EmitOp (o, op_ContinueLoop));
         {
             if (targetHasResults or isReturn)
             {
+                // resolving the results below must not move registers the fall-through path still uses
+                if (not isReturn)
+_                   (PreserveRegistersBelowTop (o, 2));
+
                 IM3Operation op = IsStackTopInRegister (o) ? op_BranchIfPrologue_r : op_BranchIfPrologue_s;
 
     _           (EmitOp (o, op));
@@ -1621,6 +1632,9 @@ _   (PreserveRegisterIfOccupied (o, c_m3Type_i64));         // move branch opera
     u16 slot = GetStackTopSlotNumber (o);
 _   (Pop (o));
 
+    // each target resolves its results from the same stack state
+_   (PreserveNonTopRegisters (o));
+
     // OPTZ: according to spec: "forward branches that target a control instruction with a non-empty
     // result type consume matching operands first and push them back on the operand stack after unwinding"
     // So, this move-to-reg is only necessary if the target scopes have a type.
@@ -1699,6 +1713,18 @@ _   (SetStackPolymorphic (o));
     _catch: return result;
 }
 
+static
+M3Result  ValidateTailCallResults  (IM3Compilation o, IM3FuncType i_type)
+{
+    IM3FuncType callerType = o->function->funcType;
+
+    // the callee's results become the caller's results
+    if (callerType->numRets != i_type->numRets or memcmp (callerType->types, i_type->types, i_type->numRets))
+        return m3Err_typeMismatch;
+
+    return m3Err_none;
+}
+
 static
 M3Result  CompileCallArgsAndReturn  (IM3Compilation o, u16 * o_stackOffset, IM3FuncType i_type, bool i_isIndirect)
 {
@@ -1757,33 +1783,53 @@ _   (ReadLEB_u32 (& functionIndex, & o->wasm, o->wasmEnd));
     if (function)
     {                                                                   m3log (compile, d_indent " (func= [%d] '%s'; args= %d)",
                                                                                 get_indention_string (o), functionIndex, m3_GetFunctionName (function), function->funcType->numArgs);
-        if (function->module)
+        // while streaming, later bodies haven't arrived and imports aren't linked yet; op_Compile resolves them on first call
+        if (function->module or o->module->streamRuntime == o->runtime)
         {
+            bool isTailCall = (i_opcode == c_waOp_returnCall);
+
+            if (isTailCall)
+_               (ValidateTailCallResults (o, function->funcType));
+
             u16 slotTop;
 _           (CompileCallArgsAndReturn (o, & slotTop, function->funcType, false));
 
-            IM3Operation op;
-            const void * operand;
-
-            if (function->compiled)
+            if (isTailCall and not d_m3EnableLocalRegCaching)
             {
-                op = op_Call;
-                operand = function->compiled;
+_               (EmitOp         (o, op_ReturnCall));
+                EmitPointer     (o, function);
+                EmitConstant32  (o, slotTop);
+
+_               (SetStackPolymorphic (o));
             }
             else
             {
-                op = op_Compile;
-                operand = function;
-            }
+                IM3Operation op;
+                const void * operand;
+
+                if (function->compiled)
+                {
+                    op = op_Call;
+                    operand = function->compiled;
+                }
+                else
+                {
+                    op = op_Compile;
+                    operand = function;
+                }
 
-_           (EmitOp     (o, op));
-            EmitPointer (o, operand);
-            // stackOffset is used to compute the callee stack frame pointer (sp = _sp + stackOffset).
-            // It must never be patched/encoded for local-regcache.
-            EmitConstant32  (o, slotTop);
+_               (EmitOp     (o, op));
+                EmitPointer (o, operand);
+                // stackOffset is used to compute the callee stack frame pointer (sp = _sp + stackOffset).
+                // It must never be patched/encoded for local-regcache.
+                EmitConstant32  (o, slotTop);
 #if d_m3EnableLocalRegCaching
-            EmitPointer (o, o->function);
+                EmitPointer (o, o->function);
 #endif
+                // local-regcache keeps the caller's frame alive: the tail call degrades to call + return
+                if (isTailCall)
+_                   (Compile_Return (o, c_waOp_return));
+            }
         }
         else
         {
@@ -1814,19 +1860,41 @@ _       (PreserveRegisterIfOccupied (o, c_m3Type_i32));
 
     u16 execTop;
     IM3FuncType type = o->module->funcTypes [typeIndex];
+
+    bool isTailCall = (i_opcode == c_waOp_returnCallIndirect);
+
+    if (isTailCall)
+_       (ValidateTailCallResults (o, type));
+
 _   (CompileCallArgsAndReturn (o, & execTop, type, true));
 
-_   (EmitOp         (o, op_CallIndirect));
-    EmitSlotOffset  (o, tableIndexSlot);
-    EmitPointer     (o, o->module);
-    EmitPointer     (o, type);              // TODO: unify all types in M3Environment
-    // stackOffset is used to compute the callee stack frame pointer (sp = _sp + stackOffset).
-    // It must never be patched/encoded for local-regcache.
-    EmitConstant32  (o, execTop);
+    if (isTailCall and not d_m3EnableLocalRegCaching)
+    {
+_       (EmitOp         (o, op_ReturnCallIndirect));
+        EmitSlotOffset  (o, tableIndexSlot);
+        EmitPointer     (o, o->module);
+        EmitPointer     (o, type);
+        EmitConstant32  (o, execTop);
+
+_       (SetStackPolymorphic (o));
+    }
+    else
+    {
+_       (EmitOp         (o, op_CallIndirect));
+        EmitSlotOffset  (o, tableIndexSlot);
+        EmitPointer     (o, o->module);
+        EmitPointer     (o, type);              // TODO: unify all types in M3Environment
+        // stackOffset is used to compute the callee stack frame pointer (sp = _sp + stackOffset).
+        // It must never be patched/encoded for local-regcache.
+        EmitConstant32  (o, execTop);
 #if d_m3EnableLocalRegCaching
-    EmitPointer     (o, o->function);
+        EmitPointer     (o, o->function);
 #endif
 
+        if (isTailCall)
+_           (Compile_Return (o, c_waOp_return));
+    }
+
 } _catch:
     return result;
 }
@@ -1871,7 +1939,7 @@ M3Result  Compile_Memory_CopyFill  (IM3Compilation o, m3opcode_t i_opcode)
 {
     M3Result result = m3Err_none;
 
-    u32 sourceMemoryIdx, targetMemoryIdx;
+    u32 sourceMemoryIdx = 0, targetMemoryIdx;
     IM3Operation op;
     if (i_opcode == c_waOp_memoryCopy)
     {
@@ -1882,6 +1950,8 @@ _       (ReadLEB_u32 (& sourceMemoryIdx, & o->wasm, o->wasmEnd));
 
 _   (ReadLEB_u32 (& targetMemoryIdx, & o->wasm, o->wasmEnd));
 
+    _throwif (m3Err_unknownMemory, targetMemoryIdx != 0 or (i_opcode == c_waOp_memoryCopy and sourceMemoryIdx != 0));
+
 _   (CopyStackTopToRegister (o, false));
 
 _   (EmitOp  (o, op));
@@ -1893,6 +1963,107 @@ _   (EmitSlotNumOfStackTopAndPop (o));
 }
 
 
+static
+M3Result  Compile_Memory_Init  (IM3Compilation o, m3opcode_t i_opcode)
+{
+    M3Result result = m3Err_none;
+
+    u32 segmentIndex, memoryIdx;
+_   (ReadLEB_u32 (& segmentIndex, & o->wasm, o->wasmEnd));
+_   (ReadLEB_u32 (& memoryIdx, & o->wasm, o->wasmEnd));
+
+    _throwif ("data count section required", not o->module->hasDataCount);
+    _throwif ("unknown data segment", segmentIndex >= o->module->numDataSegments);
+    _throwif (m3Err_unknownMemory, memoryIdx != 0);
+
+_   (CopyStackTopToRegister (o, false));
+
+_   (EmitOp  (o, op_MemInit));
+_   (PopType (o, c_m3Type_i32));
+_   (EmitSlotNumOfStackTopAndPop (o));
+_   (EmitSlotNumOfStackTopAndPop (o));
+    EmitPointer (o, & o->module->dataSegments [segmentIndex]);
+
+    _catch: return result;
+}
+
+
+static
+M3Result  Compile_Table_Init  (IM3Compilation o, m3opcode_t i_opcode)
+{
+    M3Result result = m3Err_none;
+
+    u32 segmentIndex, tableIdx;
+_   (ReadLEB_u32 (& segmentIndex, & o->wasm, o->wasmEnd));
+_   (ReadLEB_u32 (& tableIdx, & o->wasm, o->wasmEnd));
+
+    _throwif ("unknown element segment", segmentIndex >= o->module->numElementSegments);
+    _throwif ("only table 0 supported", tableIdx != 0);
+
+_   (CopyStackTopToRegister (o, false));
+
+_   (EmitOp  (o, op_TableInit));
+_   (PopType (o, c_m3Type_i32));
+_   (EmitSlotNumOfStackTopAndPop (o));
+_   (EmitSlotNumOfStackTopAndPop (o));
+    EmitPointer (o, o->module);
+    EmitPointer (o, & o->module->elementSegments [segmentIndex]);
+
+    _catch: return result;
+}
+
+
+static
+M3Result  Compile_Table_Copy  (IM3Compilation o, m3opcode_t i_opcode)
+{
+    M3Result result = m3Err_none;
+
+    u32 targetTableIdx, sourceTableIdx;
+_   (ReadLEB_u32 (& targetTableIdx, & o->wasm, o->wasmEnd));
+_   (ReadLEB_u32 (& sourceTableIdx, & o->wasm, o->wasmEnd));
+
+    _throwif ("only table 0 supported", targetTableIdx != 0 or sourceTableIdx != 0);
+
+_   (CopyStackTopToRegister (o, false));
+
+_   (EmitOp  (o, op_TableCopy));
+_   (PopType (o, c_m3Type_i32));
+_   (EmitSlotNumOfStackTopAndPop (o));
+_   (EmitSlotNumOfStackTopAndPop (o));
+    EmitPointer (o, o->module);
+
+    _catch: return result;
+}
+
+
+static
+M3Result  Compile_SegmentDrop  (IM3Compilation o, m3opcode_t i_opcode)
+{
+    M3Result result = m3Err_none;
+
+    u32 segmentIndex;
+_   (ReadLEB_u32 (& segmentIndex, & o->wasm, o->wasmEnd));
+
+    if (i_opcode == c_waOp_dataDrop)
+    {
+        _throwif ("data count section required", not o->module->hasDataCount);
+        _throwif ("unknown data segment", segmentIndex >= o->module->numDataSegments);
+
+_       (EmitOp  (o, op_DataDrop));
+        EmitPointer (o, & o->module->dataSegments [segmentIndex]);
+    }
+    else
+    {
+        _throwif ("unknown element segment", segmentIndex >= o->module->numElementSegments);
+
+_       (EmitOp  (o, op_ElemDrop));
+        EmitPointer (o, & o->module->elementSegments [segmentIndex]);
+    }
+
+    _catch: return result;
+}
+
+
 static
 M3Result  ReadBlockType  (IM3Compilation o, IM3FuncType * o_blockType)
 {
@@ -1952,6 +2123,11 @@ M3Result  Compile_LoopOrBlock  (IM3Compilation o, m3opcode_t i_opcode)
 {
     M3Result result;
 
+#if d_m3EnableFuelMetering
+    u32 * loopCost = NULL;
+    u32 outerFuelCost = o->fuelCost;
+#endif
+
     // TODO: these shouldn't be necessary for non-loop blocks?
 _   (PreserveRegisters (o));
 _   (PreserveArgsAndLocals (o));
@@ -1992,6 +2168,10 @@ _                       (CopyStackIndexToSlot (o, newSlot, i));
 _           (EmitOp (o, op_Loop));
 #if d_m3EnableLocalRegCaching
             EmitPointer (o, o->function);
+#endif
+#if d_m3EnableFuelMetering
+            loopCost = (u32 *) ReservePointer (o);
+            o->fuelCost = 0;
 #endif
         }
     }
@@ -2001,6 +2181,15 @@ _           (EmitOp (o, op_Loop));
 
 _   (CompileBlock (o, blockType, i_opcode));
 
+#if d_m3EnableFuelMetering
+    // op_Loop charges the body on every iteration, so it doesn't count towards the enclosing code
+    if (loopCost)
+    {
+        * loopCost = o->fuelCost;
+        o->fuelCost = outerFuelCost;
+    }
+#endif
+
     _catch: return result;
 }
 
@@ -2351,6 +2540,31 @@ M3Result  CompileRawFunction  (IM3Module io_module,  IM3Function io_function, co
 
 
 
+M3Result  CompileTypedFunction  (IM3Module io_module,  IM3Function io_function, M3TypedThunk i_thunk, const void * i_function)
+{
+    d_m3Assert (io_module->runtime);
+
+    IM3CodePage page = AcquireCodePageWithCapacity (io_module->runtime, 4);
+
+    if (page)
+    {
+        io_function->compiled = GetPagePC (page);
+        io_function->module = io_module;
+
+        EmitWord (page, op_CallTypedFunction);
+        EmitWord (page, i_thunk);
+        EmitWord (page, i_function);
+        EmitWord (page, io_function);
+
+        ReleaseCodePage (io_module->runtime, page);
+        return m3Err_none;
+    }
+    else {
+        return m3Err_mallocFailedCodePage;
+    }
+}
+
+
 // d_logOp, d_logOp2 macros aren't actually used by the compiler, just codepage decoding (d_m3LogCodePages = 1)
 #define d_logOp(OP)                         { op_##OP,                  NULL,                       NULL,                       NULL }
 #define d_logOp2(OP1,OP2)                   { op_##OP1,                 op_##OP2,                   NULL,                       NULL }
@@ -2381,7 +2595,7 @@ const M3OpInfo c_operations [] =
     M3OP( "return",              0, any,    d_logOp (Return),                   Compile_Return ),       // 0x0f
     M3OP( "call",                0, any,    d_logOp (Call),                     Compile_Call ),         // 0x10
     M3OP( "call_indirect",       0, any,    d_logOp (CallIndirect),             Compile_CallIndirect ), // 0x11
-    M3OP( "return_call",         0, any,    d_emptyOpList,                      Compile_Call ),         // 0x12 TODO: Optimize
+    M3OP( "return_call",         0, any,    d_emptyOpList,                      Compile_Call ),         // 0x12
     M3OP( "return_call_indirect",0, any,    d_emptyOpList,                      Compile_CallIndirect ), // 0x13
 
     M3OP_RESERVED,  M3OP_RESERVED,                                                                      // 0x14...
@@ -2596,7 +2810,8 @@ const M3OpInfo c_operations [] =
 # endif
 
     d_m3DebugOp (Compile),          d_m3DebugOp (Entry),            d_m3DebugOp (End),
-    d_m3DebugOp (Unsupported),      d_m3DebugOp (CallRawFunction),
+    d_m3DebugOp (Unsupported),      d_m3DebugOp (CallRawFunction),  d_m3DebugOp (CallTypedFunction),
+    d_m3DebugOp (ReturnCall),       d_m3DebugOp (ReturnCallIndirect),
 
     d_m3DebugOp (GetGlobal_s32),    d_m3DebugOp (GetGlobal_s64),    d_m3DebugOp (ContinueLoop),     d_m3DebugOp (ContinueLoopIf),
 
@@ -2641,10 +2856,13 @@ const M3OpInfo c_operationsFC [] =
     M3OP_F( "i64.trunc_s:sat/f64",0,  i_64,   d_convertOpList (i64_TruncSat_f64),        Compile_Convert ),  // 0x06
     M3OP_F( "i64.trunc_u:sat/f64",0,  i_64,   d_convertOpList (u64_TruncSat_f64),        Compile_Convert ),  // 0x07
 
-    M3OP_RESERVED, M3OP_RESERVED,
-
+    M3OP( "memory.init",            0,  none,   d_emptyOpList,                           Compile_Memory_Init ),     // 0x08
+    M3OP( "data.drop",              0,  none,   d_emptyOpList,                           Compile_SegmentDrop ),     // 0x09
     M3OP( "memory.copy",            0,  none,   d_emptyOpList,                           Compile_Memory_CopyFill ), // 0x0a
     M3OP( "memory.fill",            0,  none,   d_emptyOpList,                           Compile_Memory_CopyFill ), // 0x0b
+    M3OP( "table.init",             0,  none,   d_emptyOpList,                           Compile_Table_Init ),      // 0x0c
+    M3OP( "elem.drop",              0,  none,   d_emptyOpList,                           Compile_SegmentDrop ),     // 0x0d
+    M3OP( "table.copy",             0,  none,   d_emptyOpList,                           Compile_Table_Copy ),      // 0x0e
 
 
 # ifdef DEBUG
@@ -2671,6 +2889,23 @@ IM3OpInfo  GetOpInfo  (m3opcode_t opcode)
     return NULL;
 }
 
+#if d_m3EnableOpProfiling
+u32  GetOpInfoIndex  (m3opcode_t opcode)
+{
+    return (opcode >> 8) ? M3_COUNT_OF (c_operations) + (opcode & 0xFF) : opcode;
+}
+
+IM3OpInfo  GetOpInfoAtIndex  (u32 i_index)
+{
+    if (i_index < M3_COUNT_OF (c_operations))
+        return & c_operations [i_index];
+
+    i_index -= M3_COUNT_OF (c_operations);
+
+    return (i_index < M3_COUNT_OF (c_operationsFC)) ? & c_operationsFC [i_index] : NULL;
+}
+#endif
+
 M3Result  CompileBlockStatements  (IM3Compilation o)
 {
     M3Result result = m3Err_none;
@@ -2707,9 +2942,21 @@ _       (Read_opcode (& opcode, & o->wasm, o->wasmEnd));                log_opco
 
         IM3OpInfo opinfo = GetOpInfo (opcode);
 
+#if d_m3EnableFuelMetering
+        o->fuelCost++;
+#endif
+
         if (opinfo == NULL)
             _throw (ErrorCompile (m3Err_unknownOpcode, o, "opcode '%x' not available", opcode));
 
+# if d_m3EnableOpProfiling
+        if (o->function)
+        {
+_           (EmitOp (o, op_CountOp));
+            EmitConstant32 (o, GetOpInfoIndex (opcode));
+        }
+# endif
+
         if (opinfo->compiler) {
 _           ((* opinfo->compiler) (o, opcode))
         } else {
@@ -2747,7 +2994,8 @@ M3Result  PushBlockResults  (IM3Compilation o)
     {
         u8 type = GetFuncTypeResultType (o->block.type, i);
 
-        if (i == numResults - 1 and IsFpType (type))
+        // the last result stays in its register class
+        if (i == numResults - 1)
         {
 _           (PushRegister (o, type));
         }
@@ -3082,7 +3330,7 @@ void  FinalizeLocalRegCache  (IM3Compilation o)
         }
     }
 
-    m3_Free (o->slotOffsetPatches);
+    m3_AllocatorFree (& o->module->environment->allocator, o->slotOffsetPatches);
     o->slotOffsetPatches = NULL;
     o->numSlotOffsetPatches = 0;
     o->capSlotOffsetPatches = 0;
@@ -3092,7 +3340,7 @@ void  FinalizeLocalRegCache  (IM3Compilation o)
 
 M3Result  CompileFunction  (IM3Function io_function)
 {
-    if (!io_function->wasm) return "function body is missing";
+    if (!io_function->wasm) return io_function->import.fieldUtf8 ? m3Err_functionImportMissing : "function body is missing";
 
     IM3FuncType funcType = io_function->funcType;                   m3log (compile, "compiling: [%d] %s %s; wasm-size: %d",
                                                                         io_function->index, m3_GetFunctionName (io_function), SPrintFuncTypeSignature (funcType), (u32) (io_function->wasmEnd - io_function->wasm));
@@ -3188,6 +3436,9 @@ _   (CompileBlockStatements (o));
 
     io_function->compiled = pc;
     io_function->maxStackSlots = o->maxStackSlots;
+#if d_m3EnableFuelMetering
+    io_function->fuelCost = o->fuelCost;
+#endif
 
     u16 numConstantSlots = o->slotMaxConstIndex - o->slotFirstConstIndex;                           m3log (compile, "unique constant slots: %d; unused slots: %d",
                                                                                                            numConstantSlots, o->slotFirstDynamicIndex - o->slotMaxConstIndex);
@@ -3195,14 +3446,14 @@ _   (CompileBlockStatements (o));
 
     if (numConstantSlots)
     {
-        io_function->constants = m3_CopyMem (o->constants, io_function->numConstantBytes);
+        io_function->constants = m3_CopyMem (o->constants, io_function->numConstantBytes, & o->module->allocator);
         _throwifnull(io_function->constants);
     }
 
 } _catch:
 
 #if d_m3EnableLocalRegCaching
-    m3_Free (o->slotOffsetPatches);
+    m3_AllocatorFree (& o->module->environment->allocator, o->slotOffsetPatches);
     o->slotOffsetPatches = NULL;
     o->numSlotOffsetPatches = 0;
     o->capSlotOffsetPatches = 0;
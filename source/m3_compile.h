@@ -24,7 +24,10 @@ enum
     c_waOp_branch               = 0x0c,
     c_waOp_branchTable          = 0x0e,
     c_waOp_branchIf             = 0x0d,
+    c_waOp_return               = 0x0f,
     c_waOp_call                 = 0x10,
+    c_waOp_returnCall           = 0x12,
+    c_waOp_returnCallIndirect   = 0x13,
     c_waOp_getLocal             = 0x20,
     c_waOp_setLocal             = 0x21,
     c_waOp_teeLocal             = 0x22,
@@ -41,8 +44,13 @@ enum
 
     c_waOp_extended             = 0xfc,
 
+    c_waOp_memoryInit           = 0xfc08,
+    c_waOp_dataDrop             = 0xfc09,
     c_waOp_memoryCopy           = 0xfc0a,
-    c_waOp_memoryFill           = 0xfc0b
+    c_waOp_memoryFill           = 0xfc0b,
+    c_waOp_tableInit            = 0xfc0c,
+    c_waOp_elemDrop             = 0xfc0d,
+    c_waOp_tableCopy            = 0xfc0e
 };
 
 
@@ -126,6 +134,10 @@ typedef struct
 
     m3opcode_t          previousOpcode;
 
+#if d_m3EnableFuelMetering
+    u32                 fuelCost;                   // instructions compiled in the current function body or loop
+#endif
+
 #if d_m3EnableLocalRegCaching
     // Local usage counts (args + locals) and slot-offset patching for encoded cached locals.
     u32                 localUseCounts              [d_m3MaxFunctionStackHeight];
@@ -148,7 +160,7 @@ typedef M3Result (* M3Compiler)         (IM3Compilation, m3opcode_t);
 
 typedef struct M3OpInfo
 {
-#ifdef DEBUG
+#if defined(DEBUG) || d_m3EnableOpProfiling
     const char * const      name;
 #endif
 
@@ -167,11 +179,11 @@ typedef const M3OpInfo *    IM3OpInfo;
 
 IM3OpInfo  GetOpInfo  (m3opcode_t opcode);
 
-// TODO: This helper should be removed, when MultiValue is implemented
-static inline
-u8 GetSingleRetType(IM3FuncType ftype) {
-    return (ftype && ftype->numRets) ? ftype->types[0] : (u8)c_m3Type_none;
-}
+#if d_m3EnableOpProfiling
+// the op profiler counts each opcode under its index in c_operations followed by c_operationsFC
+u32        GetOpInfoIndex      (m3opcode_t opcode);
+IM3OpInfo  GetOpInfoAtIndex    (u32 i_index);          // NULL past the last entry
+#endif
 
 static const u16 c_m3RegisterUnallocated = 0;
 static const u16 c_slotUnused = 0xffff;
@@ -193,7 +205,7 @@ static inline bool  IsFpRegisterSlotAlias      (u16 i_slot)    { return (i_slot
 static inline bool  IsIntRegisterSlotAlias     (u16 i_slot)    { return (i_slot == d_m3Reg0SlotAlias); }
 
 
-#ifdef DEBUG
+#if defined(DEBUG) || d_m3EnableOpProfiling
     #define M3OP(...)       { __VA_ARGS__ }
     #define M3OP_RESERVED   { "reserved" }
 #else
@@ -221,6 +233,11 @@ M3Result    CompileFunction             (IM3Function io_function);
 
 M3Result    CompileRawFunction          (IM3Module io_module, IM3Function io_function, const void * i_function, const void * i_userdata);
 
+// calls i_function with its arguments loaded from io_sp and stores its (single) result into io_sp [0]
+typedef void (* M3TypedThunk) (u64 * io_sp, const void * i_function);
+
+M3Result    CompileTypedFunction        (IM3Module io_module, IM3Function io_function, M3TypedThunk i_thunk, const void * i_function);
+
 d_m3EndExternC
 
 #endif // m3_compile_h
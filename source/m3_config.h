@@ -53,12 +53,92 @@
 #   define d_m3FixedHeapAlign                   16
 # endif
 
+# ifndef d_m3MaxTypedImportArgs
+#   define d_m3MaxTypedImportArgs               2       // typed import thunks for 0..N args (2..6); above 3, i32/i64 only. ~18KB of code at 3, ~56KB at 6
+# endif
+
+# ifndef d_m3EnableModuleArena
+#   define d_m3EnableModuleArena                (!d_m3FixedHeap)    // bump-allocate module-lifetime data
+# endif
+
+# ifndef d_m3ModuleArenaChunkSize
+#   define d_m3ModuleArenaChunkSize             (16*1024)
+# endif
+
 # ifndef d_m3Use32BitSlots
 #   define d_m3Use32BitSlots                    1
 # endif
 
-# ifndef d_m3ProfilerSlotMask
-#   define d_m3ProfilerSlotMask                 0xFFFF
+# ifndef d_m3EnableMappedFiles
+#   if defined(__unix__) || defined(__APPLE__)
+#     define d_m3EnableMappedFiles              1       // m3_ParseModuleFile maps the binary instead of reading it into the heap
+#   else
+#     define d_m3EnableMappedFiles              0
+#   endif
+# endif
+
+# ifndef d_m3MaxModuleFileSize
+#   define d_m3MaxModuleFileSize                (256*1024*1024) // m3_ParseModuleFile refuses larger files before mapping or reading them
+# endif
+
+# ifndef d_m3EnableFuelMetering
+#   define d_m3EnableFuelMetering               0       // charge fuel on function entry and loop iterations; see m3_SetFuel
+# endif
+
+# ifndef d_m3EnableInterrupts
+#   define d_m3EnableInterrupts                 0       // poll m3_Interrupt / m3_SetDeadline on function entry and loop iterations
+# endif
+
+# ifndef d_m3DeadlineCheckInterval
+#   define d_m3DeadlineCheckInterval            1024    // polls between clock reads while a deadline is armed
+# endif
+
+# ifndef d_m3EnableResumableCalls
+#   define d_m3EnableResumableCalls             0       // run calls on a per-runtime stack (ucontext) so they can be suspended
+# endif
+
+# ifndef d_m3ResumableStackSize
+#   define d_m3ResumableStackSize               (256*1024)  // minimum fiber stack; grows with the runtime's stack size
+# endif
+
+# ifndef d_m3ResumableStackReserve
+#   define d_m3ResumableStackReserve            (32*1024)   // fiber stack kept free for host imports; calls entering below it trap
+# endif
+
+# ifndef d_m3WasiMaxIovecs
+#   define d_m3WasiMaxIovecs                    128     // iovecs a WASI read or write translates on the stack; longer lists are allocated
+# endif
+
+# ifndef d_m3WasiWriteBufferSize
+#   define d_m3WasiWriteBufferSize              0       // stdout/stderr write buffer; flushed on newline, when full, on fd_sync and at exit
+# endif
+
+# ifndef d_m3WasiDirCacheSize
+#   define d_m3WasiDirCacheSize                 32      // directory handles each runtime caches for WASI path lookups (0 disables); renames made outside WASI aren't seen
+# endif
+
+# ifndef d_m3WasiRandomPoolSize
+#   define d_m3WasiRandomPoolSize               4096    // random_get requests smaller than this are served from a pool refilled in one OS call (0 disables)
+# endif
+
+# ifndef d_m3WasiClockResolution
+#   define d_m3WasiClockResolution              0       // ns; realtime/monotonic clock_time_get may be coarsened to this resolution
+# endif
+
+# ifndef d_m3WasiVfs
+#   define d_m3WasiVfs                          1       // in-memory WASI images, see m3_MountWASIImage (0 disables)
+# endif
+
+# ifndef d_m3WasiStdio
+#   define d_m3WasiStdio                        1       // in-memory WASI stdio, see m3_CaptureStdioWASI (0 disables)
+# endif
+
+# ifndef d_m3WasiUringEntries
+#   define d_m3WasiUringEntries                 64      // io_uring queue depth (BUILD_WASI=uring); also caps poll_oneoff subscriptions
+# endif
+
+# ifndef d_m3WasiUringFixedMemoryMax
+#   define d_m3WasiUringFixedMemoryMax          (64*1024*1024)  // largest linear memory pinned as an io_uring fixed buffer (0 never pins)
 # endif
 
 # ifndef d_m3RecordBacktraces
@@ -73,7 +153,23 @@
 // profiling and tracing ------------------------------------------------------
 
 # ifndef d_m3EnableOpProfiling
-#   define d_m3EnableOpProfiling                0       // opcode usage counters
+#   define d_m3EnableOpProfiling                0       // per-function opcode counters; see m3_GetProfilerStats
+# endif
+
+# ifndef d_m3EnableSampling
+#   if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#     define d_m3EnableSampling                 1       // keep a shadow call stack for m3_StartSampling (SIGPROF); a few stores per call
+#   else
+#     define d_m3EnableSampling                 0
+#   endif
+# endif
+
+# ifndef d_m3SamplerMaxDepth
+#   define d_m3SamplerMaxDepth                  128     // deepest wasm call chain recorded per sample; deeper chains keep the innermost frames
+# endif
+
+# ifndef d_m3SamplerMaxStacks
+#   define d_m3SamplerMaxStacks                 8192    // distinct call chains recorded; further new chains are counted as dropped
 # endif
 
 # ifndef d_m3EnableOpTracing
@@ -96,6 +96,39 @@
 #   define M3_MUSTTAIL
 # endif
 
+// atomics for state shared between threads (C11 memory model builtins while the build is C99).
+// stores and peeks are relaxed, exchanges and compare-and-swaps are full barriers. peeks are cheap
+// enough for the interpreter's hot paths
+# if defined(M3_COMPILER_GCC) || defined(M3_COMPILER_CLANG) || defined(M3_COMPILER_ICC)
+#  define m3_AtomicLoad32(P)            __atomic_load_n ((P), __ATOMIC_ACQUIRE)
+#  define m3_AtomicPeek32(P)            __atomic_load_n ((P), __ATOMIC_RELAXED)
+#  define m3_AtomicStore32(P, V)        __atomic_store_n ((P), (V), __ATOMIC_RELAXED)
+#  define m3_AtomicExchange32(P, V)     __atomic_exchange_n ((P), (V), __ATOMIC_SEQ_CST)
+#  define m3_AtomicLoadPtr(P)           __atomic_load_n ((P), __ATOMIC_ACQUIRE)
+#  define m3_AtomicCasPtr(P, OLD, NEW)  __sync_bool_compare_and_swap ((P), (OLD), (NEW))
+# elif defined(M3_COMPILER_MSVC)
+#  include <intrin.h>
+#  define m3_AtomicLoad32(P)            ((uint32_t) _InterlockedOr ((volatile long *) (P), 0))
+#  define m3_AtomicPeek32(P)            (* (volatile uint32_t *) (P))
+#  define m3_AtomicStore32(P, V)        ((void) _InterlockedExchange ((volatile long *) (P), (long) (V)))
+#  define m3_AtomicExchange32(P, V)     ((uint32_t) _InterlockedExchange ((volatile long *) (P), (long) (V)))
+#  define m3_AtomicLoadPtr(P)           _InterlockedCompareExchangePointer ((void * volatile *) (P), NULL, NULL)
+#  define m3_AtomicCasPtr(P, OLD, NEW)  (_InterlockedCompareExchangePointer ((void * volatile *) (P), (NEW), (OLD)) == (OLD))
+# else  // single-threaded targets
+#  define m3_AtomicLoad32(P)            (* (P))
+#  define m3_AtomicPeek32(P)            (* (P))
+#  define m3_AtomicStore32(P, V)        ((void) (* (P) = (V)))
+#  define m3_AtomicExchange32(P, V)     m3_AtomicExchange32_ ((P), (V))
+#  define m3_AtomicLoadPtr(P)           (* (P))
+#  define m3_AtomicCasPtr(P, OLD, NEW)  ((* (P) == (OLD)) ? (* (P) = (NEW), 1) : 0)
+static inline uint32_t m3_AtomicExchange32_ (volatile uint32_t * io_ptr, uint32_t i_value)
+{
+    uint32_t previous = * io_ptr;
+    * io_ptr = i_value;
+    return previous;
+}
+# endif
+
 # ifndef M3_MIN
 #  define M3_MIN(A,B) (((A) < (B)) ? (A) : (B))
 # endif
@@ -22,7 +22,11 @@ void m3_Abort(const char* message) {
 M3_WEAK
 M3Result m3_Yield ()
 {
+#if d_m3EnableResumableCalls
+    return Runtime_YieldIfRequested ();
+#else
     return m3Err_none;
+#endif
 }
 
 #if d_m3LogTimestamps
@@ -152,9 +156,9 @@ void *  m3_Realloc_Impl  (void * i_ptr, size_t i_newSize, size_t i_oldSize)
 
 #endif
 
-void *  m3_CopyMem  (const void * i_from, size_t i_size)
+void *  m3_CopyMem  (const void * i_from, size_t i_size, IM3Allocator i_allocator)
 {
-    void * ptr = m3_Malloc("CopyMem", i_size);
+    void * ptr = m3_AllocatorMalloc (i_allocator, i_size);
     if (ptr) {
         memcpy (ptr, i_from, i_size);
     }
@@ -163,6 +167,242 @@ void *  m3_CopyMem  (const void * i_from, size_t i_size)
 
 //--------------------------------------------------------------------------------------------
 
+void *  m3_AllocatorMalloc  (IM3Allocator i_allocator, size_t i_size)
+{
+    if (i_allocator and i_allocator->allocate)
+        return i_allocator->allocate (i_allocator->userdata, i_size);
+    else
+        return m3_Malloc ("Allocator", i_size);
+}
+
+void *  m3_AllocatorRealloc  (IM3Allocator i_allocator, void * i_ptr, size_t i_newSize, size_t i_oldSize)
+{
+    if (i_allocator and i_allocator->reallocate)
+        return i_allocator->reallocate (i_allocator->userdata, i_ptr, i_newSize, i_oldSize);
+    else
+        return m3_Realloc ("Allocator", i_ptr, i_newSize, i_oldSize);
+}
+
+void  m3_AllocatorFreeMem  (IM3Allocator i_allocator, void * i_ptr)
+{
+    if (i_allocator and i_allocator->release)
+    {
+        if (i_ptr)
+            i_allocator->release (i_allocator->userdata, i_ptr);
+    }
+    else m3_Free (i_ptr);
+}
+
+//--------------------------------------------------------------------------------------------
+
+#define d_m3ArenaAlign                  16
+#define ARENA_ALIGN_SIZE(S)             (((S) + (d_m3ArenaAlign - 1)) & ~(size_t) (d_m3ArenaAlign - 1))
+#define d_m3ArenaChunkHeaderSize        ARENA_ALIGN_SIZE (sizeof (M3ArenaChunk))
+
+static
+u8 *  Arena_NewChunk  (M3Arena * io_arena, size_t i_size)
+{
+    M3ArenaChunk * chunk = (M3ArenaChunk *) m3_AllocatorMalloc (& io_arena->parent, d_m3ArenaChunkHeaderSize + i_size);
+
+    if (chunk)
+    {
+        chunk->next = io_arena->chunks;
+        io_arena->chunks = chunk;
+
+        return (u8 *) chunk + d_m3ArenaChunkHeaderSize;
+    }
+    else return NULL;
+}
+
+static
+void *  Arena_Allocate  (void * i_arena, size_t i_size)
+{
+    M3Arena * arena = (M3Arena *) i_arena;
+
+    size_t size = ARENA_ALIGN_SIZE (M3_MAX (i_size, 1));
+
+    if (size > (size_t) (arena->end - arena->top))
+    {
+        // large blocks get a chunk of their own, so the current one keeps being filled
+        if (size > d_m3ModuleArenaChunkSize / 4)
+            return Arena_NewChunk (arena, size);
+
+        u8 * chunk = Arena_NewChunk (arena, d_m3ModuleArenaChunkSize);
+        if (not chunk)
+            return NULL;
+
+        arena->top = chunk;
+        arena->end = chunk + d_m3ModuleArenaChunkSize;
+    }
+
+    // chunks come zeroed from the parent and the top never moves back, so neither does fresh arena memory
+    u8 * ptr = arena->top;
+    arena->top += size;
+    arena->last = ptr;
+
+    return ptr;
+}
+
+static
+void *  Arena_Reallocate  (void * i_arena, void * i_ptr, size_t i_newSize, size_t i_oldSize)
+{
+    M3Arena * arena = (M3Arena *) i_arena;
+
+    if (i_ptr and i_newSize <= i_oldSize)
+        return i_ptr;
+
+    if (i_ptr and i_ptr == arena->last)
+    {
+        size_t size = ARENA_ALIGN_SIZE (i_newSize);
+
+        if (size <= (size_t) (arena->end - (u8 *) i_ptr))
+        {
+            memset ((u8 *) i_ptr + i_oldSize, 0x0, i_newSize - i_oldSize);
+            arena->top = (u8 *) i_ptr + size;
+            return i_ptr;
+        }
+    }
+
+    void * ptr = Arena_Allocate (arena, i_newSize);
+
+    if (ptr and i_ptr)
+        memcpy (ptr, i_ptr, i_oldSize);
+
+    return ptr;
+}
+
+static
+void  Arena_Free  (void * i_arena, void * i_ptr)
+{
+}
+
+void  Arena_Init  (M3Arena * o_arena, IM3Allocator i_parent, M3Allocator * o_allocator)
+{
+    * o_arena = (M3Arena) { .chunks = NULL };
+
+    if (i_parent)
+        o_arena->parent = * i_parent;
+
+    * o_allocator = (M3Allocator) { Arena_Allocate, Arena_Reallocate, Arena_Free, o_arena };
+}
+
+void  Arena_Release  (M3Arena * io_arena)
+{
+    M3ArenaChunk * chunk = io_arena->chunks;
+
+    while (chunk)
+    {
+        M3ArenaChunk * next = chunk->next;
+        m3_AllocatorFree (& io_arena->parent, chunk);
+        chunk = next;
+    }
+
+    io_arena->chunks = NULL;
+    io_arena->top = io_arena->end = io_arena->last = NULL;
+}
+
+//--------------------------------------------------------------------------------------------
+
+#if d_m3EnableMappedFiles
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+M3Result  m3_MapFile  (void ** o_data, size_t * o_size, cstr_t i_path)
+{
+    * o_data = NULL;
+    * o_size = 0;
+
+    int fd = open (i_path, O_RDONLY);
+    if (fd < 0)
+        return m3Err_cannotOpenFile;
+
+    M3Result result = m3Err_cannotReadFile;
+
+    // sized from the open descriptor, so the limit holds for exactly what gets mapped
+    struct stat st;
+    if (fstat (fd, & st) == 0)
+    {
+        if (st.st_size > d_m3MaxModuleFileSize)
+        {
+            result = m3Err_fileTooBig;
+        }
+        else if (st.st_size > 0)
+        {
+            // read-only & private: every process mapping the same binary shares its page cache
+            void * data = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (data != MAP_FAILED)
+            {
+                * o_data = data;
+                * o_size = (size_t) st.st_size;
+                result = m3Err_none;
+            }
+        }
+    }
+
+    close (fd);
+
+    return result;
+}
+
+void  m3_UnmapFile  (void * i_data, size_t i_size)
+{
+    if (i_data)
+        munmap (i_data, i_size);
+}
+
+#else
+
+M3Result  m3_MapFile  (void ** o_data, size_t * o_size, cstr_t i_path)
+{
+    * o_data = NULL;
+    * o_size = 0;
+
+    FILE * f = fopen (i_path, "rb");
+    if (not f)
+        return m3Err_cannotOpenFile;
+
+    M3Result result = m3Err_cannotReadFile;
+
+    long size = -1;
+    if (fseek (f, 0, SEEK_END) == 0)
+        size = ftell (f);
+
+    if (size > d_m3MaxModuleFileSize)
+    {
+        result = m3Err_fileTooBig;
+    }
+    else if (size > 0 and fseek (f, 0, SEEK_SET) == 0)
+    {
+        void * data = m3_Malloc ("Wasm Binary", (size_t) size);
+
+        if (data and fread (data, 1, (size_t) size, f) == (size_t) size)
+        {
+            * o_data = data;
+            * o_size = (size_t) size;
+            result = m3Err_none;
+        }
+        else if (data) m3_Free (data);
+        else result = m3Err_mallocFailed;
+    }
+
+    fclose (f);
+
+    return result;
+}
+
+void  m3_UnmapFile  (void * i_data, size_t i_size)
+{
+    m3_Free (i_data);
+}
+
+#endif
+
+//--------------------------------------------------------------------------------------------
+
 #if d_m3LogNativeStack
 
 static size_t stack_start;
@@ -482,7 +722,7 @@ M3Result  ReadLEB_i64  (i64 * o_value, bytes_t * io_bytes, cbytes_t i_end)
 }
 
 
-M3Result  Read_utf8  (cstr_t * o_utf8, bytes_t * io_bytes, cbytes_t i_end)
+M3Result  Read_utf8  (cstr_t * o_utf8, bytes_t * io_bytes, cbytes_t i_end, IM3Allocator i_allocator)
 {
     *o_utf8 = NULL;
 
@@ -498,7 +738,7 @@ M3Result  Read_utf8  (cstr_t * o_utf8, bytes_t * io_bytes, cbytes_t i_end)
 
             if (end <= i_end)
             {
-                char * utf8 = (char *)m3_Malloc ("UTF8", utf8Length + 1);
+                char * utf8 = (char *)m3_AllocatorMalloc (i_allocator, utf8Length + 1);
 
                 if (utf8)
                 {
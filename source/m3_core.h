@@ -134,6 +134,13 @@ typedef struct M3MemoryHeader
     IM3Runtime      runtime;
     void *          maxStack;
     size_t          length;
+    u64             serial;         // unique per (re)allocation, so hosts can tell a moved or replaced memory apart
+#if d_m3EnableFuelMetering
+    u64             fuel;           // kept next to maxStack so ops can charge it without a runtime lookup
+#endif
+#if d_m3EnableResumableCalls
+    void *          nativeStackLimit;   // lowest native stack address a call may enter at; NULL when unchecked
+#endif
 }
 M3MemoryHeader;
 
@@ -220,7 +227,41 @@ void        m3_Abort                (const char* message);
 void *      m3_Malloc_Impl          (size_t i_size);
 void *      m3_Realloc_Impl         (void * i_ptr, size_t i_newSize, size_t i_oldSize);
 void        m3_Free_Impl            (void * i_ptr);
-void *      m3_CopyMem              (const void * i_from, size_t i_size);
+void *      m3_CopyMem              (const void * i_from, size_t i_size, IM3Allocator i_allocator);
+
+M3Result    m3_MapFile              (void ** o_data, size_t * o_size, cstr_t i_path);
+void        m3_UnmapFile            (void * i_data, size_t i_size);
+
+// a NULL allocator (or one without hooks) falls back to the m3_*_Impl heap
+void *      m3_AllocatorMalloc      (IM3Allocator i_allocator, size_t i_size);
+void *      m3_AllocatorRealloc     (IM3Allocator i_allocator, void * i_ptr, size_t i_newSize, size_t i_oldSize);
+void        m3_AllocatorFreeMem     (IM3Allocator i_allocator, void * i_ptr);
+
+#define     m3_AllocatorAllocStruct(ALLOC, STRUCT)                  (STRUCT *)m3_AllocatorMalloc ((ALLOC), sizeof (STRUCT))
+#define     m3_AllocatorAllocArray(ALLOC, STRUCT, NUM)              (STRUCT *)m3_AllocatorMalloc ((ALLOC), sizeof (STRUCT) * (NUM))
+#define     m3_AllocatorReallocArray(ALLOC, STRUCT, PTR, NEW, OLD)  (STRUCT *)m3_AllocatorRealloc ((ALLOC), (void *)(PTR), sizeof (STRUCT) * (NEW), sizeof (STRUCT) * (OLD))
+#define     m3_AllocatorFree(ALLOC, P)                              do { m3_AllocatorFreeMem ((ALLOC), (void*)(P)); (P) = NULL; } while(0)
+
+typedef struct M3ArenaChunk
+{
+    struct M3ArenaChunk *   next;
+}
+M3ArenaChunk;
+
+// bump allocator; individual frees are no-ops and everything is returned to the parent by Arena_Release
+typedef struct M3Arena
+{
+    M3Allocator             parent;
+    M3ArenaChunk *          chunks;
+
+    u8 *                    top;
+    u8 *                    end;
+    u8 *                    last;           // most recent allocation; can be grown in place
+}
+M3Arena;
+
+void        Arena_Init              (M3Arena * o_arena, IM3Allocator i_parent, M3Allocator * o_allocator);
+void        Arena_Release           (M3Arena * io_arena);
 
 #if d_m3LogHeapOps
 
@@ -293,7 +334,7 @@ M3Result    ReadLEB_u7              (u8  * o_value, bytes_t * io_bytes, cbytes_t
 M3Result    ReadLEB_i7              (i8  * o_value, bytes_t * io_bytes, cbytes_t i_end);
 M3Result    ReadLEB_i32             (i32 * o_value, bytes_t * io_bytes, cbytes_t i_end);
 M3Result    ReadLEB_i64             (i64 * o_value, bytes_t * io_bytes, cbytes_t i_end);
-M3Result    Read_utf8               (cstr_t * o_utf8, bytes_t * io_bytes, cbytes_t i_end);
+M3Result    Read_utf8               (cstr_t * o_utf8, bytes_t * io_bytes, cbytes_t i_end, IM3Allocator i_allocator);
 
 cstr_t      SPrintValue             (void * i_value, u8 i_type);
 size_t      SPrintArg               (char * o_string, size_t i_stringBufferSize, voidptr_t i_sp, u8 i_type);
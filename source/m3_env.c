@@ -5,6 +5,16 @@
 //  Copyright © 2019 Steven Massey. All rights reserved.
 //
 
+// Linux only: on Apple and the BSDs a _POSIX_C_SOURCE hides MAP_ANON and friends
+#if defined(__linux__)
+#   if !defined(_POSIX_C_SOURCE)
+#       define _POSIX_C_SOURCE 200809L  // clock_gettime for deadlines
+#   endif
+#   if !defined(_DEFAULT_SOURCE)
+#       define _DEFAULT_SOURCE          // MAP_ANONYMOUS for fiber stacks
+#   endif
+#endif
+
 #include <stdarg.h>
 #include <limits.h>
 
@@ -13,20 +23,47 @@
 #include "m3_exception.h"
 #include "m3_info.h"
 
+#if d_m3EnableInterrupts
+#   include <time.h>
+#   if defined(_WIN32)
+#       include <windows.h>
+#   endif
+#endif
+
+#if d_m3EnableResumableCalls
+#   include <ucontext.h>
+#   include <sys/mman.h>
+#   include <unistd.h>
+#   if !defined(MAP_ANONYMOUS)
+#       define MAP_ANONYMOUS MAP_ANON
+#   endif
+
+static void ReleaseFiber (IM3Runtime io_runtime);
+#endif
+
 
 IM3Environment  m3_NewEnvironment  ()
 {
-    IM3Environment env = m3_AllocStruct (M3Environment);
+    return m3_NewEnvironmentWithAllocator (NULL);
+}
+
+
+IM3Environment  m3_NewEnvironmentWithAllocator  (IM3Allocator i_allocator)
+{
+    IM3Environment env = m3_AllocatorAllocStruct (i_allocator, M3Environment);
 
     if (env)
     {
+        if (i_allocator)
+            env->allocator = * i_allocator;
+
         _try
         {
             // create FuncTypes for all simple block return ValueTypes
             for (u8 t = c_m3Type_none; t <= c_m3Type_f64; t++)
             {
                 IM3FuncType ftype;
-_               (AllocFuncType (& ftype, 1));
+_               (AllocFuncType (& ftype, 1, & env->allocator));
 
                 ftype->numArgs = 0;
                 ftype->numRets = (t == c_m3Type_none) ? 0 : 1;
@@ -58,12 +95,12 @@ void  Environment_Release  (IM3Environment i_environment)
     while (ftype)
     {
         IM3FuncType next = ftype->next;
-        m3_Free (ftype);
+        m3_AllocatorFree (& i_environment->allocator, ftype);
         ftype = next;
     }
 
     m3log (runtime, "freeing %d pages from environment", CountCodePages (i_environment->pagesReleased));
-    FreeCodePages (& i_environment->pagesReleased);
+    FreeCodePages (& i_environment->pagesReleased, & i_environment->allocator);
 }
 
 
@@ -71,8 +108,10 @@ void  m3_FreeEnvironment  (IM3Environment i_environment)
 {
     if (i_environment)
     {
+        M3Allocator allocator = i_environment->allocator;
+
         Environment_Release (i_environment);
-        m3_Free (i_environment);
+        m3_AllocatorFree (& allocator, i_environment);
     }
 }
 
@@ -93,7 +132,7 @@ void  Environment_AddFuncType  (IM3Environment i_environment, IM3FuncType * io_f
     {
         if (AreFuncTypesEqual (newType, addType))
         {
-            m3_Free (addType);
+            m3_AllocatorFree (& i_environment->allocator, addType);
             break;
         }
 
@@ -172,7 +211,7 @@ void  Environment_ReleaseCodePages  (IM3Environment i_environment, IM3CodePage i
 
 IM3Runtime  m3_NewRuntime  (IM3Environment i_environment, u32 i_stackSizeInBytes, void * i_userdata)
 {
-    IM3Runtime runtime = m3_AllocStruct (M3Runtime);
+    IM3Runtime runtime = m3_AllocatorAllocStruct (& i_environment->allocator, M3Runtime);
 
     if (runtime)
     {
@@ -181,14 +220,14 @@ IM3Runtime  m3_NewRuntime  (IM3Environment i_environment, u32 i_stackSizeInBytes
         runtime->environment = i_environment;
         runtime->userdata = i_userdata;
 
-        runtime->originStack = m3_Malloc ("Wasm Stack", i_stackSizeInBytes + 4*sizeof (m3slot_t)); // TODO: more precise stack checks
+        runtime->originStack = m3_AllocatorMalloc (& i_environment->allocator, i_stackSizeInBytes + 4*sizeof (m3slot_t)); // TODO: more precise stack checks
 
         if (runtime->originStack)
         {
             runtime->stack = runtime->originStack;
             runtime->numStackSlots = i_stackSizeInBytes / sizeof (m3slot_t);         m3log (runtime, "new stack: %p", runtime->originStack);
         }
-        else m3_Free (runtime);
+        else m3_AllocatorFree (& i_environment->allocator, runtime);
     }
 
     return runtime;
@@ -234,8 +273,19 @@ void  Runtime_Release  (IM3Runtime i_runtime)
     Environment_ReleaseCodePages (i_runtime->environment, i_runtime->pagesOpen);
     Environment_ReleaseCodePages (i_runtime->environment, i_runtime->pagesFull);
 
-    m3_Free (i_runtime->originStack);
-    m3_Free (i_runtime->memory.mallocated);
+#if d_m3EnableResumableCalls
+    ReleaseFiber (i_runtime);
+#endif
+
+    if (i_runtime->releaseWasi)
+        i_runtime->releaseWasi (i_runtime);
+
+# if d_m3RecordBacktraces
+    ClearBacktrace (i_runtime);
+# endif
+
+    m3_AllocatorFree (& i_runtime->environment->allocator, i_runtime->originStack);
+    m3_AllocatorFree (& i_runtime->environment->allocator, i_runtime->memory.mallocated);
 }
 
 
@@ -243,10 +293,15 @@ void  m3_FreeRuntime  (IM3Runtime i_runtime)
 {
     if (i_runtime)
     {
-        m3_PrintProfilerInfo ();
+#if d_m3EnableSampling
+        m3_StopSampling (i_runtime, NULL);
+#endif
+#if d_m3EnableOpProfiling
+        m3_AllocatorFree (& i_runtime->environment->allocator, i_runtime->profilerStatsData);
+#endif
 
         Runtime_Release (i_runtime);
-        m3_Free (i_runtime);
+        m3_AllocatorFree (& i_runtime->environment->allocator, i_runtime);
     }
 }
 
@@ -298,7 +353,7 @@ M3Result  EvaluateExpression  (IM3Module i_module, void * o_expressed, u8 i_type
 
         if (not result)
         {
-# if (d_m3EnableOpProfiling || d_m3EnableOpTracing)
+# if d_m3EnableOpTracing
             m3ret_t r = RunCode (m3code, stack, NULL, d_m3OpDefaultArgs, d_m3BaseCstr);
 # else
             m3ret_t r = RunCode (m3code, stack, NULL, d_m3OpDefaultArgs);
@@ -384,10 +439,14 @@ M3Result  ResizeMemory  (IM3Runtime io_runtime, u32 i_numPages)
         size_t numBytes = numPageBytes + sizeof (M3MemoryHeader);
 
         size_t numPreviousBytes = memory->numPages * io_runtime->memory.pageSize;
-        if (numPreviousBytes)
+        if (memory->mallocated)
             numPreviousBytes += sizeof (M3MemoryHeader);
 
-        void* newMem = m3_Realloc ("Wasm Linear Memory", memory->mallocated, numBytes, numPreviousBytes);
+# if d_m3EnableFuelMetering || d_m3EnableResumableCalls
+        bool isNewMemory = not memory->mallocated;
+# endif
+
+        void* newMem = m3_AllocatorRealloc (& io_runtime->environment->allocator, memory->mallocated, numBytes, numPreviousBytes);
         _throwifnull(newMem);
 
         memory->mallocated = (M3MemoryHeader*)newMem;
@@ -398,11 +457,23 @@ M3Result  ResizeMemory  (IM3Runtime io_runtime, u32 i_numPages)
 
         memory->numPages = numPagesToAlloc;
 
+        static u64 s_memorySerial = 0;
+
         memory->mallocated->length =  numPageBytes;
         memory->mallocated->runtime = io_runtime;
+        memory->mallocated->serial = ++s_memorySerial;
 
         memory->mallocated->maxStack = (m3slot_t *) io_runtime->stack + io_runtime->numStackSlots;
 
+# if d_m3EnableFuelMetering
+        if (isNewMemory)
+            memory->mallocated->fuel = UINT64_MAX;      // unmetered until m3_SetFuel
+# endif
+# if d_m3EnableResumableCalls
+        if (isNewMemory)
+            memory->mallocated->nativeStackLimit = NULL;
+# endif
+
         m3log (runtime, "resized old: %p; mem: %p; length: %zu; pages: %d", oldMallocated, memory->mallocated, memory->mallocated->length, memory->numPages);
     }
     else result = m3Err_wasmMemoryOverflow;
@@ -463,6 +534,10 @@ M3Result  InitDataSegments  (M3Memory * io_memory, IM3Module io_module)
     {
         M3DataSegment * segment = & io_module->dataSegments [i];
 
+        // passive segments stay in the wasm binary until a memory.init touches them
+        if (segment->isPassive)
+            continue;
+
         i32 segmentOffset;
         bytes_t start = segment->initExpr;
 _       (EvaluateExpression (io_module, & segmentOffset, c_m3Type_i32, & start, segment->initExpr + segment->initExprSize));
@@ -473,6 +548,7 @@ _       (EvaluateExpression (io_module, & segmentOffset, c_m3Type_i32, & start,
         {
             u8 * dest = m3MemData (io_memory->mallocated) + segmentOffset;
             memcpy (dest, segment->data, segment->size);
+            segment->isDropped = true;
         } else {
             _throw ("data segment out of bounds");
         }
@@ -486,22 +562,21 @@ M3Result  InitElements  (IM3Module io_module)
 {
     M3Result result = m3Err_none;
 
-    bytes_t bytes = io_module->elementSection;
-    cbytes_t end = io_module->elementSectionEnd;
-
     for (u32 i = 0; i < io_module->numElementSegments; ++i)
     {
-        u32 index;
-_       (ReadLEB_u32 (& index, & bytes, end));
+        M3ElementSegment * segment = & io_module->elementSegments [i];
 
-        if (index == 0)
+        if (segment->isPassive or segment->isDropped)
+            continue;
+
+        if (segment->tableIndex == 0)
         {
             i32 offset;
-_           (EvaluateExpression (io_module, & offset, c_m3Type_i32, & bytes, end));
+            bytes_t start = segment->initExpr;
+_           (EvaluateExpression (io_module, & offset, c_m3Type_i32, & start, segment->initExpr + segment->initExprSize));
             _throwif ("table underflow", offset < 0);
 
-            u32 numElements;
-_           (ReadLEB_u32 (& numElements, & bytes, end));
+            u32 numElements = segment->size;
 
             size_t endElement = (size_t) numElements + offset;
             _throwif ("table overflow", endElement > d_m3MaxSaneTableSize);
@@ -510,19 +585,23 @@ _           (ReadLEB_u32 (& numElements, & bytes, end));
             // make sure the table isn't shrunk.
             if (endElement > io_module->table0Size)
             {
-                io_module->table0 = m3_ReallocArray (IM3Function, io_module->table0, endElement, io_module->table0Size);
+                io_module->table0 = m3_AllocatorReallocArray (& io_module->allocator, IM3Function, io_module->table0, endElement, io_module->table0Size);
                 io_module->table0Size = (u32) endElement;
             }
             _throwifnull(io_module->table0);
 
             for (u32 e = 0; e < numElements; ++e)
             {
-                u32 functionIndex;
-_               (ReadLEB_u32 (& functionIndex, & bytes, end));
-                _throwif ("function index out of range", functionIndex >= io_module->numFunctions);
-                IM3Function function = & io_module->functions [functionIndex];      d_m3Assert (function); //printf ("table: %s\n", m3_GetFunctionName(function));
+                u32 functionIndex = segment->functionIndices [e];
+                IM3Function function = NULL;
+
+                if (functionIndex != c_m3NullFunctionIndex)
+                    function = & io_module->functions [functionIndex];          //printf ("table: %s\n", m3_GetFunctionName(function));
+
                 io_module->table0 [e + offset] = function;
             }
+
+            segment->isDropped = true;
         }
         else _throw ("element table index must be zero for MVP");
     }
@@ -575,7 +654,7 @@ _           (CompileFunction (function));
         startFunctionTmp = io_module->startFunction;
         io_module->startFunction = -1;
 
-# if (d_m3EnableOpProfiling || d_m3EnableOpTracing)
+# if d_m3EnableOpTracing
         result = (M3Result) RunCode (function->compiled, (m3stack_t) runtime->stack, runtime->memory.mallocated, d_m3OpDefaultArgs, d_m3BaseCstr);
 # else
         result = (M3Result) RunCode (function->compiled, (m3stack_t) runtime->stack, runtime->memory.mallocated, d_m3OpDefaultArgs);
@@ -601,6 +680,10 @@ M3Result  m3_LoadModule  (IM3Runtime io_runtime, IM3Module io_module)
         return m3Err_moduleAlreadyLinked;
     }
 
+    if (M3_UNLIKELY(io_module->streamRuntime and io_module->streamRuntime != io_runtime)) {
+        return "module was compiled for another runtime";
+    }
+
     io_module->runtime = io_runtime;
     M3Memory * memory = & io_runtime->memory;
 
@@ -616,6 +699,8 @@ _   (InitElements (io_module));
     Module_GenerateNames(io_module);
 #endif
 
+_   (Module_IndexSymbols (io_module));
+
     io_module->next = io_runtime->modules;
     io_runtime->modules = io_module;
     return result; // ok
@@ -628,30 +713,16 @@ _catch:
 IM3Global  m3_FindGlobal  (IM3Module               io_module,
                            const char * const      i_globalName)
 {
-    // Search exports
-    for (u32 i = 0; i < io_module->numGlobals; ++i)
-    {
-        IM3Global g = & io_module->globals [i];
-        if (g->name and strcmp (g->name, i_globalName) == 0)
-        {
-            return g;
-        }
-    }
+    if (Module_IndexSymbols (io_module))
+        return NULL;
 
-    // Search imports
-    for (u32 i = 0; i < io_module->numGlobals; ++i)
-    {
-        IM3Global g = & io_module->globals [i];
+    // Search exports, then imports
+    M3Symbol * symbol = Module_FindSymbol (io_module, c_m3Symbol_globalExport, i_globalName, NULL);
 
-        if (g->import.moduleUtf8 and g->import.fieldUtf8)
-        {
-            if (strcmp (g->import.fieldUtf8, i_globalName) == 0)
-            {
-                return g;
-            }
-        }
-    }
-    return NULL;
+    if (not symbol)
+        symbol = Module_FindSymbol (io_module, c_m3Symbol_globalImport, i_globalName, NULL);
+
+    return symbol ? & io_module->globals [symbol->index] : NULL;
 }
 
 M3Result  m3_GetGlobal  (IM3Global                 i_global,
@@ -701,33 +772,16 @@ M3ValueType  m3_GetGlobalType  (IM3Global          i_global)
 
 void *  v_FindFunction  (IM3Module i_module, const char * const i_name)
 {
+    if (Module_IndexSymbols (i_module))
+        return NULL;
 
-    // Prefer exported functions
-    for (u32 i = 0; i < i_module->numFunctions; ++i)
-    {
-        IM3Function f = & i_module->functions [i];
-        if (f->export_name and strcmp (f->export_name, i_name) == 0)
-            return f;
-    }
-
-    // Search internal functions
-    for (u32 i = 0; i < i_module->numFunctions; ++i)
-    {
-        IM3Function f = & i_module->functions [i];
-
-        bool isImported = f->import.moduleUtf8 or f->import.fieldUtf8;
-
-        if (isImported)
-            continue;
+    // Prefer exported functions, then search internal functions
+    M3Symbol * symbol = Module_FindSymbol (i_module, c_m3Symbol_functionExport, i_name, NULL);
 
-        for (int j = 0; j < f->numNames; j++)
-        {
-            if (f->names [j] and strcmp (f->names [j], i_name) == 0)
-                return f;
-        }
-    }
+    if (not symbol)
+        symbol = Module_FindSymbol (i_module, c_m3Symbol_functionName, i_name, NULL);
 
-    return NULL;
+    return symbol ? & i_module->functions [symbol->index] : NULL;
 }
 
 
@@ -876,6 +930,302 @@ void  ReportNativeStackUsage  ()
 }
 
 
+#if d_m3EnableResumableCalls
+
+typedef struct M3Fiber
+{
+    ucontext_t              host;
+    ucontext_t              guest;
+
+    void *                  mapping;        // guard page followed by the stack
+    size_t                  mappingSize;
+    void *                  stack;
+    size_t                  stackSize;
+    void *                  stackLimit;     // calls entering below this trap with m3Err_trapStackOverflow
+
+    pc_t                    pc;
+    m3stack_t               sp;
+    IM3Function             function;       // becomes runtime->lastCalled once the call completes
+
+    M3Result                result;
+    bool                    active;         // a call is running or suspended on this stack
+    bool                    suspended;
+}
+M3Fiber;
+
+// runtime whose call is executing on its fiber on this thread, or NULL. set around every
+// switch (so a suspended call can be resumed by a different thread) and read from the
+// guest side by Runtime_YieldIfRequested and m3_Suspend
+static __thread IM3Runtime  s_fiberRuntime = NULL;
+
+
+static
+void  RunFiber  (void)
+{
+    IM3Runtime runtime = s_fiberRuntime;
+    M3Fiber * fiber = runtime->fiber;
+
+# if d_m3EnableOpTracing
+    fiber->result = (M3Result) RunCode (fiber->pc, fiber->sp, runtime->memory.mallocated, d_m3OpDefaultArgs, d_m3BaseCstr);
+# else
+    fiber->result = (M3Result) RunCode (fiber->pc, fiber->sp, runtime->memory.mallocated, d_m3OpDefaultArgs);
+# endif
+
+    fiber->active = false;
+}   // returns to fiber->host through uc_link
+
+
+static
+M3Result  SwitchToFiber  (IM3Runtime io_runtime)
+{
+    M3Fiber * fiber = io_runtime->fiber;
+
+    IM3Runtime previous = s_fiberRuntime;
+    s_fiberRuntime = io_runtime;
+
+    fiber->suspended = false;
+    swapcontext (& fiber->host, & fiber->guest);
+
+    s_fiberRuntime = previous;
+
+    if (fiber->suspended)
+        return m3Err_suspended;
+
+    return fiber->result;
+}
+
+
+static
+M3Result  AllocateFiber  (IM3Runtime io_runtime)
+{
+    M3Fiber * fiber = m3_AllocatorAllocStruct (& io_runtime->environment->allocator, M3Fiber);
+    if (not fiber)
+        return m3Err_mallocFailed;
+
+    // every wasm call nests a few native frames, so the stack scales with the wasm stack.
+    // the pages are only committed as they're touched
+    size_t pageSize = (size_t) sysconf (_SC_PAGESIZE);
+    size_t stackSize = M3_MAX ((size_t) d_m3ResumableStackSize, (size_t) io_runtime->numStackSlots * sizeof (m3slot_t) * 4);
+    stackSize = (stackSize + pageSize - 1) & ~(pageSize - 1);
+
+    fiber->mappingSize = pageSize + stackSize;
+    fiber->mapping = mmap (NULL, fiber->mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (fiber->mapping == MAP_FAILED)
+    {
+        m3_AllocatorFree (& io_runtime->environment->allocator, fiber);
+        return m3Err_mallocFailed;
+    }
+
+    // an overrun the entry check can't see (a deep host import) faults instead of corrupting the heap
+    mprotect (fiber->mapping, pageSize, PROT_NONE);
+
+    fiber->stack = (u8 *) fiber->mapping + pageSize;
+    fiber->stackSize = stackSize;
+    fiber->stackLimit = (u8 *) fiber->stack + M3_MIN ((size_t) d_m3ResumableStackReserve, stackSize / 2);
+
+    io_runtime->fiber = fiber;
+
+    return m3Err_none;
+}
+
+
+static
+M3Result  ExecuteCode  (IM3Runtime io_runtime, IM3Function i_function, pc_t i_pc, m3stack_t i_sp)
+{
+    M3Result result = m3Err_none;
+    M3MemoryHeader * mem = io_runtime->memory.mallocated;
+    M3Fiber * fiber = io_runtime->fiber;
+
+    if (fiber)
+    {
+        if (fiber->suspended)
+            return m3Err_runtimeSuspended;
+
+        // a host import calling back into its own runtime just nests on the current stack
+        if (fiber->active)
+        {
+# if d_m3EnableOpTracing
+            return (M3Result) RunCode (i_pc, i_sp, mem, d_m3OpDefaultArgs, d_m3BaseCstr);
+# else
+            return (M3Result) RunCode (i_pc, i_sp, mem, d_m3OpDefaultArgs);
+# endif
+        }
+    }
+
+    if (not io_runtime->suspendable and not io_runtime->suspendRequested)
+    {
+        // nothing can suspend this call: skip the context switches (and their signal mask
+        // syscalls). when nested in another runtime's fiber, stay within its stack limit
+        IM3Runtime outer = s_fiberRuntime;
+        void * previousLimit = mem->nativeStackLimit;
+
+        mem->nativeStackLimit = outer ? outer->fiber->stackLimit : NULL;
+        s_fiberRuntime = NULL;
+
+# if d_m3EnableOpTracing
+        result = (M3Result) RunCode (i_pc, i_sp, mem, d_m3OpDefaultArgs, d_m3BaseCstr);
+# else
+        result = (M3Result) RunCode (i_pc, i_sp, mem, d_m3OpDefaultArgs);
+# endif
+
+        s_fiberRuntime = outer;
+        io_runtime->memory.mallocated->nativeStackLimit = previousLimit;   // the memory may have moved
+
+        return result;
+    }
+
+    if (not fiber)
+    {
+_       (AllocateFiber (io_runtime));
+        fiber = io_runtime->fiber;
+    }
+
+    mem->nativeStackLimit = fiber->stackLimit;
+
+    getcontext (& fiber->guest);
+    fiber->guest.uc_stack.ss_sp = fiber->stack;
+    fiber->guest.uc_stack.ss_size = fiber->stackSize;
+    fiber->guest.uc_link = & fiber->host;
+    makecontext (& fiber->guest, RunFiber, 0);
+
+    fiber->pc = i_pc;
+    fiber->sp = i_sp;
+    fiber->function = i_function;
+    fiber->active = true;
+
+    result = SwitchToFiber (io_runtime);
+
+    _catch: return result;
+}
+
+
+static
+void  ReleaseFiber  (IM3Runtime io_runtime)
+{
+    M3Fiber * fiber = io_runtime->fiber;
+
+    if (fiber)
+    {
+        munmap (fiber->mapping, fiber->mappingSize);
+        m3_AllocatorFree (& io_runtime->environment->allocator, fiber);
+        io_runtime->fiber = NULL;
+    }
+}
+
+
+M3Result  Runtime_YieldIfRequested  (void)
+{
+    IM3Runtime runtime = s_fiberRuntime;
+
+    if (runtime and runtime->suspendRequested)
+        return m3_Suspend (runtime);
+
+    return m3Err_none;
+}
+
+#else
+
+static inline
+M3Result  ExecuteCode  (IM3Runtime io_runtime, IM3Function i_function, pc_t i_pc, m3stack_t i_sp)
+{
+# if d_m3EnableOpTracing
+    return (M3Result) RunCode (i_pc, i_sp, io_runtime->memory.mallocated, d_m3OpDefaultArgs, d_m3BaseCstr);
+# else
+    return (M3Result) RunCode (i_pc, i_sp, io_runtime->memory.mallocated, d_m3OpDefaultArgs);
+# endif
+}
+
+#endif // d_m3EnableResumableCalls
+
+
+M3Result  m3_Suspend  (IM3Runtime io_runtime)
+{
+# if d_m3EnableResumableCalls
+    M3Fiber * fiber = io_runtime->fiber;
+
+    if (not fiber or not fiber->active or s_fiberRuntime != io_runtime)
+        return m3Err_cannotSuspend;
+
+    io_runtime->suspendRequested = false;
+    fiber->suspended = true;
+
+#  if d_m3EnableSampling
+    // a parked call isn't running: keep it out of samples until it resumes
+    M3SampleFrame * frames = io_runtime->sampleFrames;
+    io_runtime->sampleFrames = NULL;
+#  endif
+
+    swapcontext (& fiber->guest, & fiber->host);
+
+#  if d_m3EnableSampling
+    io_runtime->sampleFrames = frames;
+#  endif
+
+    return m3Err_none;
+# else
+    return m3Err_cannotSuspend;
+# endif
+}
+
+
+M3Result  m3_Resume  (IM3Runtime io_runtime)
+{
+# if d_m3EnableResumableCalls
+    M3Fiber * fiber = io_runtime->fiber;
+
+    if (not fiber or not fiber->suspended)
+        return m3Err_notSuspended;
+
+    M3Result result = SwitchToFiber (io_runtime);
+
+    if (result != m3Err_suspended)
+        io_runtime->lastCalled = result ? NULL : fiber->function;
+
+    return result;
+# else
+    return m3Err_notSuspended;
+# endif
+}
+
+
+void  m3_RequestSuspend  (IM3Runtime io_runtime)
+{
+# if d_m3EnableResumableCalls
+    io_runtime->suspendRequested = true;
+# endif
+}
+
+
+void  m3_SetSuspendable  (IM3Runtime io_runtime, bool i_suspendable)
+{
+# if d_m3EnableResumableCalls
+    io_runtime->suspendable = i_suspendable;
+# endif
+}
+
+
+bool  m3_IsSuspended  (IM3Runtime i_runtime)
+{
+# if d_m3EnableResumableCalls
+    return i_runtime->fiber and i_runtime->fiber->suspended;
+# else
+    return false;
+# endif
+}
+
+
+bool  m3_CanSuspend  (IM3Runtime i_runtime)
+{
+# if d_m3EnableResumableCalls
+    M3Fiber * fiber = i_runtime->fiber;
+    return fiber and fiber->active and not fiber->suspended and s_fiberRuntime == i_runtime;
+# else
+    return false;
+# endif
+}
+
+
 M3Result  m3_CallVL  (IM3Function i_function, va_list i_args)
 {
     IM3Runtime runtime = i_function->module->runtime;
@@ -910,11 +1260,7 @@ _   (checkStartFunction(i_function->module))
         }
     }
 
-# if (d_m3EnableOpProfiling || d_m3EnableOpTracing)
-    result = (M3Result) RunCode (i_function->compiled, (m3stack_t)(runtime->stack), runtime->memory.mallocated, d_m3OpDefaultArgs, d_m3BaseCstr);
-# else
-    result = (M3Result) RunCode (i_function->compiled, (m3stack_t)(runtime->stack), runtime->memory.mallocated, d_m3OpDefaultArgs);
-# endif
+    result = ExecuteCode (runtime, i_function, i_function->compiled, (m3stack_t)(runtime->stack));
     ReportNativeStackUsage ();
 
     runtime->lastCalled = result ? NULL : i_function;
@@ -959,11 +1305,7 @@ _   (checkStartFunction(i_function->module))
         }
     }
 
-# if (d_m3EnableOpProfiling || d_m3EnableOpTracing)
-    result = (M3Result) RunCode (i_function->compiled, (m3stack_t)(runtime->stack), runtime->memory.mallocated, d_m3OpDefaultArgs, d_m3BaseCstr);
-# else
-    result = (M3Result) RunCode (i_function->compiled, (m3stack_t)(runtime->stack), runtime->memory.mallocated, d_m3OpDefaultArgs);
-# endif
+    result = ExecuteCode (runtime, i_function, i_function->compiled, (m3stack_t)(runtime->stack));
 
     ReportNativeStackUsage ();
 
@@ -1009,11 +1351,7 @@ _   (checkStartFunction(i_function->module))
         }
     }
 
-# if (d_m3EnableOpProfiling || d_m3EnableOpTracing)
-    result = (M3Result) RunCode (i_function->compiled, (m3stack_t)(runtime->stack), runtime->memory.mallocated, d_m3OpDefaultArgs, d_m3BaseCstr);
-# else
-    result = (M3Result) RunCode (i_function->compiled, (m3stack_t)(runtime->stack), runtime->memory.mallocated, d_m3OpDefaultArgs);
-# endif
+    result = ExecuteCode (runtime, i_function, i_function->compiled, (m3stack_t)(runtime->stack));
     
     ReportNativeStackUsage ();
 
@@ -1023,6 +1361,124 @@ _   (checkStartFunction(i_function->module))
 }
 
 
+M3Result  m3_PrepareCall  (IM3PreparedCall * o_call, IM3Function i_function)
+{
+    IM3PreparedCall call = NULL;
+
+_try {
+    _throwif (m3Err_functionLookupFailed, not i_function);
+    _throwif (m3Err_missingCompiledCode, not i_function->compiled);
+
+    IM3Runtime runtime = i_function->module->runtime;
+    _throwif (m3Err_moduleNotLinked, not runtime);
+
+    IM3FuncType ftype = i_function->funcType;
+
+    call = (IM3PreparedCall) m3_AllocatorMalloc (& runtime->environment->allocator, sizeof (M3PreparedCall) + sizeof (M3Value) * ftype->numArgs);
+    _throwifnull (call);
+
+    call->function = i_function;
+    call->runtime = runtime;
+    call->code = i_function->compiled;
+    call->numArgs = ftype->numArgs;
+    call->numRets = ftype->numRets;
+
+} _catch:
+    * o_call = call;
+    return result;
+}
+
+
+void  m3_FreePreparedCall  (IM3PreparedCall i_call)
+{
+    if (i_call)
+        m3_AllocatorFree (& i_call->runtime->environment->allocator, i_call);
+}
+
+
+M3Value *  m3_GetPreparedArgs  (IM3PreparedCall i_call)
+{
+    return i_call->args;
+}
+
+
+const M3Value *  m3_GetPreparedResults  (IM3PreparedCall i_call)
+{
+    return (const M3Value *) i_call->runtime->stack;
+}
+
+
+static inline
+M3Result  RunPreparedCall  (IM3PreparedCall i_call, const M3Value * i_args)
+{
+    IM3Runtime runtime = i_call->runtime;
+    M3Value * stack = (M3Value *) runtime->stack;
+
+# if d_m3RecordBacktraces
+    ClearBacktrace (runtime);
+# endif
+
+    m3StackCheckInit();
+
+    memcpy (stack + i_call->numRets, i_args, sizeof (M3Value) * i_call->numArgs);
+
+    M3Result result = ExecuteCode (runtime, i_call->function, i_call->code, (m3stack_t) stack);
+
+    ReportNativeStackUsage ();
+
+    return result;
+}
+
+
+M3Result  m3_CallPrepared  (IM3PreparedCall i_call)
+{
+    M3Result result = m3Err_none;
+    IM3Function function = i_call->function;
+
+    if (M3_UNLIKELY (function->module->startFunction >= 0))
+    {
+_       (checkStartFunction (function->module));
+    }
+
+    result = RunPreparedCall (i_call, i_call->args);
+
+    i_call->runtime->lastCalled = result ? NULL : function;
+
+    _catch: return result;
+}
+
+
+M3Result  m3_CallPreparedBatch  (IM3PreparedCall i_call, uint32_t i_count, const M3Value * i_args, M3Value * o_results, uint32_t * o_numCompleted)
+{
+    M3Result result = m3Err_none;
+    IM3Function function = i_call->function;
+    const M3Value * results = (const M3Value *) i_call->runtime->stack;
+    u32 i = 0;
+
+    if (M3_UNLIKELY (function->module->startFunction >= 0))
+    {
+_       (checkStartFunction (function->module));
+    }
+
+    for (; i < i_count; ++i)
+    {
+_       (RunPreparedCall (i_call, i_args));
+        i_args += i_call->numArgs;
+
+        memcpy (o_results, results, sizeof (M3Value) * i_call->numRets);
+        o_results += i_call->numRets;
+    }
+
+    _catch:
+    i_call->runtime->lastCalled = result ? NULL : function;
+
+    if (o_numCompleted)
+        * o_numCompleted = i;
+
+    return result;
+}
+
+
 //u8 * AlignStackPointerTo64Bits (const u8 * i_stack)
 //{
 //    uintptr_t ptr = (uintptr_t) i_stack;
@@ -1228,6 +1684,104 @@ uint32_t  m3_GetMemorySize  (IM3Runtime i_runtime)
 }
 
 
+M3Result  m3_SetFuel  (IM3Runtime i_runtime, uint64_t i_fuel)
+{
+# if d_m3EnableFuelMetering
+    if (not i_runtime->memory.mallocated)
+        return m3Err_moduleNotLinked;
+
+    i_runtime->memory.mallocated->fuel = i_fuel;
+    return m3Err_none;
+# else
+    return m3Err_fuelMeteringDisabled;
+# endif
+}
+
+
+uint64_t  m3_GetFuel  (IM3Runtime i_runtime)
+{
+# if d_m3EnableFuelMetering
+    if (i_runtime->memory.mallocated)
+        return i_runtime->memory.mallocated->fuel;
+# endif
+    return UINT64_MAX;
+}
+
+
+#if d_m3EnableInterrupts
+
+static
+u64  GetMonotonicTime  (void)
+{
+# if defined(_WIN32)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency (& frequency);
+    QueryPerformanceCounter (& counter);
+    return (u64) (counter.QuadPart / frequency.QuadPart) * 1000000000ull
+         + (u64) (counter.QuadPart % frequency.QuadPart) * 1000000000ull / frequency.QuadPart;
+# elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, & ts);
+    return (u64) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+# else
+    struct timespec ts;
+    timespec_get (& ts, TIME_UTC);
+    return (u64) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+# endif
+}
+
+
+M3Result  Runtime_PollInterrupt  (IM3Runtime io_runtime)
+{
+    // consume the request, so one m3_Interrupt stops one call
+    if (m3_AtomicExchange32 (& io_runtime->interrupt, 0))
+        return m3Err_trapInterrupted;
+
+    if (io_runtime->deadlineTicks and --io_runtime->deadlineTicks == 0)
+    {
+        if (GetMonotonicTime () >= io_runtime->deadline)
+        {
+            io_runtime->deadlineTicks = 1;      // keep trapping on every poll until the deadline is reset
+            return m3Err_trapDeadlineExceeded;
+        }
+
+        io_runtime->deadlineTicks = d_m3DeadlineCheckInterval;
+    }
+
+    return m3Err_none;
+}
+
+#endif // d_m3EnableInterrupts
+
+
+M3Result  m3_Interrupt  (IM3Runtime i_runtime)
+{
+# if d_m3EnableInterrupts
+    m3_AtomicStore32 (& i_runtime->interrupt, 1);
+    return m3Err_none;
+# else
+    return m3Err_interruptsDisabled;
+# endif
+}
+
+
+M3Result  m3_SetDeadline  (IM3Runtime i_runtime, uint64_t i_nanoseconds)
+{
+# if d_m3EnableInterrupts
+    if (i_nanoseconds)
+    {
+        i_runtime->deadline = GetMonotonicTime () + i_nanoseconds;
+        i_runtime->deadlineTicks = 1;                   // first poll reads the clock
+    }
+    else i_runtime->deadlineTicks = 0;
+
+    return m3Err_none;
+# else
+    return m3Err_interruptsDisabled;
+# endif
+}
+
+
 M3BacktraceInfo *  m3_GetBacktrace  (IM3Runtime i_runtime)
 {
 # if d_m3RecordBacktraces
@@ -49,9 +49,29 @@ typedef struct M3DataSegment
     u32                     initExprSize;
     u32                     memoryRegion;
     u32                     size;
+
+    bool                    isPassive;          // only copied by memory.init
+    bool                    isDropped;          // set by data.drop; active segments are dropped once loaded
 }
 M3DataSegment;
 
+
+#define c_m3NullFunctionIndex       0xFFFFFFFF
+
+typedef struct M3ElementSegment
+{
+    const u8 *              initExpr;           // wasm code
+    u32 *                   functionIndices;    // c_m3NullFunctionIndex marks a ref.null element
+
+    u32                     initExprSize;
+    u32                     tableIndex;
+    u32                     size;
+
+    bool                    isPassive;          // only copied by table.init
+    bool                    isDropped;          // set by elem.drop; active & declarative segments are dropped once loaded
+}
+M3ElementSegment;
+
 //---------------------------------------------------------------------------------------------------------------------------------
 
 typedef struct M3Global
@@ -78,6 +98,28 @@ typedef struct M3Global
 M3Global;
 
 
+//---------------------------------------------------------------------------------------------------------------------------------
+
+enum
+{
+    c_m3Symbol_none,
+    c_m3Symbol_functionExport,
+    c_m3Symbol_functionName,        // name-section / generated names of defined functions
+    c_m3Symbol_functionImport,      // keyed by field name
+    c_m3Symbol_globalExport,
+    c_m3Symbol_globalImport         // keyed by field name
+};
+
+typedef struct M3Symbol
+{
+    cstr_t                  name;
+    u32                     hash;
+    u32                     index;          // into functions or globals
+    u8                      kind;
+}
+M3Symbol;
+
+
 //---------------------------------------------------------------------------------------------------------------------------------
 typedef struct M3Module
 {
@@ -86,6 +128,19 @@ typedef struct M3Module
 
     bytes_t                 wasmStart;
     bytes_t                 wasmEnd;
+    u32                     wasmStartOffset;        // binary offset of wasmStart; a streamed module points it at its code section
+
+    void *                  wasmMapping;            // owned binary from m3_ParseModuleFile
+    size_t                  wasmMappingSize;
+
+    void **                 streamSections;         // owned sections from m3_FeedModuleStream
+    u32                     numStreamSections;
+    struct M3Runtime *      streamRuntime;          // function bodies were compiled into this runtime while streaming
+
+    M3Allocator             allocator;              // module-lifetime allocations: the arena, or the environment's allocator
+#if d_m3EnableModuleArena
+    M3Arena                 arena;
+#endif
 
     cstr_t                  name;
 
@@ -101,14 +156,15 @@ typedef struct M3Module
 
     u32                     numDataSegments;
     M3DataSegment *         dataSegments;
+    bool                    hasDataCount;           // memory.init & data.drop are only valid with a DataCount section
 
     //u32                     importedGlobals;
     u32                     numGlobals;
+    u32                     allGlobals;             // allocated globals count
     M3Global *              globals;
 
     u32                     numElementSegments;
-    bytes_t                 elementSection;
-    bytes_t                 elementSectionEnd;
+    M3ElementSegment *      elementSegments;
 
     IM3Function *           table0;
     u32                     table0Size;
@@ -121,10 +177,17 @@ typedef struct M3Module
 
     //bool                    hasWasmCodeCopy;
 
+    M3Symbol *              symbols;                // open-addressed name index; rebuilt on demand after functions or globals are added
+    u32                     symbolsMask;
+    bool                    symbolsIndexed;
+
     struct M3Module *       next;
 }
 M3Module;
 
+M3Result                    Module_New                  (IM3Environment i_environment, IM3Module * o_module);
+
+M3Result                    Module_PreallocGlobals      (IM3Module io_module, u32 i_totalGlobals);
 M3Result                    Module_AddGlobal            (IM3Module io_module, IM3Global * o_global, u8 i_type, bool i_mutable, bool i_isImported);
 
 M3Result                    Module_PreallocFunctions    (IM3Module io_module, u32 i_totalFunctions);
@@ -133,7 +196,11 @@ IM3Function                 Module_GetFunction          (IM3Module i_module, u32
 
 void                        Module_GenerateNames        (IM3Module i_module);
 
-void                        FreeImportInfo              (M3ImportInfo * i_info);
+M3Result                    Module_IndexSymbols         (IM3Module io_module);
+// pass the previous match as i_previous to continue with the next symbol of the same name & kind
+M3Symbol *                  Module_FindSymbol           (IM3Module i_module, u8 i_kind, cstr_t i_name, M3Symbol * i_previous);
+
+void                        FreeImportInfo              (M3ImportInfo * i_info, IM3Allocator i_allocator);
 
 //---------------------------------------------------------------------------------------------------------------------------------
 
@@ -148,6 +215,8 @@ typedef struct M3Environment
     M3CodePage *            pagesReleased;
 
     M3SectionHandler        customSectionHandler;
+
+    M3Allocator             allocator;
 }
 M3Environment;
 
@@ -158,6 +227,17 @@ void                        Environment_AddFuncType     (IM3Environment i_enviro
 
 //---------------------------------------------------------------------------------------------------------------------------------
 
+#if d_m3EnableSampling
+// shadow call stack read by the sampling profiler: op_Entry and op_CallRawFunction link one
+// of these on the native stack for every call in progress
+typedef struct M3SampleFrame
+{
+    IM3Function volatile                function;
+    struct M3SampleFrame * volatile     caller;
+}
+M3SampleFrame;
+#endif
+
 typedef struct M3Runtime
 {
     M3Compilation           compilation;
@@ -180,6 +260,9 @@ typedef struct M3Runtime
 
     void *                  userdata;
 
+    void *                  wasi;           // state of the linked WASI implementation; see releaseWasi
+    void                 (* releaseWasi)    (IM3Runtime i_runtime);
+
     M3Memory                memory;
     u32                     memoryLimit;
 
@@ -196,13 +279,59 @@ typedef struct M3Runtime
     M3BacktraceInfo         backtrace;
 #endif
 
+#if d_m3EnableSampling
+    M3SampleFrame * volatile    sampleFrames;   // innermost call executing on this runtime
+#endif
+
+#if d_m3EnableOpProfiling
+    IM3Function             profiledFunction;   // function whose ops are being counted
+    M3ProfilerStats         profilerStats;      // last m3_GetProfilerStats snapshot
+    void *                  profilerStatsData;
+#endif
+
 	u32						newCodePageSequence;
+
+#if d_m3EnableInterrupts
+    u32                     interrupt;      // set by m3_Interrupt, possibly from another thread; only accessed through m3_Atomic*
+    u32                     deadlineTicks;  // polls left until the clock is read; zero when no deadline is armed
+    u64                     deadline;       // monotonic, in nanoseconds
+#endif
+
+#if d_m3EnableResumableCalls
+    struct M3Fiber *        fiber;          // native stack and contexts for suspendable calls; see m3_Suspend
+    bool                    suspendable;    // run calls on the fiber; see m3_SetSuspendable
+    volatile bool           suspendRequested;
+#endif
 }
 M3Runtime;
 
+typedef struct M3PreparedCall
+{
+    IM3Function             function;
+    IM3Runtime              runtime;
+    pc_t                    code;
+
+    u32                     numArgs;
+    u32                     numRets;
+
+    M3Value                 args [];
+}
+M3PreparedCall;
+
+
 void                        InitRuntime                 (IM3Runtime io_runtime, u32 i_stackSizeInBytes);
 void                        Runtime_Release             (IM3Runtime io_runtime);
 
+#if d_m3EnableInterrupts
+// slow path of the interrupt poll in op_Entry and op_Loop: returns a trap once interrupted or past the deadline
+M3Result                    Runtime_PollInterrupt       (IM3Runtime io_runtime);
+#endif
+
+#if d_m3EnableResumableCalls
+// suspends the call executing on this thread if m3_RequestSuspend was called for its runtime
+M3Result                    Runtime_YieldIfRequested    (void);
+#endif
+
 M3Result                    ResizeMemory                (IM3Runtime io_runtime, u32 i_numPages);
 
 typedef void *              (* ModuleVisitor)           (IM3Module i_module, void * i_info);
@@ -260,10 +260,7 @@ static inline f64  m3LoadLocalFp  (m3stack_t i_sp, u16 i_slot, u8 i_type)
 #endif // d_m3EnableLocalRegCaching
 
 
-# if d_m3EnableOpProfiling
-                                    d_m3RetSig  profileOp   (d_m3OpSig, cstr_t i_operationName);
-#   define nextOp()                 M3_MUSTTAIL return profileOp (d_m3OpAllArgs, __FUNCTION__)
-# elif d_m3EnableOpTracing
+# if d_m3EnableOpTracing
                                     d_m3RetSig  debugOp     (d_m3OpSig, cstr_t i_operationName);
 #   define nextOp()                 M3_MUSTTAIL return debugOp (d_m3OpAllArgs, __FUNCTION__)
 # else
@@ -323,7 +320,24 @@ static inline f64  m3LoadLocalFp  (m3stack_t i_sp, u16 i_slot, u8 i_type)
 
 #endif
 
-# if (d_m3EnableOpProfiling || d_m3EnableOpTracing)
+#if d_m3EnableInterrupts
+    // two loads and a branch unless an interrupt is pending or a deadline is armed
+#   define m3PollInterrupt()                                                   \
+    {                                                                          \
+        IM3Runtime pollRuntime = _mem->runtime;                                \
+        if (M3_UNLIKELY (m3_AtomicPeek32 (& pollRuntime->interrupt) |          \
+                         pollRuntime->deadlineTicks))                          \
+        {                                                                      \
+            m3ret_t pollTrap = Runtime_PollInterrupt (pollRuntime);            \
+            if (pollTrap)                                                      \
+                newTrap (pollTrap);                                            \
+        }                                                                      \
+    }
+#else
+#   define m3PollInterrupt()
+#endif
+
+# if d_m3EnableOpTracing
 d_m3RetSig  Call  (d_m3OpSig, cstr_t i_operationName)
 # else
 d_m3RetSig  Call  (d_m3OpSig)
@@ -762,7 +776,7 @@ d_m3Op  (Call)
 
     m3stack_t sp = _sp + stackOffset;
 
-# if (d_m3EnableOpProfiling || d_m3EnableOpTracing)
+# if d_m3EnableOpTracing
     m3ret_t r = Call (callPC, sp, _mem, d_m3OpDefaultArgs, d_m3BaseCstr);
 # else
     m3ret_t r = Call (callPC, sp, _mem, d_m3OpDefaultArgs);
@@ -812,7 +826,7 @@ d_m3Op  (CallIndirect)
                 if (M3_LIKELY(not r))
                 {
 
-# if (d_m3EnableOpProfiling || d_m3EnableOpTracing)
+# if d_m3EnableOpTracing
                     r = Call (function->compiled, sp, _mem, d_m3OpDefaultArgs, d_m3BaseCstr);
 # else
                     r = Call (function->compiled, sp, _mem, d_m3OpDefaultArgs);
@@ -895,20 +909,36 @@ d_m3Op  (CallRawFunction)
     // I.e. exported/table function can be called from an impoted function.
     void* stack_backup = runtime->stack;
     runtime->stack = sp;
+#if d_m3EnableSampling
+    // time spent in the host is charged to the import
+    M3SampleFrame frame;
+    frame.function = ctx.function;
+    frame.caller = runtime->sampleFrames;
+    runtime->sampleFrames = & frame;
+#endif
     m3ret_t possible_trap = call (runtime, &ctx, sp, m3MemData(_mem));
+#if d_m3EnableSampling
+    runtime->sampleFrames = frame.caller;
+#endif
     runtime->stack = stack_backup;
 
 #if d_m3EnableStrace
     if (M3_UNLIKELY(possible_trap)) {
         d_m3TracePrint("%s -> %s", outbuff, (char*)possible_trap);
     } else {
-        switch (GetSingleRetType(ftype)) {
-        case c_m3Type_none: d_m3TracePrint("%s", outbuff); break;
-        case c_m3Type_i32:  d_m3TracePrint("%s = %" PRIi32, outbuff, *(i32*)sp); break;
-        case c_m3Type_i64:  d_m3TracePrint("%s = %" PRIi64, outbuff, *(i64*)sp); break;
-        case c_m3Type_f32:  d_m3TracePrint("%s = %" PRIf32, outbuff, *(f32*)sp); break;
-        case c_m3Type_f64:  d_m3TracePrint("%s = %" PRIf64, outbuff, *(f64*)sp); break;
+        if (nRets) outp += snprintf(outp, oute-outp, " = ");
+        for (int i=0; i<nRets; i++) {
+            const int type = ftype->types[i];
+            switch (type) {
+            case c_m3Type_i32:  outp += snprintf(outp, oute-outp, "%" PRIi32, *(i32*)(sp+i)); break;
+            case c_m3Type_i64:  outp += snprintf(outp, oute-outp, "%" PRIi64, *(i64*)(sp+i)); break;
+            case c_m3Type_f32:  outp += snprintf(outp, oute-outp, "%" PRIf32, *(f32*)(sp+i)); break;
+            case c_m3Type_f64:  outp += snprintf(outp, oute-outp, "%" PRIf64, *(f64*)(sp+i)); break;
+            default:            outp += snprintf(outp, oute-outp, "<type %d>", type);        break;
+            }
+            if (i < nRets-1) outp += snprintf(outp, oute-outp, ", ");
         }
+        d_m3TracePrint("%s", outbuff);
     }
 #endif
 
@@ -920,6 +950,24 @@ d_m3Op  (CallRawFunction)
 }
 
 
+d_m3Op  (CallTypedFunction)
+{
+    M3TypedThunk thunk = immediate (M3TypedThunk);
+    const void * function = immediate (const void *);
+
+#if d_m3EnableStrace
+    d_m3TracePrepare
+    IM3Function func = immediate (IM3Function);
+    d_m3TracePrint("%s!%s(<typed>)", func->import.moduleUtf8, func->import.fieldUtf8);
+#endif
+
+    // no import context, stack swap or trap path: typed imports can't reenter the runtime or fail
+    thunk ((u64 *) _sp, function);
+
+    return m3Err_none;
+}
+
+
 d_m3Op  (MemSize)
 {
     IM3Memory memory            = m3MemInfo (_mem);
@@ -997,6 +1045,94 @@ d_m3Op  (MemFill)
 }
 
 
+d_m3Op  (MemInit)
+{
+    u32 size = (u32) _r0;
+    u64 source = slot (u32);
+    u64 destination = slot (u32);
+    M3DataSegment * segment = immediate (M3DataSegment *);
+
+    u32 segmentSize = segment->isDropped ? 0 : segment->size;
+
+    if (M3_LIKELY(destination + size <= _mem->length))
+    {
+        if (M3_LIKELY(source + size <= segmentSize))
+        {
+            u8 * dst = m3MemData (_mem) + destination;
+            memcpy (dst, segment->data + source, size);
+
+            nextOp ();
+        }
+        else d_outOfBoundsMemOp (source, size);
+    }
+    else d_outOfBoundsMemOp (destination, size);
+}
+
+
+d_m3Op  (DataDrop)
+{
+    M3DataSegment * segment = immediate (M3DataSegment *);
+
+    segment->isDropped = true;
+
+    nextOp ();
+}
+
+
+d_m3Op  (TableInit)
+{
+    u32 size = (u32) _r0;
+    u64 source = slot (u32);
+    u64 destination = slot (u32);
+    IM3Module module = immediate (IM3Module);
+    M3ElementSegment * segment = immediate (M3ElementSegment *);
+
+    u32 segmentSize = segment->isDropped ? 0 : segment->size;
+
+    if (M3_LIKELY(destination + size <= module->table0Size and source + size <= segmentSize))
+    {
+        for (u32 i = 0; i < size; ++i)
+        {
+            u32 functionIndex = segment->functionIndices [source + i];
+
+            module->table0 [destination + i] = (functionIndex != c_m3NullFunctionIndex) ?
+                                               & module->functions [functionIndex] : NULL;
+        }
+
+        nextOp ();
+    }
+    else newTrap (m3Err_trapTableOutOfBounds);
+}
+
+
+d_m3Op  (ElemDrop)
+{
+    M3ElementSegment * segment = immediate (M3ElementSegment *);
+
+    segment->isDropped = true;
+
+    nextOp ();
+}
+
+
+d_m3Op  (TableCopy)
+{
+    u32 size = (u32) _r0;
+    u64 source = slot (u32);
+    u64 destination = slot (u32);
+    IM3Module module = immediate (IM3Module);
+
+    if (M3_LIKELY(destination + size <= module->table0Size and source + size <= module->table0Size))
+    {
+        if (size)
+            memmove (module->table0 + destination, module->table0 + source, size * sizeof (IM3Function));
+
+        nextOp ();
+    }
+    else newTrap (m3Err_trapTableOutOfBounds);
+}
+
+
 // it's a debate: should the compilation be trigger be the caller or callee page.
 // it's a much easier to put it in the caller pager. if it's in the callee, either the entire page
 // has be left dangling or it's just a stub that jumps to a newly acquired page.  In Gestalt, I opted
@@ -1026,6 +1162,67 @@ d_m3Op  (Compile)
 
 
 
+// what every wasm function starts with: the stack headroom check, the fuel charge, the
+// interrupt poll and its locals zeroed with the constants copied in behind them. the
+// top sample frame and the profiled function become i_function. op_Entry runs this
+// for calls, PrepareTailCall for tail calls that jump past op_Entry
+static inline
+m3ret_t  EnterFunction  (IM3Function i_function, m3stack_t i_sp, M3MemoryHeader * i_mem)
+{
+#if d_m3SkipStackCheck
+#elif d_m3EnableResumableCalls
+    // fiber stacks are small: trap before the native recursion reaches the guard page
+    if (M3_UNLIKELY ((void *) (i_sp + i_function->maxStackSlots) >= i_mem->maxStack or
+                     __builtin_frame_address (0) < i_mem->nativeStackLimit))
+        return m3Err_trapStackOverflow;
+#else
+    if (M3_UNLIKELY ((void *) (i_sp + i_function->maxStackSlots) >= i_mem->maxStack))
+        return m3Err_trapStackOverflow;
+#endif
+#if defined(DEBUG)
+    i_function->hits++;
+#endif
+#if d_m3EnableFuelMetering
+    if (M3_UNLIKELY (i_mem->fuel < i_function->fuelCost))
+        return m3Err_trapOutOfFuel;
+
+    i_mem->fuel -= i_function->fuelCost;
+#endif
+#if d_m3EnableInterrupts
+    IM3Runtime runtime = i_mem->runtime;
+    if (M3_UNLIKELY (m3_AtomicPeek32 (& runtime->interrupt) | runtime->deadlineTicks))
+    {
+        m3ret_t r = Runtime_PollInterrupt (runtime);
+        if (r)
+            return r;
+    }
+#endif
+
+    u8 * stack = (u8 *) ((m3slot_t *) i_sp + i_function->numRetAndArgSlots);
+
+    memset (stack, 0x0, i_function->numLocalBytes);
+    stack += i_function->numLocalBytes;
+
+    if (i_function->constants)
+    {
+        memcpy (stack, i_function->constants, i_function->numConstantBytes);
+    }
+
+#if d_m3EnableSampling
+    // op_Entry has pushed a frame for the call; a tail call takes over the caller's
+    M3SampleFrame * frame = i_mem->runtime->sampleFrames;
+    if (frame)
+        frame->function = i_function;
+#endif
+#if d_m3EnableOpProfiling
+    i_mem->runtime->profiledFunction = i_function;
+    i_function->numProfiledCalls++;
+#endif
+
+    return m3Err_none;
+}
+
+
 d_m3Op  (Entry)
 {
     d_m3ClearRegisters
@@ -1035,25 +1232,23 @@ d_m3Op  (Entry)
     IM3Function function = immediate (IM3Function);
     IM3Memory memory = m3MemInfo (_mem);
 
-#if d_m3SkipStackCheck
-    if (true)
-#else
-    if (M3_LIKELY ((void *) (_sp + function->maxStackSlots) < _mem->maxStack))
+#if d_m3EnableSampling
+    IM3Runtime sampled = m3MemRuntime (_mem);
+    M3SampleFrame frame;
+    frame.function = function;
+    frame.caller = sampled->sampleFrames;
+    sampled->sampleFrames = & frame;
 #endif
-    {
-#if defined(DEBUG)
-        function->hits++;
-#endif
-        u8 * stack = (u8 *) ((m3slot_t *) _sp + function->numRetAndArgSlots);
 
-        memset (stack, 0x0, function->numLocalBytes);
-        stack += function->numLocalBytes;
+#if d_m3EnableOpProfiling
+    IM3Runtime profiled = m3MemRuntime (_mem);
+    IM3Function profiledCaller = profiled->profiledFunction;
+#endif
 
-        if (function->constants)
-        {
-            memcpy (stack, function->constants, function->numConstantBytes);
-        }
+    m3ret_t r = EnterFunction (function, _sp, _mem);
 
+    if (M3_LIKELY (not r))
+    {
 #if d_m3EnableStrace >= 2
         d_m3TracePrint("%s %s {", m3_GetFunctionName(function), SPrintFunctionArgList (function, _sp + function->numRetSlots));
         trace_rt->callDepth++;
@@ -1063,22 +1258,17 @@ d_m3Op  (Entry)
         M3_RELOAD_LOCAL_REGS (function);
 #endif
 
-        m3ret_t r = nextOpImpl ();
+        r = nextOpImpl ();
 
 #if d_m3EnableStrace >= 2
         trace_rt->callDepth--;
 
         if (r) {
             d_m3TracePrint("} !trap = %s", (char*)r);
+        } else if (function->funcType->numRets) {
+            d_m3TracePrint("} = %s", SPrintFunctionRetList (function, _sp));
         } else {
-            int rettype = GetSingleRetType(function->funcType);
-            if (rettype != c_m3Type_none) {
-                char str [128] = { 0 };
-                SPrintArg (str, 127, _sp, rettype);
-                d_m3TracePrint("} = %s", str);
-            } else {
-                d_m3TracePrint("}");
-            }
+            d_m3TracePrint("}");
         }
 #endif
 
@@ -1086,9 +1276,109 @@ d_m3Op  (Entry)
             _mem = memory->mallocated;
             fillBacktraceFrame ();
         }
-        forwardTrap (r);
     }
-    else newTrap (m3Err_trapStackOverflow);
+    else pushBacktraceFrame ();
+
+#if d_m3EnableOpProfiling
+    profiled->profiledFunction = profiledCaller;
+#endif
+#if d_m3EnableSampling
+    sampled->sampleFrames = frame.caller;
+#endif
+
+    forwardTrap (r);
+}
+
+
+// replaces the calling frame with the callee's: the staged args are moved down to the
+// base of the current frame and, for wasm functions, the work of op_Entry is done here
+// so the callee body can be jumped to without growing the native stack.
+static inline
+m3ret_t  PrepareTailCall  (pc_t * o_pc, IM3Function i_function, m3stack_t i_sp, M3MemoryHeader * i_mem, i32 i_stackOffset)
+{
+    m3ret_t r = m3Err_none;
+
+    if (M3_UNLIKELY (not i_function->compiled))
+        r = CompileFunction (i_function);
+
+    if (not r)
+        r = m3_Yield ();
+
+    if (r)
+        return r;
+
+    IM3FuncType type = i_function->funcType;
+    const u32 ioSlotCount = sizeof (u64) / sizeof (m3slot_t);
+    u32 numRetSlots = type->numRets * ioSlotCount;
+
+    memmove (i_sp + numRetSlots, i_sp + i_stackOffset + numRetSlots, type->numArgs * ioSlotCount * sizeof (m3slot_t));
+
+    pc_t pc = i_function->compiled;
+
+    if (* (IM3Operation *) pc == op_Entry)
+    {
+        r = EnterFunction (i_function, i_sp, i_mem);
+
+        pc += 2;    // skip op_Entry and its function immediate
+    }
+
+    * o_pc = pc;
+
+    return r;
+}
+
+
+d_m3Op  (ReturnCall)
+{
+    IM3Function function        = immediate (IM3Function);
+    i32 stackOffset             = immediate (i32);
+
+    pc_t callPC = NULL;
+    m3ret_t r = PrepareTailCall (& callPC, function, _sp, _mem, stackOffset);
+
+    if (M3_LIKELY (not r))
+    {
+        d_m3ClearRegisters
+        jumpOp (callPC);
+    }
+
+    newTrap (r);
+}
+
+
+d_m3Op  (ReturnCallIndirect)
+{
+    u32 tableIndex              = slot (u32);
+    IM3Module module            = immediate (IM3Module);
+    IM3FuncType type            = immediate (IM3FuncType);
+    i32 stackOffset             = immediate (i32);
+
+    m3ret_t r = m3Err_none;
+    pc_t callPC = NULL;
+
+    if (M3_LIKELY(tableIndex < module->table0Size))
+    {
+        IM3Function function = module->table0 [tableIndex];
+
+        if (M3_LIKELY(function))
+        {
+            if (M3_LIKELY(type == function->funcType))
+            {
+                r = PrepareTailCall (& callPC, function, _sp, _mem, stackOffset);
+
+                if (M3_LIKELY (not r))
+                {
+                    d_m3ClearRegisters
+                    jumpOp (callPC);
+                }
+            }
+            else r = m3Err_trapIndirectCallTypeMismatch;
+        }
+        else r = m3Err_trapTableElementIsNull;
+    }
+    else r = m3Err_trapTableIndexOutOfRange;
+
+    newTrap (r);
 }
 
 
@@ -1105,11 +1395,22 @@ d_m3Op  (Loop)
 #if d_m3EnableLocalRegCaching
     IM3Function function = immediate (IM3Function);
 #endif
+#if d_m3EnableFuelMetering
+    u32 fuelCost = immediate (u32);
+#endif
 
     IM3Memory memory = m3MemInfo (_mem);
 
     do
     {
+#if d_m3EnableFuelMetering
+        if (M3_UNLIKELY (_mem->fuel < fuelCost))
+            newTrap (m3Err_trapOutOfFuel);
+
+        _mem->fuel -= fuelCost;
+#endif
+        m3PollInterrupt ();
+
 #if d_m3EnableStrace >= 3
         d_m3TracePrint("iter {");
         trace_rt->callDepth++;
@@ -1300,6 +1601,23 @@ d_m3Op  (DumpStack)
 #endif
 
 
+#if d_m3EnableOpProfiling
+// emitted ahead of each wasm instruction; counts it under its op-info table index
+d_m3Op  (CountOp)
+{
+    u32 index = immediate (u32);
+    IM3Function function = m3MemRuntime (_mem)->profiledFunction;
+
+    if (M3_LIKELY (function and index < function->numOpCounts))
+        function->opCounts [index]++;
+    else
+        CountProfiledOp (function, index);
+
+    nextOp ();
+}
+#endif
+
+
 #define d_m3Select_i(TYPE, REG)                 \
 d_m3Op  (Select_##TYPE##_rss)                   \
 {                                               \
@@ -1761,15 +2079,6 @@ d_m3RetSig  debugOp  (d_m3OpSig, cstr_t i_opcode)
 }
 # endif
 
-# if d_m3EnableOpProfiling
-d_m3RetSig  profileOp  (d_m3OpSig, cstr_t i_operationName)
-{
-    ProfileHit (i_operationName);
-
-    nextOpDirect();
-}
-# endif
-
 d_m3EndExternC
 
 #endif // m3_exec_h
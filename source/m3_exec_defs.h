@@ -106,7 +106,7 @@ d_m3BeginExternC
 
 
 #define d_m3RetSig                  static inline m3ret_t vectorcall
-# if (d_m3EnableOpProfiling || d_m3EnableOpTracing)
+# if d_m3EnableOpTracing
     typedef m3ret_t (vectorcall * IM3Operation) (d_m3OpSig, cstr_t i_operationName);
 #    define d_m3Op(NAME)                M3_NO_UBSAN d_m3RetSig op_##NAME (d_m3OpSig, cstr_t i_operationName)
 
@@ -123,7 +123,7 @@ d_m3BeginExternC
 #define nextOpDirect()              M3_MUSTTAIL return nextOpImpl()
 #define jumpOpDirect(PC)            M3_MUSTTAIL return jumpOpImpl((pc_t)(PC))
 
-# if (d_m3EnableOpProfiling || d_m3EnableOpTracing)
+# if d_m3EnableOpTracing
 d_m3RetSig  RunCode  (d_m3OpSig, cstr_t i_operationName)
 # else
 d_m3RetSig  RunCode  (d_m3OpSig)
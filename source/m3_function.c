@@ -9,9 +9,9 @@
 #include "m3_env.h"
 
 
-M3Result AllocFuncType (IM3FuncType * o_functionType, u32 i_numTypes)
+M3Result AllocFuncType (IM3FuncType * o_functionType, u32 i_numTypes, IM3Allocator i_allocator)
 {
-    *o_functionType = (IM3FuncType) m3_Malloc ("M3FuncType", sizeof (M3FuncType) + i_numTypes);
+    *o_functionType = (IM3FuncType) m3_AllocatorMalloc (i_allocator, sizeof (M3FuncType) + i_numTypes);
     return (*o_functionType) ? m3Err_none : m3Err_mallocFailed;
 }
 
@@ -74,30 +74,30 @@ u8  GetFuncTypeResultType  (const IM3FuncType i_funcType, u16 i_index)
 //---------------------------------------------------------------------------------------------------------------
 
 
-void FreeImportInfo (M3ImportInfo * i_info)
+void FreeImportInfo (M3ImportInfo * i_info, IM3Allocator i_allocator)
 {
-    m3_Free (i_info->moduleUtf8);
-    m3_Free (i_info->fieldUtf8);
+    m3_AllocatorFree (i_allocator, i_info->moduleUtf8);
+    m3_AllocatorFree (i_allocator, i_info->fieldUtf8);
 }
 
 
-void  Function_Release  (IM3Function i_function)
+void  Function_Release  (IM3Function i_function, IM3Allocator i_allocator)
 {
-    m3_Free (i_function->constants);
+    m3_AllocatorFree (i_allocator, i_function->constants);
 
     for (int i = 0; i < i_function->numNames; i++)
     {
         // name can be an alias of fieldUtf8
         if (i_function->names[i] != i_function->import.fieldUtf8)
         {
-            m3_Free (i_function->names[i]);
+            m3_AllocatorFree (i_allocator, i_function->names[i]);
         }
     }
 
-    FreeImportInfo (& i_function->import);
+    FreeImportInfo (& i_function->import, i_allocator);
 
     if (i_function->ownsWasmCode)
-        m3_Free (i_function->wasm);
+        m3_AllocatorFree (i_allocator, i_function->wasm);
 
     // Function_FreeCompiledCode (func);
 
@@ -107,6 +107,13 @@ void  Function_Release  (IM3Function i_function)
         i_function->numCodePageRefs = 0;
     }
 #   endif
+
+#   if d_m3EnableOpProfiling
+    {
+        m3_AllocatorFree (i_allocator, i_function->opCounts);
+        i_function->numOpCounts = 0;
+    }
+#   endif
 }
 
 
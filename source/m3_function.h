@@ -27,7 +27,7 @@ M3FuncType;
 typedef M3FuncType *        IM3FuncType;
 
 
-M3Result    AllocFuncType                   (IM3FuncType * o_functionType, u32 i_numTypes);
+M3Result    AllocFuncType                   (IM3FuncType * o_functionType, u32 i_numTypes, IM3Allocator i_allocator);
 bool        AreFuncTypesEqual               (const IM3FuncType i_typeA, const IM3FuncType i_typeB);
 
 u16         GetFuncTypeNumParams            (const IM3FuncType i_funcType);
@@ -67,6 +67,16 @@ typedef struct M3Function
 
     u16                     maxStackSlots;
 
+# if d_m3EnableFuelMetering
+    u32                     fuelCost;                               // instructions outside of loops; charged by op_Entry
+# endif
+
+# if d_m3EnableOpProfiling
+    u64 *                   opCounts;                               // executions per opcode, indexed by GetOpInfoIndex
+    u32                     numOpCounts;
+    u64                     numProfiledCalls;
+# endif
+
     u16                     numRetSlots;
     u16                     numRetAndArgSlots;
 
@@ -92,7 +102,7 @@ typedef struct M3Function
 }
 M3Function;
 
-void        Function_Release            (IM3Function i_function);
+void        Function_Release            (IM3Function i_function, IM3Allocator i_allocator);
 void        Function_FreeCompiledCode   (IM3Function i_function);
 
 cstr_t      GetFunctionImportModuleName (IM3Function i_function);
@@ -106,6 +116,7 @@ u8          GetFunctionReturnType       (const IM3Function i_function, u16 i_ind
 u32         GetFunctionNumArgsAndLocals (IM3Function i_function);
 
 cstr_t      SPrintFunctionArgList       (IM3Function i_function, m3stack_t i_sp);
+cstr_t      SPrintFunctionRetList       (IM3Function i_function, m3stack_t i_sp);
 
 //---------------------------------------------------------------------------------------------------------------------------------
 
@@ -5,6 +5,10 @@
 //  Copyright © 2019 Steven Massey. All rights reserved.
 //
 
+#if defined(__linux__) && !defined(_POSIX_C_SOURCE)
+#   define _POSIX_C_SOURCE 200809L      // sigaction for the sampler; Apple and the BSDs expose it by default
+#endif
+
 #include "m3_env.h"
 #include "m3_info.h"
 #include "m3_compile.h"
@@ -75,6 +79,34 @@ cstr_t  SPrintFunctionArgList  (IM3Function i_function, m3stack_t i_sp)
     return string;
 }
 
+
+cstr_t  SPrintFunctionRetList  (IM3Function i_function, m3stack_t i_sp)
+{
+    static char string [256];
+
+    char * s = string;
+    ccstr_t e = string + sizeof(string) - 1;
+
+    * s = 0;
+
+    u64 * retSp = (u64 *) i_sp;
+
+    IM3FuncType funcType = i_function->funcType;
+    u32 numRets = funcType ? funcType->numRets : 0;
+
+    for (u32 i = 0; i < numRets; ++i)
+    {
+        if (i) {
+            int ret = snprintf (s, e-s, ", ");
+            s += M3_MAX (0, ret);
+        }
+
+        s += SPrintArg (s, e-s, retSp + i, d_FuncRetType (funcType, i));
+    }
+
+    return string;
+}
+
 #endif
 
 #ifdef DEBUG
@@ -499,66 +531,414 @@ void  log_emit  (IM3Compilation o, IM3Operation i_operation)
 
 # if d_m3EnableOpProfiling
 
-typedef struct M3ProfilerSlot
+// the op table is the op-info table: c_operations followed by c_operationsFC
+static
+u32  NumProfiledOps  (void)
 {
-    cstr_t      opName;
-    u64         hitCount;
+    u32 numOps = 0;
+
+    while (GetOpInfoAtIndex (numOps))
+        ++numOps;
+
+    return numOps;
 }
-M3ProfilerSlot;
 
-static M3ProfilerSlot s_opProfilerCounts [d_m3ProfilerSlotMask + 1] = {};
 
-void  ProfileHit  (cstr_t i_operationName)
+// op_CountOp found no counter for the op: the function's counters for the whole table are allocated on first use
+void  CountProfiledOp  (IM3Function i_function, u32 i_opIndex)
 {
-    u64 ptr = (u64) i_operationName;
+    if (not i_function or i_function->opCounts)
+        return;
 
-    M3ProfilerSlot * slot = & s_opProfilerCounts [ptr & d_m3ProfilerSlotMask];
+    u32 numOps = NumProfiledOps ();
+    u64 * counts = m3_AllocatorAllocArray (& i_function->module->allocator, u64, numOps);
 
-    if (slot->opName)
+    if (counts and i_opIndex < numOps)
     {
-        if (slot->opName != i_operationName)
-        {
-            m3_Abort ("profiler slot collision; increase d_m3ProfilerSlotMask");
-        }
+        i_function->opCounts = counts;
+        i_function->numOpCounts = numOps;
+
+        counts [i_opIndex]++;
     }
+    else m3_AllocatorFree (& i_function->module->allocator, counts);
+}
+
+
+static
+u64  SumOpCounts  (IM3Function i_function)
+{
+    u64 sum = 0;
 
-    slot->opName = i_operationName;
-    slot->hitCount++;
+    for (u32 i = 0; i < i_function->numOpCounts; ++i)
+        sum += i_function->opCounts [i];
+
+    return sum;
+}
+
+
+static
+int  CompareFunctionProfiles  (const void * i_a, const void * i_b)
+{
+    u64 a = ((const M3FunctionProfile *) i_a)->numOpsExecuted;
+    u64 b = ((const M3FunctionProfile *) i_b)->numOpsExecuted;
+
+    return (a < b) - (a > b);
 }
 
 
-void  m3_PrintProfilerInfo  ()
+IM3ProfilerStats  m3_GetProfilerStats  (IM3Runtime i_runtime)
 {
-    M3ProfilerSlot dummy;
-    M3ProfilerSlot * maxSlot = & dummy;
+    M3ProfilerStats * stats = & i_runtime->profilerStats;
+    IM3Allocator allocator = & i_runtime->environment->allocator;
+
+    m3_AllocatorFree (allocator, i_runtime->profilerStatsData);
+    memset (stats, 0, sizeof (M3ProfilerStats));
 
-    do
+    u32 numOps = NumProfiledOps ();
+    u32 numFunctions = 0;
+
+    for (IM3Module module = i_runtime->modules; module; module = module->next)
     {
-        maxSlot->hitCount = 0;
+        for (u32 i = 0; i < module->numFunctions; ++i)
+        {
+            IM3Function function = & module->functions [i];
 
-        for (u32 i = 0; i <= d_m3ProfilerSlotMask; ++i)
+            if (function->numProfiledCalls or SumOpCounts (function))
+                ++numFunctions;
+        }
+    }
+
+    // one block: the function records, the op totals, each function's counts, then the op names
+    size_t size = numFunctions * sizeof (M3FunctionProfile) + (numOps + (size_t) numFunctions * numOps) * sizeof (u64)
+                    + numOps * sizeof (cstr_t);
+
+    u8 * data = size ? (u8 *) m3_AllocatorMalloc (allocator, size) : NULL;
+
+    if (size and not data)
+        return NULL;
+
+    M3FunctionProfile * functions = (M3FunctionProfile *) data;
+    u64 * totals = (u64 *) (functions + numFunctions);
+    u64 * counts = totals + numOps;
+    cstr_t * names = (cstr_t *) (counts + (size_t) numFunctions * numOps);
+
+    for (u32 op = 0; op < numOps; ++op)
+    {
+        cstr_t name = GetOpInfoAtIndex (op)->name;
+        names [op] = name ? name : "reserved";
+    }
+
+    M3FunctionProfile * profile = functions;
+
+    for (IM3Module module = i_runtime->modules; module; module = module->next)
+    {
+        for (u32 i = 0; i < module->numFunctions; ++i)
         {
-            M3ProfilerSlot * slot = & s_opProfilerCounts [i];
+            IM3Function function = & module->functions [i];
+
+            if (not function->numProfiledCalls and not SumOpCounts (function))
+                continue;
+
+            profile->function = function;
+            profile->calls = function->numProfiledCalls;
+            profile->opCounts = counts;
 
-            if (slot->opName)
+            for (u32 op = 0; op < numOps and op < function->numOpCounts; ++op)
             {
-                if (slot->hitCount > maxSlot->hitCount)
-                    maxSlot = slot;
+                counts [op] = function->opCounts [op];
+                totals [op] += counts [op];
+                profile->numOpsExecuted += counts [op];
             }
+
+            counts += numOps;
+            ++profile;
         }
+    }
+
+    qsort (functions, numFunctions, sizeof (M3FunctionProfile), CompareFunctionProfiles);
+
+    i_runtime->profilerStatsData = data;
+
+    stats->numOps = numOps;
+    stats->opNames = names;
+    stats->opCounts = totals;
+    stats->numFunctions = numFunctions;
+    stats->functions = functions;
+
+    return stats;
+}
 
-        if (maxSlot->opName)
+
+void  m3_ResetProfilerStats  (IM3Runtime i_runtime)
+{
+    for (IM3Module module = i_runtime->modules; module; module = module->next)
+    {
+        for (u32 i = 0; i < module->numFunctions; ++i)
         {
-            fprintf (stderr, "%13llu  %s\n", maxSlot->hitCount, maxSlot->opName);
-            maxSlot->opName = NULL;
+            IM3Function function = & module->functions [i];
+
+            function->numProfiledCalls = 0;
+
+            if (function->opCounts)
+                memset (function->opCounts, 0, function->numOpCounts * sizeof (u64));
         }
     }
-    while (maxSlot->hitCount);
 }
 
 # else
 
-void  m3_PrintProfilerInfo  () {}
+IM3ProfilerStats  m3_GetProfilerStats  (IM3Runtime i_runtime)
+{
+    return NULL;
+}
+
+void  m3_ResetProfilerStats  (IM3Runtime i_runtime) {}
 
 # endif
 
+
+# if d_m3EnableSampling && (defined(__unix__) || defined(__APPLE__))
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+
+// a distinct call chain; its frames are stored innermost first
+typedef struct M3SampledStack
+{
+    u64                     count;
+    u32                     hash;
+    u32                     frames;         // index into M3Sampler.frames
+    u16                     depth;
+    bool                    truncated;      // deeper than d_m3SamplerMaxDepth
+}
+M3SampledStack;
+
+typedef struct M3Sampler
+{
+    IM3Runtime              runtime;
+    struct sigaction        previous;
+
+    u64                     dropped;        // samples of new chains that found the tables full
+    u32                     numStacks;
+    u32                     numFrames;
+
+    M3SampledStack          stacks [d_m3SamplerMaxStacks * 2];     // open addressing, at most half full
+    IM3Function             frames [d_m3SamplerMaxStacks * 32];
+}
+M3Sampler;
+
+static u32                      s_samplerClaimed = 0;   // one sampler at a time
+static pthread_t                s_samplerThread;        // written before s_sampler is published
+static M3Sampler * volatile     s_sampler = NULL;
+
+
+static
+void  RecordSample  (int i_signal, siginfo_t * i_info, void * i_context)
+{
+    // SIGPROF goes to whichever thread is using the CPU. other threads leave without touching
+    // the sampler, which its own thread can free at any time
+    M3Sampler * sampler = (M3Sampler *) m3_AtomicLoadPtr (& s_sampler);
+    if (not sampler or not pthread_equal (s_samplerThread, pthread_self ()))
+        return;
+
+    IM3Function chain [d_m3SamplerMaxDepth];
+    u32 depth = 0;
+    u32 hash = 2166136261u;
+
+    M3SampleFrame * frame = sampler->runtime->sampleFrames;
+    while (frame and depth < d_m3SamplerMaxDepth)
+    {
+        IM3Function function = frame->function;
+        chain [depth++] = function;
+        hash = (hash ^ (u32) ((uintptr_t) function >> 4)) * 16777619u;
+        frame = frame->caller;
+    }
+
+    if (not depth)      // the runtime isn't executing
+        return;
+
+    bool truncated = (frame != NULL);
+    const u32 mask = d_m3SamplerMaxStacks * 2 - 1;
+
+    for (u32 i = hash & mask;; i = (i + 1) & mask)
+    {
+        M3SampledStack * stack = & sampler->stacks [i];
+
+        if (not stack->count)
+        {
+            if (sampler->numStacks >= d_m3SamplerMaxStacks or
+                sampler->numFrames + depth > M3_COUNT_OF (sampler->frames))
+            {
+                sampler->dropped++;
+                return;
+            }
+
+            memcpy (& sampler->frames [sampler->numFrames], chain, depth * sizeof (IM3Function));
+            stack->hash = hash;
+            stack->frames = sampler->numFrames;
+            stack->depth = depth;
+            stack->truncated = truncated;
+            stack->count = 1;
+
+            sampler->numFrames += depth;
+            sampler->numStacks++;
+            return;
+        }
+
+        if (stack->hash == hash and stack->depth == depth and stack->truncated == truncated and
+            memcmp (& sampler->frames [stack->frames], chain, depth * sizeof (IM3Function)) == 0)
+        {
+            stack->count++;
+            return;
+        }
+    }
+}
+
+
+static
+void  WriteFoldedName  (FILE * o_file, IM3Function i_function)
+{
+    cstr_t name = m3_GetFunctionName (i_function);
+
+    if (i_function->import.moduleUtf8)
+        fprintf (o_file, "%s.", i_function->import.moduleUtf8);
+    else if (not strcmp (name, "<unnamed>"))
+    {
+        fprintf (o_file, "$f%u", (u32) (i_function - i_function->module->functions));
+        return;
+    }
+
+    // ';' separates frames and a newline ends the chain
+    for (cstr_t c = name; * c; ++c)
+        fputc ((* c == ';' or * c == '\n') ? '_' : * c, o_file);
+}
+
+
+static
+M3Result  WriteFoldedStacks  (M3Sampler * i_sampler, const char * i_path)
+{
+    FILE * f = fopen (i_path, "w");
+    if (not f)
+        return "cannot open sampling output";
+
+    for (u32 i = 0; i < M3_COUNT_OF (i_sampler->stacks); ++i)
+    {
+        M3SampledStack * stack = & i_sampler->stacks [i];
+        if (not stack->count)
+            continue;
+
+        if (stack->truncated)
+            fputs ("[truncated];", f);
+
+        IM3Function * frames = & i_sampler->frames [stack->frames];
+        for (u32 d = stack->depth; d > 0; --d)
+        {
+            WriteFoldedName (f, frames [d - 1]);
+            if (d > 1)
+                fputc (';', f);
+        }
+        fprintf (f, " %" PRIu64 "\n", stack->count);
+    }
+
+    if (i_sampler->dropped)
+        fprintf (f, "[dropped] %" PRIu64 "\n", i_sampler->dropped);
+
+    bool failed = ferror (f);
+    if (fclose (f) != 0 or failed)
+        return "cannot write sampling output";
+
+    return m3Err_none;
+}
+
+
+M3Result  m3_StartSampling  (IM3Runtime i_runtime, u32 i_samplesPerSecond)
+{
+    if (i_samplesPerSecond == 0 or i_samplesPerSecond > 1000000)
+        return "invalid sampling rate";
+
+    if (m3_AtomicExchange32 (& s_samplerClaimed, 1))
+        return m3Err_samplerBusy;
+
+    IM3Allocator allocator = & i_runtime->environment->allocator;
+    M3Sampler * sampler = m3_AllocatorAllocStruct (allocator, M3Sampler);
+    if (not sampler)
+    {
+        m3_AtomicExchange32 (& s_samplerClaimed, 0);
+        return m3Err_mallocFailed;
+    }
+
+    memset (sampler, 0, sizeof (M3Sampler));
+    sampler->runtime = i_runtime;
+
+    struct sigaction action;
+    memset (& action, 0, sizeof (action));
+    action.sa_sigaction = RecordSample;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset (& action.sa_mask);
+
+    if (sigaction (SIGPROF, & action, & sampler->previous) != 0)
+    {
+        m3_AllocatorFree (allocator, sampler);
+        m3_AtomicExchange32 (& s_samplerClaimed, 0);
+        return "cannot install SIGPROF handler";
+    }
+
+    s_samplerThread = pthread_self ();
+    m3_AtomicCasPtr (& s_sampler, NULL, sampler);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = M3_MAX (1000000 / i_samplesPerSecond, 1);
+    timer.it_value = timer.it_interval;
+
+    if (setitimer (ITIMER_PROF, & timer, NULL) != 0)
+    {
+        m3_AtomicCasPtr (& s_sampler, sampler, NULL);
+        sigaction (SIGPROF, & sampler->previous, NULL);
+        m3_AllocatorFree (allocator, sampler);
+        m3_AtomicExchange32 (& s_samplerClaimed, 0);
+        return "cannot start the profiling timer";
+    }
+
+    return m3Err_none;
+}
+
+
+M3Result  m3_StopSampling  (IM3Runtime i_runtime, const char * i_foldedPath)
+{
+    M3Sampler * sampler = (M3Sampler *) m3_AtomicLoadPtr (& s_sampler);
+
+    if (not sampler or sampler->runtime != i_runtime or not pthread_equal (s_samplerThread, pthread_self ()))
+        return m3Err_notSampled;
+
+    struct itimerval off;
+    memset (& off, 0, sizeof (off));
+    setitimer (ITIMER_PROF, & off, NULL);
+
+    // a signal already pending on this thread finds no sampler
+    m3_AtomicCasPtr (& s_sampler, sampler, NULL);
+    sigaction (SIGPROF, & sampler->previous, NULL);
+
+    M3Result result = i_foldedPath ? WriteFoldedStacks (sampler, i_foldedPath) : m3Err_none;
+
+    m3_AllocatorFree (& i_runtime->environment->allocator, sampler);
+    m3_AtomicExchange32 (& s_samplerClaimed, 0);
+
+    return result;
+}
+
+# else
+
+M3Result  m3_StartSampling  (IM3Runtime i_runtime, u32 i_samplesPerSecond)
+{
+    return m3Err_samplingDisabled;
+}
+
+M3Result  m3_StopSampling  (IM3Runtime i_runtime, const char * i_foldedPath)
+{
+    return m3Err_samplingDisabled;
+}
+
+# endif // d_m3EnableSampling
+
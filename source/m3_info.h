@@ -12,7 +12,9 @@
 
 d_m3BeginExternC
 
-void            ProfileHit              (cstr_t i_operationName);
+#if d_m3EnableOpProfiling
+void            CountProfiledOp         (IM3Function i_function, u32 i_opIndex);
+#endif
 
 #ifdef DEBUG
 
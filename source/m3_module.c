@@ -9,12 +9,42 @@
 #include "m3_exception.h"
 
 
+static
+IM3Allocator  Module_EnvironmentAllocator  (IM3Module i_module)
+{
+    return i_module->environment ? & i_module->environment->allocator : NULL;
+}
+
+
+M3Result  Module_New  (IM3Environment i_environment, IM3Module * o_module)
+{
+_try {
+    IM3Module module = m3_AllocatorAllocStruct (i_environment ? & i_environment->allocator : NULL, M3Module);
+    _throwifnull (module);
+    module->name = ".unnamed";
+    module->startFunction = -1;
+    //module->hasWasmCodeCopy = false;
+    module->environment = i_environment;
+
+#if d_m3EnableModuleArena
+    Arena_Init (& module->arena, Module_EnvironmentAllocator (module), & module->allocator);
+#else
+    if (i_environment)
+        module->allocator = i_environment->allocator;
+#endif
+
+    * o_module = module;
+
+} _catch: return result;
+}
+
+
 void Module_FreeFunctions (IM3Module i_module)
 {
     for (u32 i = 0; i < i_module->numFunctions; ++i)
     {
         IM3Function func = & i_module->functions [i];
-        Function_Release (func);
+        Function_Release (func, & i_module->allocator);
     }
 }
 
@@ -28,34 +58,94 @@ void  m3_FreeModule  (IM3Module i_module)
 
         Module_FreeFunctions (i_module);
 
-        m3_Free (i_module->functions);
+#if d_m3EnableModuleArena
+        // everything else the module allocated lives in its arena
+        Arena_Release (& i_module->arena);
+#else
+        IM3Allocator allocator = & i_module->allocator;
+
+        m3_AllocatorFree (allocator, i_module->functions);
         //m3_Free (i_module->imports);
-        m3_Free (i_module->funcTypes);
-        m3_Free (i_module->dataSegments);
-        m3_Free (i_module->table0);
+        m3_AllocatorFree (allocator, i_module->funcTypes);
+        m3_AllocatorFree (allocator, i_module->dataSegments);
+
+        for (u32 i = 0; i < i_module->numElementSegments; ++i)
+        {
+            m3_AllocatorFree (allocator, i_module->elementSegments[i].functionIndices);
+        }
+        m3_AllocatorFree (allocator, i_module->elementSegments);
+        m3_AllocatorFree (allocator, i_module->table0);
 
         for (u32 i = 0; i < i_module->numGlobals; ++i)
         {
-            m3_Free (i_module->globals[i].name);
-            FreeImportInfo(&(i_module->globals[i].import));
+            m3_AllocatorFree (allocator, i_module->globals[i].name);
+            FreeImportInfo(&(i_module->globals[i].import), allocator);
+        }
+        m3_AllocatorFree (allocator, i_module->globals);
+        m3_AllocatorFree (allocator, i_module->memoryExportName);
+        m3_AllocatorFree (allocator, i_module->table0ExportName);
+
+        FreeImportInfo(&i_module->memoryImport, allocator);
+
+        for (u32 i = 0; i < i_module->numStreamSections; ++i)
+        {
+            m3_AllocatorFree (allocator, i_module->streamSections[i]);
         }
-        m3_Free (i_module->globals);
-        m3_Free (i_module->memoryExportName);
-        m3_Free (i_module->table0ExportName);
+        m3_AllocatorFree (allocator, i_module->streamSections);
+        m3_AllocatorFree (allocator, i_module->symbols);
+#endif
+
+        m3_UnmapFile (i_module->wasmMapping, i_module->wasmMappingSize);
+
+        m3_AllocatorFree (Module_EnvironmentAllocator (i_module), i_module);
+    }
+}
+
 
-        FreeImportInfo(&i_module->memoryImport);
+// the table is kept for reuse; with the arena, a freed block would only be abandoned
+static
+void  Module_InvalidateSymbols  (IM3Module io_module)
+{
+    io_module->symbolsIndexed = false;
+}
 
-        m3_Free (i_module);
+
+// arrays grow geometrically: the arena can't reuse a block it has moved away from
+static
+u32  Module_GrowCapacity  (u32 i_capacity, u32 i_needed)
+{
+    u32 capacity = M3_MAX (i_capacity, 8);
+
+    while (capacity < i_needed)
+        capacity *= 2;
+
+    return capacity;
+}
+
+
+M3Result  Module_PreallocGlobals  (IM3Module io_module, u32 i_totalGlobals)
+{
+_try {
+    if (i_totalGlobals > io_module->allGlobals) {
+        io_module->globals = m3_AllocatorReallocArray (& io_module->allocator, M3Global, io_module->globals, i_totalGlobals, io_module->allGlobals);
+        _throwifnull (io_module->globals);
+        io_module->allGlobals = i_totalGlobals;
     }
+} _catch:
+    return result;
 }
 
 
 M3Result  Module_AddGlobal  (IM3Module io_module, IM3Global * o_global, u8 i_type, bool i_mutable, bool i_isImported)
 {
 _try {
-    u32 index = io_module->numGlobals++;
-    io_module->globals = m3_ReallocArray (M3Global, io_module->globals, io_module->numGlobals, index);
-    _throwifnull (io_module->globals);
+    Module_InvalidateSymbols (io_module);
+
+    u32 index = io_module->numGlobals;
+    if (index >= io_module->allGlobals)
+_       (Module_PreallocGlobals (io_module, Module_GrowCapacity (io_module->allGlobals, index + 1)));
+
+    io_module->numGlobals++;
     M3Global * global = & io_module->globals [index];
 
     global->type = i_type;
@@ -73,9 +163,10 @@ M3Result  Module_PreallocFunctions  (IM3Module io_module, u32 i_totalFunctions)
 {
 _try {
     if (i_totalFunctions > io_module->allFunctions) {
-        io_module->functions = m3_ReallocArray (M3Function, io_module->functions, i_totalFunctions, io_module->allFunctions);
-        io_module->allFunctions = i_totalFunctions;
+        Module_InvalidateSymbols (io_module);
+        io_module->functions = m3_AllocatorReallocArray (& io_module->allocator, M3Function, io_module->functions, i_totalFunctions, io_module->allFunctions);
         _throwifnull (io_module->functions);
+        io_module->allFunctions = i_totalFunctions;
     }
 } _catch:
     return result;
@@ -85,8 +176,13 @@ M3Result  Module_AddFunction  (IM3Module io_module, u32 i_typeIndex, IM3ImportIn
 {
 _try {
 
-    u32 index = io_module->numFunctions++;
-_   (Module_PreallocFunctions(io_module, io_module->numFunctions));
+    Module_InvalidateSymbols (io_module);
+
+    u32 index = io_module->numFunctions;
+    if (index >= io_module->allFunctions)
+_       (Module_PreallocFunctions (io_module, Module_GrowCapacity (io_module->allFunctions, index + 1)));
+
+    io_module->numFunctions++;
 
     _throwif ("type sig index out of bounds", i_typeIndex >= io_module->numFuncTypes);
 
@@ -115,13 +211,15 @@ _   (Module_PreallocFunctions(io_module, io_module->numFunctions));
 #ifdef DEBUG
 void  Module_GenerateNames  (IM3Module i_module)
 {
+    Module_InvalidateSymbols (i_module);
+
     for (u32 i = 0; i < i_module->numFunctions; ++i)
     {
         IM3Function func = & i_module->functions [i];
 
         if (func->numNames == 0)
         {
-            char* buff = m3_AllocArray(char, 16);
+            char* buff = m3_AllocatorAllocArray(& i_module->allocator, char, 16);
             snprintf(buff, 16, "$func%d", i);
             func->names[0] = buff;
             func->numNames = 1;
@@ -133,7 +231,7 @@ void  Module_GenerateNames  (IM3Module i_module)
 
         if (global->name == NULL)
         {
-            char* buff = m3_AllocArray(char, 16);
+            char* buff = m3_AllocatorAllocArray(& i_module->allocator, char, 16);
             snprintf(buff, 16, "$global%d", i);
             global->name = buff;
         }
@@ -141,6 +239,126 @@ void  Module_GenerateNames  (IM3Module i_module)
 }
 #endif
 
+static
+u32  HashSymbolName  (cstr_t i_name)
+{
+    u32 hash = 2166136261u;     // FNV-1a
+
+    while (* i_name)
+    {
+        hash ^= (u8) * i_name++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+
+static
+void  InsertSymbol  (IM3Module io_module, u8 i_kind, cstr_t i_name, u32 i_index)
+{
+    if (not i_name)
+        return;
+
+    u32 hash = HashSymbolName (i_name);
+    u32 slot = hash & io_module->symbolsMask;
+
+    while (io_module->symbols [slot].kind != c_m3Symbol_none)
+        slot = (slot + 1) & io_module->symbolsMask;
+
+    M3Symbol * symbol = & io_module->symbols [slot];
+    symbol->name = i_name;
+    symbol->hash = hash;
+    symbol->index = i_index;
+    symbol->kind = i_kind;
+}
+
+
+M3Result  Module_IndexSymbols  (IM3Module io_module)
+{
+    if (io_module->symbolsIndexed)
+        return m3Err_none;
+
+_try {
+    u32 numSymbols = io_module->numGlobals * 2;
+
+    for (u32 i = 0; i < io_module->numFunctions; ++i)
+        numSymbols += 1 + io_module->functions [i].numNames;
+
+    // keep the load factor at or below 1/2
+    u32 capacity = 16;
+    while (capacity < numSymbols * 2)
+        capacity *= 2;
+
+    u32 oldCapacity = io_module->symbols ? io_module->symbolsMask + 1 : 0;
+
+    if (capacity > oldCapacity)
+    {
+        io_module->symbols = m3_AllocatorReallocArray (& io_module->allocator, M3Symbol, io_module->symbols, capacity, oldCapacity);
+        _throwifnull (io_module->symbols);
+    }
+    else capacity = oldCapacity;
+
+    memset (io_module->symbols, 0x0, capacity * sizeof (M3Symbol));
+    io_module->symbolsMask = capacity - 1;
+
+    for (u32 i = 0; i < io_module->numFunctions; ++i)
+    {
+        IM3Function f = & io_module->functions [i];
+
+        InsertSymbol (io_module, c_m3Symbol_functionExport, f->export_name, i);
+
+        if (f->import.moduleUtf8 and f->import.fieldUtf8)
+        {
+            InsertSymbol (io_module, c_m3Symbol_functionImport, f->import.fieldUtf8, i);
+        }
+        else if (not f->import.moduleUtf8 and not f->import.fieldUtf8)
+        {
+            for (u32 j = 0; j < f->numNames; ++j)
+                InsertSymbol (io_module, c_m3Symbol_functionName, f->names [j], i);
+        }
+    }
+
+    for (u32 i = 0; i < io_module->numGlobals; ++i)
+    {
+        IM3Global g = & io_module->globals [i];
+
+        InsertSymbol (io_module, c_m3Symbol_globalExport, g->name, i);
+
+        if (g->import.moduleUtf8 and g->import.fieldUtf8)
+            InsertSymbol (io_module, c_m3Symbol_globalImport, g->import.fieldUtf8, i);
+    }
+
+    io_module->symbolsIndexed = true;
+
+} _catch:
+    return result;
+}
+
+
+M3Symbol *  Module_FindSymbol  (IM3Module i_module, u8 i_kind, cstr_t i_name, M3Symbol * i_previous)
+{
+    if (not i_module->symbolsIndexed)
+        return NULL;
+
+    u32 hash = HashSymbolName (i_name);
+    u32 slot = i_previous ? (u32) (i_previous - i_module->symbols) + 1 : hash;
+
+    for (;;)
+    {
+        M3Symbol * symbol = & i_module->symbols [slot & i_module->symbolsMask];
+
+        if (symbol->kind == c_m3Symbol_none)
+            return NULL;
+
+        if (symbol->kind == i_kind and symbol->hash == hash and strcmp (symbol->name, i_name) == 0)
+            return symbol;
+
+        ++slot;
+    }
+}
+
+
 IM3Function  Module_GetFunction  (IM3Module i_module, u32 i_functionIndex)
 {
     IM3Function func = NULL;
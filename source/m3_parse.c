@@ -11,11 +11,23 @@
 #include "m3_info.h"
 
 
-M3Result  ParseType_Table  (IM3Module io_module, bytes_t i_bytes, cbytes_t i_end)
+M3Result  ParseType_Table  (u32 * o_initSize, bytes_t * io_bytes, cbytes_t i_end)
 {
     M3Result result = m3Err_none;
 
-    return result;
+    u8 refType, flag;
+    u32 maxSize;
+
+_   (Read_u8 (& refType, io_bytes, i_end));
+    _throwif ("unsupported table element type", refType != 0x70 and refType != 0x6f);
+
+_   (ReadLEB_u7 (& flag, io_bytes, i_end));
+_   (ReadLEB_u32 (o_initSize, io_bytes, i_end));
+
+    if (flag & (1u << 0))
+_       (ReadLEB_u32 (& maxSize, io_bytes, i_end));
+
+    _catch: return result;
 }
 
 
@@ -56,7 +68,7 @@ _   (ReadLEB_u32 (& numTypes, & i_bytes, i_end));
     if (numTypes)
     {
         // table of IM3FuncType (that point to the actual M3FuncType struct in the Environment)
-        io_module->funcTypes = m3_AllocArray (IM3FuncType, numTypes);
+        io_module->funcTypes = m3_AllocatorAllocArray (& io_module->allocator, IM3FuncType, numTypes);
         _throwifnull (io_module->funcTypes);
         io_module->numFuncTypes = numTypes;
 
@@ -89,7 +101,7 @@ _               (NormalizeType (& argType, wasmType));
 _           (ReadLEB_u32 (& numRets, & i_bytes, i_end));
             _throwif (m3Err_tooManyArgsRets, (u64)(numRets) + numArgs > d_m3MaxSaneFunctionArgRetCount);
 
-_           (AllocFuncType (& ftype, numRets + numArgs));
+_           (AllocFuncType (& ftype, numRets + numArgs, & io_module->environment->allocator));
             ftype->numArgs = numArgs;
             ftype->numRets = numRets;
 
@@ -114,9 +126,9 @@ _               (NormalizeType (& retType, wasmType));
 
     if (result)
     {
-        m3_Free (ftype);
+        m3_AllocatorFree (& io_module->environment->allocator, ftype);
         // FIX: M3FuncTypes in the table are leaked
-        m3_Free (io_module->funcTypes);
+        m3_AllocatorFree (& io_module->allocator, io_module->funcTypes);
         io_module->numFuncTypes = 0;
     }
 
@@ -165,8 +177,8 @@ _   (Module_PreallocFunctions(io_module, numImports));
     {
         u8 importKind;
 
-_       (Read_utf8 (& import.moduleUtf8, & i_bytes, i_end));
-_       (Read_utf8 (& import.fieldUtf8, & i_bytes, i_end));
+_       (Read_utf8 (& import.moduleUtf8, & i_bytes, i_end, & io_module->allocator));
+_       (Read_utf8 (& import.fieldUtf8, & i_bytes, i_end, & io_module->allocator));
 _       (Read_u8 (& importKind, & i_bytes, i_end));                                 m3log (parse, "    kind: %d '%s.%s' ",
                                                                                                 (u32) importKind, import.moduleUtf8, import.fieldUtf8);
         switch (importKind)
@@ -216,12 +228,12 @@ _               (Module_AddGlobal (io_module, & global, type, isMutable, true /*
                 _throw (m3Err_wasmMalformed);
         }
 
-        FreeImportInfo (& import);
+        FreeImportInfo (& import, & io_module->allocator);
     }
 
     _catch:
 
-    FreeImportInfo (& import);
+    FreeImportInfo (& import, & io_module->allocator);
 
     return result;
 }
@@ -242,7 +254,7 @@ _   (ReadLEB_u32 (& numExports, & i_bytes, i_end));
         u8 exportKind;
         u32 index;
 
-_       (Read_utf8 (& utf8, & i_bytes, i_end));
+_       (Read_utf8 (& utf8, & i_bytes, i_end, & io_module->allocator));
 _       (Read_u8 (& exportKind, & i_bytes, i_end));
 _       (ReadLEB_u32 (& index, & i_bytes, i_end));                                  m3log (parse, "    index: %3d; kind: %d; export: '%s'; ", index, (u32) exportKind, utf8);
 
@@ -261,28 +273,28 @@ _       (ReadLEB_u32 (& index, & i_bytes, i_end));
         {
             _throwif(m3Err_wasmMalformed, index >= io_module->numGlobals);
             IM3Global global = &(io_module->globals [index]);
-            m3_Free (global->name);
+            m3_AllocatorFree (& io_module->allocator, global->name);
             global->name = utf8;
             utf8 = NULL; // ownership transferred to M3Global
         }
         else if (exportKind == d_externalKind_memory)
         {
-            m3_Free (io_module->memoryExportName);
+            m3_AllocatorFree (& io_module->allocator, io_module->memoryExportName);
             io_module->memoryExportName = utf8;
             utf8 = NULL; // ownership transferred to M3Module
         }
         else if (exportKind == d_externalKind_table)
         {
-            m3_Free (io_module->table0ExportName);
+            m3_AllocatorFree (& io_module->allocator, io_module->table0ExportName);
             io_module->table0ExportName = utf8;
             utf8 = NULL; // ownership transferred to M3Module
         }
 
-        m3_Free (utf8);
+        m3_AllocatorFree (& io_module->allocator, utf8);
     }
 
 _catch:
-    m3_Free (utf8);
+    m3_AllocatorFree (& io_module->allocator, utf8);
     return result;
 }
 
@@ -325,6 +337,60 @@ M3Result  Parse_InitExpr  (M3Module * io_module, bytes_t * io_bytes, cbytes_t i_
 }
 
 
+M3Result  ParseSection_Table  (IM3Module io_module, bytes_t i_bytes, cbytes_t i_end)
+{
+    M3Result result = m3Err_none;
+
+    u32 numTables;
+_   (ReadLEB_u32 (& numTables, & i_bytes, i_end));                               m3log (parse, "** Table [%d]", numTables);
+
+    _throwif ("only one table supported", numTables > 1);
+
+    if (numTables)
+    {
+        u32 initSize;
+_       (ParseType_Table (& initSize, & i_bytes, i_end));
+        _throwif ("table overflow", initSize > d_m3MaxSaneTableSize);
+
+        if (initSize)
+        {
+            io_module->table0 = m3_AllocatorAllocArray (& io_module->allocator, IM3Function, initSize);
+            _throwifnull (io_module->table0);
+            io_module->table0Size = initSize;
+        }
+    }
+
+    _catch: return result;
+}
+
+
+static
+M3Result  Parse_ElementExpr  (u32 * o_functionIndex, bytes_t * io_bytes, cbytes_t i_end)
+{
+    M3Result result = m3Err_none;
+
+    u8 opcode;
+_   (Read_u8 (& opcode, io_bytes, i_end));
+
+    if (opcode == 0xd2)             // ref.func
+    {
+_       (ReadLEB_u32 (o_functionIndex, io_bytes, i_end));
+    }
+    else if (opcode == 0xd0)        // ref.null
+    {
+        u8 refType;
+_       (Read_u8 (& refType, io_bytes, i_end));
+        * o_functionIndex = c_m3NullFunctionIndex;
+    }
+    else _throw ("unsupported element expression");
+
+_   (Read_u8 (& opcode, io_bytes, i_end));
+    _throwif (m3Err_wasmMissingInitExpr, opcode != c_waOp_end);
+
+    _catch: return result;
+}
+
+
 M3Result  ParseSection_Element  (IM3Module io_module, bytes_t i_bytes, cbytes_t i_end)
 {
     M3Result result = m3Err_none;
@@ -334,10 +400,91 @@ _   (ReadLEB_u32 (& numSegments, & i_bytes, i_end));                         m3l
 
     _throwif ("too many element segments", numSegments > d_m3MaxSaneElementSegments);
 
-    io_module->elementSection = i_bytes;
-    io_module->elementSectionEnd = i_end;
+    io_module->elementSegments = m3_AllocatorAllocArray (& io_module->allocator, M3ElementSegment, numSegments);
+    _throwif (m3Err_mallocFailed, numSegments and not io_module->elementSegments);
     io_module->numElementSegments = numSegments;
 
+    for (u32 i = 0; i < numSegments; ++i)
+    {
+        M3ElementSegment * segment = & io_module->elementSegments [i];
+
+        // bit 0: passive or declarative; bit 1: explicit table index (active) or declarative (otherwise);
+        // bit 2: elements are expressions instead of function indices
+        u32 flags;
+_       (ReadLEB_u32 (& flags, & i_bytes, i_end));
+        _throwif (m3Err_wasmMalformed, flags > 7);
+
+        if (flags & 1)
+        {
+            segment->isPassive = not (flags & 2);
+            segment->isDropped = (flags & 2);
+        }
+        else
+        {
+            if (flags & 2)
+_               (ReadLEB_u32 (& segment->tableIndex, & i_bytes, i_end));
+
+            segment->initExpr = i_bytes;
+_           (Parse_InitExpr (io_module, & i_bytes, i_end));
+            segment->initExprSize = (u32) (i_bytes - segment->initExpr);
+
+            _throwif (m3Err_wasmMissingInitExpr, segment->initExprSize <= 1);
+        }
+
+        if (flags & 3)
+        {
+            u8 elementKind;         // elemkind (0x00 = funcref) or reftype
+_           (Read_u8 (& elementKind, & i_bytes, i_end));
+        }
+
+_       (ReadLEB_u32 (& segment->size, & i_bytes, i_end));
+        _throwif ("table overflow", segment->size > d_m3MaxSaneTableSize);
+
+        segment->functionIndices = m3_AllocatorAllocArray (& io_module->allocator, u32, segment->size);
+        _throwif (m3Err_mallocFailed, segment->size and not segment->functionIndices);
+
+        for (u32 e = 0; e < segment->size; ++e)
+        {
+            u32 functionIndex;
+
+            if (flags & 4)
+_               (Parse_ElementExpr (& functionIndex, & i_bytes, i_end))
+            else
+_               (ReadLEB_u32 (& functionIndex, & i_bytes, i_end));
+
+            _throwif ("function index out of range", functionIndex != c_m3NullFunctionIndex and functionIndex >= io_module->numFunctions);
+            segment->functionIndices [e] = functionIndex;
+        }
+                                                                                    m3log (parse, "    segment [%u]  flags: %u;  size: %u", i, flags, segment->size);
+    }
+
+    _catch: return result;
+}
+
+
+static
+M3Result  Parse_FunctionBody  (M3Module * io_module, u32 i_index, bytes_t * io_bytes, cbytes_t i_end)
+{
+    M3Result result = m3Err_none;
+
+    const u8 * start = * io_bytes;
+
+    u32 size;
+_   (ReadLEB_u32 (& size, io_bytes, i_end));
+
+    if (size)
+    {
+        _throwif (m3Err_wasmSectionOverrun, size > (u32) (i_end - * io_bytes));
+        * io_bytes += size;
+
+        IM3Function func = Module_GetFunction (io_module, i_index + io_module->numFuncImports);
+
+        func->module = io_module;
+        func->wasm = start;
+        func->wasmEnd = * io_bytes;
+        //func->ownsWasmCode = io_module->hasWasmCodeCopy;
+    }
+
     _catch: return result;
 }
 
@@ -356,48 +503,7 @@ _   (ReadLEB_u32 (& numFunctions, & i_bytes, i_end));
 
     for (u32 f = 0; f < numFunctions; ++f)
     {
-        const u8 * start = i_bytes;
-
-        u32 size;
-_       (ReadLEB_u32 (& size, & i_bytes, i_end));
-
-        if (size)
-        {
-            const u8 * ptr = i_bytes;
-            i_bytes += size;
-
-            if (i_bytes <= i_end)
-            {
-                /*
-                u32 numLocalBlocks;
-_               (ReadLEB_u32 (& numLocalBlocks, & ptr, i_end));                                      m3log (parse, "    code size: %-4d", size);
-
-                u32 numLocals = 0;
-
-                for (u32 l = 0; l < numLocalBlocks; ++l)
-                {
-                    u32 varCount;
-                    i8 wasmType;
-                    u8 normalType;
-
-_                   (ReadLEB_u32 (& varCount, & ptr, i_end));
-_                   (ReadLEB_i7 (& wasmType, & ptr, i_end));
-_                   (NormalizeType (& normalType, wasmType));
-
-                    numLocals += varCount;                                                      m3log (parse, "      %2d locals; type: '%s'", varCount, c_waTypes [normalType]);
-                }
-                 */
-
-                IM3Function func = Module_GetFunction (io_module, f + io_module->numFuncImports);
-
-                func->module = io_module;
-                func->wasm = start;
-                func->wasmEnd = i_bytes;
-                //func->ownsWasmCode = io_module->hasWasmCodeCopy;
-//                func->numLocals = numLocals;
-            }
-            else _throw (m3Err_wasmSectionOverrun);
-        }
+_       (Parse_FunctionBody (io_module, f, & i_bytes, i_end));
     }
 
     _catch:
@@ -418,21 +524,47 @@ _   (ReadLEB_u32 (& numDataSegments, & i_bytes, i_end));
 
     _throwif("too many data segments", numDataSegments > d_m3MaxSaneDataSegments);
 
-    io_module->dataSegments = m3_AllocArray (M3DataSegment, numDataSegments);
-    _throwifnull(io_module->dataSegments);
-    io_module->numDataSegments = numDataSegments;
+    if (io_module->dataSegments)
+    {
+        // preallocated by the DataCount section
+        _throwif ("data count and data section have inconsistent lengths", numDataSegments != io_module->numDataSegments);
+    }
+    else
+    {
+        io_module->dataSegments = m3_AllocatorAllocArray (& io_module->allocator, M3DataSegment, numDataSegments);
+        _throwif (m3Err_mallocFailed, numDataSegments and not io_module->dataSegments);
+        io_module->numDataSegments = numDataSegments;
+    }
 
     for (u32 i = 0; i < numDataSegments; ++i)
     {
         M3DataSegment * segment = & io_module->dataSegments [i];
 
-_       (ReadLEB_u32 (& segment->memoryRegion, & i_bytes, i_end));
+        // 0: active, memory 0;  1: passive;  2: active, explicit memory index
+        u32 flags;
+_       (ReadLEB_u32 (& flags, & i_bytes, i_end));
+        _throwif (m3Err_wasmMalformed, flags > 2);
 
-        segment->initExpr = i_bytes;
-_       (Parse_InitExpr (io_module, & i_bytes, i_end));
-        segment->initExprSize = (u32) (i_bytes - segment->initExpr);
+        segment->memoryRegion = 0;
+        segment->initExpr = NULL;
+        segment->initExprSize = 0;
+        segment->isPassive = (flags == 1);
+        segment->isDropped = false;
+
+        if (flags == 2)
+        {
+_           (ReadLEB_u32 (& segment->memoryRegion, & i_bytes, i_end));
+            _throwif (m3Err_unknownMemory, segment->memoryRegion != 0);     // modules have one memory at most
+        }
+
+        if (not segment->isPassive)
+        {
+            segment->initExpr = i_bytes;
+_           (Parse_InitExpr (io_module, & i_bytes, i_end));
+            segment->initExprSize = (u32) (i_bytes - segment->initExpr);
 
-        _throwif (m3Err_wasmMissingInitExpr, segment->initExprSize <= 1);
+            _throwif (m3Err_wasmMissingInitExpr, segment->initExprSize <= 1);
+        }
 
 _       (ReadLEB_u32 (& segment->size, & i_bytes, i_end));
         segment->data = i_bytes;                                                    m3log (parse, "    segment [%u]  memory: %u;  expr-size: %d;  size: %d",
@@ -448,6 +580,29 @@ _       (ReadLEB_u32 (& segment->size, & i_bytes, i_end));
 }
 
 
+M3Result  ParseSection_DataCount  (M3Module * io_module, bytes_t i_bytes, cbytes_t i_end)
+{
+    M3Result result = m3Err_none;
+
+    u32 numDataSegments;
+_   (ReadLEB_u32 (& numDataSegments, & i_bytes, i_end));                            m3log (parse, "** DataCount [%d]", numDataSegments);
+
+    _throwif("too many data segments", numDataSegments > d_m3MaxSaneDataSegments);
+
+    // allocate up front so the code section can be validated against it. until the data
+    // section arrives, the segments are empty & passive.
+    io_module->dataSegments = m3_AllocatorAllocArray (& io_module->allocator, M3DataSegment, numDataSegments);
+    _throwif (m3Err_mallocFailed, numDataSegments and not io_module->dataSegments);
+    io_module->numDataSegments = numDataSegments;
+    io_module->hasDataCount = true;
+
+    for (u32 i = 0; i < numDataSegments; ++i)
+        io_module->dataSegments [i].isPassive = true;
+
+    _catch: return result;
+}
+
+
 M3Result  ParseSection_Memory  (M3Module * io_module, bytes_t i_bytes, cbytes_t i_end)
 {
     M3Result result = m3Err_none;
@@ -473,6 +628,7 @@ M3Result  ParseSection_Global  (M3Module * io_module, bytes_t i_bytes, cbytes_t
 _   (ReadLEB_u32 (& numGlobals, & i_bytes, i_end));                                 m3log (parse, "** Global [%d]", numGlobals);
 
     _throwif("too many globals", numGlobals > d_m3MaxSaneGlobalsCount);
+_   (Module_PreallocGlobals (io_module, io_module->numGlobals + numGlobals));
 
     for (u32 i = 0; i < numGlobals; ++i)
     {
@@ -523,7 +679,7 @@ _           (ReadLEB_u32 (& numNames, & i_bytes, i_end));
             {
                 u32 index;
 _               (ReadLEB_u32 (& index, & i_bytes, i_end));
-_               (Read_utf8 (& name, & i_bytes, i_end));
+_               (Read_utf8 (& name, & i_bytes, i_end, & io_module->allocator));
 
                 if (index < io_module->numFunctions)
                 {
@@ -537,7 +693,7 @@ _               (Read_utf8 (& name, & i_bytes, i_end));
 //                          else m3log (parse, "prenamed: %s", io_module->functions [index].name);
                 }
 
-                m3_Free (name);
+                m3_AllocatorFree (& io_module->allocator, name);
             }
         }
 
@@ -553,7 +709,7 @@ M3Result  ParseSection_Custom  (M3Module * io_module, bytes_t i_bytes, cbytes_t
     M3Result result;
 
     cstr_t name;
-_   (Read_utf8 (& name, & i_bytes, i_end));
+_   (Read_utf8 (& name, & i_bytes, i_end, & io_module->allocator));
                                                                                     m3log (parse, "** Custom: '%s'", name);
     if (strcmp (name, "name") == 0) {
 _       (ParseSection_Name(io_module, i_bytes, i_end));
@@ -561,7 +717,7 @@ _       (ParseSection_Name(io_module, i_bytes, i_end));
 _       (io_module->environment->customSectionHandler(io_module, name, i_bytes, i_end));
     }
 
-    m3_Free (name);
+    m3_AllocatorFree (& io_module->allocator, name);
 
     _catch: return result;
 }
@@ -579,7 +735,7 @@ M3Result  ParseModuleSection  (M3Module * o_module, u8 i_sectionType, bytes_t i_
         ParseSection_Type,      // 1
         ParseSection_Import,    // 2
         ParseSection_Function,  // 3
-        NULL,                   // 4: TODO Table
+        ParseSection_Table,     // 4
         ParseSection_Memory,    // 5
         ParseSection_Global,    // 6
         ParseSection_Export,    // 7
@@ -587,7 +743,7 @@ M3Result  ParseModuleSection  (M3Module * o_module, u8 i_sectionType, bytes_t i_
         ParseSection_Element,   // 9
         ParseSection_Code,      // 10
         ParseSection_Data,      // 11
-        NULL,                   // 12: TODO DataCount
+        ParseSection_DataCount, // 12
     };
 
     M3Parser parser = NULL;
@@ -609,16 +765,44 @@ M3Result  ParseModuleSection  (M3Module * o_module, u8 i_sectionType, bytes_t i_
 }
 
 
+static
+M3Result  Parse_Preamble  (bytes_t * io_bytes, cbytes_t i_end)
+{
+_try {
+    u32 magic, version;
+_   (Read_u32 (& magic, io_bytes, i_end));
+_   (Read_u32 (& version, io_bytes, i_end));
+
+    _throwif (m3Err_wasmMalformed, magic != 0x6d736100);
+    _throwif (m3Err_incompatibleWasmVersion, version != 1);
+
+} _catch: return result;
+}
+
+
+static
+M3Result  CheckSectionOrder  (u8 * io_expectedSection, u8 i_section)
+{
+    M3Result result = m3Err_none;
+
+    static const u8 sectionsOrder[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 12, 10, 11, 0 }; // 0 is a placeholder
+
+    if (i_section != 0) {
+        // Ensure sections appear only once and in order
+        while (sectionsOrder[(* io_expectedSection)++] != i_section) {
+            _throwif(m3Err_misorderedWasmSection, * io_expectedSection >= 12);
+        }
+    }
+
+    _catch: return result;
+}
+
+
 M3Result  m3_ParseModule  (IM3Environment i_environment, IM3Module * o_module, cbytes_t i_bytes, u32 i_numBytes)
 {
-    IM3Module module;                                                               m3log (parse, "load module: %d bytes", i_numBytes);
+    IM3Module module = NULL;                                                        m3log (parse, "load module: %d bytes", i_numBytes);
 _try {
-    module = m3_AllocStruct (M3Module);
-    _throwifnull (module);
-    module->name = ".unnamed";                                                      m3log (parse, "load module: %d bytes", i_numBytes);
-    module->startFunction = -1;
-    //module->hasWasmCodeCopy = false;
-    module->environment = i_environment;
+_   (Module_New (i_environment, & module));
 
     const u8 * pos = i_bytes;
     const u8 * end = pos + i_numBytes;
@@ -626,27 +810,15 @@ _try {
     module->wasmStart = pos;
     module->wasmEnd = end;
 
-    u32 magic, version;
-_   (Read_u32 (& magic, & pos, end));
-_   (Read_u32 (& version, & pos, end));
-
-    _throwif (m3Err_wasmMalformed, magic != 0x6d736100);
-    _throwif (m3Err_incompatibleWasmVersion, version != 1);
+_   (Parse_Preamble (& pos, end));
 
-    static const u8 sectionsOrder[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 12, 10, 11, 0 }; // 0 is a placeholder
     u8 expectedSection = 0;
 
     while (pos < end)
     {
         u8 section;
 _       (ReadLEB_u7 (& section, & pos, end));
-
-        if (section != 0) {
-            // Ensure sections appear only once and in order
-            while (sectionsOrder[expectedSection++] != section) {
-                _throwif(m3Err_misorderedWasmSection, expectedSection >= 12);
-            }
-        }
+_       (CheckSectionOrder (& expectedSection, section));
 
         u32 sectionLength;
 _       (ReadLEB_u32 (& sectionLength, & pos, end));
@@ -669,3 +841,328 @@ _       (ParseModuleSection (module, section, pos, sectionLength));
 
     return result;
 }
+
+
+//---------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct M3ModuleStream
+{
+    IM3Environment          environment;
+    IM3Module               module;
+    IM3Runtime              runtime;                // optional; function bodies are compiled into it as they arrive
+    M3Result                error;                  // sticky; a failed stream rejects further input
+
+    u8                      header [8];             // preamble, or section id + length LEB
+    u32                     headerSize;
+    bool                    hasPreamble;
+
+    u8 *                    section;                // current section; handed to the module once complete
+    u32                     sectionSize;
+    u32                     sectionFilled;
+    u8                      sectionType;
+    bool                    inSection;
+    u8                      expectedSection;
+
+    u32                     codeParsed;             // code section: bytes of complete function bodies already consumed
+    u32                     numCodeFunctions;
+    u32                     numCodeParsed;
+
+    u32                     offset;                 // position in the binary
+}
+M3ModuleStream;
+
+
+static
+M3Result  Stream_RetainSection  (IM3ModuleStream io_stream)
+{
+_try {
+    IM3Module module = io_stream->module;
+
+    if (io_stream->section)
+    {
+        module->streamSections = m3_AllocatorReallocArray (& module->allocator, void *, module->streamSections, module->numStreamSections + 1, module->numStreamSections);
+        _throwifnull (module->streamSections);
+
+        module->streamSections [module->numStreamSections++] = io_stream->section;
+        io_stream->section = NULL;
+    }
+
+} _catch: return result;
+}
+
+
+static
+M3Result  Stream_CompileFunction  (IM3ModuleStream io_stream, IM3Function io_function)
+{
+    IM3Module module = io_stream->module;
+
+    // the module isn't loaded yet; only borrow the runtime for its code pages
+    module->runtime = io_stream->runtime;
+    M3Result result = CompileFunction (io_function);
+    module->runtime = NULL;
+
+    return result;
+}
+
+
+// registers the code section's function bodies as soon as each one is complete
+static
+M3Result  Stream_ParseCode  (IM3ModuleStream io_stream)
+{
+    M3Result result = m3Err_none;
+
+    IM3Module module = io_stream->module;
+    bytes_t pos = io_stream->section + io_stream->codeParsed;
+    cbytes_t end = io_stream->section + io_stream->sectionFilled;
+
+    if (io_stream->codeParsed == 0)
+    {
+        u32 numFunctions;
+        if (ReadLEB_u32 (& numFunctions, & pos, end))
+            return m3Err_none;                                                      // count LEB not complete yet
+
+        _throwif ("mismatched function count in code section", numFunctions != module->numFunctions - module->numFuncImports);
+
+        io_stream->numCodeFunctions = numFunctions;
+        io_stream->codeParsed = (u32) (pos - io_stream->section);
+    }
+
+    while (io_stream->numCodeParsed < io_stream->numCodeFunctions)
+    {
+        bytes_t body = pos;
+        u32 size;
+
+        if (ReadLEB_u32 (& size, & body, end) or size > (u32) (end - body))
+            break;                                                                  // body not complete yet
+
+_       (Parse_FunctionBody (module, io_stream->numCodeParsed, & pos, end));
+
+        IM3Function function = & module->functions [module->numFuncImports + io_stream->numCodeParsed];
+
+        if (io_stream->runtime and function->wasm)
+_           (Stream_CompileFunction (io_stream, function));
+
+        io_stream->numCodeParsed++;
+        io_stream->codeParsed = (u32) (pos - io_stream->section);
+    }
+
+    _catch: return result;
+}
+
+
+static
+M3Result  Stream_CompleteSection  (IM3ModuleStream io_stream)
+{
+_try {
+    IM3Module module = io_stream->module;
+
+    if (io_stream->sectionType == 10)
+    {
+_       (Stream_ParseCode (io_stream));
+
+        _throwif ("mismatched function count in code section", io_stream->numCodeParsed != io_stream->numCodeFunctions);
+        _throwif (m3Err_wasmSectionUnderrun, io_stream->codeParsed != io_stream->sectionSize);
+    }
+    else
+    {
+_       (ParseModuleSection (module, io_stream->sectionType, io_stream->section, io_stream->sectionSize));
+    }
+
+    // function bodies, data segments & init expressions point into the section
+_   (Stream_RetainSection (io_stream));
+
+    io_stream->inSection = false;
+
+} _catch: return result;
+}
+
+
+static
+M3Result  Stream_ParseHeader  (IM3ModuleStream io_stream)
+{
+_try {
+    bytes_t pos = io_stream->header;
+    cbytes_t end = io_stream->header + io_stream->headerSize;
+
+    if (not io_stream->hasPreamble)
+    {
+        if (io_stream->headerSize == 8)
+        {
+_           (Parse_Preamble (& pos, end));
+            io_stream->hasPreamble = true;
+            io_stream->headerSize = 0;
+        }
+    }
+    else if (io_stream->headerSize >= 2)
+    {
+        u8 section;
+        u32 sectionLength;
+
+_       (ReadLEB_u7 (& section, & pos, end));
+        result = ReadLEB_u32 (& sectionLength, & pos, end);
+
+        if (result == m3Err_wasmUnderrun and io_stream->headerSize < sizeof (io_stream->header))
+            return m3Err_none;                                                      // length LEB not complete yet
+_       (result);
+
+_       (CheckSectionOrder (& io_stream->expectedSection, section));
+
+        io_stream->headerSize = 0;
+        io_stream->sectionType = section;
+        io_stream->sectionSize = sectionLength;
+        io_stream->sectionFilled = 0;
+        io_stream->codeParsed = 0;
+        io_stream->inSection = true;
+
+        if (sectionLength)
+        {
+            io_stream->section = (u8 *) m3_AllocatorMalloc (& io_stream->module->allocator, sectionLength);
+            _throwifnull (io_stream->section);
+        }
+
+        if (section == 10)
+        {
+            // keep code page mapping entries relative to the start of the binary
+            io_stream->module->wasmStart = io_stream->section;
+            io_stream->module->wasmEnd = io_stream->section + sectionLength;
+            io_stream->module->wasmStartOffset = io_stream->offset;
+        }
+
+        if (not sectionLength)
+_           (Stream_CompleteSection (io_stream));
+    }
+
+} _catch: return result;
+}
+
+
+M3Result  m3_ParseModuleStreaming  (IM3Environment i_environment, IM3ModuleStream * o_stream)
+{
+    IM3ModuleStream stream = NULL;
+_try {
+    stream = m3_AllocatorAllocStruct (& i_environment->allocator, M3ModuleStream);
+    _throwifnull (stream);
+    stream->environment = i_environment;
+
+_   (Module_New (i_environment, & stream->module));
+
+} _catch:
+
+    if (result)
+        m3_FreeModuleStream (stream);
+    else
+        * o_stream = stream;
+
+    return result;
+}
+
+
+M3Result  m3_CompileModuleStream  (IM3ModuleStream io_stream, IM3Runtime i_runtime)
+{
+    if (io_stream->error)
+        return io_stream->error;
+
+    if (io_stream->expectedSection > 10)                                            // past the code section's place in sectionsOrder
+        return "code section already started";
+
+    io_stream->runtime = i_runtime;
+    io_stream->module->streamRuntime = i_runtime;
+
+    return m3Err_none;
+}
+
+
+M3Result  m3_FeedModuleStream  (IM3ModuleStream io_stream, const uint8_t * i_bytes, uint32_t i_numBytes)
+{
+    M3Result result = io_stream->error;
+
+    while (not result and i_numBytes)
+    {
+        if (not io_stream->inSection)
+        {
+            io_stream->header [io_stream->headerSize++] = * i_bytes++;
+            --i_numBytes;
+            ++io_stream->offset;
+
+            result = Stream_ParseHeader (io_stream);
+        }
+        else
+        {
+            u32 numBytes = M3_MIN (i_numBytes, io_stream->sectionSize - io_stream->sectionFilled);
+
+            memcpy (io_stream->section + io_stream->sectionFilled, i_bytes, numBytes);
+            io_stream->sectionFilled += numBytes;
+            io_stream->offset += numBytes;
+            i_bytes += numBytes;
+            i_numBytes -= numBytes;
+
+            if (io_stream->sectionFilled == io_stream->sectionSize)
+                result = Stream_CompleteSection (io_stream);
+            else if (io_stream->sectionType == 10)
+                result = Stream_ParseCode (io_stream);
+        }
+    }
+
+    io_stream->error = result;
+
+    return result;
+}
+
+
+M3Result  m3_FinishModuleStream  (IM3ModuleStream i_stream, IM3Module * o_module)
+{
+    M3Result result = i_stream->error;
+
+    * o_module = NULL;
+
+    if (not result and (not i_stream->hasPreamble or i_stream->inSection or i_stream->headerSize))
+        result = m3Err_wasmUnderrun;
+
+    if (not result)
+    {
+        * o_module = i_stream->module;
+        i_stream->module = NULL;
+    }
+
+    m3_FreeModuleStream (i_stream);
+
+    return result;
+}
+
+
+void  m3_FreeModuleStream  (IM3ModuleStream i_stream)
+{
+    if (i_stream)
+    {
+        if (i_stream->module)
+        {
+            m3_AllocatorFree (& i_stream->module->allocator, i_stream->section);
+            m3_FreeModule (i_stream->module);
+        }
+        m3_AllocatorFree (& i_stream->environment->allocator, i_stream);
+    }
+}
+
+
+M3Result  m3_ParseModuleFile  (IM3Environment i_environment, IM3Module * o_module, const char * const i_path)
+{
+    void * wasm = NULL;
+    size_t wasmSize = 0;
+
+    * o_module = NULL;
+_try {
+_   (m3_MapFile (& wasm, & wasmSize, i_path));
+    _throwif (m3Err_fileTooBig, (u64) wasmSize > UINT32_MAX);
+
+_   (m3_ParseModule (i_environment, o_module, (cbytes_t) wasm, (u32) wasmSize));
+
+    (* o_module)->wasmMapping = wasm;
+    (* o_module)->wasmMappingSize = wasmSize;
+    wasm = NULL;
+
+} _catch:
+
+    m3_UnmapFile (wasm, wasmSize);
+
+    return result;
+}
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <stdarg.h>
+#include <stdbool.h>
 
 #include "wasm3_defs.h"
 
@@ -35,6 +36,9 @@ struct M3Runtime;       typedef struct M3Runtime *      IM3Runtime;
 struct M3Module;        typedef struct M3Module *       IM3Module;
 struct M3Function;      typedef struct M3Function *     IM3Function;
 struct M3Global;        typedef struct M3Global *       IM3Global;
+struct M3ModuleStream;  typedef struct M3ModuleStream * IM3ModuleStream;
+struct M3PreparedCall;  typedef struct M3PreparedCall * IM3PreparedCall;
+struct M3ImportRegistry;typedef struct M3ImportRegistry * IM3ImportRegistry;
 
 typedef struct M3ErrorInfo
 {
@@ -66,6 +70,26 @@ typedef struct M3BacktraceInfo
 }
 M3BacktraceInfo, * IM3BacktraceInfo;
 
+typedef struct M3FunctionProfile
+{
+    IM3Function                  function;
+    uint64_t                     calls;
+    uint64_t                     numOpsExecuted;
+    const uint64_t *             opCounts;     // per op, indexed like M3ProfilerStats.opNames
+}
+M3FunctionProfile;
+
+typedef struct M3ProfilerStats
+{
+    uint32_t                     numOps;
+    const char * const *         opNames;      // the op table: wasm opcodes, e.g. "i32.add"; unused entries are "reserved"
+    const uint64_t *             opCounts;     // per op, summed over the functions
+
+    uint32_t                     numFunctions; // functions that ran, most ops executed first
+    const M3FunctionProfile *    functions;
+}
+M3ProfilerStats, * IM3ProfilerStats;
+
 
 typedef enum M3ValueType
 {
@@ -78,16 +102,20 @@ typedef enum M3ValueType
     c_m3Type_unknown
 } M3ValueType;
 
+// one 64-bit value slot; i32/f32 occupy the low-address bytes, matching the wasm stack layout
+typedef union M3ValueUnion
+{
+    uint32_t    i32;
+    uint64_t    i64;
+    float       f32;
+    double      f64;
+}
+M3Value;
+
 typedef struct M3TaggedValue
 {
     M3ValueType type;
-    union M3ValueUnion
-    {
-        uint32_t    i32;
-        uint64_t    i64;
-        float       f32;
-        double      f64;
-    } value;
+    M3Value     value;
 }
 M3TaggedValue, * IM3TaggedValue;
 
@@ -106,6 +134,19 @@ typedef struct M3ImportContext
 }
 M3ImportContext, * IM3ImportContext;
 
+
+// allocate & reallocate must return zero-filled memory (reallocate: the grown tail)
+typedef struct M3Allocator
+{
+    void *          (* allocate)    (void * i_userdata, size_t i_size);
+    void *          (* reallocate)  (void * i_userdata, void * i_ptr, size_t i_newSize, size_t i_oldSize);
+    void            (* release)     (void * i_userdata, void * i_ptr);
+    void *          userdata;
+}
+M3Allocator;
+
+typedef const M3Allocator *     IM3Allocator;
+
 // -------------------------------------------------------------------------------------------------------------------------------
 //  error codes
 // -------------------------------------------------------------------------------------------------------------------------------
@@ -126,6 +167,9 @@ d_m3ErrorConst  (none,                          NULL)
 
 // general errors
 d_m3ErrorConst  (mallocFailed,                  "memory allocation failed")
+d_m3ErrorConst  (cannotOpenFile,                "cannot open file")
+d_m3ErrorConst  (cannotReadFile,                "cannot read file")
+d_m3ErrorConst  (fileTooBig,                    "file is too big")
 
 // parse errors
 d_m3ErrorConst  (incompatibleWasmVersion,       "incompatible Wasm binary version")
@@ -140,12 +184,15 @@ d_m3ErrorConst  (wasmSectionUnderrun,           "section underrun while parsing
 d_m3ErrorConst  (wasmSectionOverrun,            "section overrun while parsing Wasm binary")
 d_m3ErrorConst  (invalidTypeId,                 "unknown value_type")
 d_m3ErrorConst  (tooManyMemorySections,         "only one memory per module is supported")
+d_m3ErrorConst  (unknownMemory,                 "unknown memory")
 d_m3ErrorConst  (tooManyArgsRets,               "too many arguments or return values")
 
 // link errors
 d_m3ErrorConst  (moduleNotLinked,               "attempting to use module that is not loaded")
 d_m3ErrorConst  (moduleAlreadyLinked,           "attempting to bind module to multiple runtimes")
 d_m3ErrorConst  (functionLookupFailed,          "function lookup failed")
+d_m3ErrorConst  (functionSignatureMismatch,     "function signature mismatch")
+d_m3ErrorConst  (typedImportUnsupported,        "typed import signature not supported")
 d_m3ErrorConst  (functionImportMissing,         "missing imported function")
 
 d_m3ErrorConst  (malformedFunctionSignature,    "malformed function signature")
@@ -171,6 +218,15 @@ d_m3ErrorConst  (argumentTypeMismatch,          "argument type mismatch")
 d_m3ErrorConst  (globalLookupFailed,            "global lookup failed")
 d_m3ErrorConst  (globalTypeMismatch,            "global type mismatch")
 d_m3ErrorConst  (globalNotMutable,              "global is not mutable")
+d_m3ErrorConst  (fuelMeteringDisabled,          "fuel metering is not enabled")
+d_m3ErrorConst  (interruptsDisabled,            "interrupts are not enabled")
+d_m3ErrorConst  (suspended,                     "execution suspended")
+d_m3ErrorConst  (notSuspended,                  "runtime has no suspended call")
+d_m3ErrorConst  (cannotSuspend,                 "runtime is not executing on a resumable stack")
+d_m3ErrorConst  (runtimeSuspended,              "runtime has a suspended call in progress")
+d_m3ErrorConst  (samplingDisabled,              "sampling is not enabled")
+d_m3ErrorConst  (samplerBusy,                   "another runtime is being sampled")
+d_m3ErrorConst  (notSampled,                    "runtime is not being sampled on this thread")
 
 // traps
 d_m3ErrorConst  (trapOutOfBoundsMemoryAccess,   "[trap] out of bounds memory access")
@@ -180,10 +236,14 @@ d_m3ErrorConst  (trapIntegerConversion,         "[trap] invalid conversion to in
 d_m3ErrorConst  (trapIndirectCallTypeMismatch,  "[trap] indirect call type mismatch")
 d_m3ErrorConst  (trapTableIndexOutOfRange,      "[trap] undefined element")
 d_m3ErrorConst  (trapTableElementIsNull,        "[trap] null table element")
+d_m3ErrorConst  (trapTableOutOfBounds,          "[trap] out of bounds table access")
 d_m3ErrorConst  (trapExit,                      "[trap] program called exit")
 d_m3ErrorConst  (trapAbort,                     "[trap] program called abort")
 d_m3ErrorConst  (trapUnreachable,               "[trap] unreachable executed")
 d_m3ErrorConst  (trapStackOverflow,             "[trap] stack overflow")
+d_m3ErrorConst  (trapOutOfFuel,                 "[trap] out of fuel")
+d_m3ErrorConst  (trapInterrupted,               "[trap] interrupted")
+d_m3ErrorConst  (trapDeadlineExceeded,          "[trap] deadline exceeded")
 
 
 //-------------------------------------------------------------------------------------------------------------------------------
@@ -195,6 +255,10 @@ d_m3ErrorConst  (trapStackOverflow,             "[trap] stack overflow")
 //-------------------------------------------------------------------------------------------------------------------------------
     IM3Environment      m3_NewEnvironment           (void);
 
+    // The environment, its runtimes and its modules allocate through i_allocator (copied). Modules additionally
+    // carve their module-lifetime data out of a bump arena (d_m3EnableModuleArena) that is released in one shot
+    IM3Environment      m3_NewEnvironmentWithAllocator  (IM3Allocator  i_allocator);
+
     void                m3_FreeEnvironment          (IM3Environment i_environment);
 
     typedef M3Result (* M3SectionHandler) (IM3Module i_module, const char* name, const uint8_t * start, const uint8_t * end);
@@ -222,6 +286,23 @@ d_m3ErrorConst  (trapStackOverflow,             "[trap] stack overflow")
 
     void *              m3_GetUserData              (IM3Runtime             i_runtime);
 
+    // fuel metering (d_m3EnableFuelMetering): function entries and loop iterations are charged the number of
+    // wasm instructions they cover; execution traps with m3Err_trapOutOfFuel instead of overdrawing.
+    // a runtime is unmetered (UINT64_MAX) until fuel is set. requires a loaded module
+    M3Result            m3_SetFuel                  (IM3Runtime             i_runtime,
+                                                     uint64_t               i_fuel);
+    uint64_t            m3_GetFuel                  (IM3Runtime             i_runtime);
+
+    // interrupts (d_m3EnableInterrupts): m3_Interrupt can be called from any thread; the running call traps with
+    // m3Err_trapInterrupted at a function entry or loop iteration, and the request is consumed. a request made
+    // while no call is running is kept, so a watchdog racing a call's start can't lose it, and stops the next
+    // call instead; a deadline bounds a single call without that hazard.
+    // m3_SetDeadline arms a monotonic deadline i_nanoseconds from now (0 disarms); calls past it trap with
+    // m3Err_trapDeadlineExceeded until it is reset
+    M3Result            m3_Interrupt                (IM3Runtime             i_runtime);
+    M3Result            m3_SetDeadline              (IM3Runtime             i_runtime,
+                                                     uint64_t               i_nanoseconds);
+
 
 //-------------------------------------------------------------------------------------------------------------------------------
 //  modules
@@ -233,6 +314,37 @@ d_m3ErrorConst  (trapStackOverflow,             "[trap] stack overflow")
                                                      const uint8_t * const  i_wasmBytes,
                                                      uint32_t               i_numWasmBytes);
 
+    // Maps the file read-only (or reads it into the heap where mmap isn't available). Function bodies and
+    // data segments point into the mapping, which is owned by the module and released by m3_FreeModule.
+    // Files over d_m3MaxModuleFileSize fail with m3Err_fileTooBig; the size is taken from the open file
+    M3Result            m3_ParseModuleFile          (IM3Environment         i_environment,
+                                                     IM3Module *            o_module,
+                                                     const char * const     i_path);
+
+    // Incremental parsing: bytes can be fed in chunks of any size. Each section is parsed as soon as it is
+    // complete; code section bodies are registered (and optionally compiled) one by one while the rest of
+    // the section is arriving.
+    // The module owns copies of the sections, so the fed buffers may be reused right away.
+    M3Result            m3_ParseModuleStreaming     (IM3Environment         i_environment,
+                                                     IM3ModuleStream *      o_stream);
+
+    // Compiles each function body into i_runtime as soon as it has arrived, overlapping compilation with the
+    // rest of the download. Must be called before the code section starts; the finished module can then only
+    // be loaded into i_runtime. Validation errors in function bodies are reported by m3_FeedModuleStream
+    M3Result            m3_CompileModuleStream      (IM3ModuleStream        io_stream,
+                                                     IM3Runtime             i_runtime);
+
+    M3Result            m3_FeedModuleStream         (IM3ModuleStream        io_stream,
+                                                     const uint8_t * const  i_bytes,
+                                                     uint32_t               i_numBytes);
+
+    // Always releases the stream. On success, the module is handed over to the caller
+    M3Result            m3_FinishModuleStream       (IM3ModuleStream        i_stream,
+                                                     IM3Module *            o_module);
+
+    // Abandons an unfinished stream
+    void                m3_FreeModuleStream         (IM3ModuleStream        i_stream);
+
     // Only modules not loaded into a M3Runtime need to be freed. A module is considered unloaded if
     // a. m3_LoadModule has not yet been called on that module. Or,
     // b. m3_LoadModule returned a result.
@@ -265,6 +377,46 @@ d_m3ErrorConst  (trapStackOverflow,             "[trap] stack overflow")
                                                      M3RawCall              i_function,
                                                      const void *           i_userdata);
 
+    // Typed imports receive their wasm arguments as C parameters and return their result directly,
+    // e.g. "F(FF)" links double (*)(double, double) and "v(i*)" links void (*)(int32_t, int32_t).
+    // The signature is required and selects the call thunk; at most one result and d_m3MaxTypedImportArgs
+    // arguments (2 by default, up to 6 when built wider; only i32 & i64 past the 3rd) are supported. Typed imports have no
+    // access to the runtime or memory and cannot trap
+    typedef void (* M3TypedCall) (void);
+
+    M3Result            m3_LinkTypedFunction        (IM3Module              io_module,
+                                                     const char * const     i_moduleName,
+                                                     const char * const     i_functionName,
+                                                     const char * const     i_signature,
+                                                     M3TypedCall            i_function);
+
+    // An import registry maps module!field to host functions. Build it once and link any number of modules
+    // against it; each link is a single pass over the module's imports. i_moduleName "*" matches any module,
+    // and registering the same module!field again replaces the entry. Names & signatures are copied
+    IM3ImportRegistry   m3_NewImportRegistry        (void);
+    void                m3_FreeImportRegistry       (IM3ImportRegistry      i_registry);
+
+    M3Result            m3_RegisterRawFunction      (IM3ImportRegistry      io_registry,
+                                                     const char * const     i_moduleName,
+                                                     const char * const     i_functionName,
+                                                     const char * const     i_signature,
+                                                     M3RawCall              i_function,
+                                                     const void *           i_userdata);
+
+    M3Result            m3_RegisterTypedFunction    (IM3ImportRegistry      io_registry,
+                                                     const char * const     i_moduleName,
+                                                     const char * const     i_functionName,
+                                                     const char * const     i_signature,
+                                                     M3TypedCall            i_function);
+
+    // called for every imported function that is neither in the registry nor already linked
+    typedef void (* M3UnresolvedImportHandler) (void * i_userdata, const char * i_moduleName, const char * i_functionName);
+
+    M3Result            m3_LinkImportRegistry       (IM3Module              io_module,
+                                                     IM3ImportRegistry      i_registry,
+                                                     M3UnresolvedImportHandler  i_unresolved,      // optional
+                                                     void *                 i_userdata);
+
     const char*         m3_GetModuleName            (IM3Module i_module);
     void                m3_SetModuleName            (IM3Module i_module, const char* name);
     IM3Runtime          m3_GetModuleRuntime         (IM3Module i_module);
@@ -286,6 +438,7 @@ d_m3ErrorConst  (trapStackOverflow,             "[trap] stack overflow")
 //-------------------------------------------------------------------------------------------------------------------------------
 //  functions
 //-------------------------------------------------------------------------------------------------------------------------------
+    // called by the interpreter on every function call; weak, so a host can override it
     M3Result            m3_Yield                    (void);
 
     // o_function is valid during the lifetime of the originating runtime
@@ -310,6 +463,41 @@ d_m3ErrorConst  (trapStackOverflow,             "[trap] stack overflow")
     M3Result            m3_GetResultsVL             (IM3Function i_function, va_list o_rets);
     M3Result            m3_GetResults               (IM3Function i_function, uint32_t i_retc, const void * o_retptrs[]);
 
+    // a prepared call resolves the function, its signature and runtime once. the host fills the argument slots
+    // (m3_GetPreparedArgs) and reads results in place (m3_GetPreparedResults; valid until the runtime runs again).
+    // the handle is valid during the lifetime of the originating runtime
+    M3Result            m3_PrepareCall              (IM3PreparedCall *      o_call,
+                                                     IM3Function            i_function);
+    void                m3_FreePreparedCall         (IM3PreparedCall        i_call);
+
+    M3Value *           m3_GetPreparedArgs          (IM3PreparedCall        i_call);
+    const M3Value *     m3_GetPreparedResults       (IM3PreparedCall        i_call);
+
+    M3Result            m3_CallPrepared             (IM3PreparedCall        i_call);
+
+    // runs the call once per argument tuple: i_args holds i_count * numArgs slots, o_results receives
+    // i_count * numRets slots. stops at the first trap; o_numCompleted (optional) reports how many calls finished
+    M3Result            m3_CallPreparedBatch        (IM3PreparedCall        i_call,
+                                                     uint32_t               i_count,
+                                                     const M3Value *        i_args,
+                                                     M3Value *              o_results,
+                                                     uint32_t *             o_numCompleted);
+
+    // resumable execution (d_m3EnableResumableCalls): a suspendable runtime runs its calls on a private,
+    // guard-paged native stack; calls that would recurse past it trap with m3Err_trapStackOverflow.
+    // m3_Suspend, called from a host import, switches back to the host and the pending m3_Call* returns
+    // m3Err_suspended; m3_Resume continues the guest later, from any thread, and returns the call's result.
+    // m3_RequestSuspend asks the interpreter to suspend at the next function call (see m3_Yield); the call
+    // it is made during must already be on the fiber, otherwise it applies to the next one.
+    // runtimes aren't suspendable by default, so their calls skip the context switches.
+    // m3_CanSuspend tells a host import whether m3_Suspend would succeed from where it is called
+    M3Result            m3_Suspend                  (IM3Runtime i_runtime);
+    M3Result            m3_Resume                   (IM3Runtime i_runtime);
+    void                m3_RequestSuspend           (IM3Runtime i_runtime);
+    void                m3_SetSuspendable           (IM3Runtime i_runtime, bool i_suspendable);
+    bool                m3_IsSuspended              (IM3Runtime i_runtime);
+    bool                m3_CanSuspend               (IM3Runtime i_runtime);
+
 
     void                m3_GetErrorInfo             (IM3Runtime i_runtime, M3ErrorInfo* o_info);
     void                m3_ResetErrorInfo           (IM3Runtime i_runtime);
@@ -323,11 +511,24 @@ d_m3ErrorConst  (trapStackOverflow,             "[trap] stack overflow")
 
     void                m3_PrintRuntimeInfo         (IM3Runtime i_runtime);
     void                m3_PrintM3Info              (void);
-    void                m3_PrintProfilerInfo        (void);
 
     // The runtime owns the backtrace, do not free the backtrace you obtain. Returns NULL if there's no backtrace.
     IM3BacktraceInfo    m3_GetBacktrace             (IM3Runtime i_runtime);
 
+    // op counters (d_m3EnableOpProfiling): ops executed by each function of the runtime since it was loaded
+    // or last reset. the runtime owns the returned snapshot; it stays valid until the next call. returns NULL
+    // when the counters aren't compiled in or the snapshot can't be allocated
+    IM3ProfilerStats    m3_GetProfilerStats         (IM3Runtime i_runtime);
+    void                m3_ResetProfilerStats       (IM3Runtime i_runtime);
+
+    // statistical profiler (d_m3EnableSampling, POSIX): SIGPROF samples the wasm call chain of i_runtime
+    // i_samplesPerSecond times per second of CPU time. one runtime is sampled at a time, on the thread that
+    // called m3_StartSampling; m3_StopSampling must be called on that thread too. it writes the chains to
+    // i_foldedPath, unless NULL, as "outer;inner count" lines (flamegraph.pl, speedscope), named from the
+    // name section. time spent in host imports is charged to the import
+    M3Result            m3_StartSampling            (IM3Runtime i_runtime, uint32_t i_samplesPerSecond);
+    M3Result            m3_StopSampling             (IM3Runtime i_runtime, const char * i_foldedPath);
+
 //-------------------------------------------------------------------------------------------------------------------------------
 //  raw function definition helpers
 //-------------------------------------------------------------------------------------------------------------------------------
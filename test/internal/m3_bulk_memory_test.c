@@ -0,0 +1,258 @@
+//
+//  m3_bulk_memory_test.c
+//
+//  Passive data/element segments and the bulk memory and table operations.
+//
+//  wasm_bulk_memory is assembled from m3_bulk_memory_test.wat. The two invalid modules are
+//
+//    (module
+//      (memory 1)
+//      (data $p "x")
+//      (func (export "drop") data.drop $p)
+//      (func (export "init") i32.const 0 i32.const 0 i32.const 0 memory.init $p))
+//
+//  with its DataCount section removed, and with memory.init naming memory 1. wasm_data_memory_0/1 are
+//
+//    (module (memory 1) (data (memory 0|1) (i32.const 0) "x"))
+//
+//  with the segment's memory index given explicitly (flags 2).
+//
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wasm3.h"
+
+static const uint8_t wasm_bulk_memory[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x13, 0x04, 0x60,
+  0x00, 0x01, 0x7f, 0x60, 0x03, 0x7f, 0x7f, 0x7f, 0x00, 0x60, 0x00, 0x00,
+  0x60, 0x01, 0x7f, 0x01, 0x7f, 0x03, 0x0e, 0x0d, 0x00, 0x00, 0x00, 0x01,
+  0x01, 0x02, 0x01, 0x01, 0x03, 0x01, 0x02, 0x01, 0x03, 0x04, 0x04, 0x01,
+  0x70, 0x00, 0x04, 0x05, 0x03, 0x01, 0x00, 0x01, 0x07, 0x60, 0x0a, 0x04,
+  0x69, 0x6e, 0x69, 0x74, 0x00, 0x03, 0x0b, 0x69, 0x6e, 0x69, 0x74, 0x5f,
+  0x61, 0x63, 0x74, 0x69, 0x76, 0x65, 0x00, 0x04, 0x04, 0x64, 0x72, 0x6f,
+  0x70, 0x00, 0x05, 0x04, 0x66, 0x69, 0x6c, 0x6c, 0x00, 0x06, 0x04, 0x63,
+  0x6f, 0x70, 0x79, 0x00, 0x07, 0x05, 0x6c, 0x6f, 0x61, 0x64, 0x38, 0x00,
+  0x08, 0x0a, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x5f, 0x69, 0x6e, 0x69, 0x74,
+  0x00, 0x09, 0x09, 0x65, 0x6c, 0x65, 0x6d, 0x5f, 0x64, 0x72, 0x6f, 0x70,
+  0x00, 0x0a, 0x0a, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x5f, 0x63, 0x6f, 0x70,
+  0x79, 0x00, 0x0b, 0x04, 0x63, 0x61, 0x6c, 0x6c, 0x00, 0x0c, 0x09, 0x0c,
+  0x02, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x41, 0x00, 0x0b, 0x01, 0x02,
+  0x0c, 0x01, 0x02, 0x0a, 0x79, 0x0d, 0x04, 0x00, 0x41, 0x01, 0x0b, 0x04,
+  0x00, 0x41, 0x02, 0x0b, 0x04, 0x00, 0x41, 0x03, 0x0b, 0x0c, 0x00, 0x20,
+  0x00, 0x20, 0x01, 0x20, 0x02, 0xfc, 0x08, 0x00, 0x00, 0x0b, 0x0c, 0x00,
+  0x20, 0x00, 0x20, 0x01, 0x20, 0x02, 0xfc, 0x08, 0x01, 0x00, 0x0b, 0x05,
+  0x00, 0xfc, 0x09, 0x00, 0x0b, 0x0b, 0x00, 0x20, 0x00, 0x20, 0x01, 0x20,
+  0x02, 0xfc, 0x0b, 0x00, 0x0b, 0x0c, 0x00, 0x20, 0x00, 0x20, 0x01, 0x20,
+  0x02, 0xfc, 0x0a, 0x00, 0x00, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x2d, 0x00,
+  0x00, 0x0b, 0x0c, 0x00, 0x20, 0x00, 0x20, 0x01, 0x20, 0x02, 0xfc, 0x0c,
+  0x00, 0x00, 0x0b, 0x05, 0x00, 0xfc, 0x0d, 0x00, 0x0b, 0x0c, 0x00, 0x20,
+  0x00, 0x20, 0x01, 0x20, 0x02, 0xfc, 0x0e, 0x00, 0x00, 0x0b, 0x07, 0x00,
+  0x20, 0x00, 0x11, 0x00, 0x00, 0x0b, 0x0b, 0x0f, 0x02, 0x01, 0x05, 0x01,
+  0x02, 0x03, 0x04, 0x05, 0x00, 0x41, 0x00, 0x0b, 0x02, 0x41, 0x42, 0x00,
+  0x19, 0x04, 0x6e, 0x61, 0x6d, 0x65, 0x01, 0x12, 0x03, 0x00, 0x03, 0x6f,
+  0x6e, 0x65, 0x01, 0x03, 0x74, 0x77, 0x6f, 0x02, 0x05, 0x74, 0x68, 0x72,
+  0x65, 0x65
+};
+
+static const uint8_t wasm_no_datacount[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x04, 0x01, 0x60,
+  0x00, 0x00, 0x03, 0x03, 0x02, 0x00, 0x00, 0x05, 0x03, 0x01, 0x00, 0x01,
+  0x07, 0x0f, 0x02, 0x04, 0x64, 0x72, 0x6f, 0x70, 0x00, 0x00, 0x04, 0x69,
+  0x6e, 0x69, 0x74, 0x00, 0x01, 0x0a, 0x14, 0x02, 0x05, 0x00, 0xfc, 0x09,
+  0x00, 0x0b, 0x0c, 0x00, 0x41, 0x00, 0x41, 0x00, 0x41, 0x00, 0xfc, 0x08,
+  0x00, 0x00, 0x0b, 0x0b, 0x04, 0x01, 0x01, 0x01, 0x78
+};
+
+static const uint8_t wasm_memory_1[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x04, 0x01, 0x60,
+  0x00, 0x00, 0x03, 0x03, 0x02, 0x00, 0x00, 0x05, 0x03, 0x01, 0x00, 0x01,
+  0x07, 0x0f, 0x02, 0x04, 0x64, 0x72, 0x6f, 0x70, 0x00, 0x00, 0x04, 0x69,
+  0x6e, 0x69, 0x74, 0x00, 0x01, 0x0c, 0x01, 0x01, 0x0a, 0x14, 0x02, 0x05,
+  0x00, 0xfc, 0x09, 0x00, 0x0b, 0x0c, 0x00, 0x41, 0x00, 0x41, 0x00, 0x41,
+  0x00, 0xfc, 0x08, 0x00, 0x01, 0x0b, 0x0b, 0x04, 0x01, 0x01, 0x01, 0x78
+};
+
+static const uint8_t wasm_data_memory_0[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x05, 0x03, 0x01, 0x00,
+  0x01, 0x0b, 0x08, 0x01, 0x02, 0x00, 0x41, 0x00, 0x0b, 0x01, 0x78
+};
+
+static const uint8_t wasm_data_memory_1[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x05, 0x03, 0x01, 0x00,
+  0x01, 0x0b, 0x08, 0x01, 0x02, 0x01, 0x41, 0x00, 0x0b, 0x01, 0x78
+};
+
+static int g_failures = 0;
+
+static void failf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    g_failures++;
+}
+
+static void expect_m3_err_eq(const char* where, M3Result res, M3Result expected) {
+    if (res != expected) {
+        failf("%s: got error=%s expected=%s", where, res ? res : "(null)", expected ? expected : "(null)");
+    }
+}
+
+// compile errors are reported as plain strings rather than m3Err_ constants
+static void expect_m3_err_str(const char* where, M3Result res, const char* expected) {
+    if (!res || strcmp(res, expected) != 0) {
+        failf("%s: got error=%s expected=%s", where, res ? res : "(null)", expected);
+    }
+}
+
+static void expect_i32_eq(const char* where, int32_t got, int32_t expected) {
+    if (got != expected) {
+        failf("%s: got=%" PRId32 " expected=%" PRId32, where, got, expected);
+    }
+}
+
+static IM3Function find_fn(IM3Runtime runtime, const char* name) {
+    IM3Function fn = NULL;
+    M3Result res = m3_FindFunction(&fn, runtime, name);
+    if (res != m3Err_none) {
+        failf("m3_FindFunction(%s) failed: %s", name, res);
+        return NULL;
+    }
+    return fn;
+}
+
+static IM3Runtime load(IM3Environment env, const uint8_t* wasm, uint32_t size) {
+    IM3Runtime runtime = m3_NewRuntime(env, 64 * 1024, NULL);
+    IM3Module module = NULL;
+
+    M3Result res = m3_ParseModule(env, &module, wasm, size);
+    if (!res) {
+        res = m3_LoadModule(runtime, module);
+        if (res) m3_FreeModule(module);
+    }
+    if (res) {
+        failf("loading module: %s", res);
+        m3_FreeRuntime(runtime);
+        return NULL;
+    }
+    return runtime;
+}
+
+static int32_t load8(IM3Function fn, uint32_t addr) {
+    uint32_t value = 0;
+    M3Result res = m3_CallV(fn, addr);
+    if (res) failf("load8(%" PRIu32 "): %s", addr, res);
+    m3_GetResultsV(fn, &value);
+    return (int32_t) value;
+}
+
+static int32_t call_table(IM3Function fn, uint32_t index, M3Result expected) {
+    uint32_t value = 0;
+    M3Result res = m3_CallV(fn, index);
+    expect_m3_err_eq("call_indirect", res, expected);
+    if (!res) m3_GetResultsV(fn, &value);
+    return (int32_t) value;
+}
+
+int main(void) {
+    IM3Environment env = m3_NewEnvironment();
+    IM3Runtime runtime = load(env, wasm_bulk_memory, sizeof(wasm_bulk_memory));
+    if (!runtime) return 2;
+
+    IM3Function init        = find_fn(runtime, "init");
+    IM3Function init_active = find_fn(runtime, "init_active");
+    IM3Function drop        = find_fn(runtime, "drop");
+    IM3Function fill        = find_fn(runtime, "fill");
+    IM3Function copy        = find_fn(runtime, "copy");
+    IM3Function loadb       = find_fn(runtime, "load8");
+    IM3Function table_init  = find_fn(runtime, "table_init");
+    IM3Function elem_drop   = find_fn(runtime, "elem_drop");
+    IM3Function table_copy  = find_fn(runtime, "table_copy");
+    IM3Function call        = find_fn(runtime, "call");
+    if (g_failures) return 1;
+
+    // memory.init from a passive segment
+    expect_m3_err_eq("init(100, 1, 3)", m3_CallV(init, 100, 1, 3), m3Err_none);
+    expect_i32_eq("mem[100]", load8(loadb, 100), 2);
+    expect_i32_eq("mem[101]", load8(loadb, 101), 3);
+    expect_i32_eq("mem[102]", load8(loadb, 102), 4);
+    expect_m3_err_eq("init past the segment", m3_CallV(init, 100, 3, 3), m3Err_trapOutOfBoundsMemoryAccess);
+    expect_m3_err_eq("init past the memory", m3_CallV(init, 65535, 0, 2), m3Err_trapOutOfBoundsMemoryAccess);
+    expect_m3_err_eq("empty init at the end", m3_CallV(init, 65536, 5, 0), m3Err_none);
+
+    // active segments are dropped once they're loaded
+    expect_i32_eq("active data", load8(loadb, 0), 'A');
+    expect_m3_err_eq("init from an active segment", m3_CallV(init_active, 0, 0, 1), m3Err_trapOutOfBoundsMemoryAccess);
+    expect_m3_err_eq("empty init from an active segment", m3_CallV(init_active, 0, 0, 0), m3Err_none);
+
+    expect_m3_err_eq("data.drop", m3_CallV(drop), m3Err_none);
+    expect_m3_err_eq("init after data.drop", m3_CallV(init, 100, 0, 1), m3Err_trapOutOfBoundsMemoryAccess);
+    expect_m3_err_eq("empty init after data.drop", m3_CallV(init, 100, 0, 0), m3Err_none);
+    expect_m3_err_eq("second data.drop", m3_CallV(drop), m3Err_none);
+
+    // memory.fill & memory.copy, including an overlapping copy
+    expect_m3_err_eq("fill", m3_CallV(fill, 200, 0x7f, 3), m3Err_none);
+    expect_m3_err_eq("copy", m3_CallV(copy, 201, 100, 3), m3Err_none);
+    expect_i32_eq("mem[200]", load8(loadb, 200), 0x7f);
+    expect_i32_eq("mem[201]", load8(loadb, 201), 2);
+    expect_i32_eq("mem[203]", load8(loadb, 203), 4);
+    expect_m3_err_eq("overlapping copy", m3_CallV(copy, 201, 200, 3), m3Err_none);
+    expect_i32_eq("mem[201] after overlap", load8(loadb, 201), 0x7f);
+    expect_i32_eq("mem[202] after overlap", load8(loadb, 202), 2);
+    expect_i32_eq("mem[203] after overlap", load8(loadb, 203), 3);
+    expect_m3_err_eq("fill past the memory", m3_CallV(fill, 65535, 0, 2), m3Err_trapOutOfBoundsMemoryAccess);
+    expect_m3_err_eq("copy past the memory", m3_CallV(copy, 0, 65535, 2), m3Err_trapOutOfBoundsMemoryAccess);
+
+    // table.init, table.copy & elem.drop
+    expect_i32_eq("table[0]", call_table(call, 0, m3Err_none), 3);
+    call_table(call, 1, m3Err_trapTableElementIsNull);
+    expect_m3_err_eq("table_init(1, 0, 2)", m3_CallV(table_init, 1, 0, 2), m3Err_none);
+    expect_i32_eq("table[1]", call_table(call, 1, m3Err_none), 1);
+    expect_i32_eq("table[2]", call_table(call, 2, m3Err_none), 2);
+    expect_m3_err_eq("table_copy(3, 0, 1)", m3_CallV(table_copy, 3, 0, 1), m3Err_none);
+    expect_i32_eq("table[3]", call_table(call, 3, m3Err_none), 3);
+    expect_m3_err_eq("table.init past the table", m3_CallV(table_init, 3, 0, 2), m3Err_trapTableOutOfBounds);
+    expect_m3_err_eq("table.copy past the table", m3_CallV(table_copy, 0, 3, 2), m3Err_trapTableOutOfBounds);
+    expect_m3_err_eq("elem.drop", m3_CallV(elem_drop), m3Err_none);
+    expect_m3_err_eq("table.init after elem.drop", m3_CallV(table_init, 0, 0, 1), m3Err_trapTableOutOfBounds);
+    call_table(call, 4, m3Err_trapTableIndexOutOfRange);
+
+    m3_FreeRuntime(runtime);
+
+    // validation: memory.init & data.drop need a DataCount section, memory.init only knows memory 0
+    IM3Function fn = NULL;
+    runtime = load(env, wasm_no_datacount, sizeof(wasm_no_datacount));
+    if (runtime) {
+        expect_m3_err_str("data.drop without DataCount", m3_FindFunction(&fn, runtime, "drop"), "data count section required");
+        expect_m3_err_str("memory.init without DataCount", m3_FindFunction(&fn, runtime, "init"), "data count section required");
+        m3_FreeRuntime(runtime);
+    }
+    runtime = load(env, wasm_memory_1, sizeof(wasm_memory_1));
+    if (runtime) {
+        expect_m3_err_eq("memory.init of memory 1", m3_FindFunction(&fn, runtime, "init"), m3Err_unknownMemory);
+        m3_FreeRuntime(runtime);
+    }
+
+    // an explicit memory index in an active data segment can only be 0
+    IM3Module module = NULL;
+    expect_m3_err_eq("data segment in memory 0", m3_ParseModule(env, &module, wasm_data_memory_0, sizeof(wasm_data_memory_0)), m3Err_none);
+    m3_FreeModule(module);
+    module = NULL;
+    expect_m3_err_eq("data segment in memory 1", m3_ParseModule(env, &module, wasm_data_memory_1, sizeof(wasm_data_memory_1)), m3Err_unknownMemory);
+    m3_FreeModule(module);
+
+    m3_FreeEnvironment(env);
+
+    if (g_failures == 0) {
+        printf("PASS: bulk memory tests\n");
+        return 0;
+    }
+
+    fprintf(stderr, "FAILED: %d bulk memory tests\n", g_failures);
+    return 1;
+}
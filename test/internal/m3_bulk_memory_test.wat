@@ -0,0 +1,65 @@
+;; passive data and element segments, memory.init/copy/fill and table.init/copy
+(module
+  (memory 1)
+  (table 4 funcref)
+
+  (data $passive "\01\02\03\04\05")
+  (data $active (i32.const 0) "AB")
+
+  (elem $elems func $one $two)
+  (elem (i32.const 0) func $three)
+
+  (func $one (result i32) i32.const 1)
+  (func $two (result i32) i32.const 2)
+  (func $three (result i32) i32.const 3)
+
+  (func (export "init") (param i32 i32 i32)
+    local.get 0
+    local.get 1
+    local.get 2
+    memory.init $passive)
+
+  (func (export "init_active") (param i32 i32 i32)
+    local.get 0
+    local.get 1
+    local.get 2
+    memory.init $active)
+
+  (func (export "drop")
+    data.drop $passive)
+
+  (func (export "fill") (param i32 i32 i32)
+    local.get 0
+    local.get 1
+    local.get 2
+    memory.fill)
+
+  (func (export "copy") (param i32 i32 i32)
+    local.get 0
+    local.get 1
+    local.get 2
+    memory.copy)
+
+  (func (export "load8") (param i32) (result i32)
+    local.get 0
+    i32.load8_u)
+
+  (func (export "table_init") (param i32 i32 i32)
+    local.get 0
+    local.get 1
+    local.get 2
+    table.init $elems)
+
+  (func (export "elem_drop")
+    elem.drop $elems)
+
+  (func (export "table_copy") (param i32 i32 i32)
+    local.get 0
+    local.get 1
+    local.get 2
+    table.copy)
+
+  (func (export "call") (param i32) (result i32)
+    local.get 0
+    call_indirect (result i32))
+)
@@ -0,0 +1,143 @@
+//
+//  m3_fuel_test.c
+//
+//  m3_SetFuel / m3_GetFuel: calls are charged exactly the instructions they execute, and running out traps
+//  with m3Err_trapOutOfFuel at a predictable point without overdrawing.
+//
+//  wasm_fuel is assembled from m3_fuel_test.wat, which documents the cost of each function.
+//
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wasm3.h"
+#include "m3_config.h"
+
+static const uint8_t wasm_fuel[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x0a, 0x02, 0x60,
+  0x00, 0x01, 0x7f, 0x60, 0x01, 0x7f, 0x01, 0x7f, 0x03, 0x04, 0x03, 0x00,
+  0x01, 0x00, 0x07, 0x1c, 0x03, 0x04, 0x66, 0x6c, 0x61, 0x74, 0x00, 0x00,
+  0x09, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x64, 0x6f, 0x77, 0x6e, 0x00, 0x01,
+  0x05, 0x74, 0x77, 0x69, 0x63, 0x65, 0x00, 0x02, 0x0a, 0x22, 0x03, 0x07,
+  0x00, 0x41, 0x01, 0x41, 0x02, 0x6a, 0x0b, 0x10, 0x00, 0x03, 0x40, 0x20,
+  0x00, 0x41, 0x01, 0x6b, 0x22, 0x00, 0x0d, 0x00, 0x0b, 0x20, 0x00, 0x0b,
+  0x07, 0x00, 0x10, 0x00, 0x10, 0x00, 0x6a, 0x0b, 0x00, 0x0e, 0x04, 0x6e,
+  0x61, 0x6d, 0x65, 0x01, 0x07, 0x01, 0x00, 0x04, 0x66, 0x6c, 0x61, 0x74
+};
+
+static int g_failures = 0;
+
+static void failf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    g_failures++;
+}
+
+static void expect_m3_err_eq(const char* where, M3Result res, M3Result expected) {
+    if (res != expected) {
+        failf("%s: got error=%s expected=%s", where, res ? res : "(null)", expected ? expected : "(null)");
+    }
+}
+
+static void expect_u64_eq(const char* where, uint64_t got, uint64_t expected) {
+    if (got != expected) {
+        failf("%s: got=%" PRIu64 " expected=%" PRIu64, where, got, expected);
+    }
+}
+
+static IM3Function find_fn(IM3Runtime runtime, const char* name) {
+    IM3Function fn = NULL;
+    M3Result res = m3_FindFunction(&fn, runtime, name);
+    if (res != m3Err_none) {
+        failf("m3_FindFunction(%s) failed: %s", name, res);
+        return NULL;
+    }
+    return fn;
+}
+
+#if d_m3EnableFuelMetering
+
+// runs fn with the given fuel and checks the result and the fuel left
+static void expect_charge(const char* where, IM3Runtime runtime, IM3Function fn, int32_t arg, uint64_t fuel,
+                          M3Result expectedResult, uint64_t expectedFuel) {
+    expect_m3_err_eq(where, m3_SetFuel(runtime, fuel), m3Err_none);
+
+    M3Result res = m3_GetArgCount(fn) ? m3_CallV(fn, arg) : m3_CallV(fn);
+    expect_m3_err_eq(where, res, expectedResult);
+    expect_u64_eq(where, m3_GetFuel(runtime), expectedFuel);
+}
+
+#endif
+
+int main(void) {
+    IM3Environment env = m3_NewEnvironment();
+    IM3Runtime runtime = m3_NewRuntime(env, 64 * 1024, NULL);
+    IM3Module module = NULL;
+
+#if d_m3EnableFuelMetering
+    // fuel lives in the linear memory header, so there's nothing to set before a module is loaded
+    expect_m3_err_eq("m3_SetFuel before loading", m3_SetFuel(runtime, 10), m3Err_moduleNotLinked);
+#endif
+
+    M3Result res = m3_ParseModule(env, &module, wasm_fuel, sizeof(wasm_fuel));
+    if (!res) res = m3_LoadModule(runtime, module);
+    expect_m3_err_eq("loading module", res, m3Err_none);
+    if (res) return 1;
+
+    IM3Function flat = find_fn(runtime, "flat");
+    IM3Function countdown = find_fn(runtime, "countdown");
+    IM3Function twice = find_fn(runtime, "twice");
+    if (!flat || !countdown || !twice) return 1;
+
+#if d_m3EnableFuelMetering
+    // unmetered until set: the charges come out of UINT64_MAX
+    expect_u64_eq("initial fuel", m3_GetFuel(runtime), UINT64_MAX);
+    res = m3_CallV(countdown, 1000);
+    expect_m3_err_eq("unmetered", res, m3Err_none);
+    expect_u64_eq("unmetered", m3_GetFuel(runtime), UINT64_MAX - (3 + 6 * 1000));
+
+    // round trip
+    expect_m3_err_eq("m3_SetFuel", m3_SetFuel(runtime, 12345), m3Err_none);
+    expect_u64_eq("m3_GetFuel", m3_GetFuel(runtime), 12345);
+
+    // exact charges
+    expect_charge("flat", runtime, flat, 0, 100, m3Err_none, 100 - 4);
+    expect_charge("flat, exact fuel", runtime, flat, 0, 4, m3Err_none, 0);
+    expect_charge("countdown 10", runtime, countdown, 10, 1000, m3Err_none, 1000 - (3 + 6 * 10));
+    expect_charge("twice", runtime, twice, 0, 100, m3Err_none, 100 - (4 + 2 * 4));
+
+    // running out traps before the instructions are executed, leaving what couldn't be spent
+    expect_charge("flat, short", runtime, flat, 0, 3, m3Err_trapOutOfFuel, 3);
+    expect_charge("twice, short", runtime, twice, 0, 4 + 4 + 3, m3Err_trapOutOfFuel, 3);
+    expect_charge("countdown, 10 iterations paid", runtime, countdown, 1000, 3 + 6 * 10, m3Err_trapOutOfFuel, 0);
+    expect_charge("countdown, 10 iterations and a bit", runtime, countdown, 1000, 3 + 6 * 10 + 5, m3Err_trapOutOfFuel, 5);
+
+    // and the runtime carries on once refuelled
+    int32_t value = -1;
+    expect_charge("refuelled", runtime, flat, 0, 4, m3Err_none, 0);
+    res = m3_GetResultsV(flat, &value);
+    expect_m3_err_eq("refuelled", res, m3Err_none);
+    expect_u64_eq("refuelled", value, 3);
+#else
+    expect_m3_err_eq("m3_SetFuel", m3_SetFuel(runtime, 10), m3Err_fuelMeteringDisabled);
+    expect_u64_eq("m3_GetFuel", m3_GetFuel(runtime), UINT64_MAX);
+    expect_m3_err_eq("unmetered", m3_CallV(countdown, 1000), m3Err_none);
+#endif
+
+    m3_FreeRuntime(runtime);
+    m3_FreeEnvironment(env);
+
+    if (g_failures == 0) {
+        printf("PASS: fuel tests\n");
+        return 0;
+    }
+
+    fprintf(stderr, "FAILED: %d fuel tests\n", g_failures);
+    return 1;
+}
@@ -0,0 +1,27 @@
+;; fuel metering: every wasm instruction, including each block's `end`, costs one unit.
+;; a function is charged its instructions outside of loops on entry, a loop its body on every iteration
+(module
+  ;; i32.const, i32.const, i32.add, end: 4
+  (func $flat (export "flat") (result i32)
+    i32.const 1
+    i32.const 2
+    i32.add)
+
+  ;; entry: loop, local.get, end = 3
+  ;; each iteration: local.get, i32.const, i32.sub, local.tee, br_if, end = 6
+  (func (export "countdown") (param $n i32) (result i32)
+    loop $next
+      local.get $n
+      i32.const 1
+      i32.sub
+      local.tee $n
+      br_if $next
+    end
+    local.get $n)
+
+  ;; call, call, i32.add, end = 4, plus 4 for each call to $flat
+  (func (export "twice") (result i32)
+    call $flat
+    call $flat
+    i32.add)
+)
@@ -0,0 +1,128 @@
+//
+//  m3_interrupt_test.c
+//
+//  m3_Interrupt / m3_SetDeadline: a pending interrupt stops exactly one call, and a call running past its
+//  deadline traps, including one that would otherwise never return.
+//
+//  wasm_interrupt is assembled from m3_interrupt_test.wat.
+//
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wasm3.h"
+#include "m3_config.h"
+
+static const uint8_t wasm_interrupt[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x08, 0x02, 0x60,
+  0x00, 0x00, 0x60, 0x00, 0x01, 0x7f, 0x02, 0x11, 0x01, 0x03, 0x65, 0x6e,
+  0x76, 0x09, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x72, 0x75, 0x70, 0x74, 0x00,
+  0x00, 0x03, 0x05, 0x04, 0x01, 0x01, 0x01, 0x00, 0x07, 0x16, 0x03, 0x04,
+  0x73, 0x65, 0x6c, 0x66, 0x00, 0x02, 0x04, 0x6c, 0x65, 0x61, 0x66, 0x00,
+  0x03, 0x04, 0x73, 0x70, 0x69, 0x6e, 0x00, 0x04, 0x0a, 0x1a, 0x04, 0x04,
+  0x00, 0x41, 0x07, 0x0b, 0x06, 0x00, 0x10, 0x00, 0x10, 0x01, 0x0b, 0x04,
+  0x00, 0x10, 0x01, 0x0b, 0x07, 0x00, 0x03, 0x40, 0x0c, 0x00, 0x0b, 0x0b,
+  0x00, 0x19, 0x04, 0x6e, 0x61, 0x6d, 0x65, 0x01, 0x12, 0x02, 0x00, 0x09,
+  0x69, 0x6e, 0x74, 0x65, 0x72, 0x72, 0x75, 0x70, 0x74, 0x01, 0x04, 0x6c,
+  0x65, 0x61, 0x66
+};
+
+static int g_failures = 0;
+
+static void failf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    g_failures++;
+}
+
+static void expect_m3_err_eq(const char* where, M3Result res, M3Result expected) {
+    if (res != expected) {
+        failf("%s: got error=%s expected=%s", where, res ? res : "(null)", expected ? expected : "(null)");
+    }
+}
+
+static IM3Function find_fn(IM3Runtime runtime, const char* name) {
+    IM3Function fn = NULL;
+    M3Result res = m3_FindFunction(&fn, runtime, name);
+    if (res != m3Err_none) {
+        failf("m3_FindFunction(%s) failed: %s", name, res);
+        return NULL;
+    }
+    return fn;
+}
+
+// host functions
+
+m3ApiRawFunction(host_interrupt) {
+    expect_m3_err_eq("m3_Interrupt from an import", m3_Interrupt(runtime), m3Err_none);
+    m3ApiSuccess();
+}
+
+int main(void) {
+    IM3Environment env = m3_NewEnvironment();
+    IM3Runtime runtime = m3_NewRuntime(env, 64 * 1024, NULL);
+    IM3Module module = NULL;
+
+    M3Result res = m3_ParseModule(env, &module, wasm_interrupt, sizeof(wasm_interrupt));
+    if (!res) res = m3_LoadModule(runtime, module);
+    if (!res) res = m3_LinkRawFunction(module, "env", "interrupt", "v()", host_interrupt);
+    expect_m3_err_eq("loading module", res, m3Err_none);
+    if (res) return 1;
+
+    IM3Function self = find_fn(runtime, "self");
+    IM3Function leaf = find_fn(runtime, "leaf");
+    IM3Function spin = find_fn(runtime, "spin");
+    if (!self || !leaf || !spin) return 1;
+
+#if d_m3EnableInterrupts
+    // raised while running: traps at the next function entry
+    expect_m3_err_eq("interrupted call", m3_CallV(self), m3Err_trapInterrupted);
+
+    // the request was consumed
+    expect_m3_err_eq("call after interrupt", m3_CallV(leaf), m3Err_none);
+
+    // raised while idle: kept for the next call only
+    expect_m3_err_eq("m3_Interrupt", m3_Interrupt(runtime), m3Err_none);
+    expect_m3_err_eq("m3_Interrupt again", m3_Interrupt(runtime), m3Err_none);
+    expect_m3_err_eq("call after idle interrupt", m3_CallV(leaf), m3Err_trapInterrupted);
+    expect_m3_err_eq("following call", m3_CallV(leaf), m3Err_none);
+
+    // stops a loop that never ends
+    expect_m3_err_eq("m3_Interrupt before spin", m3_Interrupt(runtime), m3Err_none);
+    expect_m3_err_eq("spin, interrupted", m3_CallV(spin), m3Err_trapInterrupted);
+
+    // a deadline stops it too, and keeps trapping until it is reset
+    expect_m3_err_eq("m3_SetDeadline", m3_SetDeadline(runtime, 1000000), m3Err_none);
+    expect_m3_err_eq("spin past deadline", m3_CallV(spin), m3Err_trapDeadlineExceeded);
+    expect_m3_err_eq("call past deadline", m3_CallV(leaf), m3Err_trapDeadlineExceeded);
+
+    expect_m3_err_eq("disarm deadline", m3_SetDeadline(runtime, 0), m3Err_none);
+    expect_m3_err_eq("call after disarming", m3_CallV(leaf), m3Err_none);
+
+    // a deadline that isn't reached doesn't get in the way
+    expect_m3_err_eq("distant deadline", m3_SetDeadline(runtime, 3600ull * 1000000000ull), m3Err_none);
+    expect_m3_err_eq("call before deadline", m3_CallV(leaf), m3Err_none);
+    expect_m3_err_eq("disarm distant deadline", m3_SetDeadline(runtime, 0), m3Err_none);
+#else
+    expect_m3_err_eq("m3_Interrupt", m3_Interrupt(runtime), m3Err_interruptsDisabled);
+    expect_m3_err_eq("m3_SetDeadline", m3_SetDeadline(runtime, 1000000), m3Err_interruptsDisabled);
+    expect_m3_err_eq("call", m3_CallV(leaf), m3Err_none);
+#endif
+
+    m3_FreeRuntime(runtime);
+    m3_FreeEnvironment(env);
+
+    if (g_failures == 0) {
+        printf("PASS: interrupt tests\n");
+        return 0;
+    }
+
+    fprintf(stderr, "FAILED: %d interrupt tests\n", g_failures);
+    return 1;
+}
@@ -0,0 +1,21 @@
+;; interrupts and deadlines: polled at function entries and loop iterations
+(module
+  (import "env" "interrupt" (func $interrupt))
+
+  (func $leaf (result i32)
+    i32.const 7)
+
+  ;; raises an interrupt from inside the call; the next function entry traps
+  (func (export "self") (result i32)
+    call $interrupt
+    call $leaf)
+
+  (func (export "leaf") (result i32)
+    call $leaf)
+
+  ;; never returns on its own
+  (func (export "spin")
+    loop $forever
+      br $forever
+    end)
+)
@@ -0,0 +1,239 @@
+//
+//  m3_prepared_call_test.c
+//
+//  m3_CallPrepared and m3_CallPreparedBatch with i32, i64, f32 & f64 arguments and results, compared
+//  bit for bit against m3_CallV on the same inputs.
+//
+//  wasm_prepared_call is assembled from m3_prepared_call_test.wat.
+//
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wasm3.h"
+
+static const uint8_t wasm_prepared_call[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x19, 0x03, 0x60,
+  0x04, 0x7f, 0x7e, 0x7d, 0x7c, 0x04, 0x7f, 0x7e, 0x7d, 0x7c, 0x60, 0x02,
+  0x7f, 0x7f, 0x01, 0x7f, 0x60, 0x03, 0x7c, 0x7c, 0x7c, 0x01, 0x7c, 0x03,
+  0x04, 0x03, 0x00, 0x01, 0x02, 0x07, 0x13, 0x03, 0x03, 0x6d, 0x69, 0x78,
+  0x00, 0x00, 0x03, 0x64, 0x69, 0x76, 0x00, 0x01, 0x03, 0x66, 0x6d, 0x61,
+  0x00, 0x02, 0x0a, 0x35, 0x03, 0x20, 0x00, 0x20, 0x00, 0x41, 0x03, 0x6c,
+  0x41, 0x01, 0x6a, 0x20, 0x01, 0x20, 0x01, 0x7e, 0x42, 0x01, 0x7d, 0x20,
+  0x02, 0x43, 0x00, 0x00, 0x00, 0x3f, 0x94, 0x20, 0x03, 0x20, 0x02, 0xbb,
+  0xa0, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x20, 0x01, 0x6d, 0x0b, 0x0a, 0x00,
+  0x20, 0x00, 0x20, 0x01, 0xa2, 0x20, 0x02, 0xa0, 0x0b
+};
+
+static int g_failures = 0;
+
+static void failf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    g_failures++;
+}
+
+static void expect_m3_err_eq(const char* where, M3Result res, M3Result expected) {
+    if (res != expected) {
+        failf("%s: got error=%s expected=%s", where, res ? res : "(null)", expected ? expected : "(null)");
+    }
+}
+
+static void expect_u32_eq(const char* where, uint32_t got, uint32_t expected) {
+    if (got != expected) {
+        failf("%s: got=%" PRIu32 " expected=%" PRIu32, where, got, expected);
+    }
+}
+
+static void expect_bits_eq(const char* where, const void* got, const void* expected, size_t size) {
+    if (memcmp(got, expected, size) != 0) {
+        failf("%s: results differ from m3_CallV", where);
+    }
+}
+
+static IM3Function find_fn(IM3Runtime runtime, const char* name) {
+    IM3Function fn = NULL;
+    M3Result res = m3_FindFunction(&fn, runtime, name);
+    if (res != m3Err_none) {
+        failf("m3_FindFunction(%s) failed: %s", name, res);
+        return NULL;
+    }
+    return fn;
+}
+
+static IM3Runtime load(IM3Environment env, const uint8_t* wasm, uint32_t size) {
+    IM3Runtime runtime = m3_NewRuntime(env, 64 * 1024, NULL);
+    IM3Module module = NULL;
+
+    M3Result res = m3_ParseModule(env, &module, wasm, size);
+    if (!res) {
+        res = m3_LoadModule(runtime, module);
+        if (res) m3_FreeModule(module);
+    }
+    if (res) {
+        failf("loading module: %s", res);
+        m3_FreeRuntime(runtime);
+        return NULL;
+    }
+    return runtime;
+}
+
+static IM3PreparedCall prepare(IM3Function fn) {
+    IM3PreparedCall call = NULL;
+    M3Result res = m3_PrepareCall(&call, fn);
+    if (res) failf("m3_PrepareCall: %s", res);
+    return call;
+}
+
+typedef struct {
+    uint32_t    a;
+    uint64_t    b;
+    float       c;
+    double      d;
+} MixArgs;
+
+static const MixArgs mix_args[] = {
+    { 0, 0, 0.0f, 0.0 },
+    { 5, 7, 3.0f, 1.25 },
+    { 0xFFFFFFFF, 0x100000000ull, -2.5f, -1e300 },
+    { 0x7FFFFFFF, 0xFFFFFFFFFFFFFFFFull, 1e30f, 3.141592653589793 },
+    { 123456789, 0x123456789ull, -0.0f, 1e-310 },
+};
+
+#define NUM_MIX     (sizeof(mix_args) / sizeof(mix_args[0]))
+
+// results of m3_CallV laid out as M3Value slots
+static void call_v_mix(IM3Function mix, const MixArgs* args, M3Value o_results[4]) {
+    memset(o_results, 0, 4 * sizeof(M3Value));
+
+    M3Result res = m3_CallV(mix, args->a, args->b, args->c, args->d);
+    if (!res) res = m3_GetResultsV(mix, &o_results[0].i32, &o_results[1].i64, &o_results[2].f32, &o_results[3].f64);
+    expect_m3_err_eq("m3_CallV(mix)", res, m3Err_none);
+}
+
+static void set_mix_args(M3Value* o_args, const MixArgs* args) {
+    memset(o_args, 0, 4 * sizeof(M3Value));
+    o_args[0].i32 = args->a;
+    o_args[1].i64 = args->b;
+    o_args[2].f32 = args->c;
+    o_args[3].f64 = args->d;
+}
+
+static void compare_mix(const char* where, size_t i, const M3Value* got, const M3Value* expected) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s #%zu i32", where, i);
+    expect_bits_eq(name, &got[0].i32, &expected[0].i32, sizeof(uint32_t));
+    snprintf(name, sizeof(name), "%s #%zu i64", where, i);
+    expect_bits_eq(name, &got[1].i64, &expected[1].i64, sizeof(uint64_t));
+    snprintf(name, sizeof(name), "%s #%zu f32", where, i);
+    expect_bits_eq(name, &got[2].f32, &expected[2].f32, sizeof(float));
+    snprintf(name, sizeof(name), "%s #%zu f64", where, i);
+    expect_bits_eq(name, &got[3].f64, &expected[3].f64, sizeof(double));
+}
+
+int main(void) {
+    IM3Environment env = m3_NewEnvironment();
+    IM3Runtime runtime = load(env, wasm_prepared_call, sizeof(wasm_prepared_call));
+    if (!runtime) return 2;
+
+    IM3Function mix = find_fn(runtime, "mix");
+    IM3Function div = find_fn(runtime, "div");
+    IM3Function fma = find_fn(runtime, "fma");
+    if (!mix || !div || !fma) return 1;
+
+    M3Value expected[NUM_MIX][4];
+    for (size_t i = 0; i < NUM_MIX; ++i)
+        call_v_mix(mix, &mix_args[i], expected[i]);
+
+    // one call at a time, results read in place
+    IM3PreparedCall call = prepare(mix);
+    if (call) {
+        for (size_t i = 0; i < NUM_MIX; ++i) {
+            set_mix_args(m3_GetPreparedArgs(call), &mix_args[i]);
+            expect_m3_err_eq("m3_CallPrepared(mix)", m3_CallPrepared(call), m3Err_none);
+            compare_mix("m3_CallPrepared", i, m3_GetPreparedResults(call), expected[i]);
+        }
+
+        // the whole set as one batch
+        M3Value args[NUM_MIX][4], results[NUM_MIX][4];
+        uint32_t completed = 0;
+        for (size_t i = 0; i < NUM_MIX; ++i)
+            set_mix_args(args[i], &mix_args[i]);
+        memset(results, 0, sizeof(results));
+
+        expect_m3_err_eq("m3_CallPreparedBatch(mix)", m3_CallPreparedBatch(call, NUM_MIX, args[0], results[0], &completed), m3Err_none);
+        expect_u32_eq("batch completed", completed, NUM_MIX);
+        for (size_t i = 0; i < NUM_MIX; ++i)
+            compare_mix("m3_CallPreparedBatch", i, results[i], expected[i]);
+
+        // the prepared call stays valid across plain calls on the same runtime
+        call_v_mix(mix, &mix_args[1], expected[1]);
+        set_mix_args(m3_GetPreparedArgs(call), &mix_args[3]);
+        expect_m3_err_eq("m3_CallPrepared after m3_CallV", m3_CallPrepared(call), m3Err_none);
+        compare_mix("m3_CallPrepared after m3_CallV", 3, m3_GetPreparedResults(call), expected[3]);
+
+        m3_FreePreparedCall(call);
+    }
+
+    // f64 only, three arguments
+    call = prepare(fma);
+    if (call) {
+        static const double fma_args[][3] = { { 2.0, 3.0, 1.0 }, { -1.5, 1e10, 0.25 }, { 1e-300, 1e-300, -0.0 } };
+        M3Value args[3][3], results[3];
+        memset(args, 0, sizeof(args));
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                args[i][j].f64 = fma_args[i][j];
+
+        expect_m3_err_eq("m3_CallPreparedBatch(fma)", m3_CallPreparedBatch(call, 3, args[0], results, NULL), m3Err_none);
+        for (int i = 0; i < 3; ++i) {
+            double value = 0;
+            M3Result res = m3_CallV(fma, fma_args[i][0], fma_args[i][1], fma_args[i][2]);
+            if (!res) res = m3_GetResultsV(fma, &value);
+            expect_m3_err_eq("m3_CallV(fma)", res, m3Err_none);
+            expect_bits_eq("fma batch", &results[i].f64, &value, sizeof(double));
+        }
+        m3_FreePreparedCall(call);
+    }
+
+    // a trap stops the batch; the calls before it have their results
+    call = prepare(div);
+    if (call) {
+        M3Value args[3][2], results[3];
+        uint32_t completed = 99;
+        memset(args, 0, sizeof(args));
+        memset(results, 0, sizeof(results));
+        args[0][0].i32 = 10;            args[0][1].i32 = 2;
+        args[1][0].i32 = 7;             args[1][1].i32 = 0;
+        args[2][0].i32 = 9;             args[2][1].i32 = 3;
+
+        expect_m3_err_eq("batch with a trap", m3_CallPreparedBatch(call, 3, args[0], results, &completed), m3Err_trapDivisionByZero);
+        expect_u32_eq("calls completed before the trap", completed, 1);
+        expect_u32_eq("result before the trap", results[0].i32, 5);
+
+        args[0][0].i32 = (uint32_t) -9;
+        expect_m3_err_eq("batch after a trap", m3_CallPreparedBatch(call, 1, args[0], results, &completed), m3Err_none);
+        expect_u32_eq("signed division", results[0].i32, (uint32_t) -4);
+        m3_FreePreparedCall(call);
+    }
+
+    IM3PreparedCall none = NULL;
+    expect_m3_err_eq("m3_PrepareCall(NULL)", m3_PrepareCall(&none, NULL), m3Err_functionLookupFailed);
+
+    m3_FreeRuntime(runtime);
+    m3_FreeEnvironment(env);
+
+    if (g_failures == 0) {
+        printf("PASS: prepared call tests\n");
+        return 0;
+    }
+
+    fprintf(stderr, "FAILED: %d prepared call tests\n", g_failures);
+    return 1;
+}
@@ -0,0 +1,33 @@
+;; prepared & batched calls, checked against m3_CallV
+(module
+  (func (export "mix") (param i32 i64 f32 f64) (result i32 i64 f32 f64)
+    local.get 0
+    i32.const 3
+    i32.mul
+    i32.const 1
+    i32.add
+    local.get 1
+    local.get 1
+    i64.mul
+    i64.const 1
+    i64.sub
+    local.get 2
+    f32.const 0.5
+    f32.mul
+    local.get 3
+    local.get 2
+    f64.promote_f32
+    f64.add)
+
+  (func (export "div") (param i32 i32) (result i32)
+    local.get 0
+    local.get 1
+    i32.div_s)
+
+  (func (export "fma") (param f64 f64 f64) (result f64)
+    local.get 0
+    local.get 1
+    f64.mul
+    local.get 2
+    f64.add)
+)
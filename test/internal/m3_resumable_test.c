@@ -0,0 +1,204 @@
+//
+//  m3_resumable_test.c
+//
+//  m3_Suspend / m3_Resume / m3_RequestSuspend: a parked call returns m3Err_suspended and picks up where it
+//  left off, runtimes that aren't suspendable run calls directly, and deep recursion on the fiber stack
+//  traps instead of running into its guard page.
+//
+//  wasm_resumable is assembled from m3_resumable_test.wat.
+//
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wasm3.h"
+#include "m3_config.h"
+
+static const uint8_t wasm_resumable[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x0d, 0x03, 0x60,
+  0x01, 0x7f, 0x01, 0x7f, 0x60, 0x00, 0x00, 0x60, 0x00, 0x01, 0x7f, 0x02,
+  0x1a, 0x02, 0x03, 0x65, 0x6e, 0x76, 0x04, 0x70, 0x61, 0x72, 0x6b, 0x00,
+  0x00, 0x03, 0x65, 0x6e, 0x76, 0x07, 0x72, 0x65, 0x71, 0x75, 0x65, 0x73,
+  0x74, 0x00, 0x01, 0x03, 0x04, 0x03, 0x00, 0x02, 0x00, 0x07, 0x1b, 0x03,
+  0x05, 0x73, 0x74, 0x65, 0x70, 0x73, 0x00, 0x02, 0x09, 0x72, 0x65, 0x71,
+  0x75, 0x65, 0x73, 0x74, 0x65, 0x64, 0x00, 0x03, 0x03, 0x72, 0x65, 0x63,
+  0x00, 0x04, 0x0a, 0x44, 0x03, 0x23, 0x01, 0x01, 0x7f, 0x02, 0x40, 0x03,
+  0x40, 0x20, 0x00, 0x45, 0x0d, 0x01, 0x20, 0x01, 0x20, 0x00, 0x10, 0x00,
+  0x6a, 0x21, 0x01, 0x20, 0x00, 0x41, 0x01, 0x6b, 0x21, 0x00, 0x0c, 0x00,
+  0x0b, 0x0b, 0x20, 0x01, 0x0b, 0x08, 0x00, 0x10, 0x01, 0x41, 0x01, 0x10,
+  0x04, 0x0b, 0x15, 0x00, 0x20, 0x00, 0x45, 0x04, 0x7f, 0x41, 0x00, 0x05,
+  0x20, 0x00, 0x41, 0x01, 0x6b, 0x10, 0x04, 0x41, 0x01, 0x6a, 0x0b, 0x0b,
+  0x00, 0x1c, 0x04, 0x6e, 0x61, 0x6d, 0x65, 0x01, 0x15, 0x03, 0x00, 0x04,
+  0x70, 0x61, 0x72, 0x6b, 0x01, 0x07, 0x72, 0x65, 0x71, 0x75, 0x65, 0x73,
+  0x74, 0x04, 0x03, 0x72, 0x65, 0x63
+};
+
+static int g_failures = 0;
+
+static void failf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    g_failures++;
+}
+
+static void expect_m3_err_eq(const char* where, M3Result res, M3Result expected) {
+    if (res != expected) {
+        failf("%s: got error=%s expected=%s", where, res ? res : "(null)", expected ? expected : "(null)");
+    }
+}
+
+static void expect_i64_eq(const char* where, int64_t got, int64_t expected) {
+    if (got != expected) {
+        failf("%s: got=%" PRId64 " expected=%" PRId64, where, got, expected);
+    }
+}
+
+static IM3Function find_fn(IM3Runtime runtime, const char* name) {
+    IM3Function fn = NULL;
+    M3Result res = m3_FindFunction(&fn, runtime, name);
+    if (res != m3Err_none) {
+        failf("m3_FindFunction(%s) failed: %s", name, res);
+        return NULL;
+    }
+    return fn;
+}
+
+// host functions
+
+static int      g_parks;
+static M3Result g_suspendResult;
+
+m3ApiRawFunction(host_park) {
+    m3ApiReturnType (int32_t)
+    m3ApiGetArg     (int32_t, step)
+
+    g_parks++;
+    g_suspendResult = m3_Suspend(runtime);
+
+    m3ApiReturn(step * 10);
+}
+
+m3ApiRawFunction(host_request) {
+    m3_RequestSuspend(runtime);
+    m3ApiSuccess();
+}
+
+static IM3Runtime load(IM3Environment env, uint32_t stackSize) {
+    IM3Runtime runtime = m3_NewRuntime(env, stackSize, NULL);
+    IM3Module module = NULL;
+
+    M3Result res = m3_ParseModule(env, &module, wasm_resumable, sizeof(wasm_resumable));
+    if (!res) res = m3_LoadModule(runtime, module);
+    if (!res) res = m3_LinkRawFunction(module, "env", "park", "i(i)", host_park);
+    if (!res) res = m3_LinkRawFunction(module, "env", "request", "v()", host_request);
+    expect_m3_err_eq("loading module", res, m3Err_none);
+
+    return runtime;
+}
+
+static int32_t result_i32(IM3Function fn) {
+    int32_t value = -1;
+    M3Result res = m3_GetResultsV(fn, &value);
+    expect_m3_err_eq("m3_GetResultsV", res, m3Err_none);
+    return value;
+}
+
+int main(void) {
+    IM3Environment env = m3_NewEnvironment();
+    IM3Runtime runtime = load(env, 64 * 1024);
+    IM3Function steps = find_fn(runtime, "steps");
+    IM3Function rec = find_fn(runtime, "rec");
+    IM3Function requested = find_fn(runtime, "requested");
+    M3Result res;
+
+    if (!steps || !rec || !requested) return 1;
+
+    // nothing to suspend outside a call
+    expect_m3_err_eq("suspend while idle", m3_Suspend(runtime), m3Err_cannotSuspend);
+    expect_m3_err_eq("resume while idle", m3_Resume(runtime), m3Err_notSuspended);
+
+    // runtimes aren't suspendable by default: the import sees m3_Suspend fail and the call runs through
+    res = m3_CallV(steps, 3);
+    expect_m3_err_eq("steps, not suspendable", res, m3Err_none);
+    expect_m3_err_eq("m3_Suspend, not suspendable", g_suspendResult, m3Err_cannotSuspend);
+    expect_i64_eq("steps, not suspendable", result_i32(steps), 60);
+
+#if d_m3EnableResumableCalls
+    m3_SetSuspendable(runtime, true);
+
+    // every park returns to the host; each resume runs up to the next one
+    g_parks = 0;
+    res = m3_CallV(steps, 3);
+    expect_m3_err_eq("steps", res, m3Err_suspended);
+    expect_i64_eq("steps: suspended", m3_IsSuspended(runtime), 1);
+    expect_m3_err_eq("call while suspended", m3_CallV(rec, 1), m3Err_runtimeSuspended);
+
+    for (int i = 0; i < 2; ++i) {
+        res = m3_Resume(runtime);
+        expect_m3_err_eq("steps: resume", res, m3Err_suspended);
+    }
+
+    res = m3_Resume(runtime);
+    expect_m3_err_eq("steps: last resume", res, m3Err_none);
+    expect_m3_err_eq("m3_Suspend", g_suspendResult, m3Err_none);
+    expect_i64_eq("steps: parks", g_parks, 3);
+    expect_i64_eq("steps: suspended", m3_IsSuspended(runtime), 0);
+    expect_i64_eq("steps", result_i32(steps), 60);
+    expect_m3_err_eq("resume after completion", m3_Resume(runtime), m3Err_notSuspended);
+
+    // a request made by an import takes effect at the next call
+    res = m3_CallV(requested);
+    expect_m3_err_eq("requested", res, m3Err_suspended);
+    res = m3_Resume(runtime);
+    expect_m3_err_eq("requested: resume", res, m3Err_none);
+    expect_i64_eq("requested", result_i32(requested), 1);
+
+    // a pending request puts the next call on the fiber even if the runtime isn't suspendable
+    m3_SetSuspendable(runtime, false);
+    m3_RequestSuspend(runtime);
+    res = m3_CallV(rec, 4);
+    expect_m3_err_eq("rec, requested", res, m3Err_suspended);
+    res = m3_Resume(runtime);
+    expect_m3_err_eq("rec, requested: resume", res, m3Err_none);
+    expect_i64_eq("rec, requested", result_i32(rec), 4);
+
+    // the fiber stack grows with the wasm stack ...
+    IM3Runtime deep = load(env, 8000000);
+    m3_SetSuspendable(deep, true);
+
+    if ((rec = find_fn(deep, "rec"))) {
+        res = m3_CallV(rec, 5000);
+        expect_m3_err_eq("rec 5000", res, m3Err_none);
+        expect_i64_eq("rec 5000", result_i32(rec), 5000);
+
+        // ... and unbounded recursion traps before the guard page
+        res = m3_CallV(rec, 100000000);
+        expect_m3_err_eq("rec 100000000", res, m3Err_trapStackOverflow);
+
+        res = m3_CallV(rec, 10);
+        expect_m3_err_eq("rec after overflow", res, m3Err_none);
+        expect_i64_eq("rec after overflow", result_i32(rec), 10);
+    }
+
+    m3_FreeRuntime(deep);
+#else
+    expect_i64_eq("m3_CanSuspend", m3_CanSuspend(runtime), 0);
+#endif
+
+    m3_FreeRuntime(runtime);
+    m3_FreeEnvironment(env);
+
+    if (g_failures == 0) {
+        printf("PASS: resumable call tests\n");
+        return 0;
+    }
+
+    fprintf(stderr, "FAILED: %d resumable call tests\n", g_failures);
+    return 1;
+}
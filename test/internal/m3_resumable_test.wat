@@ -0,0 +1,47 @@
+;; resumable calls: host imports park the guest and the host resumes it later
+(module
+  (import "env" "park" (func $park (param i32) (result i32)))
+  (import "env" "request" (func $request))
+
+  ;; parks once per step; the values handed back by the host are summed
+  (func (export "steps") (param $n i32) (result i32)
+    (local $sum i32)
+    block $done
+      loop $next
+        local.get $n
+        i32.eqz
+        br_if $done
+        local.get $sum
+        local.get $n
+        call $park
+        i32.add
+        local.set $sum
+        local.get $n
+        i32.const 1
+        i32.sub
+        local.set $n
+        br $next
+      end
+    end
+    local.get $sum)
+
+  ;; asks for a suspend from inside the call; it takes effect at the next call
+  (func (export "requested") (result i32)
+    call $request
+    i32.const 1
+    call $rec)
+
+  (func $rec (export "rec") (param i32) (result i32)
+    local.get 0
+    i32.eqz
+    if (result i32)
+      i32.const 0
+    else
+      local.get 0
+      i32.const 1
+      i32.sub
+      call $rec
+      i32.const 1
+      i32.add
+    end)
+)
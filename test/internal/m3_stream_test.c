@@ -0,0 +1,278 @@
+//
+//  m3_stream_test.c
+//
+//  Feeds a module to m3_FeedModuleStream in chunks of various sizes (down to single bytes) and checks
+//  that it parses to the same module as m3_ParseModule, runs the same, and that bodies compiled while
+//  streaming (m3_CompileModuleStream) are ready once the module is finished.
+//
+//  wasm_stream is assembled from m3_stream_test.wat.
+//
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wasm3.h"
+#include "m3_env.h"
+
+static const uint8_t wasm_stream[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x1d, 0x06, 0x60,
+  0x01, 0x7f, 0x01, 0x7f, 0x60, 0x00, 0x00, 0x60, 0x01, 0x7e, 0x01, 0x7e,
+  0x60, 0x01, 0x7f, 0x01, 0x7e, 0x60, 0x00, 0x01, 0x7f, 0x60, 0x02, 0x7e,
+  0x7f, 0x01, 0x7e, 0x02, 0x0d, 0x01, 0x03, 0x65, 0x6e, 0x76, 0x05, 0x74,
+  0x77, 0x69, 0x63, 0x65, 0x00, 0x00, 0x03, 0x08, 0x07, 0x01, 0x02, 0x03,
+  0x04, 0x00, 0x05, 0x01, 0x04, 0x04, 0x01, 0x70, 0x00, 0x02, 0x05, 0x03,
+  0x01, 0x00, 0x01, 0x06, 0x06, 0x01, 0x7f, 0x01, 0x41, 0x05, 0x0b, 0x07,
+  0x36, 0x06, 0x03, 0x66, 0x61, 0x63, 0x00, 0x02, 0x03, 0x73, 0x75, 0x6d,
+  0x00, 0x03, 0x0d, 0x74, 0x77, 0x69, 0x63, 0x65, 0x5f, 0x63, 0x6f, 0x75,
+  0x6e, 0x74, 0x65, 0x72, 0x00, 0x04, 0x04, 0x62, 0x79, 0x74, 0x65, 0x00,
+  0x05, 0x08, 0x69, 0x6e, 0x64, 0x69, 0x72, 0x65, 0x63, 0x74, 0x00, 0x06,
+  0x04, 0x74, 0x72, 0x61, 0x70, 0x00, 0x07, 0x08, 0x01, 0x01, 0x09, 0x08,
+  0x01, 0x00, 0x41, 0x00, 0x0b, 0x02, 0x02, 0x03, 0x0a, 0x63, 0x07, 0x09,
+  0x00, 0x23, 0x00, 0x41, 0x01, 0x6a, 0x24, 0x00, 0x0b, 0x17, 0x00, 0x20,
+  0x00, 0x42, 0x01, 0x58, 0x04, 0x7e, 0x42, 0x01, 0x05, 0x20, 0x00, 0x20,
+  0x00, 0x42, 0x01, 0x7d, 0x10, 0x02, 0x7e, 0x0b, 0x0b, 0x22, 0x01, 0x01,
+  0x7e, 0x02, 0x40, 0x03, 0x40, 0x20, 0x00, 0x45, 0x0d, 0x01, 0x20, 0x01,
+  0x20, 0x00, 0xad, 0x7c, 0x21, 0x01, 0x20, 0x00, 0x41, 0x01, 0x6b, 0x21,
+  0x00, 0x0c, 0x00, 0x0b, 0x0b, 0x20, 0x01, 0x0b, 0x06, 0x00, 0x23, 0x00,
+  0x10, 0x00, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x2d, 0x00, 0x10, 0x0b, 0x09,
+  0x00, 0x20, 0x00, 0x20, 0x01, 0x11, 0x02, 0x00, 0x0b, 0x03, 0x00, 0x00,
+  0x0b, 0x0b, 0x0c, 0x01, 0x00, 0x41, 0x10, 0x0b, 0x06, 0x73, 0x74, 0x72,
+  0x65, 0x61, 0x6d, 0x00, 0x1f, 0x04, 0x6e, 0x61, 0x6d, 0x65, 0x01, 0x18,
+  0x04, 0x00, 0x05, 0x74, 0x77, 0x69, 0x63, 0x65, 0x01, 0x04, 0x69, 0x6e,
+  0x69, 0x74, 0x02, 0x03, 0x66, 0x61, 0x63, 0x03, 0x03, 0x73, 0x75, 0x6d
+};
+
+static int g_failures = 0;
+
+static void failf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    g_failures++;
+}
+
+static void expect_m3_err_eq(const char* where, M3Result res, M3Result expected) {
+    if (res != expected) {
+        failf("%s: got error=%s expected=%s", where, res ? res : "(null)", expected ? expected : "(null)");
+    }
+}
+
+static void expect_u64_eq(const char* where, uint64_t got, uint64_t expected) {
+    if (got != expected) {
+        failf("%s: got=%" PRIu64 " expected=%" PRIu64, where, got, expected);
+    }
+}
+
+static void expect_bytes_eq(const char* where, const uint8_t* a, const uint8_t* a_end, const uint8_t* b, const uint8_t* b_end) {
+    if ((a_end - a) != (b_end - b) || (a != a_end && memcmp(a, b, a_end - a) != 0)) {
+        failf("%s: bytes differ", where);
+    }
+}
+
+m3ApiRawFunction(twice) {
+    m3ApiReturnType(int32_t)
+    m3ApiGetArg(int32_t, value)
+    m3ApiReturn(value * 2);
+}
+
+static IM3Module stream(IM3Environment env, IM3Runtime compile_into, uint32_t chunk) {
+    IM3ModuleStream s = NULL;
+    IM3Module module = NULL;
+
+    M3Result res = m3_ParseModuleStreaming(env, &s);
+    if (!res && compile_into) res = m3_CompileModuleStream(s, compile_into);
+
+    for (uint32_t pos = 0; !res && pos < sizeof(wasm_stream); pos += chunk) {
+        uint32_t n = sizeof(wasm_stream) - pos < chunk ? sizeof(wasm_stream) - pos : chunk;
+        res = m3_FeedModuleStream(s, wasm_stream + pos, n);
+    }
+
+    if (res) {
+        m3_FreeModuleStream(s);
+    } else {
+        res = m3_FinishModuleStream(s, &module);
+    }
+
+    if (res) failf("streaming in %" PRIu32 "-byte chunks: %s", chunk, res);
+    return module;
+}
+
+static void compare_modules(uint32_t chunk, IM3Module a, IM3Module b) {
+    char where[64];
+    snprintf(where, sizeof(where), "%" PRIu32 "-byte chunks", chunk);
+
+    if (a->numFuncTypes != b->numFuncTypes || a->numFuncImports != b->numFuncImports || a->numFunctions != b->numFunctions ||
+        a->numGlobals != b->numGlobals || a->numDataSegments != b->numDataSegments || a->numElementSegments != b->numElementSegments ||
+        a->startFunction != b->startFunction || a->table0Size != b->table0Size ||
+        memcmp(&a->memoryInfo, &b->memoryInfo, sizeof(a->memoryInfo)) != 0) {
+        failf("%s: module layout differs", where);
+        return;
+    }
+
+    for (uint32_t i = 0; i < a->numFuncTypes; ++i) {
+        if (a->funcTypes[i] != b->funcTypes[i]) failf("%s: type %" PRIu32 " differs", where, i);
+    }
+
+    for (uint32_t i = 0; i < a->numFunctions; ++i) {
+        IM3Function fa = &a->functions[i], fb = &b->functions[i];
+        if (fa->funcType != fb->funcType || fa->numNames != fb->numNames ||
+            (fa->numNames && strcmp(fa->names[0], fb->names[0]) != 0) ||
+            (fa->export_name != fb->export_name && (!fa->export_name || !fb->export_name || strcmp(fa->export_name, fb->export_name) != 0))) {
+            failf("%s: function %" PRIu32 " declaration differs", where, i);
+        }
+        expect_bytes_eq(where, fa->wasm, fa->wasmEnd, fb->wasm, fb->wasmEnd);
+    }
+
+    for (uint32_t i = 0; i < a->numGlobals; ++i) {
+        IM3Global ga = &a->globals[i], gb = &b->globals[i];
+        if (ga->type != gb->type || ga->isMutable != gb->isMutable || ga->imported != gb->imported) {
+            failf("%s: global %" PRIu32 " differs", where, i);
+        }
+        expect_bytes_eq(where, ga->initExpr, ga->initExpr + ga->initExprSize, gb->initExpr, gb->initExpr + gb->initExprSize);
+    }
+
+    for (uint32_t i = 0; i < a->numDataSegments; ++i) {
+        M3DataSegment* da = &a->dataSegments[i], *db = &b->dataSegments[i];
+        if (da->memoryRegion != db->memoryRegion) failf("%s: data segment %" PRIu32 " differs", where, i);
+        expect_bytes_eq(where, da->data, da->data + da->size, db->data, db->data + db->size);
+        expect_bytes_eq(where, da->initExpr, da->initExpr + da->initExprSize, db->initExpr, db->initExpr + db->initExprSize);
+    }
+}
+
+static IM3Runtime load(IM3Environment env, IM3Runtime runtime, IM3Module module) {
+    M3Result res = m3_LoadModule(runtime, module);
+    if (res) {
+        failf("m3_LoadModule: %s", res);
+        m3_FreeModule(module);
+        m3_FreeRuntime(runtime);
+        return NULL;
+    }
+    res = m3_LinkRawFunction(module, "env", "twice", "i(i)", &twice);
+    if (res) failf("m3_LinkRawFunction: %s", res);
+    return runtime;
+}
+
+static uint64_t call_u64(IM3Runtime runtime, const char* name, int argc, const char* argv[]) {
+    IM3Function fn = NULL;
+    uint64_t value = 0;
+    int32_t value32 = 0;
+
+    M3Result res = m3_FindFunction(&fn, runtime, name);
+    if (!res) res = m3_CallArgv(fn, argc, argv);
+    if (res) {
+        failf("%s: %s", name, res);
+        return 0;
+    }
+    if (m3_GetRetType(fn, 0) == c_m3Type_i64) {
+        m3_GetResultsV(fn, &value);
+        return value;
+    }
+    m3_GetResultsV(fn, &value32);
+    return (uint32_t) value32;
+}
+
+static void run(const char* where, IM3Runtime runtime) {
+    const char* ten[] = { "10" };
+    const char* hundred[] = { "100" };
+    const char* one[] = { "1" };
+    const char* indirect[] = { "5", "0" };
+
+    expect_u64_eq("fac(10)", call_u64(runtime, "fac", 1, ten), 3628800);
+    expect_u64_eq("sum(100)", call_u64(runtime, "sum", 1, hundred), 5050);
+    expect_u64_eq("twice_counter()", call_u64(runtime, "twice_counter", 0, NULL), 12);
+    expect_u64_eq("byte(1)", call_u64(runtime, "byte", 1, one), 't');
+    expect_u64_eq("indirect(5, 0)", call_u64(runtime, "indirect", 2, indirect), 120);
+}
+
+#if d_m3RecordBacktraces
+static uint32_t trap_offset(IM3Runtime runtime) {
+    IM3Function fn = NULL;
+    M3Result res = m3_FindFunction(&fn, runtime, "trap");
+    if (!res) res = m3_CallV(fn);
+    expect_m3_err_eq("trap", res, m3Err_trapUnreachable);
+
+    IM3BacktraceInfo info = m3_GetBacktrace(runtime);
+    if (!info || !info->frames) {
+        failf("trap: no backtrace");
+        return 0;
+    }
+    return info->frames->moduleOffset;
+}
+#endif
+
+int main(void) {
+    IM3Environment env = m3_NewEnvironment();
+    static const uint32_t chunks[] = { 1, 2, 3, 7, 64, sizeof(wasm_stream) };
+
+    // loading fills in the table, so compare against a module that stays unloaded
+    IM3Module reference = NULL, loaded = NULL;
+    M3Result res = m3_ParseModule(env, &reference, wasm_stream, sizeof(wasm_stream));
+    if (!res) res = m3_ParseModule(env, &loaded, wasm_stream, sizeof(wasm_stream));
+    expect_m3_err_eq("m3_ParseModule", res, m3Err_none);
+    if (res) return 1;
+
+    IM3Runtime ref_runtime = load(env, m3_NewRuntime(env, 64 * 1024, NULL), loaded);
+    if (!ref_runtime) return 1;
+    run("m3_ParseModule", ref_runtime);
+
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c) {
+        char where[64];
+        IM3Module module = stream(env, NULL, chunks[c]);
+        if (!module) continue;
+
+        compare_modules(chunks[c], reference, module);
+        m3_FreeModule(module);
+
+        // compiled while streaming: every body is ready before the module is loaded
+        IM3Runtime runtime = m3_NewRuntime(env, 64 * 1024, NULL);
+        module = stream(env, runtime, chunks[c]);
+        if (!module) {
+            m3_FreeRuntime(runtime);
+            continue;
+        }
+
+        for (uint32_t i = module->numFuncImports; i < module->numFunctions; ++i) {
+            if (!module->functions[i].compiled) failf("%" PRIu32 "-byte chunks: function %" PRIu32 " was not compiled", chunks[c], i);
+        }
+
+        IM3Runtime other = m3_NewRuntime(env, 64 * 1024, NULL);
+        if (!m3_LoadModule(other, module)) failf("%" PRIu32 "-byte chunks: loaded into another runtime", chunks[c]);
+        m3_FreeRuntime(other);
+
+        if (!load(env, runtime, module)) continue;
+        snprintf(where, sizeof(where), "%" PRIu32 "-byte chunks, compiled while streaming", chunks[c]);
+        run(where, runtime);
+
+#if d_m3RecordBacktraces
+        expect_u64_eq("backtrace offset", trap_offset(runtime), trap_offset(ref_runtime));
+#endif
+        m3_FreeRuntime(runtime);
+    }
+
+    // compilation must be requested before the code section
+    IM3ModuleStream s = NULL;
+    IM3Runtime runtime = m3_NewRuntime(env, 64 * 1024, NULL);
+    if (!m3_ParseModuleStreaming(env, &s)) {
+        expect_m3_err_eq("feed all", m3_FeedModuleStream(s, wasm_stream, sizeof(wasm_stream)), m3Err_none);
+        if (!m3_CompileModuleStream(s, runtime)) failf("m3_CompileModuleStream after the code section succeeded");
+        m3_FreeModuleStream(s);
+    }
+    m3_FreeRuntime(runtime);
+
+    m3_FreeModule(reference);
+    m3_FreeRuntime(ref_runtime);
+    m3_FreeEnvironment(env);
+
+    if (g_failures == 0) {
+        printf("PASS: module streaming tests\n");
+        return 0;
+    }
+
+    fprintf(stderr, "FAILED: %d module streaming tests\n", g_failures);
+    return 1;
+}
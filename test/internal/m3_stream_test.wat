@@ -0,0 +1,70 @@
+;; a module touching every section kind, fed to the streaming parser in small chunks
+(module
+  (import "env" "twice" (func $twice (param i32) (result i32)))
+  (memory 1)
+  (table 2 funcref)
+  (global $counter (mut i32) (i32.const 5))
+
+  (elem (i32.const 0) func $fac $sum)
+  (data (i32.const 16) "stream")
+
+  (func $init
+    global.get $counter
+    i32.const 1
+    i32.add
+    global.set $counter)
+
+  (start $init)
+
+  (func $fac (export "fac") (param i64) (result i64)
+    local.get 0
+    i64.const 1
+    i64.le_u
+    if (result i64)
+      i64.const 1
+    else
+      local.get 0
+      local.get 0
+      i64.const 1
+      i64.sub
+      call $fac
+      i64.mul
+    end)
+
+  (func $sum (export "sum") (param i32) (result i64)
+    (local i64)
+    block $done
+      loop $next
+        local.get 0
+        i32.eqz
+        br_if $done
+        local.get 1
+        local.get 0
+        i64.extend_i32_u
+        i64.add
+        local.set 1
+        local.get 0
+        i32.const 1
+        i32.sub
+        local.set 0
+        br $next
+      end
+    end
+    local.get 1)
+
+  (func (export "twice_counter") (result i32)
+    global.get $counter
+    call $twice)
+
+  (func (export "byte") (param i32) (result i32)
+    local.get 0
+    i32.load8_u offset=16)
+
+  (func (export "indirect") (param i64 i32) (result i64)
+    local.get 0
+    local.get 1
+    call_indirect (param i64) (result i64))
+
+  (func (export "trap")
+    unreachable)
+)
@@ -0,0 +1,171 @@
+//
+//  m3_tailcall_test.c
+//
+//  return_call / return_call_indirect: deep mutual recursion runs in constant wasm and native stack,
+//  indirect tail calls are checked like call_indirect, and imports can be tail called.
+//
+//  wasm_tailcall is assembled from m3_tailcall_test.wat.
+//
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wasm3.h"
+#include "m3_config.h"
+
+// tail calls compile to call + return with local register caching, and without tail call
+// optimisation every dispatched op nests; the native stack only stays flat without either
+#if !d_m3EnableLocalRegCaching && M3_HAS_TAIL_CALL && (defined(__OPTIMIZE__) || M3_COMPILER_HAS_ATTRIBUTE(musttail))
+#   define FLAT_NATIVE_STACK    1
+#   define DEPTH                1000000
+#else
+#   define FLAT_NATIVE_STACK    0
+#   define DEPTH                100
+#endif
+
+static const uint8_t wasm_tailcall[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x14, 0x04, 0x60,
+  0x01, 0x7f, 0x00, 0x60, 0x01, 0x7f, 0x01, 0x7f, 0x60, 0x00, 0x01, 0x7f,
+  0x60, 0x02, 0x7f, 0x7f, 0x01, 0x7f, 0x02, 0x18, 0x02, 0x03, 0x65, 0x6e,
+  0x76, 0x04, 0x6d, 0x61, 0x72, 0x6b, 0x00, 0x00, 0x03, 0x65, 0x6e, 0x76,
+  0x05, 0x74, 0x77, 0x69, 0x63, 0x65, 0x00, 0x01, 0x03, 0x06, 0x05, 0x01,
+  0x01, 0x02, 0x03, 0x01, 0x04, 0x04, 0x01, 0x70, 0x00, 0x04, 0x07, 0x1c,
+  0x03, 0x04, 0x65, 0x76, 0x65, 0x6e, 0x00, 0x02, 0x08, 0x69, 0x6e, 0x64,
+  0x69, 0x72, 0x65, 0x63, 0x74, 0x00, 0x05, 0x06, 0x69, 0x6d, 0x70, 0x6f,
+  0x72, 0x74, 0x00, 0x06, 0x09, 0x09, 0x01, 0x00, 0x41, 0x00, 0x0b, 0x03,
+  0x02, 0x04, 0x01, 0x0a, 0x47, 0x05, 0x16, 0x00, 0x20, 0x00, 0x10, 0x00,
+  0x20, 0x00, 0x45, 0x04, 0x40, 0x41, 0x01, 0x0f, 0x0b, 0x20, 0x00, 0x41,
+  0x01, 0x6b, 0x12, 0x03, 0x0b, 0x15, 0x00, 0x20, 0x00, 0x45, 0x04, 0x40,
+  0x41, 0x00, 0x0f, 0x0b, 0x20, 0x00, 0x41, 0x01, 0x6b, 0x41, 0x00, 0x13,
+  0x01, 0x00, 0x0b, 0x04, 0x00, 0x41, 0x2a, 0x0b, 0x09, 0x00, 0x20, 0x00,
+  0x20, 0x01, 0x13, 0x01, 0x00, 0x0b, 0x09, 0x00, 0x20, 0x00, 0x41, 0x01,
+  0x6a, 0x12, 0x01, 0x0b, 0x00, 0x28, 0x04, 0x6e, 0x61, 0x6d, 0x65, 0x01,
+  0x21, 0x05, 0x00, 0x04, 0x6d, 0x61, 0x72, 0x6b, 0x01, 0x05, 0x74, 0x77,
+  0x69, 0x63, 0x65, 0x02, 0x04, 0x65, 0x76, 0x65, 0x6e, 0x03, 0x03, 0x6f,
+  0x64, 0x64, 0x04, 0x06, 0x6e, 0x6f, 0x61, 0x72, 0x67, 0x73
+};
+
+static int g_failures = 0;
+
+static void failf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    g_failures++;
+}
+
+static void expect_m3_err_eq(const char* where, M3Result res, M3Result expected) {
+    if (res != expected) {
+        failf("%s: got error=%s expected=%s", where, res ? res : "(null)", expected ? expected : "(null)");
+    }
+}
+
+static void expect_i64_eq(const char* where, int64_t got, int64_t expected) {
+    if (got != expected) {
+        failf("%s: got=%" PRId64 " expected=%" PRId64, where, got, expected);
+    }
+}
+
+static IM3Function find_fn(IM3Runtime runtime, const char* name) {
+    IM3Function fn = NULL;
+    M3Result res = m3_FindFunction(&fn, runtime, name);
+    if (res != m3Err_none) {
+        failf("m3_FindFunction(%s) failed: %s", name, res);
+        return NULL;
+    }
+    return fn;
+}
+
+static int32_t call_i32(const char* where, IM3Function fn, int32_t a, int32_t b, M3Result expected) {
+    int32_t value = -1;
+    M3Result res = (m3_GetArgCount(fn) == 2) ? m3_CallV(fn, a, b) : m3_CallV(fn, a);
+    if (!res) res = m3_GetResultsV(fn, &value);
+    expect_m3_err_eq(where, res, expected);
+    return value;
+}
+
+// host functions
+
+static uint32_t     g_marks;
+static uintptr_t    g_lowestMark;
+static uintptr_t    g_highestMark;
+
+M3_NOINLINE
+static uintptr_t stack_position(void) {
+    volatile char marker = 0;
+    return (uintptr_t) &marker;
+}
+
+m3ApiRawFunction(host_mark) {
+    m3ApiGetArg     (int32_t, n)
+
+    uintptr_t position = stack_position();
+    if (g_marks++ == 0 || position < g_lowestMark) g_lowestMark = position;
+    if (position > g_highestMark) g_highestMark = position;
+
+    m3ApiSuccess();
+}
+
+m3ApiRawFunction(host_twice) {
+    m3ApiReturnType (int32_t)
+    m3ApiGetArg     (int32_t, n)
+
+    m3ApiReturn(n * 2);
+}
+
+int main(void) {
+    IM3Environment env = m3_NewEnvironment();
+    IM3Runtime runtime = m3_NewRuntime(env, 64 * 1024, NULL);
+    IM3Module module = NULL;
+
+    M3Result res = m3_ParseModule(env, &module, wasm_tailcall, sizeof(wasm_tailcall));
+    if (!res) res = m3_LoadModule(runtime, module);
+    if (!res) res = m3_LinkRawFunction(module, "env", "mark", "v(i)", host_mark);
+    if (!res) res = m3_LinkRawFunction(module, "env", "twice", "i(i)", host_twice);
+    expect_m3_err_eq("loading module", res, m3Err_none);
+    if (res) return 1;
+
+    IM3Function even = find_fn(runtime, "even");
+    IM3Function indirect = find_fn(runtime, "indirect");
+    IM3Function import = find_fn(runtime, "import");
+    if (!even || !indirect || !import) return 1;
+
+    // far deeper than a 64 KiB wasm stack holds frames for
+    expect_i64_eq("even(DEPTH)", call_i32("even(DEPTH)", even, DEPTH, 0, m3Err_none), 1);
+    expect_i64_eq("even(DEPTH + 1)", call_i32("even(DEPTH + 1)", even, DEPTH + 1, 0, m3Err_none), 0);
+    expect_i64_eq("marks", g_marks, (DEPTH / 2 + 1) + (DEPTH / 2 + 1));
+
+#if FLAT_NATIVE_STACK
+    expect_i64_eq("native stack movement", (int64_t) (g_highestMark - g_lowestMark), 0);
+#endif
+
+    // return_call_indirect traps like call_indirect
+    expect_i64_eq("indirect", call_i32("indirect", indirect, 5, 0, m3Err_none), 0);
+    call_i32("indirect, signature mismatch", indirect, 5, 1, m3Err_trapIndirectCallTypeMismatch);
+    call_i32("indirect, null element", indirect, 5, 3, m3Err_trapTableElementIsNull);
+    call_i32("indirect, out of range", indirect, 5, 4, m3Err_trapTableIndexOutOfRange);
+
+    // the runtime is usable after those traps
+    expect_i64_eq("even(10)", call_i32("even(10)", even, 10, 0, m3Err_none), 1);
+
+    // imports, direct and through the table
+    expect_i64_eq("import", call_i32("import", import, 20, 0, m3Err_none), 42);
+    expect_i64_eq("indirect import", call_i32("indirect import", indirect, 21, 2, m3Err_none), 42);
+
+    m3_FreeRuntime(runtime);
+    m3_FreeEnvironment(env);
+
+    if (g_failures == 0) {
+        printf("PASS: tail call tests\n");
+        return 0;
+    }
+
+    fprintf(stderr, "FAILED: %d tail call tests\n", g_failures);
+    return 1;
+}
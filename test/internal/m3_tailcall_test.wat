@@ -0,0 +1,55 @@
+;; return_call / return_call_indirect replace the caller's frame, also when the callee is an import
+(module
+  (import "env" "mark" (func $mark (param i32)))
+  (import "env" "twice" (func $twice (param i32) (result i32)))
+
+  (type $i2i (func (param i32) (result i32)))
+  (type $v2i (func (result i32)))
+
+  (table 4 funcref)
+  (elem (i32.const 0) $even $noargs $twice)
+
+  ;; mutual recursion, alternating direct and indirect tail calls. $mark reports
+  ;; every step to the host, which checks the native stack doesn't move
+  (func $even (export "even") (param $n i32) (result i32)
+    local.get $n
+    call $mark
+    local.get $n
+    i32.eqz
+    if
+      i32.const 1
+      return
+    end
+    local.get $n
+    i32.const 1
+    i32.sub
+    return_call $odd)
+
+  (func $odd (param $n i32) (result i32)
+    local.get $n
+    i32.eqz
+    if
+      i32.const 0
+      return
+    end
+    local.get $n
+    i32.const 1
+    i32.sub
+    i32.const 0
+    return_call_indirect (type $i2i))
+
+  (func $noargs (result i32)
+    i32.const 42)
+
+  ;; tail calls the table element at $index with $n
+  (func (export "indirect") (param $n i32) (param $index i32) (result i32)
+    local.get $n
+    local.get $index
+    return_call_indirect (type $i2i))
+
+  (func (export "import") (param $n i32) (result i32)
+    local.get $n
+    i32.const 1
+    i32.add
+    return_call $twice)
+)
@@ -0,0 +1,233 @@
+//
+//  m3_typed_import_test.c
+//
+//  m3_LinkTypedFunction: the wasm arguments must reach the C function as parameters, in order and with
+//  their types intact, and its result must come back to wasm.
+//
+//  wasm_typed_import is assembled from m3_typed_import_test.wat.
+//
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wasm3.h"
+#include "m3_config.h"
+
+static const uint8_t wasm_typed_import[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x30, 0x07, 0x60,
+  0x02, 0x7c, 0x7c, 0x01, 0x7c, 0x60, 0x03, 0x7f, 0x7e, 0x7d, 0x01, 0x7c,
+  0x60, 0x01, 0x7d, 0x01, 0x7d, 0x60, 0x04, 0x7f, 0x7f, 0x7f, 0x7f, 0x00,
+  0x60, 0x06, 0x7f, 0x7e, 0x7f, 0x7e, 0x7f, 0x7e, 0x01, 0x7e, 0x60, 0x00,
+  0x01, 0x7f, 0x60, 0x05, 0x7c, 0x7c, 0x7c, 0x7c, 0x7c, 0x00, 0x02, 0x4c,
+  0x07, 0x03, 0x65, 0x6e, 0x76, 0x03, 0x61, 0x64, 0x64, 0x00, 0x00, 0x03,
+  0x65, 0x6e, 0x76, 0x03, 0x6d, 0x69, 0x78, 0x00, 0x01, 0x03, 0x65, 0x6e,
+  0x76, 0x03, 0x6e, 0x65, 0x67, 0x00, 0x02, 0x03, 0x65, 0x6e, 0x76, 0x04,
+  0x6e, 0x6f, 0x74, 0x65, 0x00, 0x03, 0x03, 0x65, 0x6e, 0x76, 0x04, 0x73,
+  0x75, 0x6d, 0x36, 0x00, 0x04, 0x03, 0x65, 0x6e, 0x76, 0x05, 0x63, 0x6f,
+  0x75, 0x6e, 0x74, 0x00, 0x05, 0x03, 0x65, 0x6e, 0x76, 0x04, 0x77, 0x69,
+  0x64, 0x65, 0x00, 0x06, 0x03, 0x07, 0x06, 0x00, 0x01, 0x02, 0x03, 0x04,
+  0x05, 0x07, 0x29, 0x06, 0x03, 0x61, 0x64, 0x64, 0x00, 0x07, 0x03, 0x6d,
+  0x69, 0x78, 0x00, 0x08, 0x03, 0x6e, 0x65, 0x67, 0x00, 0x09, 0x04, 0x6e,
+  0x6f, 0x74, 0x65, 0x00, 0x0a, 0x04, 0x73, 0x75, 0x6d, 0x36, 0x00, 0x0b,
+  0x05, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x00, 0x0c, 0x0a, 0x42, 0x06, 0x08,
+  0x00, 0x20, 0x00, 0x20, 0x01, 0x10, 0x00, 0x0b, 0x0a, 0x00, 0x20, 0x00,
+  0x20, 0x01, 0x20, 0x02, 0x10, 0x01, 0x0b, 0x06, 0x00, 0x20, 0x00, 0x10,
+  0x02, 0x0b, 0x0c, 0x00, 0x20, 0x00, 0x20, 0x01, 0x20, 0x02, 0x20, 0x03,
+  0x10, 0x03, 0x0b, 0x10, 0x00, 0x20, 0x00, 0x20, 0x01, 0x20, 0x02, 0x20,
+  0x03, 0x20, 0x04, 0x20, 0x05, 0x10, 0x04, 0x0b, 0x07, 0x00, 0x10, 0x05,
+  0x10, 0x05, 0x6a, 0x0b, 0x00, 0x30, 0x04, 0x6e, 0x61, 0x6d, 0x65, 0x01,
+  0x29, 0x07, 0x00, 0x03, 0x61, 0x64, 0x64, 0x01, 0x03, 0x6d, 0x69, 0x78,
+  0x02, 0x03, 0x6e, 0x65, 0x67, 0x03, 0x04, 0x6e, 0x6f, 0x74, 0x65, 0x04,
+  0x04, 0x73, 0x75, 0x6d, 0x36, 0x05, 0x05, 0x63, 0x6f, 0x75, 0x6e, 0x74,
+  0x06, 0x04, 0x77, 0x69, 0x64, 0x65
+};
+
+static int g_failures = 0;
+
+static void failf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    g_failures++;
+}
+
+static void expect_m3_err_eq(const char* where, M3Result res, M3Result expected) {
+    if (res != expected) {
+        failf("%s: got error=%s expected=%s", where, res ? res : "(null)", expected ? expected : "(null)");
+    }
+}
+
+static void expect_i64_eq(const char* where, int64_t got, int64_t expected) {
+    if (got != expected) {
+        failf("%s: got=%" PRId64 " expected=%" PRId64, where, got, expected);
+    }
+}
+
+static void expect_f64_eq(const char* where, double got, double expected) {
+    if (memcmp(&got, &expected, sizeof(double)) != 0) {
+        failf("%s: got=%.17g expected=%.17g", where, got, expected);
+    }
+}
+
+static IM3Function find_fn(IM3Runtime runtime, const char* name) {
+    IM3Function fn = NULL;
+    M3Result res = m3_FindFunction(&fn, runtime, name);
+    if (res != m3Err_none) {
+        failf("m3_FindFunction(%s) failed: %s", name, res);
+        return NULL;
+    }
+    return fn;
+}
+
+// host functions
+
+static double host_add(double a, double b) {
+    return a + b;
+}
+
+static int32_t  g_mixA;
+static int64_t  g_mixB;
+static float    g_mixC;
+
+static double host_mix(int32_t a, int64_t b, float c) {
+    g_mixA = a;
+    g_mixB = b;
+    g_mixC = c;
+    return (double) a + (double) b + (double) c;
+}
+
+static float host_neg(float a) {
+    return -a;
+}
+
+static int32_t  g_note[4];
+
+static void host_note(int32_t a, int32_t b, int32_t c, int32_t d) {
+    g_note[0] = a;
+    g_note[1] = b;
+    g_note[2] = c;
+    g_note[3] = d;
+}
+
+static int64_t host_sum6(int32_t a, int64_t b, int32_t c, int64_t d, int32_t e, int64_t f) {
+    // weights catch swapped arguments
+    return a + 10 * b + 100 * c + 1000 * d + 10000 * e + 100000 * f;
+}
+
+static int32_t  g_count;
+
+static int32_t host_count(void) {
+    return ++g_count;
+}
+
+static void host_wide(double a, double b, double c, double d, double e) {
+}
+
+#define LINK(NAME, SIG, FN)     m3_LinkTypedFunction(module, "env", NAME, SIG, (M3TypedCall) (FN))
+
+int main(void) {
+    IM3Environment env = m3_NewEnvironment();
+    IM3Runtime runtime = m3_NewRuntime(env, 64 * 1024, NULL);
+    IM3Module module = NULL;
+
+    M3Result res = m3_ParseModule(env, &module, wasm_typed_import, sizeof(wasm_typed_import));
+    if (!res) res = m3_LoadModule(runtime, module);
+    expect_m3_err_eq("loading module", res, m3Err_none);
+    if (res) return 1;
+
+    expect_m3_err_eq("link add", LINK("add", "F(FF)", host_add), m3Err_none);
+#if d_m3MaxTypedImportArgs >= 3
+    expect_m3_err_eq("link mix", LINK("mix", "F(iIf)", host_mix), m3Err_none);
+#else
+    expect_m3_err_eq("link mix", LINK("mix", "F(iIf)", host_mix), m3Err_typedImportUnsupported);
+#endif
+    expect_m3_err_eq("link neg", LINK("neg", "f(f)", host_neg), m3Err_none);
+#if d_m3MaxTypedImportArgs >= 4
+    expect_m3_err_eq("link note", LINK("note", "v(ii*i)", host_note), m3Err_none);
+#else
+    expect_m3_err_eq("link note", LINK("note", "v(ii*i)", host_note), m3Err_typedImportUnsupported);
+#endif
+    expect_m3_err_eq("link count", LINK("count", "i()", host_count), m3Err_none);
+
+    // the signature must match the import, and only integer arguments are supported past the 3rd
+    expect_m3_err_eq("signature mismatch", LINK("neg", "F(F)", host_add), m3Err_functionSignatureMismatch);
+    expect_m3_err_eq("five f64 arguments", LINK("wide", "v(FFFFF)", host_wide), m3Err_typedImportUnsupported);
+    expect_m3_err_eq("two results", LINK("add", "FF(FF)", host_add), m3Err_typedImportUnsupported);
+
+    IM3Function fn;
+    double d = 0;
+    float f = 0;
+    int32_t i = 0;
+
+    if ((fn = find_fn(runtime, "add"))) {
+        res = m3_CallV(fn, 1.5, 2.25);
+        if (!res) res = m3_GetResultsV(fn, &d);
+        expect_m3_err_eq("add", res, m3Err_none);
+        expect_f64_eq("add", d, 3.75);
+    }
+
+#if d_m3MaxTypedImportArgs >= 3
+    if ((fn = find_fn(runtime, "mix"))) {
+        res = m3_CallV(fn, (int32_t) -7, (int64_t) 0x100000000ll, 0.5f);
+        if (!res) res = m3_GetResultsV(fn, &d);
+        expect_m3_err_eq("mix", res, m3Err_none);
+        expect_i64_eq("mix: i32 argument", g_mixA, -7);
+        expect_i64_eq("mix: i64 argument", g_mixB, 0x100000000ll);
+        expect_f64_eq("mix: f32 argument", g_mixC, 0.5);
+        expect_f64_eq("mix", d, 4294967289.5);
+    }
+#endif
+
+    if ((fn = find_fn(runtime, "neg"))) {
+        res = m3_CallV(fn, 2.5f);
+        if (!res) res = m3_GetResultsV(fn, &f);
+        expect_m3_err_eq("neg", res, m3Err_none);
+        expect_f64_eq("neg", f, -2.5);
+    }
+
+#if d_m3MaxTypedImportArgs >= 4
+    if ((fn = find_fn(runtime, "note"))) {
+        res = m3_CallV(fn, 1, 2, 3, -4);
+        expect_m3_err_eq("note", res, m3Err_none);
+        expect_i64_eq("note: 1st argument", g_note[0], 1);
+        expect_i64_eq("note: 2nd argument", g_note[1], 2);
+        expect_i64_eq("note: 3rd argument", g_note[2], 3);
+        expect_i64_eq("note: 4th argument", g_note[3], -4);
+    }
+#endif
+
+    if ((fn = find_fn(runtime, "count"))) {
+        res = m3_CallV(fn);
+        if (!res) res = m3_GetResultsV(fn, &i);
+        expect_m3_err_eq("count", res, m3Err_none);
+        expect_i64_eq("count", i, 1 + 2);
+    }
+
+#if d_m3MaxTypedImportArgs >= 6
+    expect_m3_err_eq("link sum6", LINK("sum6", "I(iIiIiI)", host_sum6), m3Err_none);
+
+    if ((fn = find_fn(runtime, "sum6"))) {
+        int64_t l = 0;
+        res = m3_CallV(fn, 1, (int64_t) 2, 3, (int64_t) 4, 5, (int64_t) 6);
+        if (!res) res = m3_GetResultsV(fn, &l);
+        expect_m3_err_eq("sum6", res, m3Err_none);
+        expect_i64_eq("sum6", l, 654321);
+    }
+#endif
+
+    m3_FreeRuntime(runtime);
+    m3_FreeEnvironment(env);
+
+    if (g_failures == 0) {
+        printf("PASS: typed import tests\n");
+        return 0;
+    }
+
+    fprintf(stderr, "FAILED: %d typed import tests\n", g_failures);
+    return 1;
+}
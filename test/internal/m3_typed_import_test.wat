@@ -0,0 +1,46 @@
+;; typed imports: arguments arrive as C parameters, the result is returned directly
+(module
+  (import "env" "add" (func $add (param f64 f64) (result f64)))
+  (import "env" "mix" (func $mix (param i32 i64 f32) (result f64)))
+  (import "env" "neg" (func $neg (param f32) (result f32)))
+  (import "env" "note" (func $note (param i32 i32 i32 i32)))
+  (import "env" "sum6" (func $sum6 (param i32 i64 i32 i64 i32 i64) (result i64)))
+  (import "env" "count" (func $count (result i32)))
+  (import "env" "wide" (func $wide (param f64 f64 f64 f64 f64)))
+
+  (func (export "add") (param f64 f64) (result f64)
+    local.get 0
+    local.get 1
+    call $add)
+
+  (func (export "mix") (param i32 i64 f32) (result f64)
+    local.get 0
+    local.get 1
+    local.get 2
+    call $mix)
+
+  (func (export "neg") (param f32) (result f32)
+    local.get 0
+    call $neg)
+
+  (func (export "note") (param i32 i32 i32 i32)
+    local.get 0
+    local.get 1
+    local.get 2
+    local.get 3
+    call $note)
+
+  (func (export "sum6") (param i32 i64 i32 i64 i32 i64) (result i64)
+    local.get 0
+    local.get 1
+    local.get 2
+    local.get 3
+    local.get 4
+    local.get 5
+    call $sum6)
+
+  (func (export "count") (result i32)
+    call $count
+    call $count
+    i32.add)
+)
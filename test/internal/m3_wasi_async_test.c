@@ -0,0 +1,191 @@
+//
+//  m3_wasi_async_test.c
+//
+//  m3_AttachWASILoop: uvwasi calls of suspendable runtimes park the guest and run on the loop's
+//  threadpool; the loop resumes each runtime once its call is done. covers poll_oneoff and an
+//  fd_write with more iovecs than d_m3WasiMaxIovecs. detached, the same calls run directly.
+//
+//  wasm_wasi_async is assembled from m3_wasi_async_test.wat.
+//
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "uv.h"
+
+#include "wasm3.h"
+#include "m3_config.h"
+#include "m3_api_wasi.h"
+
+static const uint8_t wasm_wasi_async[] = {
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x12, 0x03, 0x60,
+  0x04, 0x7f, 0x7f, 0x7f, 0x7f, 0x01, 0x7f, 0x60, 0x00, 0x01, 0x7f, 0x60,
+  0x01, 0x7f, 0x01, 0x7f, 0x02, 0x48, 0x02, 0x16, 0x77, 0x61, 0x73, 0x69,
+  0x5f, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x5f, 0x70, 0x72,
+  0x65, 0x76, 0x69, 0x65, 0x77, 0x31, 0x0b, 0x70, 0x6f, 0x6c, 0x6c, 0x5f,
+  0x6f, 0x6e, 0x65, 0x6f, 0x66, 0x66, 0x00, 0x00, 0x16, 0x77, 0x61, 0x73,
+  0x69, 0x5f, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x5f, 0x70,
+  0x72, 0x65, 0x76, 0x69, 0x65, 0x77, 0x31, 0x08, 0x66, 0x64, 0x5f, 0x77,
+  0x72, 0x69, 0x74, 0x65, 0x00, 0x00, 0x03, 0x03, 0x02, 0x01, 0x02, 0x05,
+  0x03, 0x01, 0x00, 0x01, 0x07, 0x19, 0x03, 0x05, 0x73, 0x6c, 0x65, 0x65,
+  0x70, 0x00, 0x02, 0x04, 0x64, 0x6f, 0x74, 0x73, 0x00, 0x03, 0x06, 0x6d,
+  0x65, 0x6d, 0x6f, 0x72, 0x79, 0x02, 0x00, 0x0a, 0x60, 0x02, 0x19, 0x00,
+  0x41, 0x00, 0x41, 0xe4, 0x00, 0x41, 0x01, 0x41, 0xc8, 0x01, 0x10, 0x00,
+  0x41, 0xe4, 0x00, 0x6c, 0x41, 0xc8, 0x01, 0x28, 0x02, 0x00, 0x6a, 0x0b,
+  0x44, 0x01, 0x01, 0x7f, 0x02, 0x40, 0x03, 0x40, 0x20, 0x01, 0x20, 0x00,
+  0x4f, 0x0d, 0x01, 0x20, 0x01, 0x41, 0x08, 0x6c, 0x41, 0x80, 0x08, 0x6a,
+  0x42, 0x80, 0x82, 0x80, 0x80, 0x10, 0x37, 0x03, 0x00, 0x20, 0x01, 0x41,
+  0x01, 0x6a, 0x21, 0x01, 0x0c, 0x00, 0x0b, 0x0b, 0x41, 0x01, 0x41, 0x80,
+  0x08, 0x20, 0x00, 0x41, 0xcc, 0x01, 0x10, 0x01, 0x41, 0xa0, 0x8d, 0x06,
+  0x6c, 0x41, 0xcc, 0x01, 0x28, 0x02, 0x00, 0x6a, 0x0b, 0x0b, 0x19, 0x02,
+  0x00, 0x41, 0x10, 0x0b, 0x0c, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x80, 0xf0, 0xfa, 0x02, 0x00, 0x41, 0x80, 0x02, 0x0b, 0x01, 0x2e,
+  0x00, 0x1f, 0x04, 0x6e, 0x61, 0x6d, 0x65, 0x01, 0x18, 0x02, 0x00, 0x0b,
+  0x70, 0x6f, 0x6c, 0x6c, 0x5f, 0x6f, 0x6e, 0x65, 0x6f, 0x66, 0x66, 0x01,
+  0x08, 0x66, 0x64, 0x5f, 0x77, 0x72, 0x69, 0x74, 0x65
+};
+
+#define RUNTIMES    3
+#define IOVECS      (d_m3WasiMaxIovecs + 72)
+
+static int g_failures = 0;
+
+static void failf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    g_failures++;
+}
+
+static void expect_m3_err_eq(const char* where, M3Result res, M3Result expected) {
+    if (res != expected) {
+        failf("%s: got error=%s expected=%s", where, res ? res : "(null)", expected ? expected : "(null)");
+    }
+}
+
+static void expect_i64_eq(const char* where, int64_t got, int64_t expected) {
+    if (got != expected) {
+        failf("%s: got=%" PRId64 " expected=%" PRId64, where, got, expected);
+    }
+}
+
+static IM3Function find_fn(IM3Runtime runtime, const char* name) {
+    IM3Function fn = NULL;
+    M3Result res = m3_FindFunction(&fn, runtime, name);
+    if (res != m3Err_none) {
+        failf("m3_FindFunction(%s) failed: %s", name, res);
+        return NULL;
+    }
+    return fn;
+}
+
+// the call each runtime has parked, and what the loop finished it with
+
+static IM3Function  g_pending [RUNTIMES];
+static M3Result     g_results [RUNTIMES];
+static int32_t      g_values  [RUNTIMES];
+static int          g_resumes;
+
+static void on_resumed(IM3Runtime runtime, M3Result result) {
+    int i = (int) (intptr_t) m3_GetUserData(runtime);
+    g_resumes++;
+    if (result == m3Err_suspended) return;
+
+    g_results[i] = result;
+    if (result == m3Err_none) {
+        int32_t value = 0;
+        expect_m3_err_eq("m3_GetResultsV", m3_GetResultsV(g_pending[i], &value), m3Err_none);
+        g_values[i] = value;
+    }
+}
+
+static IM3Runtime load(IM3Environment env, int i) {
+    IM3Runtime runtime = m3_NewRuntime(env, 64 * 1024, (void*) (intptr_t) i);
+    IM3Module module = NULL;
+
+    M3Result res = m3_ParseModule(env, &module, wasm_wasi_async, sizeof(wasm_wasi_async));
+    if (!res) res = m3_LoadModule(runtime, module);
+    if (!res) res = m3_LinkWASI(module);
+    if (res) {
+        failf("loading module %d failed: %s", i, res);
+        return NULL;
+    }
+    m3_SetSuspendable(runtime, true);
+    return runtime;
+}
+
+// parks every runtime in fn, then lets the loop finish them
+static void run_all(IM3Runtime* runtimes, const char* fn, const char* arg, int32_t expected) {
+    char where [64];
+    const char* argv[] = { arg };
+
+    g_resumes = 0;
+    for (int i = 0; i < RUNTIMES; ++i) {
+        g_pending[i] = find_fn(runtimes[i], fn);
+        g_results[i] = "(not resumed)";
+        g_values[i] = -1;
+        if (!g_pending[i]) return;
+
+        snprintf(where, sizeof(where), "%s on runtime %d", fn, i);
+        expect_m3_err_eq(where, m3_CallArgv(g_pending[i], arg ? 1 : 0, argv), m3Err_suspended);
+    }
+
+    uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+    expect_i64_eq("resumes", g_resumes, RUNTIMES);
+    for (int i = 0; i < RUNTIMES; ++i) {
+        snprintf(where, sizeof(where), "%s resumed on runtime %d", fn, i);
+        expect_m3_err_eq(where, g_results[i], m3Err_none);
+        expect_i64_eq(where, g_values[i], expected);
+    }
+}
+
+int main(void) {
+    IM3Environment env = m3_NewEnvironment();
+    IM3Runtime runtimes [RUNTIMES];
+    char iovecs [16];
+
+    for (int i = 0; i < RUNTIMES; ++i) {
+        runtimes[i] = load(env, i);
+        if (!runtimes[i]) return 1;
+    }
+
+    snprintf(iovecs, sizeof(iovecs), "%d", IOVECS);
+
+    expect_m3_err_eq("m3_AttachWASILoop", m3_AttachWASILoop(uv_default_loop(), on_resumed), m3Err_none);
+
+    // one event each, no errno
+    run_all(runtimes, "sleep", NULL, 1);
+    run_all(runtimes, "dots", iovecs, IOVECS);
+    printf("\n");
+
+    // without a loop the calls complete before returning
+    m3_AttachWASILoop(NULL, NULL);
+
+    IM3Function fn = find_fn(runtimes[0], "sleep");
+    if (fn) {
+        int32_t value = 0;
+        expect_m3_err_eq("sleep detached", m3_CallV(fn), m3Err_none);
+        expect_m3_err_eq("sleep detached results", m3_GetResultsV(fn, &value), m3Err_none);
+        expect_i64_eq("sleep detached", value, 1);
+    }
+
+    for (int i = 0; i < RUNTIMES; ++i) {
+        m3_FreeRuntime(runtimes[i]);
+    }
+    m3_FreeEnvironment(env);
+    uv_loop_close(uv_default_loop());
+
+    if (g_failures == 0) {
+        printf("PASS: wasi async tests\n");
+        return 0;
+    }
+
+    fprintf(stderr, "FAILED: %d wasi async tests\n", g_failures);
+    return 1;
+}
@@ -0,0 +1,57 @@
+;; uvwasi calls of suspendable runtimes: the guest parks at the import while the call runs on the loop's threadpool
+(module
+  (import "wasi_snapshot_preview1" "poll_oneoff" (func $poll_oneoff (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+  (memory (export "memory") 1)
+
+  ;; clock subscription at 0: monotonic, 50ms relative
+  (data (i32.const 16) "\01\00\00\00\00\00\00\00\80\f0\fa\02")
+  (data (i32.const 256) ".")
+
+  ;; sleeps 50ms; returns errno * 100 + the number of events
+  (func (export "sleep") (result i32)
+    i32.const 0
+    i32.const 100
+    i32.const 1
+    i32.const 200
+    call $poll_oneoff
+    i32.const 100
+    i32.mul
+    i32.const 200
+    i32.load
+    i32.add)
+
+  ;; writes $n one-byte iovecs to stdout in one fd_write; returns errno * 100000 + the bytes written
+  (func (export "dots") (param $n i32) (result i32)
+    (local $i i32)
+    block $done
+      loop $next
+        local.get $i
+        local.get $n
+        i32.ge_u
+        br_if $done
+        local.get $i
+        i32.const 8
+        i32.mul
+        i32.const 1024
+        i32.add
+        i64.const 0x100000100
+        i64.store
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $next
+      end
+    end
+    i32.const 1
+    i32.const 1024
+    local.get $n
+    i32.const 204
+    call $fd_write
+    i32.const 100000
+    i32.mul
+    i32.const 204
+    i32.load
+    i32.add)
+)
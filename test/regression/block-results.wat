@@ -0,0 +1,184 @@
+;; block and call results kept in registers (PushBlockResults) and registers below branch
+;; values (PreserveRegistersBelowTop). every export returns 1 when the results are right
+(module
+  (global $g (mut i32) (i32.const 5))
+  (global $h (mut f64) (f64.const 2.5))
+
+  ;; x lives in r0 under the branch value y when br_if resolves the block result
+  (func $br_if (param $cond i32) (result i32)
+    (local $y i32)
+    i32.const 7
+    local.set $y
+    block $b (result i32)
+      global.get $g
+      i32.const 2
+      i32.mul
+      local.get $y
+      local.get $cond
+      br_if $b
+      i32.add
+    end)
+
+  (func (export "br_if_keeps_r0") (result i32)
+    i32.const 0
+    call $br_if
+    i32.const 17
+    i32.eq
+    i32.const 1
+    call $br_if
+    i32.const 7
+    i32.eq
+    i32.and)
+
+  ;; br_table resolves the same two results for every target, while fp0 holds the lower one
+  (func $br_table (param $index i32) (result f64)
+    (local $y f64)
+    f64.const 7
+    local.set $y
+    block $outer (result f64 f64)
+      block $inner (result f64 f64)
+        global.get $h
+        f64.const 2
+        f64.mul
+        local.get $y
+        local.get $index
+        br_table $inner $outer $inner
+      end
+      f64.const 100
+      f64.add
+    end
+    f64.sub)
+
+  (func (export "br_table_keeps_fp0") (result i32)
+    i32.const 0
+    call $br_table
+    f64.const -102
+    f64.eq
+    i32.const 1
+    call $br_table
+    f64.const -2
+    f64.eq
+    i32.and
+    i32.const 2
+    call $br_table
+    f64.const -102
+    f64.eq
+    i32.and)
+
+  ;; br_if out of a block with two results while r0 holds a value below them
+  (func $br_if_pair (param $cond i32) (result i32)
+    (local $y i32)
+    i32.const 3
+    local.set $y
+    block $b (result i32 i32)
+      global.get $g
+      i32.const 1
+      i32.add
+      global.get $g
+      i32.const 4
+      i32.mul
+      local.get $y
+      local.get $cond
+      br_if $b
+      i32.add
+      i32.add
+      i32.const 1
+    end
+    i32.sub)
+
+  (func (export "br_if_multi_value") (result i32)
+    i32.const 0
+    call $br_if_pair
+    i32.const 28
+    i32.eq
+    i32.const 1
+    call $br_if_pair
+    i32.const 17
+    i32.eq
+    i32.and)
+
+  ;; multi-value blocks whose last result is an integer, then a float
+  (func (export "multi_value_block") (result i32)
+    (local $c i32)
+    block (result i32 i32)
+      global.get $g
+      i32.const 1
+      i32.add
+      global.get $g
+      i32.const 2
+      i32.add
+    end
+    i32.sub
+    i32.const -1
+    i32.eq
+    block (result i32 f64)
+      global.get $g
+      global.get $h
+      f64.const 4
+      f64.mul
+    end
+    f64.const 10
+    f64.eq
+    local.set $c
+    i32.const 5
+    i32.eq
+    local.get $c
+    i32.and
+    i32.and
+    block (result f64 i32)
+      global.get $h
+      global.get $g
+      i32.const 3
+      i32.mul
+    end
+    i32.const 15
+    i32.eq
+    local.set $c
+    f64.const 2.5
+    f64.eq
+    local.get $c
+    i32.and
+    i32.and)
+
+  (func $pair (result i32 i32)
+    global.get $g
+    i32.const 3
+    i32.add
+    global.get $g
+    i32.const 1
+    i32.sub)
+
+  (func $mixed (result f64 i32 i64)
+    global.get $h
+    global.get $g
+    global.get $g
+    i64.extend_i32_s
+    i64.const 10
+    i64.mul)
+
+  ;; calls returning several values, with a live register below the call
+  (func (export "multi_value_call") (result i32)
+    (local $c i32)
+    global.get $g
+    i32.const 10
+    i32.mul
+    call $pair
+    i32.sub
+    i32.add
+    i32.const 54
+    i32.eq
+    call $mixed
+    i64.const 50
+    i64.eq
+    local.set $c
+    i32.const 5
+    i32.eq
+    local.get $c
+    i32.and
+    local.set $c
+    f64.const 2.5
+    f64.eq
+    local.get $c
+    i32.and
+    i32.and)
+)
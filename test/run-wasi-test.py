@@ -14,6 +14,8 @@ import sys
 import subprocess
 import hashlib
 import fnmatch
+import socket
+import threading
 
 sys.path.append('../extra')
 
@@ -45,6 +47,28 @@ commands_full = [
     "wasm":           "./wasi/simple/test-opt.wasm",
     "args":           ["cat", "./wasi/simple/0.txt"],
     "expect_pattern": "Hello world*Constructor OK*Args: *; cat; ./wasi/simple/0.txt;*fib(20) = 6765* ms*48 65 6c 6c 6f 20 77 6f 72 6c 64*=== done ===*"
+  }, {
+    "name":           "Files (dir handle cache)",
+    "wasm":           "./wasi/files/files.wasm",
+    "expect_pattern": "path_open x2000 in * us*files OK*"
+  }, {
+    "name":           "Files (in-memory image)",
+    "opts":           ["--image", "./wasi/files/image.tar"],
+    "wasm":           "./wasi/files/files.wasm",
+    "expect_pattern": "path_open x2000 in * us*files OK*"
+  }, {
+    "name":           "Sockets (loopback echo)",
+    "requires":       "--listen",
+    "opts":           ["--listen", "127.0.0.1:{port}"],
+    "wasm":           "./wasi/sockets/echo.wasm",
+    "client":         { "after": b"accept: AGAIN", "send": 1200 },
+    "expect_pattern": "accept: AGAIN*echoed 1200 bytes*echo OK*"
+  }, {
+    "name":           "Simple WASI test (in-memory image)",
+    "opts":           ["--image", "./wasi/files/image.tar"],
+    "wasm":           "./wasi/simple/test.wasm",
+    "args":           ["cat", "./image/0.txt"],
+    "expect_pattern": "Hello world*Constructor OK*Args: *; cat; ./image/0.txt;*48 65 6c 6c 6f 20 77 6f 72 6c 64*=== done ===*"
   }, {
     "name":           "mandelbrot",
     "wasm":           "./wasi/mandelbrot/mandel.wasm",
@@ -104,6 +128,28 @@ commands_fast = [
     "wasm":           "./wasi/simple/test.wasm",
     "args":           ["cat", "./wasi/simple/0.txt"],
     "expect_pattern": "Hello world*Constructor OK*Args: *; cat; ./wasi/simple/0.txt;*fib(20) = 6765* ms*48 65 6c 6c 6f 20 77 6f 72 6c 64*=== done ===*"
+  }, {
+    "name":           "Files (dir handle cache)",
+    "wasm":           "./wasi/files/files.wasm",
+    "expect_pattern": "path_open x2000 in * us*files OK*"
+  }, {
+    "name":           "Files (in-memory image)",
+    "opts":           ["--image", "./wasi/files/image.tar"],
+    "wasm":           "./wasi/files/files.wasm",
+    "expect_pattern": "path_open x2000 in * us*files OK*"
+  }, {
+    "name":           "Sockets (loopback echo)",
+    "requires":       "--listen",
+    "opts":           ["--listen", "127.0.0.1:{port}"],
+    "wasm":           "./wasi/sockets/echo.wasm",
+    "client":         { "after": b"accept: AGAIN", "send": 1200 },
+    "expect_pattern": "accept: AGAIN*echoed 1200 bytes*echo OK*"
+  }, {
+    "name":           "Simple WASI test (in-memory image)",
+    "opts":           ["--image", "./wasi/files/image.tar"],
+    "wasm":           "./wasi/simple/test.wasm",
+    "args":           ["cat", "./image/0.txt"],
+    "expect_pattern": "Hello world*Constructor OK*Args: *; cat; ./image/0.txt;*48 65 6c 6c 6f 20 77 6f 72 6c 64*=== done ===*"
   }, {
     "skip":           True,  # Backtraces not enabled by default
     "name":           "Simple WASI test",
@@ -150,13 +196,74 @@ def fail(msg):
     print(f"{ansi.FAIL}FAIL:{ansi.ENDC} {msg}")
     stats.failed += 1
 
+def supports(option):
+    # options only some builds accept are listed in the usage text
+    try:
+        usage = subprocess.run(args.exec.split(' ') + ["--help"], timeout=args.timeout,
+                               stdout=subprocess.PIPE, stderr=subprocess.STDOUT).stdout
+    except (OSError, subprocess.TimeoutExpired):
+        return False
+    return option.encode() in usage
+
+def free_port():
+    with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+# runs command with a TCP client: once the module prints client["after"], connects to the
+# listener, sends client["send"] bytes and expects the same bytes echoed back
+def run_with_client(command, client, port):
+    proc = subprocess.Popen(command, stdout=subprocess.PIPE)
+    timer = threading.Timer(args.timeout, proc.kill)
+    timer.start()
+    try:
+        output = b""
+        while client["after"] not in output:
+            line = proc.stdout.readline()
+            if not line:
+                break
+            output += line
+
+        if client["after"] in output:
+            data = bytes(i % 251 for i in range(client["send"]))
+            echoed = b""
+            with socket.create_connection(("127.0.0.1", port), timeout=args.timeout) as conn:
+                conn.sendall(data)
+                conn.shutdown(socket.SHUT_WR)
+                while True:
+                    chunk = conn.recv(4096)
+                    if not chunk:
+                        break
+                    echoed += chunk
+            if echoed != data:
+                fail(f"Echoed {len(echoed)} bytes, not the {len(data)} sent")
+
+        output += proc.stdout.read()
+        proc.wait()
+    finally:
+        timer.cancel()
+
+    if proc.returncode < 0:
+        raise subprocess.TimeoutExpired(command, args.timeout)
+    if proc.returncode:
+        raise subprocess.CalledProcessError(proc.returncode, command)
+    return output
+
 commands = commands_fast if args.fast else commands_full
 
 for cmd in commands:
     if "skip" in cmd:
         continue
+    if "requires" in cmd and not supports(cmd['requires']):
+        print(f"=== {cmd['name']} ===")
+        print(f"skipped: no {cmd['requires']} option\n")
+        continue
+
+    port = free_port() if "client" in cmd else None
 
     command = args.exec.split(' ')
+    if "opts" in cmd:
+        command.extend(opt.format(port=port) for opt in cmd['opts'])
     command.append(cmd['wasm'])
     if "args" in cmd:
         if args.separate_args:
@@ -172,6 +279,9 @@ for cmd in commands:
             f = open(fn, "rb")
             print(f"cat {fn} | {' '.join(command)}")
             output = subprocess.check_output(command, timeout=args.timeout, stdin=f)
+        elif "client" in cmd:
+            print(f"{' '.join(command)}")
+            output = run_with_client(command, cmd['client'], port)
         elif "can_crash" in cmd:
             print(f"{' '.join(command)}")
             output = subprocess.run(command, timeout=args.timeout, stdout=subprocess.PIPE, stderr=subprocess.STDOUT).stdout
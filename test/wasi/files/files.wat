@@ -0,0 +1,128 @@
+;; File-heavy WASI test: creates, writes and stats the same nested path many
+;; times, then renames its parent directory and checks that the old path no
+;; longer resolves while the new one does. A second rename moves the directory
+;; above a cached one and recreates the old names, so a lookup through the
+;; stale prefix would find the moved file instead of failing.
+;;
+;; Prints the time spent in the path_open/fd_write/fd_close/path_filestat_get
+;; loop, so runs with and without d_m3WasiDirCacheSize can be compared.
+(module
+  (type (;0;) (func (param i32 i32 i32 i32 i32 i64 i64 i32 i32) (result i32)))
+  (type (;1;) (func (param i32 i32 i32 i32) (result i32)))
+  (type (;2;) (func (param i32) (result i32)))
+  (type (;3;) (func (param i32 i32 i32) (result i32)))
+  (type (;4;) (func (param i32 i32 i32 i32 i32) (result i32)))
+  (type (;5;) (func (param i32 i32 i32 i32 i32 i32) (result i32)))
+  (type (;6;) (func (param i32 i64 i32) (result i32)))
+  (type (;7;) (func (param i32)))
+  (type (;8;) (func (param i32 i32)))
+  (type (;9;) (func (param i64)))
+  (type (;10;) (func (result i64)))
+  (type (;11;) (func))
+
+  (import "wasi_snapshot_preview1" "path_open"             (func $path_open             (type 0)))
+  (import "wasi_snapshot_preview1" "fd_write"              (func $fd_write              (type 1)))
+  (import "wasi_snapshot_preview1" "fd_close"              (func $fd_close              (type 2)))
+  (import "wasi_snapshot_preview1" "path_create_directory" (func $path_create_directory (type 3)))
+  (import "wasi_snapshot_preview1" "path_filestat_get"     (func $path_filestat_get     (type 4)))
+  (import "wasi_snapshot_preview1" "path_unlink_file"      (func $path_unlink_file      (type 3)))
+  (import "wasi_snapshot_preview1" "path_remove_directory" (func $path_remove_directory (type 3)))
+  (import "wasi_snapshot_preview1" "path_rename"           (func $path_rename           (type 5)))
+  (import "wasi_snapshot_preview1" "clock_time_get"        (func $clock_time_get        (type 6)))
+  (import "wasi_snapshot_preview1" "proc_exit"             (func $proc_exit             (type 7)))
+
+  ;; 64: iovec, 72: nwritten, 76: opened fd, 80: timestamp, 128: filestat
+  (memory (export "memory") 1)
+
+  (data (i32.const 256) "files.tmp")
+  (data (i32.const 272) "files.tmp/a")
+  (data (i32.const 288) "files.tmp/a/b")
+  (data (i32.const 304) "files.tmp/a/b/f.txt")
+  (data (i32.const 336) "files.tmp/a/c")
+  (data (i32.const 352) "files.tmp/a/c/f.txt")
+  (data (i32.const 384) "FAIL\n")
+  (data (i32.const 400) "files OK\n")
+  (data (i32.const 416) "path_open x2000 in ")
+  (data (i32.const 448) " us\n")
+  (data (i32.const 560) "files.tmp/z")
+  (data (i32.const 576) "files.tmp/z/c/f.txt")
+
+  (func $print (type 8) (param $ptr i32) (param $len i32)
+    (i32.store (i32.const 64) (local.get $ptr))
+    (i32.store (i32.const 68) (local.get $len))
+    (drop (call $fd_write (i32.const 1) (i32.const 64) (i32.const 1) (i32.const 72))))
+
+  (func $check (type 7) (param $errno i32)
+    (if (local.get $errno)
+      (then
+        (call $print (i32.const 384) (i32.const 5))
+        (call $proc_exit (i32.const 1)))))
+
+  (func $print_u64 (type 9) (param $v i64) (local $p i32)
+    (local.set $p (i32.const 544))
+    (loop $digits
+      (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+      (i64.store8 (local.get $p) (i64.add (i64.rem_u (local.get $v) (i64.const 10)) (i64.const 48)))
+      (local.set $v (i64.div_u (local.get $v) (i64.const 10)))
+      (br_if $digits (i64.ne (local.get $v) (i64.const 0))))
+    (call $print (local.get $p) (i32.sub (i32.const 544) (local.get $p))))
+
+  ;; opens path under the first preopen for reading and writing; returns the errno
+  (func $open (type 3) (param $path i32) (param $len i32) (param $oflags i32) (result i32)
+    (call $path_open (i32.const 3) (i32.const 1) (local.get $path) (local.get $len) (local.get $oflags)
+                     (i64.const 66) (i64.const 0) (i32.const 0) (i32.const 76)))
+
+  (func $now (type 10) (result i64)
+    (call $check (call $clock_time_get (i32.const 1) (i64.const 1) (i32.const 80)))
+    (i64.load (i32.const 80)))
+
+  ;; stats path and fails unless it is one byte long
+  (func $check_size (type 8) (param $path i32) (param $len i32)
+    (call $check (call $path_filestat_get (i32.const 3) (i32.const 1) (local.get $path) (local.get $len) (i32.const 128)))
+    (if (i64.ne (i64.load (i32.const 160)) (i64.const 1))
+      (then (call $check (i32.const 1)))))
+
+  (func $_start (type 11) (local $i i32) (local $t0 i64)
+    (call $check (call $path_create_directory (i32.const 3) (i32.const 256) (i32.const 9)))
+    (call $check (call $path_create_directory (i32.const 3) (i32.const 272) (i32.const 11)))
+    (call $check (call $path_create_directory (i32.const 3) (i32.const 288) (i32.const 13)))
+
+    (local.set $t0 (call $now))
+    (loop $files
+      ;; O_CREAT | O_TRUNC
+      (call $check (call $open (i32.const 304) (i32.const 19) (i32.const 9)))
+      (i32.store (i32.const 64) (i32.const 384))
+      (i32.store (i32.const 68) (i32.const 1))
+      (call $check (call $fd_write (i32.load (i32.const 76)) (i32.const 64) (i32.const 1) (i32.const 72)))
+      (call $check (call $fd_close (i32.load (i32.const 76))))
+      (call $check_size (i32.const 304) (i32.const 19))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $files (i32.lt_u (local.get $i) (i32.const 2000))))
+
+    (call $print (i32.const 416) (i32.const 19))
+    (call $print_u64 (i64.div_u (i64.sub (call $now) (local.get $t0)) (i64.const 1000)))
+    (call $print (i32.const 448) (i32.const 4))
+
+    ;; a/b -> a/c: a cached handle for a/b must not keep the old name working
+    (call $check (call $path_rename (i32.const 3) (i32.const 288) (i32.const 13) (i32.const 3) (i32.const 336) (i32.const 13)))
+    (call $check (i32.ne (call $open (i32.const 304) (i32.const 19) (i32.const 0)) (i32.const 44)))
+    (call $check_size (i32.const 352) (i32.const 19))
+
+    ;; a -> z with a/c cached: entries below a renamed directory go too, and the
+    ;; recreated a/c is empty
+    (call $check (call $path_rename (i32.const 3) (i32.const 272) (i32.const 11) (i32.const 3) (i32.const 560) (i32.const 11)))
+    (call $check (call $path_create_directory (i32.const 3) (i32.const 272) (i32.const 11)))
+    (call $check (call $path_create_directory (i32.const 3) (i32.const 336) (i32.const 13)))
+    (call $check (i32.ne (call $open (i32.const 352) (i32.const 19) (i32.const 0)) (i32.const 44)))
+    (call $check_size (i32.const 576) (i32.const 19))
+
+    (call $check (call $path_unlink_file (i32.const 3) (i32.const 576) (i32.const 19)))
+    (call $check (call $path_remove_directory (i32.const 3) (i32.const 576) (i32.const 13)))
+    (call $check (call $path_remove_directory (i32.const 3) (i32.const 560) (i32.const 11)))
+    (call $check (call $path_remove_directory (i32.const 3) (i32.const 336) (i32.const 13)))
+    (call $check (call $path_remove_directory (i32.const 3) (i32.const 272) (i32.const 11)))
+    (call $check (call $path_remove_directory (i32.const 3) (i32.const 256) (i32.const 9)))
+
+    (call $print (i32.const 400) (i32.const 9)))
+
+  (export "_start" (func $_start)))
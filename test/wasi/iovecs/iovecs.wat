@@ -0,0 +1,211 @@
+;; fd_write and fd_read with 1000 one-byte iovecs, several times d_m3WasiMaxIovecs: the
+;; backend translates lists that long on the heap instead of failing them. Writes a file
+;; in order, reads it back into the pieces in reverse and compares.
+(module
+  (import "wasi_snapshot_preview1" "path_open"        (func $path_open (param i32 i32 i32 i32 i32 i64 i64 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write"         (func $fd_write (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_read"          (func $fd_read (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_close"         (func $fd_close (param i32) (result i32)))
+  (import "wasi_snapshot_preview1" "path_unlink_file" (func $path_unlink_file (param i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "proc_exit"        (func $proc_exit (param i32)))
+
+  ;; 0: opened fd, 4: byte count, 64: print iovec, 1024: written bytes, 2048: read bytes, 4096: iovecs
+  (memory (export "memory") 1)
+
+  (data (i32.const 16) "iovecs.tmp")
+  (data (i32.const 32) "FAIL\n")
+  (data (i32.const 48) "iovecs OK\n")
+
+  (func $print (param $ptr i32) (param $len i32)
+    i32.const 64
+    local.get $ptr
+    i32.store
+    i32.const 68
+    local.get $len
+    i32.store
+    i32.const 1
+    i32.const 64
+    i32.const 1
+    i32.const 4
+    call $fd_write
+    drop)
+
+  ;; prints FAIL and exits unless $ok
+  (func $check (param $ok i32)
+    local.get $ok
+    i32.eqz
+    if
+      i32.const 32
+      i32.const 5
+      call $print
+      i32.const 1
+      call $proc_exit
+    end)
+
+  (func $open (param $oflags i32) (param $rights i64) (result i32)
+    i32.const 3
+    i32.const 1
+    i32.const 16
+    i32.const 10
+    local.get $oflags
+    local.get $rights
+    i64.const 0
+    i32.const 0
+    i32.const 0
+    call $path_open
+    i32.eqz
+    call $check
+    i32.const 0
+    i32.load)
+
+  ;; iovec $i is byte $base + $i, or $base + 999 - $i when $reverse
+  (func $iovecs (param $base i32) (param $reverse i32)
+    (local $i i32)
+    block $done
+      loop $next
+        local.get $i
+        i32.const 1000
+        i32.eq
+        br_if $done
+        local.get $i
+        i32.const 3
+        i32.shl
+        i32.const 4096
+        i32.add
+        local.get $base
+        i32.const 999
+        local.get $i
+        i32.sub
+        local.get $i
+        local.get $reverse
+        select
+        i32.add
+        i32.store
+        local.get $i
+        i32.const 3
+        i32.shl
+        i32.const 4100
+        i32.add
+        i32.const 1
+        i32.store
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $next
+      end
+    end)
+
+  (func $start
+    (local $fd i32)
+    (local $i i32)
+
+    ;; bytes 0..255, repeated
+    block $filled
+      loop $fill
+        local.get $i
+        i32.const 1000
+        i32.eq
+        br_if $filled
+        local.get $i
+        i32.const 1024
+        i32.add
+        local.get $i
+        i32.store8
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $fill
+      end
+    end
+
+    ;; create and truncate with fd_write rights
+    i32.const 9
+    i64.const 0x40
+    call $open
+    local.set $fd
+    i32.const 1024
+    i32.const 0
+    call $iovecs
+    local.get $fd
+    i32.const 4096
+    i32.const 1000
+    i32.const 4
+    call $fd_write
+    i32.eqz
+    call $check
+    i32.const 4
+    i32.load
+    i32.const 1000
+    i32.eq
+    call $check
+    local.get $fd
+    call $fd_close
+    i32.eqz
+    call $check
+
+    ;; reopen with fd_read rights
+    i32.const 0
+    i64.const 0x2
+    call $open
+    local.set $fd
+    i32.const 2048
+    i32.const 1
+    call $iovecs
+    local.get $fd
+    i32.const 4096
+    i32.const 1000
+    i32.const 4
+    call $fd_read
+    i32.eqz
+    call $check
+    i32.const 4
+    i32.load
+    i32.const 1000
+    i32.eq
+    call $check
+    local.get $fd
+    call $fd_close
+    i32.eqz
+    call $check
+
+    ;; byte $i landed at 2048 + 999 - $i
+    i32.const 0
+    local.set $i
+    block $compared
+      loop $compare
+        local.get $i
+        i32.const 1000
+        i32.eq
+        br_if $compared
+        local.get $i
+        i32.const 1024
+        i32.add
+        i32.load8_u
+        i32.const 3047
+        local.get $i
+        i32.sub
+        i32.load8_u
+        i32.eq
+        call $check
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $compare
+      end
+    end
+
+    i32.const 3
+    i32.const 16
+    i32.const 10
+    call $path_unlink_file
+    i32.eqz
+    call $check
+    i32.const 48
+    i32.const 10
+    call $print)
+
+  (export "_start" (func $start))
+)
@@ -0,0 +1,287 @@
+;; poll_oneoff: clock subscriptions sleep at least their timeout, a regular file is
+;; readable at once without waiting for a pending clock, and a bad fd reports EBADF.
+;; the simple and uring backends return it as an event instead of failing the call.
+(module
+  (import "wasi_snapshot_preview1" "poll_oneoff"      (func $poll_oneoff (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "clock_time_get"   (func $clock_time_get (param i32 i64 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "path_open"        (func $path_open (param i32 i32 i32 i32 i32 i64 i64 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write"         (func $fd_write (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_close"         (func $fd_close (param i32) (result i32)))
+  (import "wasi_snapshot_preview1" "path_unlink_file" (func $path_unlink_file (param i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "proc_exit"        (func $proc_exit (param i32)))
+
+  ;; 0: subscriptions, 500: opened fd, 504: byte count, 508: event count, 512: timestamp,
+  ;; 600: print iovec, 1024: events
+  (memory (export "memory") 1)
+
+  (data (i32.const 256) "poll.tmp")
+  (data (i32.const 272) "FAIL\n")
+  (data (i32.const 288) "poll OK\n")
+
+  (func $print (param $ptr i32) (param $len i32)
+    i32.const 600
+    local.get $ptr
+    i32.store
+    i32.const 604
+    local.get $len
+    i32.store
+    i32.const 1
+    i32.const 600
+    i32.const 1
+    i32.const 504
+    call $fd_write
+    drop)
+
+  ;; prints FAIL and exits unless $ok
+  (func $check (param $ok i32)
+    local.get $ok
+    i32.eqz
+    if
+      i32.const 272
+      i32.const 5
+      call $print
+      i32.const 1
+      call $proc_exit
+    end)
+
+  (func $now (result i64)
+    i32.const 1
+    i64.const 0
+    i32.const 512
+    call $clock_time_get
+    i32.eqz
+    call $check
+    i32.const 512
+    i64.load)
+
+  ;; relative monotonic clock subscription $index
+  (func $clock (param $index i32) (param $ud i64) (param $timeout i64) (param $precision i64)
+    (local $base i32)
+    local.get $index
+    i32.const 48
+    i32.mul
+    local.set $base
+    local.get $base
+    local.get $ud
+    i64.store
+    local.get $base
+    i32.const 0
+    i32.store8 offset=8
+    local.get $base
+    i32.const 1
+    i32.store offset=16
+    local.get $base
+    local.get $timeout
+    i64.store offset=24
+    local.get $base
+    local.get $precision
+    i64.store offset=32
+    local.get $base
+    i32.const 0
+    i32.store16 offset=40)
+
+  ;; fd_read subscription $index
+  (func $read (param $index i32) (param $ud i64) (param $fd i32)
+    (local $base i32)
+    local.get $index
+    i32.const 48
+    i32.mul
+    local.set $base
+    local.get $base
+    local.get $ud
+    i64.store
+    local.get $base
+    i32.const 1
+    i32.store8 offset=8
+    local.get $base
+    local.get $fd
+    i32.store offset=16)
+
+  ;; polls the first $count subscriptions and returns the number of events
+  (func $poll (param $count i32) (result i32)
+    i32.const 0
+    i32.const 1024
+    local.get $count
+    i32.const 508
+    call $poll_oneoff
+    i32.eqz
+    call $check
+    i32.const 508
+    i32.load)
+
+  ;; event $index has $ud, $error and $type
+  (func $event (param $index i32) (param $ud i64) (param $error i32) (param $type i32) (result i32)
+    (local $base i32)
+    local.get $index
+    i32.const 32
+    i32.mul
+    i32.const 1024
+    i32.add
+    local.set $base
+    local.get $base
+    i64.load
+    local.get $ud
+    i64.eq
+    local.get $base
+    i32.load16_u offset=8
+    local.get $error
+    i32.eq
+    i32.and
+    local.get $base
+    i32.load8_u offset=10
+    local.get $type
+    i32.eq
+    i32.and)
+
+  (func $start
+    (local $t0 i64)
+    (local $fd i32)
+    (local $n i32)
+    (local $i i32)
+
+    ;; 50ms, and 80ms that may be coalesced with it: each event is a clock without error
+    call $now
+    local.set $t0
+    i32.const 0
+    i64.const 1
+    i64.const 50000000
+    i64.const 0
+    call $clock
+    i32.const 1
+    i64.const 2
+    i64.const 80000000
+    i64.const 40000000
+    call $clock
+    i32.const 2
+    call $poll
+    local.tee $n
+    i32.const 1
+    i32.ge_u
+    local.get $n
+    i32.const 2
+    i32.le_u
+    i32.and
+    call $check
+    block $checked
+      loop $next
+        local.get $i
+        local.get $n
+        i32.eq
+        br_if $checked
+        local.get $i
+        i64.const 1
+        i32.const 0
+        i32.const 0
+        call $event
+        local.get $i
+        i64.const 2
+        i32.const 0
+        i32.const 0
+        call $event
+        i32.or
+        call $check
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $next
+      end
+    end
+    call $now
+    local.get $t0
+    i64.sub
+    i64.const 50000000
+    i64.ge_u
+    call $check
+
+    ;; a regular file doesn't wait for the 10s clock
+    i32.const 3
+    i32.const 1
+    i32.const 256
+    i32.const 8
+    i32.const 1
+    i64.const 0x2
+    i64.const 0
+    i32.const 0
+    i32.const 500
+    call $path_open
+    i32.eqz
+    call $check
+    i32.const 500
+    i32.load
+    local.set $fd
+    call $now
+    local.set $t0
+    i32.const 0
+    i64.const 3
+    local.get $fd
+    call $read
+    i32.const 1
+    i64.const 4
+    i64.const 10000000000
+    i64.const 0
+    call $clock
+    i32.const 2
+    call $poll
+    i32.const 1
+    i32.eq
+    call $check
+    i32.const 0
+    i64.const 3
+    i32.const 0
+    i32.const 1
+    call $event
+    call $check
+    call $now
+    local.get $t0
+    i64.sub
+    i64.const 5000000000
+    i64.lt_u
+    call $check
+
+    ;; EBADF for a descriptor that isn't open: as an event, or from hosts that fail the call
+    i32.const 0
+    i64.const 5
+    i32.const 999
+    call $read
+    i32.const 0
+    i32.const 1024
+    i32.const 1
+    i32.const 508
+    call $poll_oneoff
+    local.tee $n
+    if
+      local.get $n
+      i32.const 8
+      i32.eq
+      call $check
+    else
+      i32.const 508
+      i32.load
+      i32.const 1
+      i32.eq
+      call $check
+      i32.const 0
+      i64.const 5
+      i32.const 8
+      i32.const 1
+      call $event
+      call $check
+    end
+
+    local.get $fd
+    call $fd_close
+    i32.eqz
+    call $check
+    i32.const 3
+    i32.const 256
+    i32.const 8
+    call $path_unlink_file
+    i32.eqz
+    call $check
+    i32.const 288
+    i32.const 8
+    call $print)
+
+  (export "_start" (func $start))
+)
@@ -0,0 +1,124 @@
+;; Loopback echo over a listener pre-opened with `wasm3 --listen` (fd 5).
+;;
+;; Makes the listener non-blocking and expects sock_accept to return AGAIN
+;; before anyone connects, then waits for the client with an fd_read
+;; subscription in poll_oneoff (next to a 10 s clock that fails the test).
+;; The accepted connection is echoed back through sock_recv into two iovecs
+;; and sock_send until the client shuts down its side.
+(module
+  (type (;0;) (func (param i32 i32 i32 i32) (result i32)))
+  (type (;1;) (func (param i32 i32) (result i32)))
+  (type (;2;) (func (param i32 i32 i32) (result i32)))
+  (type (;3;) (func (param i32 i32 i32 i32 i32 i32) (result i32)))
+  (type (;4;) (func (param i32 i32 i32 i32 i32) (result i32)))
+  (type (;5;) (func (param i32) (result i32)))
+  (type (;6;) (func (param i32)))
+  (type (;7;) (func (param i32 i32)))
+  (type (;8;) (func (param i64)))
+  (type (;9;) (func))
+
+  (import "wasi_snapshot_preview1" "fd_write"            (func $fd_write            (type 0)))
+  (import "wasi_snapshot_preview1" "fd_fdstat_set_flags" (func $fd_fdstat_set_flags (type 1)))
+  (import "wasi_snapshot_preview1" "sock_accept"         (func $sock_accept         (type 2)))
+  (import "wasi_snapshot_preview1" "sock_recv"           (func $sock_recv           (type 3)))
+  (import "wasi_snapshot_preview1" "sock_send"           (func $sock_send           (type 4)))
+  (import "wasi_snapshot_preview1" "sock_shutdown"       (func $sock_shutdown       (type 1)))
+  (import "wasi_snapshot_preview1" "poll_oneoff"         (func $poll_oneoff         (type 0)))
+  (import "wasi_snapshot_preview1" "fd_close"            (func $fd_close            (type 5)))
+  (import "wasi_snapshot_preview1" "proc_exit"           (func $proc_exit           (type 6)))
+
+  ;; 64: print iovec, 72: nwritten, 76: accepted fd, 80: received, 84: ro_flags, 88: sent,
+  ;; 92: nevents, 96: recv iovecs, 112: send iovec, 128: subscriptions, 224: events,
+  ;; 1024: data
+  (memory (export "memory") 1)
+
+  (data (i32.const 320) "FAIL\n")
+  (data (i32.const 336) "accept: AGAIN\n")
+  (data (i32.const 352) "echoed ")
+  (data (i32.const 368) " bytes\n")
+  (data (i32.const 384) "echo OK\n")
+
+  (func $print (type 7) (param $ptr i32) (param $len i32)
+    (i32.store (i32.const 64) (local.get $ptr))
+    (i32.store (i32.const 68) (local.get $len))
+    (drop (call $fd_write (i32.const 1) (i32.const 64) (i32.const 1) (i32.const 72))))
+
+  (func $check (type 6) (param $errno i32)
+    (if (local.get $errno)
+      (then
+        (call $print (i32.const 320) (i32.const 5))
+        (call $proc_exit (i32.const 1)))))
+
+  (func $print_u64 (type 8) (param $v i64) (local $p i32)
+    (local.set $p (i32.const 544))
+    (loop $digits
+      (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+      (i64.store8 (local.get $p) (i64.add (i64.rem_u (local.get $v) (i64.const 10)) (i64.const 48)))
+      (local.set $v (i64.div_u (local.get $v) (i64.const 10)))
+      (br_if $digits (i64.ne (local.get $v) (i64.const 0))))
+    (call $print (local.get $p) (i32.sub (i32.const 544) (local.get $p))))
+
+  ;; waits until $fd is readable; fails after 10 s
+  (func $wait_readable (type 6) (param $fd i32)
+    ;; fd_read on $fd, userdata 1
+    (i64.store (i32.const 128) (i64.const 1))
+    (i32.store8 (i32.const 136) (i32.const 1))
+    (i32.store (i32.const 144) (local.get $fd))
+    ;; relative monotonic clock, userdata 2
+    (i64.store (i32.const 176) (i64.const 2))
+    (i32.store8 (i32.const 184) (i32.const 0))
+    (i32.store (i32.const 192) (i32.const 1))
+    (i64.store (i32.const 200) (i64.const 10000000000))
+    (i64.store (i32.const 208) (i64.const 0))
+    (i32.store16 (i32.const 216) (i32.const 0))
+
+    (call $check (call $poll_oneoff (i32.const 128) (i32.const 224) (i32.const 2) (i32.const 92)))
+    ;; the first event must be the fd, without an error
+    (call $check (i64.ne (i64.load (i32.const 224)) (i64.const 1)))
+    (call $check (i32.load16_u (i32.const 232))))
+
+  (func $_start (type 9) (local $conn i32) (local $n i32) (local $off i32) (local $total i64) (local $err i32)
+    ;; NONBLOCK
+    (call $check (call $fd_fdstat_set_flags (i32.const 5) (i32.const 4)))
+
+    ;; nobody connects before this line is printed
+    (call $check (i32.ne (call $sock_accept (i32.const 5) (i32.const 0) (i32.const 76)) (i32.const 6)))
+    (call $print (i32.const 336) (i32.const 14))
+
+    (call $wait_readable (i32.const 5))
+    (call $check (call $sock_accept (i32.const 5) (i32.const 0) (i32.const 76)))
+    (local.set $conn (i32.load (i32.const 76)))
+
+    ;; 300 + 212 bytes per receive
+    (i32.store (i32.const 96)  (i32.const 1024))
+    (i32.store (i32.const 100) (i32.const 300))
+    (i32.store (i32.const 104) (i32.const 1324))
+    (i32.store (i32.const 108) (i32.const 212))
+
+    (block $eof
+      (loop $next
+        (call $wait_readable (local.get $conn))
+        (call $check (call $sock_recv (local.get $conn) (i32.const 96) (i32.const 2) (i32.const 0) (i32.const 80) (i32.const 84)))
+        (local.set $n (i32.load (i32.const 80)))
+        (br_if $eof (i32.eqz (local.get $n)))
+        (local.set $total (i64.add (local.get $total) (i64.extend_i32_u (local.get $n))))
+
+        (local.set $off (i32.const 0))
+        (loop $send
+          (i32.store (i32.const 112) (i32.add (i32.const 1024) (local.get $off)))
+          (i32.store (i32.const 116) (i32.sub (local.get $n) (local.get $off)))
+          (call $check (call $sock_send (local.get $conn) (i32.const 112) (i32.const 1) (i32.const 0) (i32.const 88)))
+          (local.set $off (i32.add (local.get $off) (i32.load (i32.const 88))))
+          (br_if $send (i32.lt_u (local.get $off) (local.get $n))))
+        (br $next)))
+
+    ;; SHUT_WR
+    (call $check (call $sock_shutdown (local.get $conn) (i32.const 2)))
+    (call $check (call $fd_close (local.get $conn)))
+
+    (call $print (i32.const 352) (i32.const 7))
+    (call $print_u64 (local.get $total))
+    (call $print (i32.const 368) (i32.const 7))
+    (call $print (i32.const 384) (i32.const 8)))
+
+  (export "_start" (func $_start)))
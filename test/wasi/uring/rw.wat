@@ -0,0 +1,119 @@
+;; Vectored file I/O for the io_uring backend (BUILD_WASI=uring): every iovec of a
+;; read or write goes out as its own fixed-buffer request, linked at the file
+;; position and concurrent for reads at an offset. Checks the byte counts, the
+;; order the pieces land in and short transfers at end of file.
+(module
+  (type (;0;) (func (param i32 i32 i32 i32 i32 i64 i64 i32 i32) (result i32)))
+  (type (;1;) (func (param i32 i32 i32 i32) (result i32)))
+  (type (;2;) (func (param i32 i32 i32 i64 i32) (result i32)))
+  (type (;3;) (func (param i32) (result i32)))
+  (type (;4;) (func (param i32 i32 i32) (result i32)))
+  (type (;5;) (func (param i32)))
+  (type (;6;) (func (param i32 i32)))
+  (type (;7;) (func))
+
+  (import "wasi_snapshot_preview1" "path_open"        (func $path_open        (type 0)))
+  (import "wasi_snapshot_preview1" "fd_write"         (func $fd_write         (type 1)))
+  (import "wasi_snapshot_preview1" "fd_read"          (func $fd_read          (type 1)))
+  (import "wasi_snapshot_preview1" "fd_pwrite"        (func $fd_pwrite        (type 2)))
+  (import "wasi_snapshot_preview1" "fd_pread"         (func $fd_pread         (type 2)))
+  (import "wasi_snapshot_preview1" "fd_close"         (func $fd_close         (type 3)))
+  (import "wasi_snapshot_preview1" "path_unlink_file" (func $path_unlink_file (type 4)))
+  (import "wasi_snapshot_preview1" "proc_exit"        (func $proc_exit        (type 5)))
+
+  ;; 64: iovecs, 128: byte count, 132: opened fd, 512: read buffer
+  (memory (export "memory") 1)
+
+  (data (i32.const 256) "rw.tmp")
+  (data (i32.const 272) "abc")
+  (data (i32.const 280) "defgh")
+  (data (i32.const 288) "XY")
+  (data (i32.const 296) "Z")
+  (data (i32.const 304) "abcdefghXYZ")
+  (data (i32.const 320) "FAIL\n")
+  (data (i32.const 336) "rw OK\n")
+
+  (func $print (type 6) (param $ptr i32) (param $len i32)
+    (i32.store (i32.const 64) (local.get $ptr))
+    (i32.store (i32.const 68) (local.get $len))
+    (drop (call $fd_write (i32.const 1) (i32.const 64) (i32.const 1) (i32.const 128))))
+
+  ;; prints FAIL and exits unless $ok
+  (func $check (type 5) (param $ok i32)
+    (if (i32.eqz (local.get $ok))
+      (then
+        (call $print (i32.const 320) (i32.const 5))
+        (call $proc_exit (i32.const 1)))))
+
+  (func $iovec (param $index i32) (param $ptr i32) (param $len i32)
+    (i32.store (i32.add (i32.const 64) (i32.shl (local.get $index) (i32.const 3))) (local.get $ptr))
+    (i32.store (i32.add (i32.const 68) (i32.shl (local.get $index) (i32.const 3))) (local.get $len)))
+
+  ;; compares $len bytes at $a and $b
+  (func $equal (param $a i32) (param $b i32) (param $len i32) (result i32)
+    (block $differ
+      (loop $next
+        (if (i32.eqz (local.get $len)) (then (return (i32.const 1))))
+        (br_if $differ (i32.ne (i32.load8_u (local.get $a)) (i32.load8_u (local.get $b))))
+        (local.set $a (i32.add (local.get $a) (i32.const 1)))
+        (local.set $b (i32.add (local.get $b) (i32.const 1)))
+        (local.set $len (i32.sub (local.get $len) (i32.const 1)))
+        (br $next)))
+    (i32.const 0))
+
+  (func $count (param $expected i32) (result i32)
+    (i32.eq (i32.load (i32.const 128)) (local.get $expected)))
+
+  (func $start (type 7)
+    (local $fd i32)
+
+    ;; create with read, write, seek and tell rights
+    (call $check (i32.eqz (call $path_open (i32.const 3) (i32.const 1) (i32.const 256) (i32.const 6)
+                                           (i32.const 9) (i64.const 0x66) (i64.const 0) (i32.const 0) (i32.const 132))))
+    (local.set $fd (i32.load (i32.const 132)))
+
+    ;; three pieces at the file position, one of them empty
+    (call $iovec (i32.const 0) (i32.const 272) (i32.const 3))
+    (call $iovec (i32.const 1) (i32.const 272) (i32.const 0))
+    (call $iovec (i32.const 2) (i32.const 280) (i32.const 5))
+    (call $check (i32.eqz (call $fd_write (local.get $fd) (i32.const 64) (i32.const 3) (i32.const 128))))
+    (call $check (call $count (i32.const 8)))
+
+    ;; two pieces at an offset
+    (call $iovec (i32.const 0) (i32.const 288) (i32.const 2))
+    (call $iovec (i32.const 1) (i32.const 296) (i32.const 1))
+    (call $check (i32.eqz (call $fd_pwrite (local.get $fd) (i32.const 64) (i32.const 2) (i64.const 8) (i32.const 128))))
+    (call $check (call $count (i32.const 3)))
+
+    ;; reads at an offset stop at the end of the file: 11 bytes into 2 + 3 + 20
+    (call $iovec (i32.const 0) (i32.const 512) (i32.const 2))
+    (call $iovec (i32.const 1) (i32.const 514) (i32.const 3))
+    (call $iovec (i32.const 2) (i32.const 517) (i32.const 20))
+    (call $check (i32.eqz (call $fd_pread (local.get $fd) (i32.const 64) (i32.const 3) (i64.const 0) (i32.const 128))))
+    (call $check (call $count (i32.const 11)))
+    (call $check (call $equal (i32.const 512) (i32.const 304) (i32.const 11)))
+
+    ;; a short first piece ends the transfer
+    (call $iovec (i32.const 0) (i32.const 600) (i32.const 4))
+    (call $iovec (i32.const 1) (i32.const 604) (i32.const 4))
+    (call $check (i32.eqz (call $fd_pread (local.get $fd) (i32.const 64) (i32.const 2) (i64.const 9) (i32.const 128))))
+    (call $check (call $count (i32.const 2)))
+    (call $check (call $equal (i32.const 600) (i32.const 313) (i32.const 2)))
+
+    ;; the writes above left the file position at 8
+    (call $iovec (i32.const 0) (i32.const 700) (i32.const 1))
+    (call $iovec (i32.const 1) (i32.const 701) (i32.const 10))
+    (call $check (i32.eqz (call $fd_read (local.get $fd) (i32.const 64) (i32.const 2) (i32.const 128))))
+    (call $check (call $count (i32.const 3)))
+    (call $check (call $equal (i32.const 700) (i32.const 312) (i32.const 3)))
+
+    ;; and at the end of the file there is nothing left
+    (call $check (i32.eqz (call $fd_read (local.get $fd) (i32.const 64) (i32.const 2) (i32.const 128))))
+    (call $check (call $count (i32.const 0)))
+
+    (call $check (i32.eqz (call $fd_close (local.get $fd))))
+    (call $check (i32.eqz (call $path_unlink_file (i32.const 3) (i32.const 256) (i32.const 6))))
+    (call $print (i32.const 336) (i32.const 6)))
+
+  (export "_start" (func $start))
+)